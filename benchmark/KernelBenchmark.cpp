@@ -0,0 +1,315 @@
+#include "Geometry/GalaxyGenerator.h"
+#include "Menu.h"
+#include "Vulkan/GpuSimulation.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Times the acceleration and integration passes in isolation, without window, for several numbers of stars and
+// interaction rates, and writes the results as JSON. The acceleration and leapfrog passes are timed on the generated
+// order of the stars, then once the stars are sorted along the Z-curve on the device, with the time of the sort.
+// Each measure is the median wall time of single submissions, fence included: for small galaxies it is bounded by the
+// latency of a submission rather than by the shader. The median GPU time of the same submissions, between the
+// timestamps of the pass, is reported next to it, and the throughputs are given for both.
+
+namespace
+{
+/// Parameters of the benchmark.
+struct BenchmarkOptions
+{
+    std::vector<uint32_t> NbStars{1000, 10000, 100000, 1000000};
+    std::vector<float> InteractionRates{0.01f, 0.1f, 1.f};
+    AccelerationPass::Kernel Kernel = AccelerationPass::Kernel::Direct;
+    /// Minimum time spent on each measure, and minimum number of repetitions.
+    double MinSeconds = 0.5;
+    uint32_t MinRepetitions = 5;
+    /// Output file, standard output if empty.
+    std::string OutputPath;
+};
+
+/// Timing of one pass.
+struct Measure
+{
+    uint32_t Repetitions = 0;
+    double MedianSeconds = 0.0;
+    double MinSeconds = 0.0;
+    /// Median time between the timestamps of the pass, 0 if not measured.
+    double MedianGpuSeconds = 0.0;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+const char *NextValue(int iArgc, char **iArgv, int &ioIndex)
+{
+    if (ioIndex + 1 >= iArgc)
+        throw std::invalid_argument(std::string("missing value after ") + iArgv[ioIndex]);
+    return iArgv[++ioIndex];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template <typename T>
+std::vector<T> ToList(const std::string &iValue)
+{
+    std::vector<T> values;
+    std::stringstream stream(iValue);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        try
+        {
+            if constexpr (std::is_integral_v<T>)
+                values.push_back(static_cast<T>(std::stoul(item)));
+            else
+                values.push_back(static_cast<T>(std::stod(item)));
+        }
+        catch (const std::exception &)
+        {
+            throw std::invalid_argument("invalid list: " + iValue);
+        }
+    }
+    if (values.empty())
+        throw std::invalid_argument("empty list: " + iValue);
+    return values;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+BenchmarkOptions ParseOptions(int iArgc, char **iArgv)
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < iArgc; ++i)
+    {
+        const std::string arg = iArgv[i];
+        if (arg == "--stars")
+            options.NbStars = ToList<uint32_t>(NextValue(iArgc, iArgv, i));
+        else if (arg == "--interaction-rates")
+            options.InteractionRates = ToList<float>(NextValue(iArgc, iArgv, i));
+        else if (arg == "--kernel")
+        {
+            const std::string kernel = NextValue(iArgc, iArgv, i);
+            if (kernel == "tiled")
+                options.Kernel = AccelerationPass::Kernel::Tiled;
+            else if (kernel == "direct")
+                options.Kernel = AccelerationPass::Kernel::Direct;
+            else
+                throw std::invalid_argument("unknown acceleration kernel: " + kernel);
+        }
+        else if (arg == "--min-time")
+            options.MinSeconds = ToList<double>(NextValue(iArgc, iArgv, i)).front();
+        else if (arg == "--repetitions")
+            options.MinRepetitions = std::max(ToList<uint32_t>(NextValue(iArgc, iArgv, i)).front(), 1u);
+        else if (arg == "--output")
+            options.OutputPath = NextValue(iArgc, iArgv, i);
+        else
+            throw std::invalid_argument("unknown argument: " + arg);
+    }
+    return options;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string GetUsage()
+{
+    return "Usage: GalaxyBenchmark [options]\n"
+           "  --stars <n,n,...>              Numbers of stars (default 1000,10000,100000,1000000).\n"
+           "  --interaction-rates <f,f,...>  Interaction rates (default 0.01,0.1,1).\n"
+           "  --kernel <name>                Acceleration shader: direct (default) or tiled.\n"
+           "  --min-time <s>                 Minimum time of each measure (default 0.5).\n"
+           "  --repetitions <n>              Minimum repetitions of each measure (default 5).\n"
+           "  --output <file>                JSON output file (default standard output).\n";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @param iPass Runs the pass once and waits for it.
+/// @param iGpuTime Gives the GPU time of the last pass read back, in milliseconds. The compute passes read the
+///                 timestamps of the previous submission when they are submitted: the warm up run is read first.
+Measure Time(
+    const std::function<void()> &iPass, const std::function<float()> &iGpuTime, const BenchmarkOptions &iOptions)
+{
+    // First run out of the measure: pipeline and memory warm up.
+    iPass();
+
+    std::vector<double> durations;
+    std::vector<double> gpuDurations;
+    double total = 0.0;
+    while (durations.size() < iOptions.MinRepetitions || total < iOptions.MinSeconds)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        iPass();
+        auto end = std::chrono::high_resolution_clock::now();
+        durations.push_back(std::chrono::duration<double>(end - start).count());
+        gpuDurations.push_back(iGpuTime() * 1e-3);
+        total += durations.back();
+    }
+
+    std::sort(durations.begin(), durations.end());
+    std::sort(gpuDurations.begin(), gpuDurations.end());
+    Measure measure;
+    measure.Repetitions = static_cast<uint32_t>(durations.size());
+    measure.MedianSeconds = durations[durations.size() / 2];
+    measure.MinSeconds = durations.front();
+    measure.MedianGpuSeconds = gpuDurations[gpuDurations.size() / 2];
+    return measure;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @return iNumerator / iDenominator, 0 for a null denominator: no interaction, or a time not measured.
+double Divide(double iNumerator, double iDenominator)
+{
+    return iDenominator > 0.0 ? iNumerator / iDenominator : 0.0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @return Number of sources of each star, Count of GetSources in sources.glsl: ceil(InteractionRate * NbPoints) stars,
+///  one every Stride stars from an Offset that rotates with the steps. At most: with an Offset, the last strided
+///  sources may fall past the end of the buffer.
+uint64_t GetNbSources(uint32_t iNbStars, float iInteractionRate)
+{
+    double nbSources = std::ceil(static_cast<double>(iInteractionRate) * iNbStars);
+    return static_cast<uint64_t>(std::clamp(nbSources, 0.0, static_cast<double>(iNbStars)));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void WriteMeasure(std::ostream &oStream, const Measure &iMeasure)
+{
+    oStream << "\"repetitions\": " << iMeasure.Repetitions << ", \"median_ms\": " << iMeasure.MedianSeconds * 1e3
+            << ", \"min_ms\": " << iMeasure.MinSeconds * 1e3
+            << ", \"gpu_median_ms\": " << iMeasure.MedianGpuSeconds * 1e3;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Run(const BenchmarkOptions &iOptions, std::ostream &oStream)
+{
+    olp::Instance instance;
+    instance.CreateInstance("Galaxy benchmark", nullptr, 0);
+    GpuSimulation simulation(instance);
+
+    const Menu::GalaxyParameters galaxy;
+    const Menu::RealTimeParameters realTime;
+    simulation.SetStep(realTime.Step);
+    simulation.SetSmoothLenght(realTime.SmoothingLenght);
+
+    oStream << "{\n"
+            << "  \"kernel\": \"" << (iOptions.Kernel == AccelerationPass::Kernel::Tiled ? "tiled" : "direct") << "\",\n"
+            << "  \"results\": [";
+
+    bool first = true;
+    for (uint32_t nbStars : iOptions.NbStars)
+    {
+        simulation.InitializeGalaxy(
+            GenerateGalaxy(nbStars, galaxy.Diameter, galaxy.Thickness, galaxy.StarsSpeed),
+            galaxy.BlackHoleMass,
+            iOptions.Kernel);
+
+        simulation.SetInteractionRate(iOptions.InteractionRates.front());
+        simulation.ComputeAccelerations();
+        const Measure integration = Time(
+            [&simulation] { simulation.Integrate(); },
+            [&simulation] { return simulation.GetIntegrationTime(); },
+            iOptions);
+
+        for (bool sorted : {false, true})
+        {
+            // Sorting sorted stars costs the same: every sort runs all its passes.
+            Measure reorder;
+            if (sorted)
+                reorder = Time(
+                    [&simulation] { simulation.Reorder(); },
+                    [&simulation] { return simulation.GetReorderTime(); },
+                    iOptions);
+
+            for (float interactionRate : iOptions.InteractionRates)
+            {
+                simulation.SetInteractionRate(interactionRate);
+                const Measure acceleration = Time(
+                    [&simulation] { simulation.ComputeAccelerations(); },
+                    [&simulation] { return simulation.GetAccelerationTime(); },
+                    iOptions);
+                const Measure leapfrog = Time(
+                    [&simulation] { simulation.Leapfrog(); },
+                    [&simulation] { return simulation.GetLeapfrogTime(); },
+                    iOptions);
+
+                const uint64_t nbInteractions = nbStars * GetNbSources(nbStars, interactionRate);
+                const double stepSeconds = acceleration.MedianSeconds + integration.MedianSeconds;
+                const double gpuStepSeconds = acceleration.MedianGpuSeconds + integration.MedianGpuSeconds;
+                std::cerr << nbStars << " stars" << (sorted ? " sorted" : "") << ", interaction rate " << interactionRate
+                          << ": " << acceleration.MedianSeconds * 1e3 << " ms + " << integration.MedianSeconds * 1e3
+                          << " ms, fused " << leapfrog.MedianSeconds * 1e3 << " ms (GPU "
+                          << acceleration.MedianGpuSeconds * 1e3 << " ms + " << integration.MedianGpuSeconds * 1e3
+                          << " ms, fused " << leapfrog.MedianGpuSeconds * 1e3 << " ms)" << std::endl;
+
+                oStream << (first ? "\n" : ",\n")
+                        << "    {\"stars\": " << nbStars << ", \"order\": \"" << (sorted ? "z-curve" : "generated")
+                        << "\", \"interaction_rate\": " << interactionRate << ", \"interactions\": " << nbInteractions
+                        << ",\n"
+                        << "     \"acceleration\": {";
+                WriteMeasure(oStream, acceleration);
+                oStream << ", \"ns_per_interaction\": "
+                        << Divide(acceleration.MedianSeconds * 1e9, static_cast<double>(nbInteractions))
+                        << ", \"gpu_ns_per_interaction\": "
+                        << Divide(acceleration.MedianGpuSeconds * 1e9, static_cast<double>(nbInteractions)) << "},\n"
+                        << "     \"integration\": {";
+                WriteMeasure(oStream, integration);
+                oStream << ", \"ns_per_star\": " << integration.MedianSeconds * 1e9 / nbStars
+                        << ", \"gpu_ns_per_star\": " << integration.MedianGpuSeconds * 1e9 / nbStars << "},\n"
+                        << "     \"leapfrog\": {";
+                WriteMeasure(oStream, leapfrog);
+                oStream << "},\n";
+                if (sorted)
+                {
+                    oStream << "     \"reorder\": {";
+                    WriteMeasure(oStream, reorder);
+                    oStream << "},\n";
+                }
+                oStream << "     \"steps_per_second\": " << Divide(1.0, stepSeconds)
+                        << ", \"fused_steps_per_second\": " << Divide(1.0, leapfrog.MedianSeconds)
+                        << ", \"gpu_steps_per_second\": " << Divide(1.0, gpuStepSeconds)
+                        << ", \"gpu_fused_steps_per_second\": " << Divide(1.0, leapfrog.MedianGpuSeconds) << "}";
+                first = false;
+            }
+        }
+
+        simulation.ReleaseGalaxy();
+    }
+    oStream << "\n  ]\n}\n";
+
+    simulation.ReleaseResources();
+    instance.Destroy();
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BenchmarkOptions options;
+    try
+    {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << e.what() << "\n"
+                  << GetUsage();
+        return 1;
+    }
+
+    if (options.OutputPath.empty())
+    {
+        Run(options, std::cout);
+        return 0;
+    }
+
+    std::ofstream file(options.OutputPath);
+    if (!file)
+    {
+        std::cerr << "cannot open " << options.OutputPath << std::endl;
+        return 1;
+    }
+    Run(options, file);
+    return 0;
+}
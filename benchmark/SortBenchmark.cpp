@@ -0,0 +1,390 @@
+#include "Olympus/Debug.h"
+#include "Olympus/Device.h"
+#include "Olympus/Instance.h"
+#include "Vulkan/RadixSort.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Times the radix sort of the device on random keys, without window, for several numbers of keys and key sizes, and
+// writes the results as JSON. Before the measures, small sorts are checked against std::stable_sort: 32 and 64-bit
+// keys, on all their bits or fewer, with partial last blocks and with many equal keys. The first sort of each measured
+// case is checked too. A wrong order stops the run with an exit code of 1.
+// Each measure is the median of single submissions: the wall time includes the submission and the fence wait, the GPU
+// time only the dispatches.
+
+namespace
+{
+/// Parameters of the benchmark.
+struct BenchmarkOptions
+{
+    std::vector<uint32_t> NbKeys{100000, 1000000, 10000000};
+    /// Sizes of the keys, 32 or 64 bits.
+    std::vector<uint32_t> KeyBits{32, 64};
+    /// Minimum time spent on each measure, and minimum number of repetitions.
+    double MinSeconds = 0.5;
+    uint32_t MinRepetitions = 5;
+    /// Output file, standard output if empty.
+    std::string OutputPath;
+};
+
+/// Timing of the sort.
+struct Measure
+{
+    uint32_t Repetitions = 0;
+    double MedianSeconds = 0.0;
+    double MedianGpuSeconds = 0.0;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+const char *NextValue(int iArgc, char **iArgv, int &ioIndex)
+{
+    if (ioIndex + 1 >= iArgc)
+        throw std::invalid_argument(std::string("missing value after ") + iArgv[ioIndex]);
+    return iArgv[++ioIndex];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<uint32_t> ToList(const std::string &iValue)
+{
+    std::vector<uint32_t> values;
+    std::stringstream stream(iValue);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        try
+        {
+            values.push_back(static_cast<uint32_t>(std::stoul(item)));
+        }
+        catch (const std::exception &)
+        {
+            throw std::invalid_argument("invalid list: " + iValue);
+        }
+    }
+    if (values.empty())
+        throw std::invalid_argument("empty list: " + iValue);
+    return values;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+BenchmarkOptions ParseOptions(int iArgc, char **iArgv)
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < iArgc; ++i)
+    {
+        const std::string arg = iArgv[i];
+        if (arg == "--keys")
+            options.NbKeys = ToList(NextValue(iArgc, iArgv, i));
+        else if (arg == "--key-bits")
+        {
+            options.KeyBits = ToList(NextValue(iArgc, iArgv, i));
+            for (uint32_t keyBits : options.KeyBits)
+                if (keyBits != 32 && keyBits != 64)
+                    throw std::invalid_argument("key bits must be 32 or 64: " + std::to_string(keyBits));
+        }
+        else if (arg == "--min-time")
+            options.MinSeconds = std::stod(NextValue(iArgc, iArgv, i));
+        else if (arg == "--repetitions")
+            options.MinRepetitions = std::max(ToList(NextValue(iArgc, iArgv, i)).front(), 1u);
+        else if (arg == "--output")
+            options.OutputPath = NextValue(iArgc, iArgv, i);
+        else
+            throw std::invalid_argument("unknown argument: " + arg);
+    }
+    return options;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string GetUsage()
+{
+    return "Usage: GalaxySortBenchmark [options]\n"
+           "  --keys <n,n,...>               Numbers of keys (default 100000,1000000,10000000).\n"
+           "  --key-bits <n,n,...>           Sizes of the keys, 32 or 64 (default 32,64).\n"
+           "  --min-time <s>                 Minimum time of each measure (default 0.5).\n"
+           "  --repetitions <n>              Minimum repetitions of each measure (default 5).\n"
+           "  --output <file>                JSON output file (default standard output).\n";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+olp::MemoryBuffer CreateDeviceBuffer(const olp::Device &iDevice, VkDeviceSize iSize)
+{
+    return iDevice.CreateMemoryBuffer(
+        iSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Upload(const olp::Device &iDevice, const void *iData, olp::MemoryBuffer &oBuffer)
+{
+    olp::MemoryBuffer stagingBuffer = iDevice.CreateMemoryBuffer(
+        oBuffer.Size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void *data = nullptr;
+    VK_CHECK_RESULT(vkMapMemory(iDevice.GetDevice(), stagingBuffer.Memory, 0, oBuffer.Size, 0, &data))
+    std::memcpy(data, iData, static_cast<size_t>(oBuffer.Size));
+    vkUnmapMemory(iDevice.GetDevice(), stagingBuffer.Memory);
+    oBuffer.CopyFrom(stagingBuffer.Buffer, oBuffer.Size);
+    stagingBuffer.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Download(const olp::Device &iDevice, const olp::MemoryBuffer &iBuffer, void *oData)
+{
+    olp::MemoryBuffer stagingBuffer = iDevice.CreateMemoryBuffer(
+        iBuffer.Size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer.CopyFrom(iBuffer.Buffer, iBuffer.Size);
+    void *data = nullptr;
+    VK_CHECK_RESULT(vkMapMemory(iDevice.GetDevice(), stagingBuffer.Memory, 0, iBuffer.Size, 0, &data))
+    std::memcpy(oData, data, static_cast<size_t>(iBuffer.Size));
+    vkUnmapMemory(iDevice.GetDevice(), stagingBuffer.Memory);
+    stagingBuffer.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @return Random keys on their iKeyBits low bits. With iNbDistinct above 0, only that many values, spread over these
+///  bits so every pass moves equal keys.
+template <typename Key>
+std::vector<Key> GenerateKeys(uint32_t iNbKeys, uint32_t iKeyBits, uint32_t iNbDistinct)
+{
+    std::mt19937_64 random(iNbKeys + iKeyBits);
+    const Key mask = iKeyBits < sizeof(Key) * 8 ? static_cast<Key>((Key(1) << iKeyBits) - 1) : static_cast<Key>(~Key(0));
+    std::vector<Key> keys(iNbKeys);
+    for (Key &key : keys)
+    {
+        key = static_cast<Key>(random()) & mask;
+        if (iNbDistinct > 0)
+            key = static_cast<Key>((key % iNbDistinct) * (mask / iNbDistinct));
+    }
+    return keys;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// Sorts keys on the device, with their index as value, and compares the result with std::stable_sort.
+/// Throws std::runtime_error if a key or a value is out of place.
+template <typename Key>
+void CheckSort(
+    const olp::Device &iDevice,
+    VkDescriptorPool iDescriptorPool,
+    const std::vector<Key> &iKeys,
+    uint32_t iKeyBits,
+    const std::string &iCase)
+{
+    const uint32_t nbKeys = static_cast<uint32_t>(iKeys.size());
+    std::vector<uint32_t> values(nbKeys);
+    for (uint32_t i = 0; i < nbKeys; ++i)
+        values[i] = i;
+
+    olp::MemoryBuffer keyBuffer = CreateDeviceBuffer(iDevice, sizeof(Key) * nbKeys);
+    olp::MemoryBuffer valueBuffer = CreateDeviceBuffer(iDevice, sizeof(uint32_t) * nbKeys);
+    RadixSort sort(iDevice);
+    sort.Create(
+        iDescriptorPool,
+        keyBuffer,
+        valueBuffer,
+        nbKeys,
+        sizeof(Key) == 8 ? RadixSort::KeySize::Bits64 : RadixSort::KeySize::Bits32);
+
+    Upload(iDevice, iKeys.data(), keyBuffer);
+    Upload(iDevice, values.data(), valueBuffer);
+    sort.Sort(nbKeys, iKeyBits);
+
+    std::vector<uint32_t> sortedValues(nbKeys);
+    std::vector<Key> sortedKeys(nbKeys);
+    Download(iDevice, valueBuffer, sortedValues.data());
+    Download(iDevice, keyBuffer, sortedKeys.data());
+
+    sort.Destroy();
+    valueBuffer.Destroy();
+    keyBuffer.Destroy();
+    VK_CHECK_RESULT(vkResetDescriptorPool(iDevice.GetDevice(), iDescriptorPool, 0))
+
+    // The sort is stable: the values are the indices of the keys in the stable order.
+    std::vector<uint32_t> expected(values);
+    std::stable_sort(
+        expected.begin(), expected.end(), [&iKeys](uint32_t iLeft, uint32_t iRight) { return iKeys[iLeft] < iKeys[iRight]; });
+    for (uint32_t i = 0; i < nbKeys; ++i)
+        if (sortedValues[i] != expected[i] || sortedKeys[i] != iKeys[expected[i]])
+            throw std::runtime_error(
+                "wrong order at " + std::to_string(i) + " of " + std::to_string(nbKeys) + " " +
+                std::to_string(iKeyBits) + "-bit keys (" + iCase + ")");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// Checks the sorts of 32 and 64-bit keys against std::stable_sort, on all their bits and on fewer bits, with partial
+/// last blocks, a single full block and many equal keys.
+/// Throws std::runtime_error at the first wrong order.
+/// @return Number of cases checked.
+uint32_t CheckSorts(const olp::Device &iDevice, VkDescriptorPool iDescriptorPool)
+{
+    const uint32_t block = RadixSort::KeysPerBlock;
+    const std::array<uint32_t, 6> sizes{2, 1000, block, block + 1, 3 * block - 1, 5 * block + 123};
+    uint32_t nbCases = 0;
+    for (uint32_t nbKeys : sizes)
+    {
+        for (uint32_t nbDistinct : {0u, 16u})
+        {
+            const std::string keys = nbDistinct > 0 ? "16 distinct keys" : "random keys";
+            // 30 and 63 bits are the Morton keys of 10 and 21 bits by axis.
+            for (uint32_t keyBits : {32u, 30u})
+                CheckSort(iDevice, iDescriptorPool, GenerateKeys<uint32_t>(nbKeys, keyBits, nbDistinct), keyBits, keys);
+            for (uint32_t keyBits : {64u, 63u})
+                CheckSort(iDevice, iDescriptorPool, GenerateKeys<uint64_t>(nbKeys, keyBits, nbDistinct), keyBits, keys);
+            nbCases += 4;
+        }
+    }
+    return nbCases;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// Sorts random keys on the device, checks the first result and times the next sorts.
+/// @return Timing of the sort, throws std::runtime_error if the result is wrong.
+template <typename Key>
+Measure Run(const olp::Device &iDevice, VkDescriptorPool iDescriptorPool, uint32_t iNbKeys, const BenchmarkOptions &iOptions)
+{
+    const uint32_t keyBits = sizeof(Key) * 8;
+    const std::vector<Key> keys = GenerateKeys<Key>(iNbKeys, keyBits, 0);
+    CheckSort(iDevice, iDescriptorPool, keys, keyBits, "measured case");
+
+    olp::MemoryBuffer keyBuffer = CreateDeviceBuffer(iDevice, sizeof(Key) * iNbKeys);
+    olp::MemoryBuffer valueBuffer = CreateDeviceBuffer(iDevice, sizeof(uint32_t) * iNbKeys);
+    RadixSort sort(iDevice);
+    sort.Create(
+        iDescriptorPool,
+        keyBuffer,
+        valueBuffer,
+        iNbKeys,
+        sizeof(Key) == 8 ? RadixSort::KeySize::Bits64 : RadixSort::KeySize::Bits32);
+    std::vector<uint32_t> values(iNbKeys);
+    for (uint32_t i = 0; i < iNbKeys; ++i)
+        values[i] = i;
+    Upload(iDevice, values.data(), valueBuffer);
+
+    // The keys are shuffled again before each measure, outside of it: a sorted input would scatter in order.
+    std::vector<double> durations;
+    std::vector<double> gpuDurations;
+    double total = 0.0;
+    while (durations.size() < iOptions.MinRepetitions || total < iOptions.MinSeconds)
+    {
+        Upload(iDevice, keys.data(), keyBuffer);
+        auto start = std::chrono::high_resolution_clock::now();
+        sort.Sort(iNbKeys, keyBits);
+        auto end = std::chrono::high_resolution_clock::now();
+        durations.push_back(std::chrono::duration<double>(end - start).count());
+        gpuDurations.push_back(sort.GetGpuTime() * 1e-3);
+        total += durations.back();
+    }
+
+    sort.Destroy();
+    valueBuffer.Destroy();
+    keyBuffer.Destroy();
+    VK_CHECK_RESULT(vkResetDescriptorPool(iDevice.GetDevice(), iDescriptorPool, 0))
+
+    std::sort(durations.begin(), durations.end());
+    std::sort(gpuDurations.begin(), gpuDurations.end());
+    Measure measure;
+    measure.Repetitions = static_cast<uint32_t>(durations.size());
+    measure.MedianSeconds = durations[durations.size() / 2];
+    measure.MedianGpuSeconds = gpuDurations[gpuDurations.size() / 2];
+    return measure;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Run(const BenchmarkOptions &iOptions, std::ostream &oStream)
+{
+    olp::Instance instance;
+    instance.CreateInstance("Galaxy sort benchmark", nullptr, 0);
+    olp::Device device(instance, VK_NULL_HANDLE);
+
+    VkDescriptorPoolSize storageBufferPoolSize{};
+    storageBufferPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    storageBufferPoolSize.descriptorCount = RadixSort::NbStorageDescriptors;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &storageBufferPoolSize;
+    poolInfo.maxSets = RadixSort::NbDescriptorSets;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateDescriptorPool(device.GetDevice(), &poolInfo, nullptr, &descriptorPool))
+
+    const uint32_t nbCases = CheckSorts(device, descriptorPool);
+    std::cerr << nbCases << " sorts checked against std::stable_sort" << std::endl;
+
+    oStream << "{\n"
+            << "  \"results\": [";
+
+    bool first = true;
+    for (uint32_t nbKeys : iOptions.NbKeys)
+    {
+        for (uint32_t keyBits : iOptions.KeyBits)
+        {
+            const Measure measure = keyBits == 64 ? Run<uint64_t>(device, descriptorPool, nbKeys, iOptions)
+                                                  : Run<uint32_t>(device, descriptorPool, nbKeys, iOptions);
+            const double gpuSeconds = measure.MedianGpuSeconds > 0.0 ? measure.MedianGpuSeconds : measure.MedianSeconds;
+            std::cerr << nbKeys << " " << keyBits << "-bit keys: " << measure.MedianSeconds * 1e3 << " ms, GPU "
+                      << measure.MedianGpuSeconds * 1e3 << " ms" << std::endl;
+
+            oStream << (first ? "\n" : ",\n")
+                    << "    {\"keys\": " << nbKeys << ", \"key_bits\": " << keyBits
+                    << ", \"repetitions\": " << measure.Repetitions << ", \"median_ms\": " << measure.MedianSeconds * 1e3
+                    << ", \"gpu_ms\": " << measure.MedianGpuSeconds * 1e3
+                    << ", \"million_keys_per_second\": " << nbKeys / gpuSeconds * 1e-6 << "}";
+            first = false;
+        }
+    }
+    oStream << "\n  ]\n}\n";
+
+    vkDestroyDescriptorPool(device.GetDevice(), descriptorPool, nullptr);
+    device.Destroy();
+    instance.Destroy();
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BenchmarkOptions options;
+    try
+    {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << e.what() << "\n"
+                  << GetUsage();
+        return 1;
+    }
+
+    try
+    {
+        if (options.OutputPath.empty())
+        {
+            Run(options, std::cout);
+            return 0;
+        }
+
+        std::ofstream file(options.OutputPath);
+        if (!file)
+        {
+            std::cerr << "cannot open " << options.OutputPath << std::endl;
+            return 1;
+        }
+        Run(options, file);
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
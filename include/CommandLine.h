@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Menu.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Options of the application, parsed from the command line.
+struct CommandLineOptions
+{
+    enum class Mode
+    {
+        /// Interactive simulation in a window.
+        Window,
+        /// Simulation on the CPU only, without window nor Vulkan device.
+        Cpu,
+        /// Compute passes on the GPU, without window, surface nor swapchain.
+        Headless
+    };
+
+    /// Solvers of the gravity available on the CPU.
+    enum class CpuSolver
+    {
+        Direct,
+        DirectSimd,
+        BarnesHut,
+        Fmm,
+        ParticleMesh
+    };
+
+    /// How the simulation is run.
+    Mode RunMode = Mode::Window;
+    /// Number of time steps to run, in the modes without window.
+    uint32_t NbSteps = 100;
+    /// Number of CPU threads. 0 to use every core.
+    uint32_t NbThreads = 0;
+
+    /// Solver of the CPU simulation.
+    CpuSolver Solver = CpuSolver::Direct;
+    /// Opening angle of the Barnes-Hut and FMM solvers.
+    float OpeningAngle = 0.5f;
+    /// Order of the expansions of the FMM solver.
+    uint32_t FmmOrder = 4;
+    /// Number of cells along each axis of the grid of the particle-mesh solver.
+    uint32_t PmGridSize = 128;
+    /// Deepest rung of the block time steps of the CPU simulation, whose step is Step / 2^MaxRung. 0 to disable.
+    uint32_t MaxRung = 0;
+    /// Step of a star relative to sqrt(softening / |acceleration|), with the block time steps.
+    float RungAccuracy = 0.25f;
+    /// Number of stars compared with the direct sum to report the error of the solver. 0 to disable.
+    uint32_t ForceErrorSamples = 0;
+    /// Number of stars compared with the direct sum to report the error of the sampled sources. 0 to disable.
+    uint32_t SamplingErrorSamples = 0;
+    /// Radius of the neighborhood of the stars, reported from a uniform grid at start and end of the run. 0 to disable.
+    float NeighborRadius = 0.f;
+
+    /// Compares the tiled acceleration shader with acceleration.comp before the headless run.
+    bool ValidateKernels = false;
+
+    /// Snapshot to start from, in the modes without window. Its parameters replace the ones of the command line.
+    std::string LoadPath;
+    /// Snapshot written at the end of the run, in the modes without window.
+    std::string SavePath;
+    /// Trajectory file written during the headless run. Empty to disable.
+    std::string RecordPath;
+    /// Number of steps between two records of the trajectory.
+    uint32_t RecordInterval = 10;
+    /// CSV log of the GPU time of the passes at each step of the headless run. Empty to disable.
+    std::string GpuTimesPath;
+
+    /// Galaxies given one by one, packed in one buffer. Empty for the galaxy, or the merger, of Galaxy.
+    std::vector<GalaxyDescription> Galaxies;
+
+    /// Parameters of the galaxy at start.
+    Menu::GalaxyParameters Galaxy;
+    /// Parameters of the simulation.
+    Menu::RealTimeParameters RealTime;
+};
+
+/// Parses the command line. Throws std::invalid_argument on unknown or malformed arguments.
+/// @param iArgc Number of arguments.
+/// @param iArgv Arguments, starting with the program name.
+/// @return Parsed options.
+CommandLineOptions ParseCommandLine(int iArgc, char **iArgv);
+
+/// @param iOptions Parsed options.
+/// @return Galaxies to pack in one buffer, from --galaxy or --galaxies. Empty for a single galaxy around the fixed
+///  black hole.
+std::vector<GalaxyDescription> GetGalaxies(const CommandLineOptions &iOptions);
+
+/// @return Help message listing the options.
+std::string GetCommandLineUsage();
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CommandLine.h"
+#include "Simulation/CpuSimulation.h"
+
+/// Runs the simulation on the CPU for a fixed number of steps, without window.
+class CpuRunner
+{
+public:
+    /// Constructor, generates the galaxy.
+    /// @param iOptions Parameters of the run.
+    explicit CpuRunner(const CommandLineOptions &iOptions);
+
+    /// Runs the steps and prints the throughput.
+    void Run();
+
+private:
+    /// Creates the solver chosen on the command line.
+    /// @return Solver of the gravity.
+    std::unique_ptr<ForceSolver> CreateSolver();
+
+    /// Prints the rungs of the stars and the force evaluations saved by the block time steps.
+    void PrintBlockSteps();
+
+    /// Prints the error of the solver against the direct sum.
+    void PrintForceError();
+
+    /// Prints the error of the fixed and the rotating sources against their cost, for halved interaction rates.
+    void PrintSamplingError();
+
+    /// Prints the center and bulk velocity of each galaxy, when several share the buffer.
+    void PrintGalaxies();
+
+    /// Prints the neighborhood of the stars, from a uniform grid.
+    void PrintNeighbors();
+
+    /// Parameters of the run.
+    CommandLineOptions m_Options;
+    /// CPU simulation.
+    CpuSimulation m_Simulation;
+    /// Ids of each galaxy when several share the buffer.
+    std::vector<GalaxyRange> m_GalaxyRanges;
+};
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <glm/vec3.hpp>
-#include <glm/vec4.hpp>
 #include <vulkan/vulkan.h>
 #include <vector>
 
@@ -11,10 +10,13 @@ struct CloudVertex
 {
     /// Position
     glm::vec3 Pos{};
-    /// Padding (necessary for the use in compute shader).
-    float pad1;
+    /// Mass, 1 for a star of the generator. Fills the padding of the position in the compute shaders.
+    float Mass = 1.f;
     /// star speed
-    glm::vec4 Speed{};
+    glm::vec3 Speed{};
+    /// Identifier of the star, its index in the generated galaxy. Kept when the stars are reordered, so the records of a
+    /// trajectory can follow a star. Fills the padding of the speed in the compute shaders.
+    uint32_t Id = 0;
 
     static VkVertexInputBindingDescription GetBindingDescription();
     static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Geometry/CloudVertex.h"
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <vector>
+
+/// A galaxy of a batch, placed among the others in one buffer of stars.
+struct GalaxyDescription
+{
+    uint32_t NbStars = 20000;
+    float Diameter = 100.f;
+    float Thickness = 5.f;
+    float StarsSpeed = 20.f;
+    /// Mass of the black hole of the galaxy, a star at its center. 0 for none.
+    float BlackHoleMass = 0.f;
+    /// Center of the galaxy.
+    glm::vec3 Position{0.f};
+    /// Bulk velocity of the galaxy, added to the speed of its stars.
+    glm::vec3 Velocity{0.f};
+    /// Rotation of the disk around the X axis, in degrees.
+    float Inclination = 0.f;
+};
+
+/// Stars of a galaxy of a batch. The range is on the Ids of the stars, so it holds when the stars are reordered.
+struct GalaxyRange
+{
+    static constexpr uint32_t NoBlackHole = UINT32_MAX;
+
+    uint32_t FirstId = 0;
+    /// Number of stars, the black hole left out.
+    uint32_t NbStars = 0;
+    /// Id of the black hole, one of the first stars of the batch. NoBlackHole for none.
+    uint32_t BlackHoleId = NoBlackHole;
+};
+
+/// Center and bulk motion of the stars of a galaxy.
+struct GalaxyMotion
+{
+    float Mass = 0.f;
+    glm::vec3 CenterOfMass{0.f};
+    glm::vec3 Velocity{0.f};
+};
+
+/// Generates the stars of a galaxy: a flattened sphere of stars orbiting around the vertical axis.
+/// @param iNbStars Number of stars in galaxy.
+/// @param iGalaxyDiameters Galaxy's diamater.
+/// @param iGalaxyThickness Galaxy's thickness.
+/// @param iInitialSpeed Stars' initial speed.
+/// @return Stars of the galaxy.
+std::vector<CloudVertex> GenerateGalaxy(uint32_t iNbStars, float iGalaxyDiameters, float iGalaxyThickness, float iInitialSpeed);
+
+/// Generates several galaxies in one buffer, one contiguous range of stars after the other, so a single dispatch
+/// computes the forces within and between the galaxies. The black holes come first, in the order of the galaxies:
+/// the solvers sum these CountBlackHoles first stars in full whatever the interaction rate.
+/// @param iGalaxies Galaxies to generate.
+/// @return Stars of all the galaxies, with consecutive Ids.
+std::vector<CloudVertex> GenerateGalaxies(const std::vector<GalaxyDescription> &iGalaxies);
+
+/// @param iGalaxies Galaxies given to GenerateGalaxies.
+/// @return Number of black holes, the first stars of the batch.
+uint32_t CountBlackHoles(const std::vector<GalaxyDescription> &iGalaxies);
+
+/// @param iGalaxies Galaxies given to GenerateGalaxies.
+/// @return Range of Ids of each galaxy.
+std::vector<GalaxyRange> GetGalaxyRanges(const std::vector<GalaxyDescription> &iGalaxies);
+
+/// Places copies of a galaxy evenly on a circle of the XZ plane, heading to its center a little off-axis, so they
+/// merge. Each disk is inclined differently.
+/// @param iGalaxy Parameters of each galaxy, its position, velocity and inclination are replaced.
+/// @param iNbGalaxies Number of galaxies.
+/// @param iSeparation Distance between a galaxy and the center of the circle.
+/// @param iSpeed Norm of the bulk velocity of each galaxy.
+/// @return Galaxies to give to GenerateGalaxies.
+std::vector<GalaxyDescription> ArrangeGalaxies(
+    const GalaxyDescription &iGalaxy, uint32_t iNbGalaxies, float iSeparation, float iSpeed);
+
+/// Measures the center of mass and bulk velocity of each galaxy of a batch. The stars with a NaN position are left out.
+/// @param iStars Stars of all the galaxies, in any order.
+/// @param iRanges Ranges of Ids of the galaxies.
+/// @return Motion of each galaxy.
+std::vector<GalaxyMotion> MeasureGalaxies(const std::vector<CloudVertex> &iStars, const std::vector<GalaxyRange> &iRanges);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Geometry/CloudVertex.h"
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include <vector>
+
+/// @brief
+///  A vertex drawn by the cloud pipeline, an 8-byte object: the position and the brightness of a star as half floats.
+///  Written by the integration step next to the CloudVertex, so the draw fetches a quarter of the bytes.
+struct RenderVertex
+{
+    /// Position (xyz) and brightness, the norm of the speed (w), as half floats.
+    uint16_t PosBrightness[4];
+
+    /// @return Vertex of a star, packed as the integration shaders do.
+    static RenderVertex FromStar(const CloudVertex &iStar);
+
+    static VkVertexInputBindingDescription GetBindingDescription();
+    static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
+};
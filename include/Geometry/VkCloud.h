@@ -4,9 +4,17 @@
 #include "Olympus/CommandBuffer.h"
 #include "Olympus/MemoryBuffer.h"
 #include "Geometry/CloudVertex.h"
+#include "Geometry/RenderVertex.h"
 #include <glm/vec3.hpp>
+#include <array>
+#include <functional>
 /// @brief
 ///  Class which holds, allocates and draws a cloud.
+///  The stars live in two vertex buffers: a step reads the current one and writes the other, so the current buffer
+///  can be drawn while the step runs. Advance swaps them once the step is submitted.
+///  Each vertex buffer has a render buffer, the compact stream drawn by the cloud pipeline, written by the same step.
+///  The speeds of the current buffer are half a step behind the positions (leapfrog). A step writes the speeds
+///  synchronized with the positions back to the buffer it reads, which the outputs read.
 class VkCloud
 {
 public:
@@ -19,21 +27,59 @@ public:
     VkCloud &operator=(VkCloud &&ioCloud) noexcept = default;
 
     void Init(uint32_t iNbStars, float iGalaxyDiameters, float iGalaxyThickness, float iInitialSpeed);
+    /// Uploads the given stars.
+    void Init(const std::vector<CloudVertex> &iStars);
+    /// Uploads the given stars, copied straight into the staging buffer.
+    /// @param iStars Stars, may point into a mapped file.
+    /// @param iNbStars Number of stars.
+    void Init(const CloudVertex *iStars, uint32_t iNbStars);
 
     void Destroy();
     void Draw(VkCommandBuffer commandBuffer);
 
-    const olp::MemoryBuffer &GetVertexBuffer() const { return m_VertexBuffer; }
-    uint32_t GetSize() const { return static_cast<uint32_t>(m_Cloud.size()); }
+    /// Copies the stars back from the synchronized buffer, see GetSyncedBuffer. The device must be idle.
+    /// @param iReader Called with the stars, mapped in a staging buffer for the duration of the call.
+    void ReadStars(const std::function<void(const CloudVertex *iStars)> &iReader) const;
+
+    /// Makes current the buffer written by the last of the submitted steps.
+    /// @param iNbSteps Number of steps submitted, each one swaps the buffers, as does a ReorderPass.
+    void Advance(uint32_t iNbSteps) { m_Current = (m_Current + iNbSteps) % 2; }
+
+    /// @return Vertex buffer holding the stars of the last submitted step.
+    const olp::MemoryBuffer &GetVertexBuffer() const { return m_VertexBuffers[m_Current]; }
+    /// @param iIndex 0 or 1.
+    const olp::MemoryBuffer &GetVertexBuffer(uint32_t iIndex) const { return m_VertexBuffers[iIndex]; }
+    /// @return Vertex buffer read by the last submitted step: the stars at its start, their speeds synchronized with
+    ///  their positions. The stars uploaded before the first step.
+    const olp::MemoryBuffer &GetSyncedBuffer() const { return m_VertexBuffers[1 - m_Current]; }
+    /// @param iIndex 0 or 1.
+    /// @return RenderVertex of each star of the vertex buffer iIndex.
+    const olp::MemoryBuffer &GetRenderBuffer(uint32_t iIndex) const { return m_RenderBuffers[iIndex]; }
+    /// @return Index of the current vertex buffer, 0 or 1.
+    uint32_t GetCurrent() const { return m_Current; }
+    uint32_t GetSize() const { return m_NbStars; }
 
 private:
-    ///  Allocate the cloud in the gpu memory.
-    void CreateVertexBuffer();
+    ///  Allocate the two buffers of the cloud in the gpu memory, the stars are uploaded in the first one.
+    void CreateVertexBuffer(const CloudVertex *iStars);
+
+    ///  Allocate the two render buffers in the gpu memory, the first one is filled from the stars.
+    void CreateRenderBuffer(const CloudVertex *iStars);
+
+    /// Copies the stars back from a vertex buffer. The device must be idle.
+    /// @param iBuffer Vertex buffer of the cloud.
+    /// @param iReader Called with the stars, mapped in a staging buffer for the duration of the call.
+    void ReadBuffer(
+        const olp::MemoryBuffer &iBuffer, const std::function<void(const CloudVertex *iStars)> &iReader) const;
 
     /// Vulkan device.
     olp::Device &m_Device;
-    /// Point cloud.
-    std::vector<CloudVertex> m_Cloud;
-    /// Vertex buffer.
-    olp::MemoryBuffer m_VertexBuffer;
+    /// Number of stars of the cloud, they live on the device only.
+    uint32_t m_NbStars = 0;
+    /// Vertex buffers, read and written in turn by the steps.
+    std::array<olp::MemoryBuffer, 2> m_VertexBuffers;
+    /// Render buffers, one for each vertex buffer.
+    std::array<olp::MemoryBuffer, 2> m_RenderBuffers;
+    /// Index of the buffer holding the stars of the last submitted step.
+    uint32_t m_Current = 0;
 };
\ No newline at end of file
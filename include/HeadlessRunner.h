@@ -0,0 +1,46 @@
+#pragma once
+
+#include "CommandLine.h"
+#include "Snapshot.h"
+#include "Vulkan/GpuSimulation.h"
+#include <memory>
+
+/// Runs the compute passes on the GPU for a fixed number of steps, without window, surface nor swapchain.
+class HeadlessRunner
+{
+public:
+    /// Constructor, creates the instance and the device, then uploads the galaxy.
+    /// @param iOptions Parameters of the run.
+    explicit HeadlessRunner(const CommandLineOptions &iOptions);
+
+    /// Destructor, releases the Vulkan resources.
+    ~HeadlessRunner();
+
+    /// Runs the steps and prints the throughput.
+    void Run();
+
+private:
+    /// Uploads the stars at start.
+    /// @param iKernel Shader of the acceleration pass.
+    void InitializeGalaxy(AccelerationPass::Kernel iKernel);
+
+    /// Compares the accelerations of the tiled shader with the ones of acceleration.comp, then two steps of the
+    /// leapfrog shader with two steps of the split passes, and prints the differences.
+    /// Throws std::runtime_error if a difference is above its tolerance, so the run exits with an error.
+    void ValidateKernels();
+
+    /// Parameters of the run.
+    CommandLineOptions m_Options;
+    /// Stars of the galaxy at start, generated or mapped from a snapshot.
+    std::vector<CloudVertex> m_Stars;
+    /// Ids of each galaxy when several share the buffer.
+    std::vector<GalaxyRange> m_GalaxyRanges;
+    /// Number of first stars that are the black holes of a merger.
+    uint32_t m_NbBlackHoles = 0;
+    std::unique_ptr<Snapshot> m_Snapshot;
+
+    /// Vulkan instance.
+    olp::Instance m_Instance;
+    /// Simulation on the device.
+    std::unique_ptr<GpuSimulation> m_Simulation;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Geometry/GalaxyGenerator.h"
 #include <string>
 #include <vector>
 #include <array>
@@ -15,6 +16,23 @@ public:
         float Thickness = 5.f;
         float StarsSpeed = 20.f;
         float BlackHoleMass = 1000.f;
+        /// Copies of the galaxy merging in one buffer. With more than one, each black hole is a star at the center of
+        /// its galaxy instead of the fixed black hole at the origin. Not saved in the snapshots.
+        int NbGalaxies = 1;
+        /// Distance between each galaxy and the center of the merger.
+        float Separation = 300.f;
+        /// Norm of the bulk velocity of each galaxy.
+        float ApproachSpeed = 10.f;
+        /// Stage the sources in shared memory in the acceleration shader (acceleration_tiled.comp).
+        bool TiledAcceleration = false;
+        /// Compute the accelerations and move the stars in one dispatch (leapfrog.comp) instead of two passes.
+        bool FusedLeapfrog = false;
+
+        /// @return Parameters of one galaxy, at rest at the origin.
+        GalaxyDescription GetDescription() const;
+        /// @return The NbGalaxies galaxies placed by ArrangeGalaxies. Empty for a single galaxy, which keeps the fixed
+        ///  black hole.
+        std::vector<GalaxyDescription> GetMerger() const;
     };
 
     struct RealTimeParameters
@@ -22,6 +40,48 @@ public:
         float Step = 0.0001f;
         float SmoothingLenght = 1.0f;
         float InteractionRate = 0.05f;
+        /// Rotate the gravity sources at each step, so every star attracts the others over time. Otherwise the same
+        /// InteractionRate of the stars are the sources forever.
+        bool RotateSources = true;
+        /// Number of time steps run for each frame drawn.
+        int Substeps = 1;
+        /// Choose each step on the GPU from the largest acceleration and speed, Step being the longest.
+        bool AdaptiveStep = false;
+        /// Part of the softening length a star may move, or be accelerated over, in an adaptive step.
+        float StepAccuracy = 0.01f;
+        /// Number of time steps between two sorts of the stars along the Z-curve, 0 to never sort them.
+        /// Not saved in the snapshots.
+        int ReorderInterval = 0;
+    };
+
+    /// GPU time of the passes of a frame, in milliseconds.
+    struct GpuTimes
+    {
+        float Acceleration = 0.f;
+        float Integration = 0.f;
+        /// Render pass until the stars are drawn.
+        float Cloud = 0.f;
+        /// Rest of the render pass: ImGui and resolve.
+        float ImGui = 0.f;
+        /// Reduction of the conserved quantities, once a frame.
+        float Reduction = 0.f;
+        /// Last sort of the stars along the Z-curve.
+        float Reorder = 0.f;
+    };
+
+    /// Conserved quantities and bounds of the stars, reduced on the GPU.
+    struct Quantities
+    {
+        float KineticEnergy = 0.f;
+        float PotentialEnergy = 0.f;
+        /// Norm of the momentum.
+        float Momentum = 0.f;
+        /// Norm of the angular momentum around the black hole.
+        float AngularMomentum = 0.f;
+        std::array<float, 3> CenterOfMass{};
+        /// Bounding box of the stars.
+        std::array<float, 3> Min{};
+        std::array<float, 3> Max{};
     };
 
     Menu(uint32_t iWidth, uint32_t iHeight);
@@ -32,23 +92,78 @@ public:
     void Resize(uint32_t iWidth, uint32_t iHeight);
     const GalaxyParameters &GetGalaxyParameters() { return m_GalaxyParameters; }
     const RealTimeParameters &GetRealTimeParameters() { return m_RealTimeParameters; }
+    /// Replaces the parameters shown by the menu, when a snapshot is loaded.
+    void SetParameters(const GalaxyParameters &iGalaxy, const RealTimeParameters &iRealTime);
 
     bool IsActive() const { return m_Active; }
     void SetVisible(bool iIsVisible) { m_Visible = iIsVisible; }
     bool IsVisible() const { return m_Visible; }
     bool IsRestart() const { return m_Restart; }
+    bool IsSaveSnapshot() const { return m_SaveSnapshot; }
+    bool IsLoadSnapshot() const { return m_LoadSnapshot; }
+    const char *GetSnapshotPath() const { return m_SnapshotPath.data(); }
+    bool IsRecording() const { return m_Recording; }
+    /// Unchecks the record box, when the recording cannot start or the galaxy is replaced.
+    void StopRecording() { m_Recording = false; }
+    const char *GetTrajectoryPath() const { return m_TrajectoryPath.data(); }
+    uint32_t GetRecordInterval() const { return static_cast<uint32_t>(m_RecordInterval); }
+    /// Counters of the recording shown by the menu.
+    void SetRecordedSteps(uint64_t iNbRecorded, uint64_t iNbDropped);
+    /// Adds the GPU times of a frame to the graphs.
+    void AddGpuTimes(const GpuTimes &iTimes);
+    bool IsLogGpuTimes() const { return m_LogGpuTimes; }
+    const char *GetGpuTimesPath() const { return m_GpuTimesPath.data(); }
+    /// Unchecks the log box, when the log file cannot be created.
+    void StopLogGpuTimes() { m_LogGpuTimes = false; }
+    /// Adds the quantities of a frame to the graphs.
+    void AddQuantities(const Quantities &iQuantities);
+    /// @return The quantities are reduced each frame.
+    bool IsMonitoring() const { return m_Monitoring; }
 
 private:
     void AddTitle(const std::string &iTitle);
     std::vector<bool> CenteredButtons(const std::vector<std::string> iTexts, float iButtonsHeight, float iSpacesSize);
     void UpdateFPS();
+    void PlotGpuTime(const char *iLabel, const std::array<float, 100> &iTimes);
+    void PlotQuantity(const char *iLabel, const std::array<float, 100> &iValues);
 
     bool m_Active = false;
     bool m_Visible = true;
     bool m_Restart = false;
+    bool m_SaveSnapshot = false;
+    bool m_LoadSnapshot = false;
+    /// Path of the snapshot file, edited in the menu.
+    std::array<char, 256> m_SnapshotPath{"galaxy.snapshot"};
+    bool m_Recording = false;
+    /// Path of the trajectory file, edited in the menu.
+    std::array<char, 256> m_TrajectoryPath{"galaxy.trajectory"};
+    int m_RecordInterval = 10;
+    uint64_t m_NbRecorded = 0;
+    uint64_t m_NbDropped = 0;
     GalaxyParameters m_GalaxyParameters;
     RealTimeParameters m_RealTimeParameters;
 
+    /// GPU times of the last frames, by pass, oldest first.
+    std::array<float, 100> m_AccelerationTimes{0};
+    std::array<float, 100> m_IntegrationTimes{0};
+    std::array<float, 100> m_CloudTimes{0};
+    std::array<float, 100> m_ImGuiTimes{0};
+    std::array<float, 100> m_ReductionTimes{0};
+    std::array<float, 100> m_ReorderTimes{0};
+    bool m_LogGpuTimes = false;
+    /// Path of the CSV log of the GPU times, edited in the menu.
+    std::array<char, 256> m_GpuTimesPath{"gpu_times.csv"};
+
+    bool m_Monitoring = true;
+    /// Quantities of the last frames, oldest first.
+    std::array<float, 100> m_Energies{0};
+    std::array<float, 100> m_KineticEnergies{0};
+    std::array<float, 100> m_PotentialEnergies{0};
+    std::array<float, 100> m_Momenta{0};
+    std::array<float, 100> m_AngularMomenta{0};
+    Quantities m_Quantities;
+    bool m_HasQuantities = false;
+
     int m_FrameCounter = 0;
     std::array<float, 50> m_FPS{0};
     float m_MaxFPS = 0;
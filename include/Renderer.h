@@ -5,6 +5,12 @@
 #include "Olympus/Swapchain.h"
 #include "Vulkan/IntegrationPass.h"
 #include "Vulkan/AccelerationPass.h"
+#include "Vulkan/LeapfrogPass.h"
+#include "Vulkan/ReductionPass.h"
+#include "Vulkan/ReorderPass.h"
+#include "Vulkan/TrajectoryRecorder.h"
+#include "Vulkan/GpuTimer.h"
+#include "Vulkan/StepPass.h"
 #include "Olympus/PipelineLayout.h"
 #include "Olympus/CloudPipeline.h"
 #include "Olympus/Image.h"
@@ -13,6 +19,9 @@
 #include "Olympus/UniformBuffer.h"
 #include "Olympus/ImGUI.h"
 #include "Geometry/VkCloud.h"
+#include "Menu.h"
+#include <algorithm>
+#include <filesystem>
 
 class Renderer
 {
@@ -37,11 +46,56 @@ public:
     /// @param iGalaxyThickness Galaxy's thickness.
     /// @param iInitialSpeed Stars' initial speed.
     /// @param iBlackHoleMass Mass of the black hole in the center of the galaxy.
-    void InitializeGalaxy(uint32_t iNbStars, float iGalaxyDiameters, float iGalaxyThickness, float iInitialSpeed, float iBlackHoleMass);
+    /// @param iAccelerationKernel Shader of the acceleration pass.
+    /// @param iScheme Passes running a time step.
+    void InitializeGalaxy(uint32_t iNbStars, float iGalaxyDiameters, float iGalaxyThickness, float iInitialSpeed, float iBlackHoleMass,
+                          AccelerationPass::Kernel iAccelerationKernel, IntegrationPass::Scheme iScheme);
+
+    /// Initialize Galaxy and ComputePass from existing stars.
+    /// @param iStars Stars of the galaxy, may point into a mapped snapshot.
+    /// @param iNbStars Number of stars in galaxy.
+    /// @param iBlackHoleMass Mass of the black hole in the center of the galaxy.
+    /// @param iAccelerationKernel Shader of the acceleration pass.
+    /// @param iScheme Passes running a time step.
+    /// @param iNbBlackHoles Number of first stars that are the black holes of a merger, see GenerateGalaxies.
+    void InitializeGalaxy(const CloudVertex *iStars, uint32_t iNbStars, float iBlackHoleMass,
+                          AccelerationPass::Kernel iAccelerationKernel, IntegrationPass::Scheme iScheme,
+                          uint32_t iNbBlackHoles = 0);
+
+    /// Initialize several galaxies in one cloud, see GenerateGalaxies. Their black holes are the first stars, summed in
+    /// full whatever the interaction rate, without the fixed black hole at the origin.
+    /// @param iGalaxies Galaxies of the batch.
+    /// @param iAccelerationKernel Shader of the acceleration pass.
+    /// @param iScheme Passes running a time step.
+    void InitializeGalaxies(const std::vector<GalaxyDescription> &iGalaxies,
+                            AccelerationPass::Kernel iAccelerationKernel, IntegrationPass::Scheme iScheme);
+
+    /// Saves the current stars in a snapshot file.
+    /// @param iPath Path of the snapshot.
+    /// @param iGalaxy Parameters of the galaxy at start.
+    /// @param iRealTime Parameters of the simulation.
+    void SaveSnapshot(const std::filesystem::path &iPath, const Menu::GalaxyParameters &iGalaxy,
+                      const Menu::RealTimeParameters &iRealTime);
 
     /// Release Galaxy and ComputePass.
     void ReleaseGalaxy();
 
+    /// Records the stars to a trajectory file every iInterval steps, while the frames are drawn.
+    /// Throws std::runtime_error if the file cannot be created.
+    /// @param iPath Path of the trajectory file.
+    /// @param iInterval Number of steps between two records.
+    void StartRecording(const std::filesystem::path &iPath, uint32_t iInterval);
+
+    /// Writes the records in flight and closes the trajectory file.
+    void StopRecording();
+
+    const TrajectoryRecorder &GetRecorder() const { return m_Recorder; }
+
+    /// @return GPU time of the passes, measured a few frames late.
+    const Menu::GpuTimes &GetGpuTimes() const { return m_GpuTimes; }
+    /// @return Conserved quantities of the stars, reduced a few frames late.
+    const Menu::Quantities &GetQuantities() const { return m_Quantities; }
+
     ///  Recreates swapchain resources.
     /// @param iWidth New swapchain width.
     /// @param iHeight New swapchain height.
@@ -55,9 +109,43 @@ public:
     /// @param iProj Projection matrix of the scene.
     void DrawNextFrame(const glm::mat4 &iView, const glm::mat4 &iProj);
 
-    void SetStep(float iStep) { m_DisplacementInfo.Step = iStep; };
-    void SetInteractionRate(float iInteractionRate) { m_AccelerationInfo.InteractionRate = iInteractionRate; };
-    void SetSmoothLenght(float iSmoothLenght) { m_AccelerationInfo.SmoothLenght = iSmoothLenght; };
+    void SetStep(float iStep)
+    {
+        m_OptionsChanged |= m_DisplacementInfo.Step != iStep;
+        m_DisplacementInfo.Step = iStep;
+    };
+    void SetInteractionRate(float iInteractionRate)
+    {
+        m_OptionsChanged |= m_AccelerationInfo.InteractionRate != iInteractionRate;
+        m_AccelerationInfo.InteractionRate = iInteractionRate;
+    };
+    void SetSmoothLenght(float iSmoothLenght)
+    {
+        m_OptionsChanged |= m_AccelerationInfo.SmoothLenght != iSmoothLenght;
+        m_AccelerationInfo.SmoothLenght = iSmoothLenght;
+    };
+    /// @param iRotateSources Rotate the gravity sources at each step instead of keeping the same ones.
+    void SetRotateSources(bool iRotateSources)
+    {
+        const uint32_t rotate = iRotateSources ? 1 : 0;
+        m_OptionsChanged |= m_AccelerationInfo.RotateSources != rotate;
+        m_AccelerationInfo.RotateSources = rotate;
+    };
+    /// @param iAdaptive Choose the step on the GPU from the largest acceleration and speed, SetStep giving the longest.
+    /// @param iAccuracy Part of the softening length a star may move, or be accelerated over, in a step.
+    void SetAdaptiveStep(bool iAdaptive, float iAccuracy)
+    {
+        const uint32_t adaptive = iAdaptive ? 1 : 0;
+        m_OptionsChanged |= m_DisplacementInfo.AdaptiveStep != adaptive || m_DisplacementInfo.StepAccuracy != iAccuracy;
+        m_DisplacementInfo.AdaptiveStep = adaptive;
+        m_DisplacementInfo.StepAccuracy = iAccuracy;
+    };
+    /// @param iSubsteps Number of time steps run for each frame drawn.
+    void SetSubsteps(uint32_t iSubsteps) { m_NbSubsteps = std::max(iSubsteps, 1u); }
+    /// @param iMonitoring Reduce the conserved quantities after the steps of each frame.
+    void SetMonitoring(bool iMonitoring) { m_Monitoring = iMonitoring; }
+    /// @param iInterval Number of time steps between two sorts of the stars along the Z-curve, 0 to never sort them.
+    void SetReorderInterval(uint32_t iInterval) { m_ReorderInterval = iInterval; }
 
 private:
     /// Init ImGUI vulkan ressources.
@@ -124,7 +212,7 @@ private:
     /// Pipeline layout of the main render pass.
     olp::PipelineLayout m_PipelineLayout;
     /// Cloud pipeline.
-    olp::CloudPipeline<CloudVertex> m_CloudPipeline;
+    olp::CloudPipeline<RenderVertex> m_CloudPipeline;
 
     /// Graphics render pass.
     VkRenderPass m_RenderPass = VK_NULL_HANDLE;
@@ -134,6 +222,24 @@ private:
     AccelerationPass m_AccelerationPass;
     /// Pass to calculate the new position and speed of each stars.
     IntegrationPass m_IntegrationPass;
+    /// Pass to compute the accelerations and move the stars in one dispatch.
+    LeapfrogPass m_LeapfrogPass;
+    /// Step of the integration, chosen on the GPU by the pass computing the accelerations.
+    olp::MemoryBuffer m_StepState;
+    /// Time steps of a frame in one submission, with the two passes alternating or the leapfrog pass.
+    StepPass m_StepPass;
+    uint32_t m_NbSubsteps = 1;
+    /// Copies the stars to a trajectory file after the integration pass.
+    TrajectoryRecorder m_Recorder;
+    /// Reduces the conserved quantities after the steps of a frame, a slot by frame in flight.
+    ReductionPass m_ReductionPass;
+    bool m_Monitoring = true;
+    /// Sorts the stars along the Z-curve before the steps of a frame, created by the first sort.
+    ReorderPass m_ReorderPass;
+    /// Time steps between two sorts of the stars along the Z-curve, 0 to never sort them.
+    uint32_t m_ReorderInterval = 0;
+    /// Time steps submitted since the last sort.
+    uint32_t m_StepsSinceReorder = 0;
 
     /// Command pool for the graphics queue.
     VkCommandPool m_CommandPool = VK_NULL_HANDLE;
@@ -143,7 +249,7 @@ private:
     /// Depth buffer image.
     olp::Image m_DepthBuffer;
 
-    /// Mesh to draw.
+    /// Mesh to draw. The galaxies of a batch share one cloud, so one dispatch computes the forces between them.
     std::vector<VkCloud> m_Clouds;
 
     /// Maximum number of frames to calculate in parallel.
@@ -153,13 +259,32 @@ private:
     std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> m_ImageAvailableSemaphores{};
     /// Semaphore to know if the rendering is finished for current image.
     std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> m_RenderFinishedSemaphores{};
-    /// Fence to synchronize GPU/CPU for update uniform buffer.
+    /// Render pass of a frame to the time steps writing the vertex buffer it draws.
+    std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> m_ComputeSemaphores{};
+    /// Time steps of a frame to render pass of the next frame, which draws the new positions.
+    std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> m_StepSemaphores{};
+    /// Step semaphore signaled and not waited yet, VK_NULL_HANDLE if none.
+    VkSemaphore m_PendingStep = VK_NULL_HANDLE;
+    /// Compute semaphore signaled and not waited yet, VK_NULL_HANDLE if none.
+    VkSemaphore m_PendingRender = VK_NULL_HANDLE;
+    /// Fence of the time steps of a frame.
     std::array<VkFence, MAX_FRAMES_IN_FLIGHT> m_InFlightFences{};
+    /// Fence of the render pass of a frame.
+    std::array<VkFence, MAX_FRAMES_IN_FLIGHT> m_RenderPassFences{};
     std::vector<VkFence> m_ImagesInFlight{};
 
     /// Current frame index in the swapchain
     size_t m_CurrentFrame = 0;
 
+    /// Timestamps of the render pass, a slot by frame in flight: begin, stars drawn, end.
+    GpuTimer m_Timer;
+    /// The timestamps of the frame are written.
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> m_FramesTimed{};
+    Menu::GpuTimes m_GpuTimes;
+    /// The reduction of the frame was submitted.
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> m_FramesReduced{};
+    Menu::Quantities m_Quantities;
+
     /// ImGUI
     std::unique_ptr<olp::ImGUI> m_ImGUI;
 
@@ -170,19 +295,10 @@ private:
         glm::mat4 Proj;
     };
 
-    struct DisplacementInfo
-    {
-        float Step = 0;
-        uint32_t NbPoint = 0;
-    } m_DisplacementInfo;
-
-    struct AccelerationInfo
-    {
-        float BlackHoleMass = 1000.0;
-        float InteractionRate = 0;
-        float SmoothLenght = 0;
-        uint32_t NbPoint = 0;
-    } m_AccelerationInfo;
+    IntegrationPass::Options m_DisplacementInfo;
+    AccelerationPass::Options m_AccelerationInfo;
+    /// The options changed since they were sent.
+    bool m_OptionsChanged = true;
 
     /// Uniform buffers.
     struct UniformBuffers
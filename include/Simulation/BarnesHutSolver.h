@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Simulation/ForceSolver.h"
+#include "Simulation/Octree.h"
+#include "Simulation/ThreadPool.h"
+
+/// @brief
+///  Barnes-Hut tree code, O(N log N) per step.
+///  Far away nodes of the octree act as a single star at their center of mass.
+///  Every star is a gravity source: the interaction rate is ignored and the result approximates a rate of 1.
+class BarnesHutSolver : public ForceSolver
+{
+public:
+    /// Constructor.
+    /// @param iThreadPool Pool running the build and the traversal.
+    /// @param iOpeningAngle Opening angle, lower is more accurate. 0 gives the exact direct sum.
+    /// @param iLeafSize Maximum number of stars in a leaf of the octree.
+    BarnesHutSolver(ThreadPool &iThreadPool, float iOpeningAngle = 0.5f, uint32_t iLeafSize = 16);
+
+    void ComputeAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        std::vector<glm::vec4> &oAccelerations) override;
+
+    const char *GetName() const override { return "barnes-hut"; }
+
+    void SetOpeningAngle(float iOpeningAngle) { m_OpeningAngle = iOpeningAngle; }
+    float GetOpeningAngle() const { return m_OpeningAngle; }
+
+private:
+    /// Computes the squared distance below which each node must be opened.
+    void ComputeOpeningRadii();
+
+    ThreadPool &m_ThreadPool;
+    /// Octree of the stars, rebuilt at each step.
+    Octree m_Octree;
+    /// Squared opening radius of each node.
+    std::vector<float> m_OpeningRadii2;
+
+    float m_OpeningAngle;
+    uint32_t m_LeafSize;
+};
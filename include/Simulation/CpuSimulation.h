@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Geometry/CloudVertex.h"
+#include "Simulation/ForceError.h"
+#include "Simulation/ForceSolver.h"
+#include "Simulation/ThreadPool.h"
+#include <glm/vec4.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// @brief
+///  Native version of the acceleration and integration compute passes, running on a thread pool.
+///  Gives the same results as acceleration.comp and integration.comp within float tolerance.
+class CpuSimulation
+{
+public:
+    /// Constructor.
+    /// @param iNbThreads Number of threads of the simulation. 0 to use every core.
+    explicit CpuSimulation(uint32_t iNbThreads = 0);
+
+    /// Sets the stars to simulate.
+    /// @param iStars Stars of the galaxy.
+    /// @param iBlackHoleMass Mass of the black hole in the center of the galaxy.
+    /// @param iNbBlackHoles Number of first stars summed in full whatever the interaction rate, see GenerateGalaxies.
+    void Init(std::vector<CloudVertex> iStars, float iBlackHoleMass, uint32_t iNbBlackHoles = 0);
+
+    /// Computes the acceleration of each star, equivalent of the acceleration pass.
+    void ComputeAccelerations();
+
+    /// Updates the speed and position of each star, equivalent of the integration pass.
+    void Integrate();
+
+    /// Runs one time step: acceleration followed by integration.
+    /// With the block time steps, the step is split in 2^MaxRung substeps. Each star is kicked at the rate of its rung,
+    /// only the stars starting a step at a substep get their acceleration computed, and every star drifts.
+    void Step();
+
+    /// Enables the block time steps: each star gets a power-of-two fraction of the step, from its acceleration.
+    /// @param iMaxRung Deepest rung, whose step is Step / 2^iMaxRung. 0 for a single step shared by every star.
+    /// @param iAccuracy Step of a star relative to sqrt(softening / |acceleration|).
+    void SetBlockSteps(uint32_t iMaxRung, float iAccuracy);
+
+    /// Replaces the solver of the gravity between the stars, the direct sum by default.
+    /// @param iSolver New solver.
+    void SetSolver(std::unique_ptr<ForceSolver> iSolver) { m_Solver = std::move(iSolver); }
+
+    /// Compares the current solver with the exact direct sum on a subset of the stars.
+    /// @param iNbSamples Number of stars compared.
+    /// @return Relative errors of the solver.
+    ForceErrorReport MeasureForceError(uint32_t iNbSamples);
+
+    void SetStep(float iStep) { m_Step = iStep; }
+    void SetInteractionRate(float iInteractionRate) { m_Settings.InteractionRate = iInteractionRate; }
+    void SetSmoothLenght(float iSmoothLenght) { m_Settings.SmoothLenght = iSmoothLenght; }
+    /// @param iRotateSources Rotate the gravity sources at each step, or keep the same ones: one star every Stride stars
+    ///                       spread over the whole galaxy, no longer the first InteractionRate of the stars.
+    void SetRotateSources(bool iRotateSources) { m_Settings.RotateSources = iRotateSources; }
+
+    const std::vector<CloudVertex> &GetStars() const { return m_Stars; }
+    const std::vector<glm::vec4> &GetAccelerations() const { return m_Accelerations; }
+    const ForceSolver &GetSolver() const { return *m_Solver; }
+    uint32_t GetMaxRung() const { return m_MaxRung; }
+    /// @return Number of stars on each rung, from the longest step to the shortest.
+    std::vector<uint32_t> GetRungCounts() const;
+    /// @return Accelerations computed by the steps since Init, one for each kick of a star.
+    uint64_t GetNbForceEvaluations() const { return m_NbForceEvaluations; }
+    uint32_t GetSize() const { return static_cast<uint32_t>(m_Stars.size()); }
+    uint32_t GetNbBlackHoles() const { return m_Settings.NbBlackHoles; }
+    uint32_t GetNbThreads() const { return m_ThreadPool.GetSize(); }
+    ThreadPool &GetThreadPool() { return m_ThreadPool; }
+
+private:
+    /// Adds the attraction of the central black hole to the accelerations.
+    void AddBlackHole();
+
+    /// Adds the attraction of the central black hole to the accelerations of some stars.
+    /// @param iTargets Indices of the stars.
+    void AddBlackHole(const std::vector<uint32_t> &iTargets);
+
+    /// @return Attraction of the central black hole on a star.
+    glm::vec4 GetBlackHoleAcceleration(const glm::vec3 &iPos) const;
+
+    /// Runs one time step with the block time steps.
+    void BlockStep();
+
+    /// @return Rung of a star whose acceleration is iAcceleration, before the alignment on the substep.
+    uint32_t ChooseRung(const glm::vec4 &iAcceleration) const;
+
+    /// Threads running the passes.
+    ThreadPool m_ThreadPool;
+    /// Solver of the gravity between the stars.
+    std::unique_ptr<ForceSolver> m_Solver;
+
+    /// Stars of the galaxy.
+    std::vector<CloudVertex> m_Stars;
+    /// Acceleration of each star, w is unused.
+    std::vector<glm::vec4> m_Accelerations;
+    /// Accelerations computed to measure the error of the solver.
+    std::vector<glm::vec4> m_ErrorAccelerations;
+
+    /// Parameters of the solver.
+    ForceSolver::Settings m_Settings;
+    /// The time step duration.
+    float m_Step = 0.f;
+    /// Mass of the black hole in the center of the galaxy.
+    float m_BlackHoleMass = 1000.f;
+
+    /// Deepest rung of the block time steps, 0 without them.
+    uint32_t m_MaxRung = 0;
+    /// Step of a star relative to sqrt(softening / |acceleration|).
+    float m_RungAccuracy = 0.25f;
+    /// Rung of the current step of each star, lasting m_Step / 2^rung. Empty before the first block step.
+    std::vector<uint8_t> m_Rungs;
+    /// Stars starting a step at the current substep.
+    std::vector<uint32_t> m_ActiveStars;
+    uint64_t m_NbForceEvaluations = 0;
+};
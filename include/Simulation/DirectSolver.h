@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Simulation/ForceSolver.h"
+#include "Simulation/ThreadPool.h"
+
+/// @brief
+///  Direct summation on the CPU, the reference implementation of acceleration.comp.
+///  Each star sums the attraction of InteractionRate * NbStars sources, the same ones as the shader.
+class DirectSolver : public ForceSolver
+{
+public:
+    /// Constructor.
+    /// @param iThreadPool Pool running the loop over the stars.
+    explicit DirectSolver(ThreadPool &iThreadPool);
+
+    void ComputeAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        std::vector<glm::vec4> &oAccelerations) override;
+
+    void ComputeTargetAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        const std::vector<uint32_t> &iTargets,
+        std::vector<glm::vec4> &ioAccelerations) override;
+
+    const char *GetName() const override { return "direct"; }
+
+    double GetInteractionsPerSecond() const override { return m_InteractionsPerSecond; }
+
+private:
+    /// Sums the acceleration of the targets, shared by ComputeAccelerations and ComputeTargetAccelerations.
+    /// @param iStars Stars of the galaxy.
+    /// @param iSettings Parameters of the computation.
+    /// @param iTargets Index of each target in the stars, nullptr when the targets are all the stars in order.
+    /// @param iNbTargets Number of targets.
+    /// @param ioAccelerations Acceleration of each star, only the targets are written.
+    void SumAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        const uint32_t *iTargets,
+        size_t iNbTargets,
+        std::vector<glm::vec4> &ioAccelerations);
+
+    ThreadPool &m_ThreadPool;
+    /// Throughput of the last computation.
+    double m_InteractionsPerSecond = 0.0;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+/// @brief
+///  Radix-2 complex FFT of a fixed power of two size.
+class Fft
+{
+public:
+    /// Constructor, precomputes the twiddle factors.
+    /// @param iSize Number of values of a transform, a power of two.
+    explicit Fft(uint32_t iSize);
+
+    /// In place transform of contiguous values. The inverse transform is not normalized.
+    /// @param ioValues Values to transform, GetSize() of them.
+    /// @param iInverse Computes the inverse transform.
+    void Transform(std::complex<float> *ioValues, bool iInverse) const;
+
+    uint32_t GetSize() const { return m_Size; }
+
+private:
+    uint32_t m_Size;
+    /// exp(-2 i pi k / size) for k < size / 2.
+    std::vector<std::complex<float>> m_Twiddles;
+    /// Bit reversed index of each value.
+    std::vector<uint32_t> m_BitReversed;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Simulation/ForceSolver.h"
+#include "Simulation/Octree.h"
+#include "Simulation/ThreadPool.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/// @brief
+///  Fast Multipole Method, O(N) per step.
+///  Cartesian Taylor expansions of the softened potential on the octree: multipoles are gathered upward (P2M, M2M),
+///  translated to local expansions between well separated nodes (M2L), then pushed down to the stars (L2L, L2P).
+///  Near nodes interact directly (P2P). Every star is a gravity source: the interaction rate is ignored.
+class FmmSolver : public ForceSolver
+{
+public:
+    /// Constructor.
+    /// @param iThreadPool Pool running the passes.
+    /// @param iOrder Order of the expansions, higher is more accurate.
+    /// @param iOpeningAngle Ratio of the node sizes to their distance below which expansions are used.
+    /// @param iLeafSize Maximum number of stars in a leaf of the octree.
+    FmmSolver(ThreadPool &iThreadPool, uint32_t iOrder = 4, float iOpeningAngle = 0.5f, uint32_t iLeafSize = 32);
+
+    void ComputeAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        std::vector<glm::vec4> &oAccelerations) override;
+
+    const char *GetName() const override { return "fmm"; }
+
+    uint32_t GetOrder() const { return m_Order; }
+
+private:
+    /// Term of the derivative of the potential: Coefficient * x^Power[0] * y^Power[1] * z^Power[2] * G^(Derivative)(r^2).
+    struct DerivativeTerm
+    {
+        double Coefficient;
+        std::array<uint8_t, 3> Power;
+        uint8_t Derivative;
+    };
+
+    /// Product of two expansion coefficients: Output += First * Second.
+    struct Product
+    {
+        uint16_t Output;
+        uint16_t First;
+        uint16_t Second;
+    };
+
+    /// Builds the multi-indices and the tables of the translations.
+    void CreateTables();
+
+    /// @return Index of the multi-index (x, y, z) in the expansions.
+    uint32_t GetIndex(uint32_t iX, uint32_t iY, uint32_t iZ) const { return m_IndexOf[(iX * (m_Order + 1) + iY) * (m_Order + 1) + iZ]; }
+
+    /// Computes v^a / a! for every multi-index a of the expansions.
+    /// @param iVector Vector v.
+    /// @param oMonomials Output values.
+    void ComputeMonomials(const glm::dvec3 &iVector, double *oMonomials) const;
+
+    /// Computes the derivatives of the potential at a vector, up to the order of the expansions.
+    /// @param iVector Vector from the source to the target.
+    /// @param oDerivatives Output derivatives, the potential itself is not computed.
+    void ComputeDerivatives(const glm::dvec3 &iVector, double *oDerivatives) const;
+
+    /// Lists disjoint subtrees covering the tree, to spread the passes on the threads.
+    void CollectSubtrees();
+
+    /// Upward pass: multipole of a node from its stars or its children.
+    /// @param iNodeIndex Index of the node.
+    /// @param iRecursive Computes the multipoles of the descendants first.
+    void Upward(uint32_t iNodeIndex, bool iRecursive);
+
+    /// Interactions of the stars of a target node with the stars of a source node.
+    void Interact(uint32_t iTarget, uint32_t iSource, std::vector<double> &ioScratch);
+
+    /// Downward pass: local expansion of a node pushed to its descendants and evaluated at the stars.
+    void Downward(uint32_t iNodeIndex, std::vector<double> &ioScratch);
+
+    /// Direct interactions between the stars of two leaves.
+    void P2P(const Octree::Node &iTarget, const Octree::Node &iSource);
+
+    /// Translation of the multipole of a source node into the local expansion of a target node.
+    void M2L(uint32_t iTarget, uint32_t iSource, std::vector<double> &ioScratch);
+
+    ThreadPool &m_ThreadPool;
+    /// Octree of the stars, rebuilt at each step.
+    Octree m_Octree;
+
+    uint32_t m_Order;
+    float m_OpeningAngle;
+    uint32_t m_LeafSize;
+    float m_SmoothLenght = 1.f;
+
+    /// Multi-indices of the expansions, sorted by total degree.
+    std::vector<std::array<uint8_t, 3>> m_Indices;
+    /// Index of each multi-index, addressed by GetIndex.
+    std::vector<uint32_t> m_IndexOf;
+    /// Terms of the derivative of each multi-index.
+    std::vector<std::vector<DerivativeTerm>> m_DerivativeTerms;
+    /// M2M: multipole(a) += child multipole(b) * shift(a - b), for b <= a.
+    std::vector<Product> m_ShiftProducts;
+    /// M2L: local(b) += multipole(a) * derivative(a + b), for |a| + |b| <= order.
+    std::vector<Product> m_M2LProducts;
+    /// L2P: acceleration(axis) -= local(b + axis) * monomial(b).
+    std::array<std::vector<std::pair<uint16_t, uint16_t>>, 3> m_GradientTerms;
+
+    /// Multipole and local expansion of each node, m_Indices.size() coefficients per node.
+    std::vector<float> m_Multipoles;
+    std::vector<float> m_Locals;
+    /// Radius of each node around its center of mass.
+    std::vector<float> m_Radii;
+
+    /// Subtrees handled by the threads, and the top nodes above them.
+    std::vector<uint32_t> m_Subtrees;
+    std::vector<uint32_t> m_TopNodes;
+
+    /// Accelerations of the sorted stars.
+    std::vector<glm::vec3> m_SortedAccelerations;
+};
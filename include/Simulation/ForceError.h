@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Geometry/CloudVertex.h"
+#include "Simulation/ThreadPool.h"
+#include <glm/vec4.hpp>
+#include <cstdint>
+#include <vector>
+
+/// Relative error of accelerations against the exact direct sum.
+struct ForceErrorReport
+{
+    /// Number of stars compared.
+    uint32_t NbSamples = 0;
+    /// Root mean square of the relative errors.
+    float RmsRelativeError = 0.f;
+    /// 99th percentile of the relative errors.
+    float Percentile99 = 0.f;
+    /// Largest relative error.
+    float MaxRelativeError = 0.f;
+};
+
+/// Error of the gravity sources sampled with an interaction rate, as GetSourceSampling chooses them.
+struct SamplingErrorReport
+{
+    float InteractionRate = 1.f;
+    bool RotateSources = false;
+    /// Sources summed for each star in a step: a step costs NbStars * NbSources interactions.
+    uint32_t NbSources = 0;
+    /// Steps until the sources repeat, 1 for the fixed sources.
+    uint32_t NbSteps = 1;
+    /// Root mean square of the relative errors of a step, over the stars and the steps.
+    float StepRmsError = 0.f;
+    /// Root mean square of the relative errors of the accelerations averaged over NbSteps steps: the bias of the
+    /// sampling, which the following steps do not average out. 0 for the rotating sources.
+    float MeanRmsError = 0.f;
+};
+
+/// Compares accelerations with the exact direct sum, every star being a gravity source of its mass.
+/// The reference is only computed for a regular subset of the stars, for a cost of O(N * iNbSamples).
+/// @param iThreadPool Pool running the direct sums.
+/// @param iStars Stars of the galaxy.
+/// @param iSmoothLenght Smoothing length of the gravity.
+/// @param iAccelerations Accelerations to check, without the black hole term.
+/// @param iNbSamples Number of stars compared.
+/// @return Relative errors.
+ForceErrorReport MeasureForceError(
+    ThreadPool &iThreadPool,
+    const std::vector<CloudVertex> &iStars,
+    float iSmoothLenght,
+    const std::vector<glm::vec4> &iAccelerations,
+    uint32_t iNbSamples);
+
+/// Measures the error of the sampled gravity sources against the exact direct sum, for the fixed and the rotating
+/// sources of each interaction rate. The stars do not move between the steps, so the error only comes from the
+/// sampling. The sampled sums are computed in double for the same subset of the stars as MeasureForceError.
+/// @param iThreadPool Pool running the sums.
+/// @param iStars Stars of the galaxy.
+/// @param iNbBlackHoles Number of first stars always summed in full, see GetSourceSampling.
+/// @param iSmoothLenght Smoothing length of the gravity.
+/// @param iInteractionRates Interaction rates to measure.
+/// @param iNbSamples Number of stars compared.
+/// @return Errors of the fixed then the rotating sources, for each interaction rate.
+std::vector<SamplingErrorReport> MeasureSamplingError(
+    ThreadPool &iThreadPool,
+    const std::vector<CloudVertex> &iStars,
+    uint32_t iNbBlackHoles,
+    float iSmoothLenght,
+    const std::vector<float> &iInteractionRates,
+    uint32_t iNbSamples);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Geometry/CloudVertex.h"
+#include <glm/vec4.hpp>
+#include <cstdint>
+#include <vector>
+
+/// @brief
+///  Interface of the CPU solvers computing the gravity between the stars.
+///  The black hole term is not part of the solvers, it is added by the simulation.
+class ForceSolver
+{
+public:
+    /// Parameters shared by every solver, same meaning as in acceleration.comp.
+    struct Settings
+    {
+        /// Part of the stars used as gravity sources, chosen by GetSourceSampling.
+        float InteractionRate = 1.f;
+        /// Number of first stars always used as sources whatever the interaction rate: the black holes of a merger.
+        uint32_t NbBlackHoles = 0;
+        /// Added to the squared distance to avoid singularities.
+        float SmoothLenght = 1.f;
+        /// Rotate the sources at each computation instead of keeping the same ones.
+        bool RotateSources = true;
+        /// Number of accelerations computed before this one, rotates the sources.
+        uint32_t StepIndex = 0;
+    };
+
+    /// Virtual destructor.
+    virtual ~ForceSolver() = default;
+
+    /// Computes the acceleration of each star due to the others.
+    /// @param[in] iStars Stars of the galaxy.
+    /// @param[in] iSettings Parameters of the gravity.
+    /// @param[out] oAccelerations Acceleration of each star, resized to the number of stars.
+    virtual void ComputeAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        std::vector<glm::vec4> &oAccelerations) = 0;
+
+    /// Computes the acceleration of some of the stars due to all the others, for the block time steps.
+    /// The default computes every star and keeps the targets: solvers whose cost depends on the number of targets
+    /// override it.
+    /// @param[in] iStars Stars of the galaxy.
+    /// @param[in] iSettings Parameters of the gravity.
+    /// @param[in] iTargets Indices of the stars to compute.
+    /// @param[in,out] ioAccelerations Acceleration of each star, sized to the number of stars. Only the targets
+    ///                                are written.
+    virtual void ComputeTargetAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        const std::vector<uint32_t> &iTargets,
+        std::vector<glm::vec4> &ioAccelerations)
+    {
+        std::vector<glm::vec4> accelerations;
+        ComputeAccelerations(iStars, iSettings, accelerations);
+        for (uint32_t target : iTargets)
+            ioAccelerations[target] = accelerations[target];
+    }
+
+    /// @return Name of the solver, used in the logs.
+    virtual const char *GetName() const = 0;
+
+    /// @return Pairwise interactions per second of the last computation, 0 when not measured.
+    virtual double GetInteractionsPerSecond() const { return 0.0; }
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+/// Spreads the 21 low bits of a value, inserting two zero bits between each of them.
+/// @param iValue Value to spread.
+/// @return Spread bits.
+inline uint64_t SpreadBits21(uint64_t iValue)
+{
+    iValue &= 0x1fffff;
+    iValue = (iValue | iValue << 32) & 0x1f00000000ffff;
+    iValue = (iValue | iValue << 16) & 0x1f0000ff0000ff;
+    iValue = (iValue | iValue << 8) & 0x100f00f00f00f00f;
+    iValue = (iValue | iValue << 4) & 0x10c30c30c30c30c3;
+    iValue = (iValue | iValue << 2) & 0x1249249249249249;
+    return iValue;
+}
+
+/// Computes a 63-bit Morton key (Z-curve order) from quantized coordinates.
+/// Each group of 3 bits stores the x, y and z bits of a level, x being the highest.
+/// @param iX X coordinate, 21 bits.
+/// @param iY Y coordinate, 21 bits.
+/// @param iZ Z coordinate, 21 bits.
+/// @return Morton key.
+inline uint64_t MortonKey63(uint32_t iX, uint32_t iY, uint32_t iZ)
+{
+    return SpreadBits21(iX) << 2 | SpreadBits21(iY) << 1 | SpreadBits21(iZ);
+}
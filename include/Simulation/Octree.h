@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Geometry/CloudVertex.h"
+#include "Simulation/ThreadPool.h"
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <cstdint>
+#include <vector>
+
+/// @brief
+///  Octree of the stars, built in parallel from their Morton keys.
+///  The stars are stored sorted along the Z-curve, so every node holds a contiguous range of them.
+class Octree
+{
+public:
+    /// Node of the tree, a cube of space.
+    struct Node
+    {
+        /// Center of the cube.
+        glm::vec3 Center{};
+        /// Half of the cube edge.
+        float HalfSize = 0.f;
+        /// Center of mass of the stars in the node.
+        glm::vec3 CenterOfMass{};
+        /// Total mass of the stars in the node.
+        float Mass = 0.f;
+        /// Index of the first child, the children are contiguous.
+        uint32_t FirstChild = 0;
+        /// Number of non empty children, 0 for a leaf.
+        uint32_t NbChildren = 0;
+        /// Range of the stars of the node in the sorted arrays.
+        uint32_t Begin = 0;
+        uint32_t End = 0;
+
+        bool IsLeaf() const { return NbChildren == 0; }
+    };
+
+    /// Constructor.
+    /// @param iThreadPool Pool running the build.
+    explicit Octree(ThreadPool &iThreadPool);
+
+    /// Builds the tree. Stars with NaN positions are left out of the tree.
+    /// @param iStars Stars of the galaxy.
+    /// @param iLeafSize Maximum number of stars in a leaf.
+    void Build(const std::vector<CloudVertex> &iStars, uint32_t iLeafSize);
+
+    /// @return Nodes of the tree, the root is the first one. Empty if there is no valid star.
+    const std::vector<Node> &GetNodes() const { return m_Nodes; }
+    /// @return Position (xyz) and mass (w) of the stars, sorted along the Z-curve.
+    const std::vector<glm::vec4> &GetSortedStars() const { return m_SortedStars; }
+    /// @return Index in the galaxy of each sorted star.
+    const std::vector<uint32_t> &GetSortedIndices() const { return m_SortedIndices; }
+
+private:
+    /// Computes the bounding cube of the valid stars and their Morton keys.
+    void ComputeKeys(const std::vector<CloudVertex> &iStars);
+
+    /// Sorts the stars by Morton key.
+    void SortKeys();
+
+    /// Creates the children of a node and recurses in them.
+    /// @param ioNodes Nodes to append the children to.
+    /// @param iNodeIndex Index of the node in ioNodes.
+    /// @param iLevel Level of the node, 0 for the root.
+    /// @param iMaxLevel Level where the recursion stops, the nodes reached are stored in m_Subtrees.
+    void BuildNode(std::vector<Node> &ioNodes, uint32_t iNodeIndex, uint32_t iLevel, uint32_t iMaxLevel);
+
+    /// Computes the mass and the center of mass of a node from its children or its stars.
+    /// @param ioNodes Nodes of the tree, children included.
+    /// @param iNodeIndex Index of the node.
+    void ComputeMoments(std::vector<Node> &ioNodes, uint32_t iNodeIndex) const;
+
+    /// Pool running the build.
+    ThreadPool &m_ThreadPool;
+    /// Maximum number of stars in a leaf.
+    uint32_t m_LeafSize = 16;
+
+    /// Morton key and index in the galaxy of each valid star.
+    std::vector<std::pair<uint64_t, uint32_t>> m_Keys;
+    /// Buffer of the sort.
+    std::vector<std::pair<uint64_t, uint32_t>> m_SortBuffer;
+
+    /// Nodes whose subtree is built in parallel: index of the node and its level.
+    std::vector<std::pair<uint32_t, uint32_t>> m_Subtrees;
+
+    std::vector<Node> m_Nodes;
+    std::vector<glm::vec4> m_SortedStars;
+    std::vector<uint32_t> m_SortedIndices;
+
+    /// Bounding cube of the stars.
+    glm::vec3 m_Min{};
+    float m_Size = 0.f;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Simulation/Fft.h"
+#include "Simulation/ForceSolver.h"
+#include "Simulation/ThreadPool.h"
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+/// @brief
+///  Particle-mesh solver, O(N + G log G) per step for a grid of G cells.
+///  The mass of the stars is deposited on a cubic grid (cloud-in-cell), convolved with the softened potential by FFT
+///  on a grid padded to twice its size (isolated galaxy, no periodic images), then the gradient of the potential is
+///  interpolated back to the stars. Forces below the size of a cell are smoothed out.
+///  Every star is a gravity source: the interaction rate is ignored.
+class PmSolver : public ForceSolver
+{
+public:
+    /// Constructor.
+    /// @param iThreadPool Pool running the passes.
+    /// @param iGridSize Number of cells along each axis of the grid, rounded up to a power of two.
+    PmSolver(ThreadPool &iThreadPool, uint32_t iGridSize = 128);
+
+    void ComputeAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        std::vector<glm::vec4> &oAccelerations) override;
+
+    const char *GetName() const override { return "particle-mesh"; }
+
+    uint32_t GetGridSize() const { return m_GridSize; }
+
+private:
+    /// Places the grid around the stars when they leave it or fill a small part of it.
+    /// @return True if the grid moved.
+    bool UpdateGrid(const glm::vec3 &iMin, const glm::vec3 &iMax);
+
+    /// Computes the transform of the potential of a unit mass on the padded grid.
+    void ComputeGreenFunction();
+
+    /// Sorts the positions of the stars by slab of the grid, so that slabs can be deposited in parallel.
+    void SortStarsBySlab(const std::vector<CloudVertex> &iStars);
+
+    /// Cloud-in-cell deposit of the stars on the grid, copied to the padded grid.
+    void DepositMass();
+
+    /// Transforms the padded grid along the three axes.
+    /// @param ioGrid Values of the padded grid.
+    /// @param iInverse Computes the inverse transform, not normalized.
+    /// @param iExtent The forward transform skips the lines outside of the first iExtent values along each axis,
+    ///                known to be zero. The inverse transform skips the lines not needed to get them.
+    void TransformGrid(std::vector<std::complex<float>> &ioGrid, bool iInverse, uint32_t iExtent);
+
+    /// Computes the acceleration at the nodes of the grid from the potential.
+    void ComputeGridAccelerations();
+
+    /// Cloud-in-cell interpolation of the grid accelerations at the stars.
+    void InterpolateAccelerations(const std::vector<CloudVertex> &iStars, std::vector<glm::vec4> &oAccelerations);
+
+    ThreadPool &m_ThreadPool;
+
+    /// Number of cells along each axis of the grid, and of the padded grid.
+    uint32_t m_GridSize;
+    uint32_t m_PaddedSize;
+    Fft m_Fft;
+
+    /// Position of the node (0, 0, 0) and size of a cell.
+    glm::vec3 m_Origin{0.f};
+    float m_CellSize = 0.f;
+    /// Axis along which the grid is cut in slabs, the longest of the galaxy.
+    uint32_t m_SlabAxis = 0;
+    /// Smoothing length used by the Green function.
+    float m_SmoothLenght = -1.f;
+
+    /// Transform of the potential of a unit mass, real since the potential is even.
+    std::vector<float> m_GreenFunction;
+    /// Mass of each node of the grid.
+    std::vector<float> m_Mass;
+    /// Mass then potential on the padded grid.
+    std::vector<std::complex<float>> m_Grid;
+    /// Acceleration at the nodes of the grid.
+    std::vector<glm::vec3> m_GridAccelerations;
+
+    /// Positions (xyz) in grid units and masses (w) of the valid stars sorted by slab, and first star of each slab.
+    std::vector<glm::vec4> m_SortedPositions;
+    std::vector<uint32_t> m_SlabStarts;
+    /// Per chunk of stars, number of stars in each slab.
+    std::vector<uint32_t> m_SlabCounts;
+};
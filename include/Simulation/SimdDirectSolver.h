@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Simulation/ForceSolver.h"
+#include "Simulation/SourceSampling.h"
+#include "Simulation/ThreadPool.h"
+#include <vector>
+
+/// @brief
+///  Vectorized direct summation, processing 4, 8 or 16 gravity sources per instruction.
+///  The positions of the sources are copied in structure-of-arrays form, the square root and division are replaced
+///  by reciprocal estimates refined by a Newton-Raphson step. The instruction set is chosen at runtime.
+///  Gives the same results as DirectSolver within float tolerance.
+class SimdDirectSolver : public ForceSolver
+{
+public:
+    /// Instruction sets of the kernel, from the slowest to the fastest.
+    enum class InstructionSet
+    {
+        Scalar,
+        Sse,
+        Avx2,
+        Avx512
+    };
+
+    /// Constructor, selects the best instruction set supported by the CPU.
+    /// @param iThreadPool Pool running the loop over the stars.
+    explicit SimdDirectSolver(ThreadPool &iThreadPool);
+
+    void ComputeAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        std::vector<glm::vec4> &oAccelerations) override;
+
+    void ComputeTargetAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        const std::vector<uint32_t> &iTargets,
+        std::vector<glm::vec4> &ioAccelerations) override;
+
+    const char *GetName() const override;
+
+    double GetInteractionsPerSecond() const override { return m_InteractionsPerSecond; }
+
+    /// Forces an instruction set, for comparisons. Ignored if the CPU does not support it.
+    /// @param iInstructionSet Instruction set to use.
+    void SetInstructionSet(InstructionSet iInstructionSet);
+    InstructionSet GetInstructionSet() const { return m_InstructionSet; }
+
+    /// @return Best instruction set supported by the CPU.
+    static InstructionSet DetectInstructionSet();
+
+private:
+    /// Copies the gravity sources in structure-of-arrays form, padded with massless sources.
+    /// The black holes come first, in their own padded block, then the sampled sources with their mass scaled.
+    /// @param iStars Stars of the galaxy.
+    /// @param iSampling Sources of the computation.
+    void CopySources(const std::vector<CloudVertex> &iStars, const SourceSampling &iSampling);
+
+    /// Sums the acceleration of the targets, shared by ComputeAccelerations and ComputeTargetAccelerations.
+    /// @param iStars Stars of the galaxy.
+    /// @param iSettings Parameters of the computation.
+    /// @param iTargets Index of each target in the stars, nullptr when the targets are all the stars in order.
+    /// @param iNbTargets Number of targets.
+    /// @param ioAccelerations Acceleration of each star, only the targets are written.
+    void SumAccelerations(
+        const std::vector<CloudVertex> &iStars,
+        const Settings &iSettings,
+        const uint32_t *iTargets,
+        size_t iNbTargets,
+        std::vector<glm::vec4> &ioAccelerations);
+
+    ThreadPool &m_ThreadPool;
+    InstructionSet m_InstructionSet;
+
+    /// Coordinates of the sources.
+    std::vector<float> m_X;
+    std::vector<float> m_Y;
+    std::vector<float> m_Z;
+    /// Mass of the sources, scaled by SourceSampling::MassScale after the black holes. 0 for the padding and the NaN
+    /// positions.
+    std::vector<float> m_Mass;
+
+    /// Throughput of the last computation.
+    double m_InteractionsPerSecond = 0.0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/// @brief
+///  Gravity sources of a step when only InteractionRate of the stars are used, the same ones as the shaders.
+///  The sources are one star every Stride stars from Offset. With fixed sources Offset is 0, so the same stars are the
+///  sources forever and their mass is scaled by 1 / InteractionRate. With rotating sources Offset moves by one star at
+///  each step: every star is a source once every Stride steps, and the mass scaled by Stride makes the sum unbiased.
+///  The NbBlackHoles first stars are too heavy to be sampled: they are always sources, with their own mass, and the
+///  sampled sources are taken among the other stars.
+struct SourceSampling
+{
+    /// Number of first stars always summed, unscaled, before the sampled sources.
+    uint32_t NbBlackHoles = 0;
+    /// Number of sampled sources at most, ceil(InteractionRate * (NbStars - NbBlackHoles)).
+    uint32_t NbSources = 0;
+    /// Stars between two sources.
+    uint32_t Stride = 1;
+    /// Index of the first sampled source among the stars after the black holes.
+    uint32_t Offset = 0;
+    /// Scale of the mass of the sampled sources.
+    float MassScale = 1.f;
+
+    /// @param iSource Index of the sampled source, below NbSources.
+    /// @return Index of the star, past the stars for the last sources of some rotating steps.
+    uint32_t GetStar(uint32_t iSource) const { return NbBlackHoles + iSource * Stride + Offset; }
+};
+
+/// Chooses the sources of a step, as sources.glsl does.
+/// @param iNbStars Number of stars.
+/// @param iNbBlackHoles Number of first stars always summed, at most iNbStars.
+/// @param iInteractionRate Part of the stars used as sources.
+/// @param iRotate Rotate the sources at each step instead of keeping the same ones.
+/// @param iStepIndex Number of accelerations computed before this one, rotates the sources.
+/// @return Sources of the step.
+inline SourceSampling GetSourceSampling(
+    uint32_t iNbStars, uint32_t iNbBlackHoles, float iInteractionRate, bool iRotate, uint32_t iStepIndex)
+{
+    SourceSampling sampling;
+    sampling.NbBlackHoles = std::min(iNbBlackHoles, iNbStars);
+    const uint32_t nbStars = iNbStars - sampling.NbBlackHoles;
+    // Same count as the shader, rounded up in float.
+    const float max = iInteractionRate * static_cast<float>(nbStars);
+    sampling.NbSources = std::min(nbStars, static_cast<uint32_t>(std::ceil(std::max(max, 0.f))));
+    const uint32_t nbSources = std::max(sampling.NbSources, 1u);
+    if (iRotate)
+    {
+        sampling.Stride = std::max((nbStars + nbSources - 1) / nbSources, 1u);
+        sampling.Offset = iStepIndex % sampling.Stride;
+        sampling.MassScale = static_cast<float>(sampling.Stride);
+    }
+    else
+    {
+        sampling.Stride = std::max(nbStars / nbSources, 1u);
+        sampling.MassScale = 1.f / iInteractionRate;
+    }
+    return sampling;
+}
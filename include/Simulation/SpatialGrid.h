@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Geometry/CloudVertex.h"
+#include "Simulation/ThreadPool.h"
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/vector_relational.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Neighborhood of the stars within a radius.
+struct NeighborReport
+{
+    /// Pairs of stars within the radius.
+    uint64_t NbPairs = 0;
+    /// Stars with at least one neighbor.
+    uint32_t NbStarsWithNeighbors = 0;
+    /// Largest number of neighbors of a star.
+    uint32_t MaxNeighbors = 0;
+};
+
+/// Summarizes the neighbor counts of the stars, from SpatialGrid::CountNeighbors or SpatialGridPass.
+/// @param iCounts Number of other stars within the radius of each star.
+/// @return Pairs and largest neighborhood.
+NeighborReport SummarizeNeighbors(const std::vector<uint32_t> &iCounts);
+
+/// @brief
+///  Uniform grid of the stars for fixed radius neighbor queries, rebuilt in parallel in O(N).
+///  The cells are hashed into a table of buckets, a power of two at least the number of stars, so the grid has no
+///  bounds. The stars are counting-sorted by bucket: the stars of a bucket are contiguous in the sorted arrays, which a
+///  query reads in order. Distinct cells may share a bucket, the queries filter the stars by distance.
+///  The hash is the one of grid_hash.comp, so the CPU and the GPU grids put a star in the same bucket.
+class SpatialGrid
+{
+public:
+    /// Constructor.
+    /// @param iThreadPool Pool running the build.
+    explicit SpatialGrid(ThreadPool &iThreadPool);
+
+    /// Builds the grid. Stars with NaN positions are left out of the grid.
+    /// @param iStars Stars of the galaxy.
+    /// @param iCellSize Edge of a cell, the radius of the queries at most.
+    void Build(const std::vector<CloudVertex> &iStars, float iCellSize);
+
+    /// Calls iVisitor(index, star, squared distance) for each star within iRadius of iPos, itself included.
+    /// @param iPos Center of the query.
+    /// @param iRadius Radius of the query, clamped to the cell size: the 27 cells around iPos hold every neighbor.
+    /// @param iVisitor Called with the index in the galaxy, the position (xyz) and mass (w) of each neighbor.
+    template <typename Visitor>
+    void ForEachNeighbor(const glm::vec3 &iPos, float iRadius, Visitor &&iVisitor) const;
+
+    /// Counts the neighbors of every star, in parallel and in the order of the buckets.
+    /// @param iRadius Radius of the query, clamped to the cell size.
+    /// @return Number of other stars within iRadius of each star of the galaxy, 0 for the stars out of the grid.
+    std::vector<uint32_t> CountNeighbors(float iRadius) const;
+
+    /// Bucket of a cell.
+    /// @param iCell Integer coordinates of the cell.
+    /// @param iMask Size of the table minus one.
+    static uint32_t Hash(const glm::ivec3 &iCell, uint32_t iMask)
+    {
+        return ((static_cast<uint32_t>(iCell.x) * 73856093u) ^ (static_cast<uint32_t>(iCell.y) * 19349663u) ^
+                (static_cast<uint32_t>(iCell.z) * 83492791u)) &
+               iMask;
+    }
+
+    /// @return Integer coordinates of the cell holding a position.
+    glm::ivec3 GetCell(const glm::vec3 &iPos) const;
+
+    /// @return Number of buckets, a power of two.
+    uint32_t GetTableSize() const { return m_Mask + 1; }
+    float GetCellSize() const { return m_CellSize; }
+    /// @return Position (xyz) and mass (w) of the stars, sorted by bucket.
+    const std::vector<glm::vec4> &GetSortedStars() const { return m_SortedStars; }
+    /// @return Index in the galaxy of each sorted star.
+    const std::vector<uint32_t> &GetSortedIndices() const { return m_SortedIndices; }
+    /// @return Start of each bucket in the sorted arrays, then the number of sorted stars.
+    const std::vector<uint32_t> &GetBucketStarts() const { return m_BucketStarts; }
+
+private:
+    /// Counts the stars of each bucket, then turns the counts into the start of the buckets.
+    void CountBuckets();
+
+    /// Moves the stars to their bucket, in the order of the galaxy within a bucket.
+    /// @param iStars Stars of the galaxy.
+    void Scatter(const std::vector<CloudVertex> &iStars);
+
+    /// Pool running the build.
+    ThreadPool &m_ThreadPool;
+    float m_CellSize = 1.f;
+    float m_InvCellSize = 1.f;
+    /// Size of the table minus one.
+    uint32_t m_Mask = 0;
+    /// Number of stars of the galaxy.
+    uint32_t m_NbStars = 0;
+
+    /// Bucket of each star of the galaxy, the size of the table for the stars out of the grid.
+    std::vector<uint32_t> m_StarBuckets;
+    /// Count of each bucket, then the next free slot of each bucket during the scatter.
+    std::unique_ptr<std::atomic<uint32_t>[]> m_Counters;
+    /// Size of m_Counters, the size of the table.
+    size_t m_NbCounters = 0;
+    /// Start of each bucket in the sorted arrays, then the number of sorted stars.
+    std::vector<uint32_t> m_BucketStarts;
+
+    std::vector<glm::vec4> m_SortedStars;
+    std::vector<uint32_t> m_SortedIndices;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+template <typename Visitor>
+void SpatialGrid::ForEachNeighbor(const glm::vec3 &iPos, float iRadius, Visitor &&iVisitor) const
+{
+    const float radius = std::min(iRadius, m_CellSize);
+    if (m_SortedStars.empty() || !(radius >= 0.f) || glm::any(glm::isnan(iPos)))
+        return;
+
+    const glm::ivec3 low = GetCell(iPos - glm::vec3(radius));
+    const glm::ivec3 high = glm::min(GetCell(iPos + glm::vec3(radius)), low + glm::ivec3(3));
+    const float squaredRadius = radius * radius;
+
+    // Cells sharing a bucket are read once. 3 cells along each axis, 4 when a bound falls on the edge of a cell.
+    std::array<uint32_t, 64> visited{};
+    uint32_t nbVisited = 0;
+    for (int z = low.z; z <= high.z; ++z)
+    {
+        for (int y = low.y; y <= high.y; ++y)
+        {
+            for (int x = low.x; x <= high.x; ++x)
+            {
+                const uint32_t bucket = Hash(glm::ivec3(x, y, z), m_Mask);
+                if (std::find(visited.begin(), visited.begin() + nbVisited, bucket) != visited.begin() + nbVisited)
+                    continue;
+                visited[nbVisited++] = bucket;
+
+                for (uint32_t i = m_BucketStarts[bucket]; i < m_BucketStarts[bucket + 1]; ++i)
+                {
+                    const glm::vec3 offset = glm::vec3(m_SortedStars[i]) - iPos;
+                    const float squaredDistance = glm::dot(offset, offset);
+                    if (squaredDistance <= squaredRadius)
+                        iVisitor(m_SortedIndices[i], m_SortedStars[i], squaredDistance);
+                }
+            }
+        }
+    }
+}
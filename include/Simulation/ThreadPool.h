@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief
+///  Fixed size pool of worker threads running parallel loops.
+class ThreadPool
+{
+public:
+    /// Task executed on a contiguous range [iBegin, iEnd) of a parallel loop.
+    using Task = std::function<void(size_t iBegin, size_t iEnd)>;
+
+    /// Constructor.
+    /// @param iNbThreads Number of threads used by the loops, calling thread included. 0 to use every core.
+    explicit ThreadPool(uint32_t iNbThreads = 0);
+
+    /// Destructor, joins the workers.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /// Splits [iBegin, iEnd) in chunks and runs them on the pool. Blocks until every chunk is done.
+    /// Chunks are handed out dynamically, so uneven chunks are balanced between threads.
+    /// Nested calls from inside a task run serially on the calling thread.
+    /// @param iBegin First index of the loop.
+    /// @param iEnd Index past the last one.
+    /// @param iTask Task to run on each chunk.
+    /// @param iGrainSize Number of indices per chunk. 0 to let the pool choose.
+    void ParallelFor(size_t iBegin, size_t iEnd, const Task &iTask, size_t iGrainSize = 0);
+
+    /// @return Number of threads used by the loops, calling thread included.
+    uint32_t GetSize() const { return static_cast<uint32_t>(m_Workers.size()) + 1; }
+
+private:
+    /// Worker thread main loop.
+    void WorkerLoop();
+
+    /// Runs the chunks of the current loop until none is left.
+    void RunChunks();
+
+    /// Worker threads.
+    std::vector<std::thread> m_Workers;
+
+    /// Serializes concurrent ParallelFor calls.
+    std::mutex m_LoopMutex;
+    /// Protects the loop description and the counters below.
+    std::mutex m_Mutex;
+    /// Wakes up the workers when a loop starts.
+    std::condition_variable m_StartCondition;
+    /// Wakes up the caller when every worker is done.
+    std::condition_variable m_DoneCondition;
+
+    /// Current loop.
+    const Task *m_Task = nullptr;
+    size_t m_Begin = 0;
+    size_t m_End = 0;
+    size_t m_GrainSize = 1;
+    size_t m_NbChunks = 0;
+    /// Next chunk to run.
+    std::atomic<size_t> m_NextChunk{0};
+
+    /// Incremented at each loop, tells the workers a new loop is available.
+    uint64_t m_Generation = 0;
+    /// Number of workers still running the current loop.
+    uint32_t m_NbBusyWorkers = 0;
+    /// Asks the workers to exit.
+    bool m_Stop = false;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Geometry/CloudVertex.h"
+#include "Menu.h"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/// @brief
+///  State of a simulation saved in a binary file: a versioned header holding the parameters of the menu, followed by
+///  the raw stars. A snapshot is mapped in memory when loaded, the stars are read in place by the upload.
+///  The stars of the files of version 1 have no mass: they are copied with a unit mass. The stars of the files of
+///  version 1 and 2 have no Id: they are copied with their index as Id.
+class Snapshot
+{
+public:
+    /// Version of the format written by Save.
+    static constexpr uint32_t Version = 3;
+
+    /// Writes a snapshot: the header then every star in one write.
+    /// Throws std::runtime_error if the file cannot be written or there are more than 65535 black holes.
+    /// @param iPath Path of the file, replaced if it exists.
+    /// @param iStars Stars of the galaxy.
+    /// @param iNbStars Number of stars.
+    /// @param iNbBlackHoles Number of first stars that are the black holes of a merger.
+    /// @param iGalaxy Parameters of the galaxy at start.
+    /// @param iRealTime Parameters of the simulation.
+    static void Save(
+        const std::filesystem::path &iPath,
+        const CloudVertex *iStars,
+        uint32_t iNbStars,
+        uint32_t iNbBlackHoles,
+        const Menu::GalaxyParameters &iGalaxy,
+        const Menu::RealTimeParameters &iRealTime);
+
+    /// Maps a snapshot in memory.
+    /// Throws std::runtime_error if the file cannot be read, is not a snapshot or has an unknown version.
+    /// @param iPath Path of the file.
+    explicit Snapshot(const std::filesystem::path &iPath);
+
+    /// Destructor, unmaps the file.
+    ~Snapshot();
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    /// @return Stars of the snapshot, valid as long as the snapshot lives.
+    const CloudVertex *GetStars() const { return m_Stars; }
+    uint32_t GetNbStars() const { return m_NbStars; }
+    /// @return Number of first stars that are the black holes of a merger, summed in full by the solvers.
+    uint32_t GetNbBlackHoles() const { return m_NbBlackHoles; }
+
+    const Menu::GalaxyParameters &GetGalaxyParameters() const { return m_GalaxyParameters; }
+    const Menu::RealTimeParameters &GetRealTimeParameters() const { return m_RealTimeParameters; }
+
+private:
+    /// Releases the mapping.
+    void Unmap();
+
+    /// Mapped file.
+    void *m_Data = nullptr;
+    size_t m_Size = 0;
+#ifdef _WIN32
+    /// Handles of the file and of its mapping.
+    void *m_File = nullptr;
+    void *m_Mapping = nullptr;
+#endif
+
+    /// Stars, inside the mapped file or m_ConvertedStars.
+    const CloudVertex *m_Stars = nullptr;
+    /// Stars of a file of version 1 or 2, with their mass and Id.
+    std::vector<CloudVertex> m_ConvertedStars;
+    uint32_t m_NbStars = 0;
+    uint32_t m_NbBlackHoles = 0;
+
+    Menu::GalaxyParameters m_GalaxyParameters;
+    Menu::RealTimeParameters m_RealTimeParameters;
+};
@@ -5,6 +5,28 @@
 class AccelerationPass : public ComputePass
 {
 public:
+    /// Shaders available to compute the accelerations, same bindings and same result.
+    enum class Kernel
+    {
+        /// acceleration.comp: each invocation reads every source from the storage buffer.
+        Direct,
+        /// acceleration_tiled.comp: the workgroup stages blocks of sources in shared memory.
+        Tiled
+    };
+
+    /// Content of the option uniform buffer of the shaders.
+    struct Options
+    {
+        float BlackHoleMass = 1000.0;
+        float InteractionRate = 0;
+        float SmoothLenght = 0;
+        uint32_t NbPoint = 0;
+        /// Rotate the gravity sources at each step instead of keeping the same ones, see SourceSampling.
+        uint32_t RotateSources = 1;
+        /// Number of first stars summed in full whatever the interaction rate: the black holes of a merger.
+        uint32_t NbBlackHoles = 0;
+    };
+
     using ComputePass::ComputePass;
 
     void Destroy() override;
@@ -13,12 +35,19 @@ public:
     /// @param iDescriptorPool Descriptor pool to allocate descriptor of the pass.
     /// @param iGalaxy Galaxy cloud.
     /// @param iOptions  Uniform buffer of control parameters.
+    /// @param iStepOptions Uniform buffer of the integration parameters, IntegrationPass::Options.
+    /// @param iStepState Step state buffer, IntegrationPass::StepState: the pass writes the step of the integration.
+    /// @param iKernel Shader computing the accelerations.
     void Create(
         VkDescriptorPool &iDescriptorPool,
         const VkCloud &iGalaxy,
-        const olp::UniformBuffer &iOptions);
+        const olp::UniformBuffer &iOptions,
+        const olp::UniformBuffer &iStepOptions,
+        const olp::MemoryBuffer &iStepState,
+        Kernel iKernel = Kernel::Direct);
 
     const olp::MemoryBuffer &GetAccelerationBuffer() const { return m_AccelerationBuffer; }
+    Kernel GetKernel() const { return m_Kernel; }
 
 private:
     ///  Create the pipeline layout.
@@ -32,10 +61,15 @@ private:
     /// @param iDescriptorPool Descriptor pool to allocate descriptor of the pass.
     /// @param iGalaxy Galaxy cloud.
     /// @param iOptions Uniform buffer of control parameters.
+    /// @param iStepOptions Uniform buffer of the integration parameters.
+    /// @param iStepState Step state buffer.
     void CreateDescriptor(
         VkDescriptorPool &iDescriptorPool,
         const VkCloud &iGalaxy,
-        const olp::UniformBuffer &iOptions);
+        const olp::UniformBuffer &iOptions,
+        const olp::UniformBuffer &iStepOptions,
+        const olp::MemoryBuffer &iStepState);
 
     olp::MemoryBuffer m_AccelerationBuffer;
+    Kernel m_Kernel = Kernel::Direct;
 };
\ No newline at end of file
@@ -5,7 +5,11 @@
 #include "Olympus/Device.h"
 #include "Olympus/MemoryBuffer.h"
 #include "Geometry/VkCloud.h"
+#include "Vulkan/GpuTimer.h"
+#include <array>
 #include <filesystem>
+#include <initializer_list>
+#include <vector>
 
 /// @brief
 ///  Compute pass for the compute star position.
@@ -20,15 +24,47 @@ public:
     explicit ComputePass(const olp::Device &iDevice);
 
     ///  Submits the command buffer to the compute queue.
-    /// @param[in] iWaitSemaphore Semaphore to wait before execute the pass.
-    /// @param[in] iSignalSemaphore Semaphore to signal when the execution is finished.
-    void Process(VkSemaphore iWaitSemaphore, VkSemaphore iSignalSemaphore);
+    /// @param[in] iSource Vertex buffer of the galaxy holding the current stars, 0 or 1.
+    /// @param[in] iWaitSemaphore Semaphore to wait before execute the pass, VK_NULL_HANDLE to start at once.
+    /// @param[in] iSignalSemaphore Semaphore to signal when the execution is finished, VK_NULL_HANDLE for none.
+    /// @param[in] iFollowingCommandBuffer Command buffer submitted after the pass in the same submission, covered by the
+    ///                                    semaphores and the fence of the pass. VK_NULL_HANDLE for none.
+    void Process(
+        uint32_t iSource,
+        VkSemaphore iWaitSemaphore,
+        VkSemaphore iSignalSemaphore,
+        VkCommandBuffer iFollowingCommandBuffer = VK_NULL_HANDLE);
+
+    ///  Submits the command buffer of a slot without the fence of the pass, while the submissions of the other slots
+    ///  may still be pending. Reads the GPU time of the previous submission of the slot, which must be done.
+    /// @param[in] iSlot Slot of the submission, below the number of slots given to Create.
+    /// @param[in] iSource Vertex buffer of the galaxy holding the current stars, 0 or 1.
+    /// @param[in] iWaitSemaphore Semaphore to wait before execute the pass, VK_NULL_HANDLE to start at once.
+    /// @param[in] iSignalSemaphores Semaphores to signal when the execution is finished.
+    /// @param[in] iFence Fence to signal when the execution is finished, VK_NULL_HANDLE for none.
+    /// @param[in] iFollowingCommandBuffer Command buffer submitted after the pass in the same submission.
+    ///                                    VK_NULL_HANDLE for none.
+    void Submit(
+        uint32_t iSlot,
+        uint32_t iSource,
+        VkSemaphore iWaitSemaphore,
+        std::initializer_list<VkSemaphore> iSignalSemaphores,
+        VkFence iFence,
+        VkCommandBuffer iFollowingCommandBuffer = VK_NULL_HANDLE);
+
+    ///  Records the dispatch of the pass, with its pipeline and descriptor, in another command buffer.
+    /// @param[in] iCommandBuffer Command buffer of the compute queue, in recording state.
+    /// @param[in] iSource Vertex buffer of the galaxy holding the current stars, 0 or 1.
+    void RecordDispatch(VkCommandBuffer iCommandBuffer, uint32_t iSource);
 
     /// Wait the fence of the compute pass.
     void WaitFence();
 
+    /// @return GPU time of the dispatch in the last submission read back, in milliseconds. 0 if not measured.
+    float GetGpuTime() const { return m_GpuTime; }
+
     VkSemaphore GetSemaphore() { return m_Semaphore; }
-    VkCommandBuffer GetCommandBuffer() { return m_CommandBuffer; }
+    VkCommandBuffer GetCommandBuffer(uint32_t iSource, uint32_t iSlot = 0) { return m_CommandBuffers[iSlot][iSource]; }
 
 protected:
     ///  Destructor.
@@ -38,9 +74,11 @@ protected:
     /// @param iDescriptorPool Descriptor pool to allocate descriptor of the pass.
     /// @param iGalaxy Galaxy cloud.
     /// @param iOptions  Uniform buffer of control parameters.
+    /// @param iNbSlots Number of submissions in flight, each with its command buffers and timestamps.
     void Create(
         std::filesystem::path iShaderName,
-        VkDeviceSize iNbPoint);
+        VkDeviceSize iNbPoint,
+        uint32_t iNbSlots = 1);
 
     ///  Create the pipeline layout.
     virtual void CreatePipelineLayout() = 0;
@@ -48,12 +86,13 @@ protected:
     ///  Create the pipeline.
     void CreatePipeline(std::filesystem::path iShaderName);
 
-    ///  Create the command pool and the command buffer.
-    void CreateCommandPoolAndBuffer();
+    ///  Create the command pool and the command buffers.
+    /// @param[in] iNbSlots Number of submissions in flight.
+    void CreateCommandPoolAndBuffer(uint32_t iNbSlots);
     /// Create the sempahore and the fence used for the sync.
     void CreateSemaphore();
 
-    ///  Build the command buffer.
+    ///  Build the command buffers.
     /// @param[in] iWidth VertexIndexImage width.
     /// @param[in] iHeight VertexIndexImage height.
     void BuildCommandBuffer(VkDeviceSize iNbPoint);
@@ -63,8 +102,9 @@ protected:
 
     /// Command pool for the compute queue.
     VkCommandPool m_CommandPool;
-    /// Command buffer storing the dispatch commands and barriers.
-    VkCommandBuffer m_CommandBuffer;
+    /// Command buffers storing the dispatch commands and barriers, for each slot one for each vertex buffer holding the
+    /// stars.
+    std::vector<std::array<VkCommandBuffer, 2>> m_CommandBuffers;
     /// Execution dependency between compute & graphic submission.
     VkSemaphore m_Semaphore;
     /// Synchronisation GPU/CPU. Need to find a better solution.
@@ -72,8 +112,16 @@ protected:
 
     /// Layout of the compute pipeline.
     olp::PipelineLayout m_PipelineLayout;
-    /// Descriptor of the compute pass.
-    olp::DescriptorSet m_DescriptorSet;
+    /// Descriptors of the compute pass, one for each vertex buffer holding the stars.
+    std::array<olp::DescriptorSet, 2> m_DescriptorSets;
     /// Compute pipeline.
     VkPipeline m_Pipeline;
+    /// Number of workgroups of the dispatch.
+    uint32_t m_NbGroups = 0;
+
+    /// Timestamps around the dispatch, a slot for each submission in flight.
+    GpuTimer m_Timer;
+    /// The command buffers of each slot were submitted since Create, their timestamps are written once it is done.
+    std::vector<bool> m_SlotsSubmitted;
+    float m_GpuTime = 0.f;
 };
\ No newline at end of file
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "Olympus/Device.h"
+#include "Olympus/UniformBuffer.h"
+#include "Vulkan/AccelerationPass.h"
+#include "Vulkan/IntegrationPass.h"
+#include "Vulkan/LeapfrogPass.h"
+#include "Vulkan/ReductionPass.h"
+#include "Vulkan/ReorderPass.h"
+#include "Vulkan/SpatialGridPass.h"
+#include "Vulkan/TrajectoryRecorder.h"
+#include "Geometry/VkCloud.h"
+#include "Menu.h"
+#include <array>
+#include <filesystem>
+#include <glm/vec4.hpp>
+#include <vector>
+
+/// @brief
+///  Runs the compute passes on a device created without surface: no window, no swapchain, no present.
+///  The steps are submitted back to back, as fast as the device runs them.
+class GpuSimulation
+{
+public:
+    /// Constructor, creates the device.
+    /// @param iInstance Vulkan instance to initialize the device with.
+    explicit GpuSimulation(const olp::Instance &iInstance);
+    ~GpuSimulation() = default;
+
+    ///  Releases Vulkan resources.
+    void ReleaseResources();
+
+    /// Uploads the galaxy and creates the compute passes.
+    /// @param iStars Stars of the galaxy.
+    /// @param iBlackHoleMass Mass of the black hole in the center of the galaxy.
+    /// @param iAccelerationKernel Shader of the acceleration pass.
+    /// @param iScheme Passes running a time step.
+    /// @param iNbBlackHoles Number of first stars that are the black holes of a merger, see GenerateGalaxies.
+    void InitializeGalaxy(
+        const std::vector<CloudVertex> &iStars,
+        float iBlackHoleMass,
+        AccelerationPass::Kernel iAccelerationKernel,
+        IntegrationPass::Scheme iScheme = IntegrationPass::Scheme::Split,
+        uint32_t iNbBlackHoles = 0);
+
+    /// Uploads the galaxy and creates the compute passes.
+    /// @param iStars Stars of the galaxy, may point into a mapped snapshot.
+    /// @param iNbStars Number of stars.
+    /// @param iBlackHoleMass Mass of the black hole in the center of the galaxy.
+    /// @param iAccelerationKernel Shader of the acceleration pass.
+    /// @param iScheme Passes running a time step.
+    /// @param iNbBlackHoles Number of first stars that are the black holes of a merger, see GenerateGalaxies.
+    void InitializeGalaxy(
+        const CloudVertex *iStars,
+        uint32_t iNbStars,
+        float iBlackHoleMass,
+        AccelerationPass::Kernel iAccelerationKernel,
+        IntegrationPass::Scheme iScheme = IntegrationPass::Scheme::Split,
+        uint32_t iNbBlackHoles = 0);
+
+    /// Release Galaxy and ComputePass.
+    void ReleaseGalaxy();
+
+    /// Submits one time step: the leapfrog pass, or the acceleration pass then the integration pass, after the sort of
+    /// the stars along the Z-curve every reorder interval. Does not wait for them.
+    void Step();
+
+    /// Runs the acceleration pass alone and waits for it.
+    void ComputeAccelerations();
+
+    /// Runs the integration pass alone, with the accelerations in the buffer, and waits for it.
+    void Integrate();
+
+    /// Runs the leapfrog pass alone, a whole time step, and waits for it.
+    void Leapfrog();
+
+    /// Waits for the submitted steps, sorts the stars along the Z-curve on the device and waits for it. Until the next
+    /// step the outputs read the stars sorted, with their speeds half a step behind their positions.
+    void Reorder();
+
+    /// Waits for the submitted steps.
+    void Wait();
+
+    /// Waits for the submitted steps and reads the stars back, at the start of the last step (VkCloud::GetSyncedBuffer).
+    /// @return Position and speed of each star, synchronized.
+    std::vector<CloudVertex> ReadStars();
+
+    /// Waits for the submitted steps and saves the stars in a snapshot file.
+    /// @param iPath Path of the snapshot.
+    /// @param iGalaxy Parameters of the galaxy at start.
+    /// @param iRealTime Parameters of the simulation.
+    void SaveSnapshot(
+        const std::filesystem::path &iPath,
+        const Menu::GalaxyParameters &iGalaxy,
+        const Menu::RealTimeParameters &iRealTime);
+
+    /// Records the stars to a trajectory file every iInterval steps, while the steps run.
+    /// Throws std::runtime_error if the file cannot be created.
+    /// @param iPath Path of the trajectory file.
+    /// @param iInterval Number of steps between two records.
+    void StartRecording(const std::filesystem::path &iPath, uint32_t iInterval);
+
+    /// Writes the records in flight and closes the trajectory file.
+    void StopRecording();
+
+    const TrajectoryRecorder &GetRecorder() const { return m_Recorder; }
+
+    /// Waits for the submitted steps and reads the accelerations back.
+    /// @return Acceleration of each star.
+    std::vector<glm::vec4> ReadAccelerations();
+
+    void SetStep(float iStep);
+    void SetInteractionRate(float iInteractionRate);
+    void SetSmoothLenght(float iSmoothLenght);
+    /// @param iRotateSources Rotate the gravity sources at each step instead of keeping the same ones.
+    void SetRotateSources(bool iRotateSources);
+    /// @param iAdaptive Choose the step on the GPU from the largest acceleration and speed, SetStep giving the longest.
+    /// @param iAccuracy Part of the softening length a star may move, or be accelerated over, in a step.
+    void SetAdaptiveStep(bool iAdaptive, float iAccuracy);
+    /// @param iInterval Number of steps between two sorts of the stars along the Z-curve, 0 to never sort them.
+    void SetReorderInterval(uint32_t iInterval) { m_ReorderInterval = iInterval; }
+
+    /// Waits for the submitted steps and reduces the conserved quantities of the stars on the device.
+    /// @return Energy, momenta, center of mass and bounds of the stars.
+    ReductionPass::Quantities ReduceQuantities();
+
+    /// Waits for the submitted steps, builds the uniform grid of the stars on the device and counts their neighbors.
+    /// @param iRadius Radius of the neighborhood, and edge of the cells of the grid.
+    /// @return Number of other stars within iRadius of each star, 0 for the NaN stars.
+    std::vector<uint32_t> CountNeighbors(float iRadius);
+
+    /// @return Grid of the last CountNeighbors, with its GPU times.
+    const SpatialGridPass &GetGridPass() const { return m_GridPass; }
+
+    /// Waits for the submitted steps and reads the step of the last one.
+    /// @return Drift of the last time step, 0 before the first step.
+    float ReadStep();
+
+    /// @return GPU time of the last finished acceleration pass, or leapfrog pass, in milliseconds. 0 if not measured.
+    float GetAccelerationTime() const
+    {
+        return m_Scheme == IntegrationPass::Scheme::FusedLeapfrog ? m_LeapfrogPass.GetGpuTime()
+                                                                  : m_AccelerationPass.GetGpuTime();
+    }
+    /// @return GPU time of the last finished integration pass, in milliseconds. 0 if not measured or fused.
+    float GetIntegrationTime() const
+    {
+        return m_Scheme == IntegrationPass::Scheme::FusedLeapfrog ? 0.f : m_IntegrationPass.GetGpuTime();
+    }
+    /// @return GPU time of the last finished leapfrog pass, in milliseconds, whatever the scheme. 0 if not measured.
+    float GetLeapfrogTime() const { return m_LeapfrogPass.GetGpuTime(); }
+    /// @return GPU time of the last finished sort of the stars along the Z-curve, in milliseconds. 0 if not measured.
+    float GetReorderTime() const { return m_ReorderPass.GetGpuTime(); }
+
+    uint32_t GetSize() const { return m_AccelerationInfo.NbPoint; }
+    const olp::Device &GetDevice() const { return m_Device; }
+
+private:
+    ///  Creates the uniform buffers.
+    void CreateUniformBuffers();
+
+    ///  Creates the descriptor pool.
+    void CreateDescriptorPool();
+
+    ///  Sends the options to the uniform buffers if they changed. Waits for the passes reading them.
+    void UpdateUniformBuffers();
+
+    /// Copies a device buffer to the host.
+    /// @param iBuffer Buffer to read, created with VK_BUFFER_USAGE_TRANSFER_SRC_BIT.
+    /// @param oData Destination, iBuffer.Size bytes.
+    void ReadBuffer(const olp::MemoryBuffer &iBuffer, void *oData);
+
+    /// Vulkan device, without surface.
+    olp::Device m_Device;
+    /// Descriptor pool of the compute passes.
+    VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+
+    /// Pass to compute the stars acceleration
+    AccelerationPass m_AccelerationPass;
+    /// Pass to calculate the new position and speed of each stars.
+    IntegrationPass m_IntegrationPass;
+    /// Pass to compute the accelerations and move the stars in one dispatch.
+    LeapfrogPass m_LeapfrogPass;
+    /// Pass to reduce the conserved quantities of the stars.
+    ReductionPass m_ReductionPass;
+    /// Uniform grid of the stars, created by the first CountNeighbors.
+    SpatialGridPass m_GridPass;
+    /// Sort of the stars along the Z-curve, created by the first sort.
+    ReorderPass m_ReorderPass;
+    /// Step of the integration, chosen on the GPU by the pass computing the accelerations.
+    olp::MemoryBuffer m_StepState;
+    /// Passes submitted by Step.
+    IntegrationPass::Scheme m_Scheme = IntegrationPass::Scheme::Split;
+
+    /// Stars of the galaxy.
+    std::vector<VkCloud> m_Clouds;
+
+    /// Copies the stars to a trajectory file after the integration pass.
+    TrajectoryRecorder m_Recorder;
+
+    IntegrationPass::Options m_DisplacementInfo;
+    AccelerationPass::Options m_AccelerationInfo;
+    /// The options changed since they were sent.
+    bool m_OptionsChanged = true;
+    /// The semaphore of the last pass of a step is signaled, the next step waits for it.
+    bool m_PendingStep = false;
+    /// Fences of the leapfrog steps in flight, used in turn.
+    std::array<VkFence, 2> m_StepFences{};
+    /// Number of steps submitted, to use the slots of the passes in turn.
+    uint64_t m_NbSteps = 0;
+    /// Steps between two sorts of the stars along the Z-curve, 0 to never sort them.
+    uint32_t m_ReorderInterval = 0;
+    /// Steps submitted since the last sort.
+    uint32_t m_StepsSinceReorder = 0;
+
+    /// Uniform buffers.
+    struct UniformBuffers
+    {
+        olp::UniformBuffer Displacement;
+        olp::UniformBuffer Acceleration;
+    } m_UniformBuffers;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Olympus/Device.h"
+#include <cstdint>
+#include <vector>
+
+/// @brief
+///  Timestamp queries around the commands of a pass, read back without waiting.
+///  A slot holds the timestamps of one submission: a pass with several submissions in flight uses one slot for each,
+///  and reads a slot once the fence of its submission is signaled. Reading never waits, it fails while the timestamps
+///  of the slot are not all written.
+class GpuTimer
+{
+public:
+    /// Constructor.
+    /// @param iDevice Device running the pass.
+    explicit GpuTimer(const olp::Device &iDevice);
+
+    /// Creates the query pool. The timer records nothing if the queue family has no timestamp.
+    /// @param iQueueFamily Queue family the command buffers are submitted to.
+    /// @param iNbSlots Number of submissions in flight.
+    /// @param iNbTimestamps Number of timestamps written in each submission.
+    void Create(uint32_t iQueueFamily, uint32_t iNbSlots, uint32_t iNbTimestamps);
+
+    /// Destroys the query pool.
+    void Destroy();
+
+    /// Records the reset of the queries of a slot, outside of a render pass and before the timestamps.
+    /// @param iCommandBuffer Command buffer of the submission.
+    /// @param iSlot Slot of the submission.
+    void Reset(VkCommandBuffer iCommandBuffer, uint32_t iSlot);
+
+    /// Records a timestamp.
+    /// @param iCommandBuffer Command buffer of the submission.
+    /// @param iSlot Slot of the submission.
+    /// @param iIndex Index of the timestamp in the slot.
+    /// @param iStage Stage the previous commands must have completed.
+    void Write(VkCommandBuffer iCommandBuffer, uint32_t iSlot, uint32_t iIndex, VkPipelineStageFlagBits iStage);
+
+    /// Reads the timestamps of a slot, without waiting.
+    /// @param iSlot Slot of a submission already done.
+    /// @param oMilliseconds Time between each timestamp and the next one, iNbTimestamps - 1 values.
+    /// @return False if the timer is not supported or the results are not available.
+    bool Read(uint32_t iSlot, std::vector<float> &oMilliseconds) const;
+
+    bool IsSupported() const { return m_QueryPool != VK_NULL_HANDLE; }
+
+private:
+    /// Vulkan device.
+    const olp::Device &m_Device;
+
+    VkQueryPool m_QueryPool = VK_NULL_HANDLE;
+    uint32_t m_NbTimestamps = 0;
+    /// Nanoseconds per timestamp tick.
+    float m_Period = 1.f;
+    /// Valid bits of the timestamps of the queue family.
+    uint64_t m_Mask = ~0ull;
+};
@@ -2,9 +2,58 @@
 #include "Vulkan/ComputePass.h"
 
 /// Integration compute pass for update position of each star.
+/// Reads the stars from the current vertex buffer of the galaxy and writes them moved in the other one. Writes the speeds
+/// synchronized with the positions back to the stars read, for the outputs.
 class IntegrationPass : public ComputePass
 {
 public:
+    /// How a time step moves the stars. Same update, the kick-drift-kick leapfrog with the speeds half a step behind
+    /// the positions: one kick by the mean of the previous drift and of this one, then the drift.
+    enum class Scheme
+    {
+        /// The acceleration pass writes the accelerations to a buffer, then this pass reads them: two dispatches.
+        Split,
+        /// leapfrog.comp computes the accelerations and moves the stars in one dispatch, LeapfrogPass.
+        FusedLeapfrog
+    };
+
+    /// Content of the option uniform buffer of the shader, also read by the passes choosing the step.
+    struct Options
+    {
+        /// Step of the integration, the longest one with the adaptive step.
+        float Step = 0;
+        uint32_t NbPoint = 0;
+        /// Choose the step on the GPU from the largest acceleration and speed, instead of Step.
+        uint32_t AdaptiveStep = 0;
+        /// Part of the softening length a star may move, or be accelerated over, in an adaptive step.
+        float StepAccuracy = 0.01f;
+    };
+
+    /// Content of the step state storage buffer. The passes computing the accelerations reduce the largest
+    /// acceleration and speed of the stars, and the last workgroup writes the step of the next time step, then shifts
+    /// the drifts the integration reads.
+    struct StepState
+    {
+        /// Step chosen from the maxima of the last time step, the drift of the next one with the adaptive step.
+        float Step = 0;
+        /// Bits of the maxima of the current step, as floats.
+        uint32_t MaxAcceleration = 0;
+        uint32_t MaxSpeed = 0;
+        /// Workgroups which added their maxima.
+        uint32_t NbGroupsDone = 0;
+        /// Steps since the creation of the buffer, rotates the gravity sources.
+        uint32_t NbSteps = 0;
+        /// Drift of the last time step. 0 before the first one, so its kick is the opening half kick.
+        float DriftStep = 0;
+        /// Drift of the time step before the last one.
+        float PreviousStep = 0;
+    };
+
+    /// Creates the step state buffer shared by the passes of a time step, cleared.
+    /// @param iDevice Device running the passes.
+    /// @return Storage buffer holding a StepState.
+    static olp::MemoryBuffer CreateStepStateBuffer(const olp::Device &iDevice);
+
     using ComputePass::ComputePass;
 
     /// Destroy all vulkan element used by the compute pass.
@@ -15,11 +64,13 @@ public:
     /// @param[in] iGalaxy              Galaxy cloud.
     /// @param[in] iOptions             Uniform buffer of control parameters.
     /// @param[in] iAccelerationBuffer  Buffer that store the acceleration of each star.
+    /// @param[in] iStepState           Step state buffer, holding the step chosen by the acceleration pass.
     void Create(
         VkDescriptorPool &iDescriptorPool,
         const VkCloud &iGalaxy,
         const olp::UniformBuffer &iOptions,
-        const olp::MemoryBuffer &iAccelerationBuffer);
+        const olp::MemoryBuffer &iAccelerationBuffer,
+        const olp::MemoryBuffer &iStepState);
 
 private:
     ///  Create the pipeline layout.
@@ -33,5 +84,6 @@ private:
         VkDescriptorPool &iDescriptorPool,
         const VkCloud &iGalaxy,
         const olp::UniformBuffer &iOptions,
-        const olp::MemoryBuffer &iAccelerationBuffer);
+        const olp::MemoryBuffer &iAccelerationBuffer,
+        const olp::MemoryBuffer &iStepState);
 };
\ No newline at end of file
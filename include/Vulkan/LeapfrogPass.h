@@ -0,0 +1,47 @@
+#pragma once
+#include "Vulkan/ComputePass.h"
+
+/// Fused compute pass of a whole time step: computes the acceleration of each star and moves it in the same dispatch.
+/// Reads the stars from the current vertex buffer of the galaxy and writes them moved in the other one. Writes the speeds
+/// synchronized with the positions back to the stars read, for the outputs.
+class LeapfrogPass : public ComputePass
+{
+public:
+    using ComputePass::ComputePass;
+
+    /// Destroy all vulkan element used by the compute pass.
+    void Destroy() override;
+
+    ///  Creates the compute pass.
+    /// @param[in] iDescriptorPool        Descriptor pool to allocate descriptor of the pass.
+    /// @param[in] iGalaxy                Galaxy cloud.
+    /// @param[in] iAccelerationOptions   Uniform buffer of the acceleration parameters, AccelerationPass::Options.
+    /// @param[in] iIntegrationOptions    Uniform buffer of the integration parameters, IntegrationPass::Options.
+    /// @param[in] iStepState             Step state buffer, IntegrationPass::StepState: the step is read from it and
+    ///                                   the step of the next dispatch written to it.
+    /// @param[in] iNbSlots               Number of submissions in flight.
+    void Create(
+        VkDescriptorPool &iDescriptorPool,
+        const VkCloud &iGalaxy,
+        const olp::UniformBuffer &iAccelerationOptions,
+        const olp::UniformBuffer &iIntegrationOptions,
+        const olp::MemoryBuffer &iStepState,
+        uint32_t iNbSlots = 1);
+
+private:
+    ///  Create the pipeline layout.
+    void CreatePipelineLayout() override;
+
+    ///  Create the descriptors.
+    /// @param[in] iDescriptorPool        Descriptor pool to allocate descriptor of the pass.
+    /// @param[in] iGalaxy                Galaxy cloud.
+    /// @param[in] iAccelerationOptions   Uniform buffer of the acceleration parameters.
+    /// @param[in] iIntegrationOptions    Uniform buffer of the integration parameters.
+    /// @param[in] iStepState             Step state buffer.
+    void CreateDescriptor(
+        VkDescriptorPool &iDescriptorPool,
+        const VkCloud &iGalaxy,
+        const olp::UniformBuffer &iAccelerationOptions,
+        const olp::UniformBuffer &iIntegrationOptions,
+        const olp::MemoryBuffer &iStepState);
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Olympus/DescriptorSet.h"
+#include "Olympus/Device.h"
+#include "Olympus/MemoryBuffer.h"
+#include "Olympus/PipelineLayout.h"
+#include "Vulkan/GpuTimer.h"
+#include <array>
+#include <filesystem>
+
+/// @brief
+///  Key-value sort on the device: least significant digit radix sort of 32 or 64-bit keys with 32-bit values.
+///  Each pass sorts 8 bits of the keys in three dispatches: radix_histogram.comp counts the digits of each block of
+///  keys, radix_scan.comp turns the counts into the rank of the first key of each digit in each block, and
+///  radix_scatter.comp moves the keys and values to their rank, keeping the order of the equal digits.
+///  The passes go from the buffers of the caller to temporary buffers and back, an even number of them, so the sorted
+///  keys end in the buffers of the caller. Everything is recorded in a command buffer: the host reads nothing back.
+class RadixSort
+{
+public:
+    /// Size of a key, in 32-bit words.
+    enum class KeySize
+    {
+        Bits32 = 1,
+        /// Little-endian 64-bit integers, as uint64_t on the host.
+        Bits64 = 2
+    };
+
+    /// Keys read by a workgroup of the histogram and scatter shaders, 16 by invocation. The last block of a sort is
+    /// partial unless the number of keys is a multiple of it.
+    static constexpr uint32_t KeysPerBlock = 256 * 16;
+
+    /// Descriptor sets allocated by Create.
+    static constexpr uint32_t NbDescriptorSets = 2;
+    /// Storage buffer descriptors allocated by Create.
+    static constexpr uint32_t NbStorageDescriptors = 12;
+
+    ///  Constructor.
+    /// @param iDevice Device to initialize the sort with.
+    explicit RadixSort(const olp::Device &iDevice);
+
+    ///  Creates the pipelines, the temporary buffers and the descriptors.
+    /// @param iDescriptorPool Descriptor pool with NbDescriptorSets sets and NbStorageDescriptors storage buffers free.
+    /// @param iKeys Keys to sort, iMaxNbKeys of them at most, with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT.
+    /// @param iValues Value of each key, a uint32_t, with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT.
+    /// @param iMaxNbKeys Largest number of keys sorted.
+    /// @param iKeySize Size of the keys.
+    void Create(
+        VkDescriptorPool &iDescriptorPool,
+        const olp::MemoryBuffer &iKeys,
+        const olp::MemoryBuffer &iValues,
+        uint32_t iMaxNbKeys,
+        KeySize iKeySize);
+
+    ///  Destroys all vulkan elements of the sort.
+    void Destroy();
+
+    ///  Records the sort in a command buffer of the compute queue. A barrier orders it after the previous commands
+    ///  writing the keys, the commands reading them must order themselves after the compute shader writes.
+    /// @param iCommandBuffer Command buffer in recording state.
+    /// @param iNbKeys Number of keys to sort, from the start of the buffers.
+    /// @param iKeyBits Low bits of the keys to sort on, the higher ones must be 0: 30 for a 30-bit Morton key.
+    void Record(VkCommandBuffer iCommandBuffer, uint32_t iNbKeys, uint32_t iKeyBits) const;
+
+    ///  Sorts the keys at once and waits for the end.
+    /// @param iNbKeys Number of keys to sort, from the start of the buffers.
+    /// @param iKeyBits Low bits of the keys to sort on, the higher ones must be 0.
+    void Sort(uint32_t iNbKeys, uint32_t iKeyBits);
+
+    /// @return GPU time of the last Sort, in milliseconds. 0 if not measured.
+    float GetGpuTime() const { return m_GpuTime; }
+
+private:
+    ///  Creates the pipeline layout, shared by the three shaders.
+    void CreatePipelineLayout();
+
+    ///  Creates the pipeline of a shader.
+    /// @param iShaderName Name of the shader, without extension.
+    /// @return Compute pipeline.
+    VkPipeline CreatePipeline(const std::filesystem::path &iShaderName) const;
+
+    ///  Creates the state, histogram and temporary buffers.
+    /// @param iMaxNbKeys Largest number of keys sorted.
+    void CreateBuffers(uint32_t iMaxNbKeys);
+
+    ///  Creates the descriptors of the passes from the caller's buffers and of the passes back to them.
+    /// @param iDescriptorPool Descriptor pool to allocate the descriptors.
+    /// @param iKeys Keys to sort.
+    /// @param iValues Value of each key.
+    void CreateDescriptors(VkDescriptorPool &iDescriptorPool, const olp::MemoryBuffer &iKeys, const olp::MemoryBuffer &iValues);
+
+    ///  Creates the command pool, the command buffer and the fence of Sort.
+    void CreateCommandBuffer();
+
+    /// Vulkan device.
+    const olp::Device &m_Device;
+    KeySize m_KeySize = KeySize::Bits32;
+
+    /// Layout of the three pipelines.
+    olp::PipelineLayout m_PipelineLayout;
+    VkPipeline m_HistogramPipeline = VK_NULL_HANDLE;
+    VkPipeline m_ScanPipeline = VK_NULL_HANDLE;
+    VkPipeline m_ScatterPipeline = VK_NULL_HANDLE;
+    /// Passes from the caller's buffers to the temporary ones, then back.
+    std::array<olp::DescriptorSet, 2> m_DescriptorSets;
+
+    /// Number of keys, shift of the digit of the pass, number of blocks and size of a key: written before the passes.
+    olp::MemoryBuffer m_StateBuffer;
+    /// Count of each digit in each block, digit-major, then rank of its first key.
+    olp::MemoryBuffer m_HistogramBuffer;
+    olp::MemoryBuffer m_TemporaryKeys;
+    olp::MemoryBuffer m_TemporaryValues;
+
+    /// Command pool for the compute queue.
+    VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+    /// Command buffer of Sort, recorded again at each call.
+    VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+    VkFence m_Fence = VK_NULL_HANDLE;
+    /// Timestamps around the sort of Sort.
+    GpuTimer m_Timer;
+    float m_GpuTime = 0.f;
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include "Vulkan/ComputePass.h"
+#include <glm/vec4.hpp>
+#include <vector>
+
+/// Reduction compute pass: energy, momenta, center of mass and bounds of the stars of the current vertex buffer.
+/// A single dispatch reduces the stars by workgroup, then the last workgroup reduces the partial results. The result is
+/// copied to a host-visible slot, read once the submission is done: a slot for each submission in flight.
+class ReductionPass : public ComputePass
+{
+public:
+    /// Content of a slot of the result, same layout as the shader.
+    struct Quantities
+    {
+        float Mass = 0;
+        float KineticEnergy = 0;
+        /// Pairs of stars and stars with the black hole. The pairs are estimated from a sample of the stars.
+        float PotentialEnergy = 0;
+        /// Stars reduced, the stars with a NaN position or speed are left out.
+        uint32_t NbStars = 0;
+        glm::vec4 Momentum{};
+        /// Around the black hole, at the origin.
+        glm::vec4 AngularMomentum{};
+        glm::vec4 CenterOfMass{};
+        /// Bounding box of the stars.
+        glm::vec4 Min{};
+        glm::vec4 Max{};
+    };
+
+    using ComputePass::ComputePass;
+
+    /// Destroy all vulkan element used by the compute pass.
+    void Destroy() override;
+
+    ///  Creates the compute pass.
+    /// @param[in] iDescriptorPool  Descriptor pool to allocate descriptor of the pass.
+    /// @param[in] iGalaxy          Galaxy cloud.
+    /// @param[in] iOptions         Uniform buffer of the acceleration parameters, AccelerationPass::Options.
+    /// @param[in] iNbSlots         Number of submissions in flight.
+    void Create(
+        VkDescriptorPool &iDescriptorPool,
+        const VkCloud &iGalaxy,
+        const olp::UniformBuffer &iOptions,
+        uint32_t iNbSlots = 1);
+
+    /// @param iSlot Slot receiving the result.
+    /// @param iSource Current vertex buffer of the galaxy, 0 or 1. The other one is reduced, see
+    ///                VkCloud::GetSyncedBuffer.
+    /// @return Command buffer reducing the stars, to submit after the pass writing them. Its barriers order it after
+    ///         the previous commands of the queue.
+    VkCommandBuffer GetSlotCommandBuffer(uint32_t iSlot, uint32_t iSource) const
+    {
+        return m_SlotCommandBuffers[iSlot][iSource];
+    }
+
+    /// Reads the result of a slot, the submission of its command buffer must be done.
+    /// @param iSlot Slot to read.
+    /// @param oQuantities Result of the reduction.
+    /// @param oGpuTime GPU time of the dispatch in milliseconds, unchanged if not measured.
+    void Read(uint32_t iSlot, Quantities &oQuantities, float &oGpuTime) const;
+
+    /// Reduces the stars of a vertex buffer at once, with slot 0. The device must be idle.
+    /// @param iSource Current vertex buffer of the galaxy, 0 or 1. The other one is reduced, see
+    ///                VkCloud::GetSyncedBuffer.
+    /// @return Result of the reduction.
+    Quantities Reduce(uint32_t iSource);
+
+private:
+    ///  Create the pipeline layout.
+    void CreatePipelineLayout() override;
+
+    /// Create the partial results and the host-visible results.
+    /// @param iNbSlots Number of slots of the results.
+    void CreateBuffers(uint32_t iNbSlots);
+
+    ///  Create the descriptors.
+    /// @param[in] iDescriptorPool  Descriptor pool to allocate descriptor of the pass.
+    /// @param[in] iGalaxy          Galaxy cloud.
+    /// @param[in] iOptions         Uniform buffer of the acceleration parameters.
+    void CreateDescriptor(
+        VkDescriptorPool &iDescriptorPool,
+        const VkCloud &iGalaxy,
+        const olp::UniformBuffer &iOptions);
+
+    /// Records the reduction of a vertex buffer into a slot.
+    /// @param iSlot Slot receiving the result.
+    /// @param iSource Current vertex buffer of the galaxy, 0 or 1. The other one is reduced, see
+    ///                VkCloud::GetSyncedBuffer.
+    void BuildSlotCommandBuffer(uint32_t iSlot, uint32_t iSource);
+
+    /// Counter of the workgroups done, then the result of each workgroup.
+    olp::MemoryBuffer m_PartialBuffer;
+    /// Result of the last workgroup.
+    olp::MemoryBuffer m_ResultBuffer;
+    /// Copies of the result read by the host, one Quantities by slot.
+    olp::MemoryBuffer m_HostBuffer;
+    /// Mapped memory of the host buffer.
+    const Quantities *m_HostResults = nullptr;
+    /// Reduction of each vertex buffer, for each slot.
+    std::vector<std::array<VkCommandBuffer, 2>> m_SlotCommandBuffers;
+    /// Timestamps around the dispatch, a slot by submission in flight.
+    GpuTimer m_SlotTimer{m_Device};
+};
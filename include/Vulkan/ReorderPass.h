@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Geometry/VkCloud.h"
+#include "Olympus/DescriptorSet.h"
+#include "Olympus/Device.h"
+#include "Olympus/MemoryBuffer.h"
+#include "Olympus/PipelineLayout.h"
+#include "Vulkan/GpuTimer.h"
+#include "Vulkan/RadixSort.h"
+#include <array>
+#include <filesystem>
+#include <initializer_list>
+#include <vector>
+
+/// @brief
+///  Sort of the stars along the Z-curve on the device, so the stars close in space are read together by the steps and
+///  drawn together. reorder_bounds.comp reduces the bounding box of the stars, reorder_keys.comp writes a 30-bit Morton
+///  key of each star in its bounding cube, the RadixSort sorts the stars by key, and reorder_gather.comp copies them in
+///  that order to the other vertex buffer of the galaxy, with their render vertices. The black holes of a merger keep
+///  their place, the stars with a NaN position go last, and each star keeps its Id.
+///  Everything is recorded in a command buffer of the compute queue: the host reads nothing back.
+class ReorderPass
+{
+public:
+    /// Descriptor sets allocated by Create.
+    static constexpr uint32_t NbDescriptorSets = 2 + RadixSort::NbDescriptorSets;
+    /// Storage buffer descriptors allocated by Create.
+    static constexpr uint32_t NbStorageDescriptors = 12 + RadixSort::NbStorageDescriptors;
+
+    ///  Constructor.
+    /// @param iDevice Device to initialize the pass with.
+    explicit ReorderPass(const olp::Device &iDevice);
+
+    ///  Creates the pipelines, the buffers and the descriptors, and records the command buffers.
+    /// @param iDescriptorPool Descriptor pool with NbDescriptorSets sets and NbStorageDescriptors storage buffers free.
+    /// @param iGalaxy Galaxy cloud, both vertex and render buffers.
+    /// @param iNbBlackHoles Number of first stars left in place, summed in full by the shaders.
+    /// @param iNbSlots Number of sorts in flight, each with its command buffers and timestamps.
+    void Create(
+        VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy, uint32_t iNbBlackHoles, uint32_t iNbSlots = 1);
+
+    ///  Destroys all vulkan elements of the pass.
+    void Destroy();
+
+    bool IsCreated() const { return m_CommandPool != VK_NULL_HANDLE; }
+
+    ///  Records the sort in a command buffer of the compute queue. Barriers order it after the previous commands
+    ///  writing or reading the stars, and before the following shaders, transfers and draws reading the sorted stars.
+    /// @param iCommandBuffer Command buffer in recording state.
+    /// @param iSource Vertex buffer of the galaxy holding the current stars, 0 or 1. The sorted stars are written to
+    ///                the other one, which becomes current.
+    void RecordReorder(VkCommandBuffer iCommandBuffer, uint32_t iSource) const;
+
+    ///  Submits the sort to the compute queue, while the sorts of the other slots may still be pending. Reads the GPU
+    ///  time of the previous sort of the slot, which must be done. The galaxy must then advance by one buffer.
+    /// @param[in] iSlot Slot of the sort, below the number of slots given to Create.
+    /// @param[in] iSource Vertex buffer of the galaxy holding the current stars, 0 or 1.
+    /// @param[in] iWaitSemaphores Semaphores to wait before the sort, the VK_NULL_HANDLE ones are skipped.
+    /// @param[in] iSignalSemaphores Semaphores to signal when the sort is finished.
+    /// @param[in] iFence Fence to signal when the sort is finished, VK_NULL_HANDLE for none.
+    void Submit(
+        uint32_t iSlot,
+        uint32_t iSource,
+        std::initializer_list<VkSemaphore> iWaitSemaphores,
+        std::initializer_list<VkSemaphore> iSignalSemaphores,
+        VkFence iFence);
+
+    ///  Sorts the stars at once in the first slot and waits for the end. No sort must be pending. The galaxy must then
+    ///  advance by one buffer.
+    /// @param iSource Vertex buffer of the galaxy holding the current stars, 0 or 1.
+    void Reorder(uint32_t iSource);
+
+    /// @return Semaphore for the commands reading the sorted stars.
+    VkSemaphore GetSemaphore() const { return m_Semaphore; }
+    /// @return GPU time of the last sort read back, in milliseconds. 0 if not measured.
+    float GetGpuTime() const { return m_GpuTime; }
+
+private:
+    ///  Creates the pipeline layout, shared by the three shaders.
+    void CreatePipelineLayout();
+
+    ///  Creates the pipeline of a shader.
+    /// @param iShaderName Name of the shader, without extension.
+    /// @return Compute pipeline.
+    VkPipeline CreatePipeline(const std::filesystem::path &iShaderName) const;
+
+    ///  Creates the state, keys and values buffers.
+    void CreateBuffers();
+
+    ///  Creates the descriptors of each vertex buffer.
+    /// @param iDescriptorPool Descriptor pool to allocate the descriptors.
+    /// @param iGalaxy Galaxy cloud.
+    void CreateDescriptors(VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy);
+
+    ///  Creates the command pool, the semaphore and the fence, and records for each slot a command buffer for each
+    ///  vertex buffer.
+    /// @param iNbSlots Number of sorts in flight.
+    void CreateCommandBuffers(uint32_t iNbSlots);
+
+    ///  Records a dispatch of a shader of the pass, an invocation by star.
+    /// @param iCommandBuffer Command buffer in recording state.
+    /// @param iSource Vertex buffer of the galaxy, 0 or 1.
+    /// @param iPipeline Pipeline of the shader.
+    void RecordDispatch(VkCommandBuffer iCommandBuffer, uint32_t iSource, VkPipeline iPipeline) const;
+
+    /// Vulkan device.
+    const olp::Device &m_Device;
+    uint32_t m_NbStars = 0;
+    /// Number of first stars left in place.
+    uint32_t m_NbBlackHoles = 0;
+
+    /// Layout of the three pipelines.
+    olp::PipelineLayout m_PipelineLayout;
+    VkPipeline m_BoundsPipeline = VK_NULL_HANDLE;
+    VkPipeline m_KeysPipeline = VK_NULL_HANDLE;
+    VkPipeline m_GatherPipeline = VK_NULL_HANDLE;
+    /// Descriptors of each vertex buffer holding the current stars.
+    std::array<olp::DescriptorSet, 2> m_DescriptorSets;
+
+    /// Number of stars, number of black holes and bounds of the stars: written before each sort.
+    olp::MemoryBuffer m_StateBuffer;
+    /// Key of each star, sorted with the values.
+    olp::MemoryBuffer m_Keys;
+    /// Index of each star, sorted with the keys.
+    olp::MemoryBuffer m_Values;
+    /// Sorts the stars by key.
+    RadixSort m_Sort;
+
+    /// Command pool for the compute queue.
+    VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+    /// Sort of the stars of each slot, for each vertex buffer holding the current stars.
+    std::vector<std::array<VkCommandBuffer, 2>> m_CommandBuffers;
+    /// Signaled by Submit when asked, for the steps and the draw reading the sorted stars.
+    VkSemaphore m_Semaphore = VK_NULL_HANDLE;
+    /// Fence of Reorder.
+    VkFence m_Fence = VK_NULL_HANDLE;
+    /// Timestamps around the sort, a slot for each sort in flight.
+    GpuTimer m_Timer;
+    /// The command buffers of each slot were submitted since Create, their timestamps are written once it is done.
+    std::vector<bool> m_SlotsSubmitted;
+    float m_GpuTime = 0.f;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Geometry/VkCloud.h"
+#include "Olympus/DescriptorSet.h"
+#include "Olympus/Device.h"
+#include "Olympus/MemoryBuffer.h"
+#include "Olympus/PipelineLayout.h"
+#include "Vulkan/GpuTimer.h"
+#include "Vulkan/RadixSort.h"
+#include <array>
+#include <filesystem>
+
+/// @brief
+///  Uniform grid of the stars on the device, the counterpart of SpatialGrid, rebuilt from the stars in O(N).
+///  grid_hash.comp hashes the cell of each star into a table of buckets, a power of two at least the number of stars,
+///  the RadixSort sorts the stars by bucket, then grid_cells.comp writes the range of each bucket in the sorted order
+///  and gathers the stars in that order, so a query reads the stars of a cell contiguously.
+///  grid_neighbors.comp is the fixed radius query, the radius being the cell size: it counts the neighbors of each star
+///  from the 27 cells around it.
+///  Other shaders walk the cells the same way with the cell ranges, the sorted stars and the sorted indices.
+class SpatialGridPass
+{
+public:
+    /// Descriptor sets allocated by Create.
+    static constexpr uint32_t NbDescriptorSets = 2 + RadixSort::NbDescriptorSets;
+    /// Storage buffer descriptors allocated by Create.
+    static constexpr uint32_t NbStorageDescriptors = 14 + RadixSort::NbStorageDescriptors;
+
+    ///  Constructor.
+    /// @param iDevice Device to initialize the grid with.
+    explicit SpatialGridPass(const olp::Device &iDevice);
+
+    ///  Creates the pipelines, the buffers of the grid and the descriptors.
+    /// @param iDescriptorPool Descriptor pool with NbDescriptorSets sets and NbStorageDescriptors storage buffers free.
+    /// @param iGalaxy Galaxy cloud, both vertex buffers.
+    void Create(VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy);
+
+    ///  Destroys all vulkan elements of the grid.
+    void Destroy();
+
+    bool IsCreated() const { return m_CommandPool != VK_NULL_HANDLE; }
+
+    ///  Records the build of the grid in a command buffer of the compute queue. Barriers order it after the previous
+    ///  commands writing the stars, and before the following shaders and transfers reading the grid.
+    /// @param iCommandBuffer Command buffer in recording state.
+    /// @param iSource Vertex buffer of the galaxy, 0 or 1.
+    /// @param iCellSize Edge of the cells, the radius of the queries.
+    void RecordBuild(VkCommandBuffer iCommandBuffer, uint32_t iSource, float iCellSize) const;
+
+    ///  Records the count of the neighbors of each star within the cell size, after RecordBuild.
+    /// @param iCommandBuffer Command buffer in recording state.
+    /// @param iSource Vertex buffer of the galaxy the grid was built from.
+    void RecordNeighborCounts(VkCommandBuffer iCommandBuffer, uint32_t iSource) const;
+
+    ///  Builds the grid and counts the neighbors at once, and waits for the end.
+    /// @param iSource Vertex buffer of the galaxy, 0 or 1.
+    /// @param iRadius Radius of the query, and edge of the cells.
+    void CountNeighbors(uint32_t iSource, float iRadius);
+
+    /// @return Number of other stars within the radius of each star of the galaxy, uint32_t, 0 for the NaN stars.
+    const olp::MemoryBuffer &GetNeighborCounts() const { return m_NeighborCounts; }
+    /// @return First and past the last sorted star of each bucket, two uint32_t.
+    const olp::MemoryBuffer &GetCellRanges() const { return m_CellRanges; }
+    /// @return Position (xyz) and mass (w) of the stars, sorted by bucket, the NaN stars last.
+    const olp::MemoryBuffer &GetSortedStars() const { return m_SortedStars; }
+    /// @return Index in the galaxy of each sorted star, uint32_t.
+    const olp::MemoryBuffer &GetSortedIndices() const { return m_Values; }
+    /// @return Number of buckets, a power of two.
+    uint32_t GetTableSize() const { return m_TableSize; }
+
+    /// @return GPU time of the build of the last CountNeighbors, in milliseconds. 0 if not measured.
+    float GetBuildTime() const { return m_BuildTime; }
+    /// @return GPU time of the query of the last CountNeighbors, in milliseconds. 0 if not measured.
+    float GetQueryTime() const { return m_QueryTime; }
+
+private:
+    ///  Creates the pipeline layout, shared by the three shaders.
+    void CreatePipelineLayout();
+
+    ///  Creates the pipeline of a shader.
+    /// @param iShaderName Name of the shader, without extension.
+    /// @return Compute pipeline.
+    VkPipeline CreatePipeline(const std::filesystem::path &iShaderName) const;
+
+    ///  Creates the state, keys, values, cell ranges, sorted stars and neighbor counts buffers.
+    void CreateBuffers();
+
+    ///  Creates the descriptors of each vertex buffer.
+    /// @param iDescriptorPool Descriptor pool to allocate the descriptors.
+    /// @param iGalaxy Galaxy cloud.
+    void CreateDescriptors(VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy);
+
+    ///  Creates the command pool, the command buffer and the fence of CountNeighbors.
+    void CreateCommandBuffer();
+
+    ///  Records a dispatch of a grid shader, an invocation by star.
+    /// @param iCommandBuffer Command buffer in recording state.
+    /// @param iSource Vertex buffer of the galaxy, 0 or 1.
+    /// @param iPipeline Pipeline of the shader.
+    void RecordDispatch(VkCommandBuffer iCommandBuffer, uint32_t iSource, VkPipeline iPipeline) const;
+
+    /// Vulkan device.
+    const olp::Device &m_Device;
+    uint32_t m_NbStars = 0;
+    /// Number of buckets, a power of two at least the number of stars.
+    uint32_t m_TableSize = 1;
+
+    /// Layout of the three pipelines.
+    olp::PipelineLayout m_PipelineLayout;
+    VkPipeline m_HashPipeline = VK_NULL_HANDLE;
+    VkPipeline m_CellsPipeline = VK_NULL_HANDLE;
+    VkPipeline m_NeighborsPipeline = VK_NULL_HANDLE;
+    /// Descriptors of each vertex buffer of the galaxy.
+    std::array<olp::DescriptorSet, 2> m_DescriptorSets;
+
+    /// Number of stars, mask of the table and size of the cells: written before the build.
+    olp::MemoryBuffer m_StateBuffer;
+    /// Bucket of each star, sorted with the values.
+    olp::MemoryBuffer m_Keys;
+    /// Index of each star, sorted with the keys.
+    olp::MemoryBuffer m_Values;
+    olp::MemoryBuffer m_CellRanges;
+    olp::MemoryBuffer m_SortedStars;
+    olp::MemoryBuffer m_NeighborCounts;
+    /// Sorts the stars by bucket.
+    RadixSort m_Sort;
+
+    /// Command pool for the compute queue.
+    VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+    /// Command buffer of CountNeighbors, recorded again at each call.
+    VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+    VkFence m_Fence = VK_NULL_HANDLE;
+    /// Timestamps around the build and the query of CountNeighbors.
+    GpuTimer m_Timer;
+    float m_BuildTime = 0.f;
+    float m_QueryTime = 0.f;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Olympus/Device.h"
+#include "Vulkan/ComputePass.h"
+#include "Vulkan/GpuTimer.h"
+#include <array>
+#include <initializer_list>
+#include <vector>
+
+/// @brief
+///  Several time steps in one submission: the dispatches of the passes of each step follow each other in command
+///  buffers, separated by barriers, so the number of steps per frame does not depend on the display rate.
+///  Each step reads the stars from a vertex buffer of the galaxy and writes them in the other one. The first step only
+///  writes the buffer not drawn by the frame, the next steps write both: they are in a second batch of the submission,
+///  which waits for the render pass.
+///  Each submission in flight has its slot, with its own command buffers and timestamps.
+class StepPass
+{
+public:
+    ///  Constructor.
+    /// @param iDevice Device to initialize the pass with.
+    explicit StepPass(const olp::Device &iDevice);
+
+    ///  Records the command buffers.
+    /// @param iPasses Passes of a step in order, created: the acceleration and integration passes, or the leapfrog
+    ///                pass alone. The last one writes the stars in the other vertex buffer.
+    /// @param iNbSteps Number of steps of a submission.
+    /// @param iNbSlots Number of submissions in flight.
+    void Create(std::vector<ComputePass *> iPasses, uint32_t iNbSteps, uint32_t iNbSlots = 1);
+
+    ///  Destroys the command buffers.
+    void Destroy();
+
+    ///  Records the command buffers again for another number of steps. They must not be pending.
+    /// @param iNbSteps Number of steps of a submission.
+    void SetNbSteps(uint32_t iNbSteps);
+
+    ///  Submits the steps to the compute queue, while the submissions of the other slots may still be pending.
+    /// @param[in] iSlot Slot of the submission, its previous submission must be done.
+    /// @param[in] iSource Vertex buffer of the galaxy holding the current stars, 0 or 1.
+    /// @param[in] iFirstWaitSemaphore Semaphore to wait before the first step, which writes the other vertex buffer.
+    ///                                VK_NULL_HANDLE to start at once.
+    /// @param[in] iNextWaitSemaphore Semaphore to wait before the next steps, which write iSource again.
+    ///                               VK_NULL_HANDLE to start at once, must be VK_NULL_HANDLE with a single step.
+    /// @param[in] iSignalSemaphores Semaphores to signal when the last step is finished.
+    /// @param[in] iFence Fence to signal when the last step is finished, VK_NULL_HANDLE for none.
+    /// @param[in] iFollowingCommandBuffers Command buffers submitted after the steps in the same submission, in order.
+    ///                                     The VK_NULL_HANDLE ones are skipped.
+    void Submit(
+        uint32_t iSlot,
+        uint32_t iSource,
+        VkSemaphore iFirstWaitSemaphore,
+        VkSemaphore iNextWaitSemaphore,
+        std::initializer_list<VkSemaphore> iSignalSemaphores,
+        VkFence iFence,
+        std::initializer_list<VkCommandBuffer> iFollowingCommandBuffers = {});
+
+    uint32_t GetNbSteps() const { return m_NbSteps; }
+
+    ///  Reads the GPU time of the dispatches of each pass in the last submission of a slot, without waiting.
+    /// @param[in] iSlot Slot whose last submission is done, its fence signaled.
+    /// @param[out] oPassTimes Time of each pass summed over the steps, in milliseconds. In the order of the passes given
+    ///                        to Create.
+    /// @return False if the slot was not submitted since Create, or its timestamps are not available.
+    bool ReadPassTimes(uint32_t iSlot, std::vector<float> &oPassTimes) const;
+
+private:
+    ///  Creates the command pool, the command buffers and the timers, then records the steps.
+    /// @param iNbSlots Number of submissions in flight.
+    void BuildCommandBuffers(uint32_t iNbSlots);
+
+    ///  Records steps in a command buffer.
+    /// @param iCommandBuffer Command buffer to record.
+    /// @param iTimer Timer of the command buffer, passes * iNbSteps + 1 timestamps by slot.
+    /// @param iSlot Slot of the command buffer.
+    /// @param iSource Vertex buffer holding the stars before the first step.
+    /// @param iNbSteps Number of steps to record.
+    void RecordSteps(
+        VkCommandBuffer iCommandBuffer, GpuTimer &iTimer, uint32_t iSlot, uint32_t iSource, uint32_t iNbSteps);
+
+    /// Vulkan device.
+    const olp::Device &m_Device;
+
+    /// Passes of a step, in order.
+    std::vector<ComputePass *> m_Passes;
+    uint32_t m_NbSteps = 1;
+
+    /// Command pool for the compute queue.
+    VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+    /// First step of each slot, for each vertex buffer holding the stars.
+    std::vector<std::array<VkCommandBuffer, 2>> m_FirstStep;
+    /// Following steps of each slot, for each vertex buffer holding the stars after the first step. Unused with a
+    /// single step.
+    std::vector<std::array<VkCommandBuffer, 2>> m_NextSteps;
+
+    /// Timestamps around the dispatches of the first step: passes + 1 by slot.
+    GpuTimer m_FirstTimer;
+    /// Timestamps around the dispatches of the following steps: passes * (steps - 1) + 1 by slot.
+    GpuTimer m_NextTimer;
+    /// The command buffers of each slot were submitted since Create, their timestamps are written once it is done.
+    std::vector<bool> m_SlotsSubmitted;
+};
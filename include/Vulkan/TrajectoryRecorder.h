@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Olympus/Device.h"
+#include "Olympus/MemoryBuffer.h"
+#include "Geometry/VkCloud.h"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief
+///  Records the stars every N steps to a trajectory file, without stalling the frames.
+///  The stars read by the last step, their speeds synchronized with the positions (VkCloud::GetSyncedBuffer), are
+///  copied into a ring of host-visible buffers by a command buffer submitted with the
+///  integration pass. An event tells when a copy is done, then a writer thread drains the buffer to the file. When every buffer
+///  of the ring is busy, the step is dropped instead of waiting.
+class TrajectoryRecorder
+{
+public:
+    /// Constructor.
+    /// @param iDevice Device running the compute passes.
+    explicit TrajectoryRecorder(const olp::Device &iDevice);
+
+    /// Destructor, stops the recording.
+    ~TrajectoryRecorder();
+
+    TrajectoryRecorder(const TrajectoryRecorder &) = delete;
+    TrajectoryRecorder &operator=(const TrajectoryRecorder &) = delete;
+
+    /// Opens the trajectory file and creates the ring for a galaxy.
+    /// Throws std::runtime_error if the file cannot be created.
+    /// @param iPath Path of the trajectory file, replaced if it exists.
+    /// @param iGalaxy Galaxy to record, must outlive the recording.
+    /// @param iInterval Number of steps between two records.
+    /// @param iRingSize Number of host-visible buffers.
+    void Start(const std::filesystem::path &iPath, const VkCloud &iGalaxy, uint32_t iInterval, uint32_t iRingSize = 3);
+
+    /// Waits for the copies in flight, writes them and closes the file.
+    void Stop();
+
+    /// Counts the steps of a submission and hands the finished copies to the writer thread.
+    /// The current vertex buffer of the galaxy must be the one written by the last step of the submission.
+    /// @param iNbSteps Number of steps of the submission.
+    /// @return Command buffer copying the stars, to submit right after the last integration pass of the submission.
+    ///         VK_NULL_HANDLE if no record is due.
+    VkCommandBuffer NextStep(uint32_t iNbSteps = 1);
+
+    bool IsRecording() const { return m_Recording; }
+    uint64_t GetNbRecorded() const { return m_NbRecorded; }
+    /// @return Number of steps not recorded because the ring was full.
+    uint64_t GetNbDropped() const { return m_NbDropped; }
+
+private:
+    /// Buffer of the ring.
+    struct Slot
+    {
+        enum class State
+        {
+            Free,
+            /// Copy submitted, waiting for the event.
+            Copying,
+            /// Handed to the writer thread.
+            Writing
+        };
+
+        olp::MemoryBuffer Buffer;
+        /// Mapped memory of the buffer.
+        const void *Data = nullptr;
+        /// Copy of each vertex buffer of the galaxy.
+        std::array<VkCommandBuffer, 2> CommandBuffers{};
+        /// Set by the device when the copy is done.
+        VkEvent Event = VK_NULL_HANDLE;
+        /// Number of steps before the stars copied in the buffer, one less than the steps submitted.
+        uint64_t Step = 0;
+        State Status = State::Free;
+    };
+
+    /// Records a copy command buffer of a slot.
+    /// @param ioSlot Slot to record.
+    /// @param iSource Current vertex buffer of the galaxy, 0 or 1. The other one is copied, see
+    ///                VkCloud::GetSyncedBuffer.
+    void BuildCommandBuffer(Slot &ioSlot, uint32_t iSource);
+
+    /// Hands the finished copies to the writer thread, in submission order.
+    void CollectCopies();
+
+    /// Loop of the writer thread.
+    void WriteLoop();
+
+    /// Vulkan device.
+    const olp::Device &m_Device;
+
+    /// Recorded galaxy.
+    const VkCloud *m_Galaxy = nullptr;
+    uint32_t m_NbStars = 0;
+    uint32_t m_Interval = 1;
+    /// Number of steps submitted.
+    uint64_t m_Step = 0;
+    bool m_Recording = false;
+    uint64_t m_NbRecorded = 0;
+    uint64_t m_NbDropped = 0;
+
+    /// Command pool of the copies, on the compute queue family.
+    VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+    std::vector<Slot> m_Slots;
+    /// Slots being copied, oldest first.
+    std::deque<uint32_t> m_Copying;
+
+    /// Trajectory file, written by the writer thread only.
+    std::ofstream m_File;
+    std::thread m_Writer;
+    /// Protects the states of the slots, m_Writing and m_StopWriter.
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    /// Slots to write, oldest first.
+    std::deque<uint32_t> m_Writing;
+    bool m_StopWriter = false;
+};
@@ -4,6 +4,7 @@
 #include "Camera.h"
 #include "Menu.h"
 #include "Olympus/ImGUI.h"
+#include <fstream>
 #include <memory>
 
 /// Main window manage with GLFW.
@@ -48,8 +49,20 @@ private:
     /// Update real time parameters.
     void UpdateParameters();
 
+    /// Creates the galaxy of the menu, or the galaxies of its merger in one cloud.
+    void InitializeGalaxy();
+
     void Restart();
 
+    /// Saves the stars and the parameters of the menu in the snapshot file of the menu.
+    void SaveSnapshot();
+    /// Restarts from the snapshot file of the menu.
+    void LoadSnapshot();
+    /// Starts or stops the recording of the trajectory as checked in the menu.
+    void UpdateRecording();
+    /// Sends the GPU times of the passes to the menu, and to the log file if checked in the menu.
+    void UpdateGpuTimes();
+
     /// GLFW window.
     GLFWwindow *m_Window = nullptr;
     /// Window's name
@@ -66,6 +79,11 @@ private:
     /// Renderer.
     std::unique_ptr<Renderer> m_Renderer;
 
+    /// CSV log of the GPU times, open while checked in the menu.
+    std::ofstream m_GpuTimesLog;
+    /// Number of frames drawn.
+    uint64_t m_FrameIndex = 0;
+
     Camera m_Camera;
     Menu m_Menu;
     glm::vec2 m_PrevMousePos;
@@ -1,7 +1,7 @@
 #version 450
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec4 inSpeed;
+// Position (xyz) and brightness (w) of the star, half floats written by the integration step.
+layout(location = 0) in vec4 inPositionBrightness;
 
 layout(location = 0) out float outBrightness;
 
@@ -13,6 +13,6 @@ layout(binding = 0) uniform ModelInfo {
 
 void main() {
     gl_PointSize = 1;
-    gl_Position = modelUbo.proj * modelUbo.view * modelUbo.model * vec4(inPosition, 1.0);
-    outBrightness = length(inSpeed.xyz);
+    gl_Position = modelUbo.proj * modelUbo.view * modelUbo.model * vec4(inPositionBrightness.xyz, 1.0);
+    outBrightness = inPositionBrightness.w;
 }
@@ -0,0 +1,73 @@
+// Cells and buckets of the uniform grid, shared by the shaders building and walking it.
+// The including shader declares the storage buffer state, the sizes of the grid written by
+// SpatialGridPass::RecordBuild.
+
+// Largest cell coordinate, the cells further away are clamped to it.
+#define MAX_CELL 1073741824.0
+
+// Bucket of a cell, the hash of SpatialGrid::Hash.
+uint Hash(ivec3 cell)
+{
+    uvec3 ucell = uvec3(cell);
+    return ((ucell.x * 73856093u) ^ (ucell.y * 19349663u) ^ (ucell.z * 83492791u)) & state.TableMask;
+}
+
+ivec3 GetCell(vec3 pos)
+{
+    return ivec3(clamp(floor(pos * state.InvCellSize), vec3(-MAX_CELL), vec3(MAX_CELL)));
+}
+
+// Walk of the buckets of the cells within a radius of a position, the loop of SpatialGrid::ForEachNeighbor:
+//     NeighborCells cells = BeginNeighborCells(pos, radius);
+//     uint bucket;
+//     while (NextNeighborBucket(cells, bucket))
+//         for (uint j = cellRanges[bucket].x; j < cellRanges[bucket].y; ++j) ...
+// The radius is at most the cell size: 3 cells along each axis, 4 when a bound falls on the edge of a cell. Distinct
+// cells may share a bucket, so the sorted stars of a range must still be filtered by distance.
+struct NeighborCells
+{
+    ivec3 Low;
+    ivec3 High;
+    // Next cell to read.
+    ivec3 Cell;
+    // Buckets already read, each one is read once.
+    uint Visited[64];
+    uint NbVisited;
+};
+
+NeighborCells BeginNeighborCells(vec3 pos, float radius)
+{
+    NeighborCells cells;
+    cells.Low = GetCell(pos - vec3(radius));
+    cells.High = min(GetCell(pos + vec3(radius)), cells.Low + ivec3(3));
+    cells.Cell = cells.Low;
+    cells.NbVisited = 0;
+    return cells;
+}
+
+// Gives the next bucket not read yet, false once all the cells are read.
+bool NextNeighborBucket(inout NeighborCells cells, out uint bucket)
+{
+    while (cells.Cell.z <= cells.High.z)
+    {
+        bucket = Hash(cells.Cell);
+        if (++cells.Cell.x > cells.High.x)
+        {
+            cells.Cell.x = cells.Low.x;
+            if (++cells.Cell.y > cells.High.y)
+            {
+                cells.Cell.y = cells.Low.y;
+                ++cells.Cell.z;
+            }
+        }
+
+        bool seen = false;
+        for (uint v = 0; v < cells.NbVisited; ++v)
+            seen = seen || cells.Visited[v] == bucket;
+        if (seen)
+            continue;
+        cells.Visited[cells.NbVisited++] = bucket;
+        return true;
+    }
+    return false;
+}
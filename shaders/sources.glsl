@@ -0,0 +1,65 @@
+// Gravity sources of a step, shared by the shaders computing the accelerations.
+// The including shader declares the uniform options (AccelerationPass::Options), the storage buffer stepState
+// (IntegrationPass::StepState) and the stars read by the step, positions[].
+
+// Sampled gravity sources of the step, as GetSourceSampling in SourceSampling.h: one star every Stride stars from
+// Offset, among the stars after the NbBlackHoles first ones. Rotating sources move by one star at each step, so every
+// star is a source once every Stride steps and the mass scaled by the stride keeps the sum unbiased. Fixed sources are
+// the same stars forever.
+struct Sources
+{
+    uint Count;
+    uint Stride;
+    // Index of the first source, past the black holes.
+    uint Offset;
+    float MassScale;
+};
+
+Sources GetSources()
+{
+    uint nbStars = options.NbPoints - options.NbBlackHoles;
+    Sources sources;
+    sources.Count = min(uint(ceil(options.InteractionRate * nbStars)), nbStars);
+    uint count = max(sources.Count, 1);
+    if (options.RotateSources != 0)
+    {
+        sources.Stride = max((nbStars + count - 1) / count, 1);
+        sources.Offset = options.NbBlackHoles + stepState.NbSteps % sources.Stride;
+        sources.MassScale = float(sources.Stride);
+    }
+    else
+    {
+        sources.Stride = max(nbStars / count, 1);
+        sources.Offset = options.NbBlackHoles;
+        sources.MassScale = 1.0 / options.InteractionRate;
+    }
+    return sources;
+}
+
+float Norm2(vec3 vector)
+{
+    return pow(vector.x, 2) + pow(vector.y, 2) + pow(vector.z, 2);
+}
+
+// Attraction of the black holes of a merger, the NbBlackHoles first stars, on the star index. They are summed in full
+// with their own mass: sampled with the other stars, one of them would weigh a whole galaxy in some steps and nothing
+// in the others.
+vec3 BlackHolesAcceleration(uint index, vec3 pos)
+{
+    vec3 acc = vec3(0, 0, 0);
+    for (uint i = 0; i < options.NbBlackHoles; ++i)
+    {
+        vec3 other = positions[i].pos;
+        if (isnan(other.x) || isnan(other.y) || isnan(other.z))
+            continue;
+        if (i == index)
+            continue;
+
+        vec3 vector = other - pos;
+        float norm = Norm2(vector) + options.SmoothLength;
+        if (norm == 0)
+            continue;
+        acc += positions[i].mass * (normalize(vector) / norm);
+    }
+    return acc;
+}
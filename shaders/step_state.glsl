@@ -0,0 +1,68 @@
+// Choice of the time step on the GPU, shared by the shaders computing the accelerations.
+// The including shader declares the uniforms options (AccelerationPass::Options) and stepOptions
+// (IntegrationPass::Options), and the storage buffer stepState (IntegrationPass::StepState).
+
+// The step never goes below this part of the longest step, so a star thrown out does not stop the simulation.
+#define MIN_STEP_RATIO (1.0 / 1024.0)
+
+// Drift of the current time step: with the adaptive step, the step chosen from the maxima of the previous time step,
+// the longest step before the first reduction.
+float CurrentStep()
+{
+    return stepOptions.AdaptiveStep != 0 && stepState.Step > 0 ? stepState.Step : stepOptions.Step;
+}
+
+// Largest acceleration and speed of the workgroup.
+shared uint groupMaxAcceleration;
+shared uint groupMaxSpeed;
+
+// Adds the acceleration and speed of a star to the maxima of the step, called by every invocation. The last workgroup
+// to finish chooses the next step from them, then clears them: no star moves more than a part of the softening length
+// (Courant condition) nor is accelerated over it.
+void ReduceStep(bool active, vec3 acc, vec3 speed)
+{
+    if (gl_LocalInvocationID.x == 0)
+    {
+        groupMaxAcceleration = 0;
+        groupMaxSpeed = 0;
+    }
+    barrier();
+
+    float accNorm = length(acc);
+    float speedNorm = length(speed);
+    if (active && !isnan(accNorm) && !isnan(speedNorm))
+    {
+        atomicMax(groupMaxAcceleration, floatBitsToUint(accNorm));
+        atomicMax(groupMaxSpeed, floatBitsToUint(speedNorm));
+    }
+    barrier();
+
+    if (gl_LocalInvocationID.x != 0)
+        return;
+    atomicMax(stepState.MaxAcceleration, groupMaxAcceleration);
+    atomicMax(stepState.MaxSpeed, groupMaxSpeed);
+    memoryBarrierBuffer();
+    if (atomicAdd(stepState.NbGroupsDone, 1) != gl_NumWorkGroups.x - 1)
+        return;
+
+    // Every other workgroup added its maxima.
+    float maxAcceleration = uintBitsToFloat(atomicOr(stepState.MaxAcceleration, 0));
+    float maxSpeed = uintBitsToFloat(atomicOr(stepState.MaxSpeed, 0));
+    float step = stepOptions.Step;
+    if (stepOptions.AdaptiveStep != 0)
+    {
+        float softening = sqrt(options.SmoothLength);
+        if (maxAcceleration > 0)
+            step = min(step, stepOptions.StepAccuracy * sqrt(softening / maxAcceleration));
+        if (maxSpeed > 0)
+            step = min(step, stepOptions.StepAccuracy * softening / maxSpeed);
+        step = max(step, stepOptions.Step * MIN_STEP_RATIO);
+    }
+    stepState.PreviousStep = stepState.DriftStep;
+    stepState.DriftStep = CurrentStep();
+    stepState.Step = step;
+    stepState.MaxAcceleration = 0;
+    stepState.MaxSpeed = 0;
+    stepState.NbGroupsDone = 0;
+    stepState.NbSteps += 1;
+}
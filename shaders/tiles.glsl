@@ -0,0 +1,44 @@
+// Tiled sum of the attraction of the sampled sources, shared by the shaders computing the accelerations.
+// The including shader defines TILE_SIZE, its workgroup size, declares the stars read by the step, positions[], and
+// includes sources.glsl before this file.
+
+// Position (xyz) and mass (w) of the sources of the current tile.
+// NaN sources and sources past the interaction rate have a null mass, so the inner loop has no test on them.
+shared vec4 tile[TILE_SIZE];
+
+// Attraction of the sampled sources of the step on a star, the same sources as acceleration.comp. The sources are read
+// once per workgroup: each invocation stages one source in shared memory, then the whole workgroup reads the tile.
+// Called by every invocation of the workgroup, past the end of the stars too, so all of them reach the barriers.
+vec3 TiledAcceleration(vec3 pos)
+{
+    // The sources are spread over all the stars: once reordered along the Z-curve, the first stars are one region.
+    Sources sources = GetSources();
+
+    vec3 acc = vec3(0, 0, 0);
+    for (uint tileStart = 0; tileStart < sources.Count; tileStart += TILE_SIZE)
+    {
+        uint source = tileStart + gl_LocalInvocationID.x;
+        uint index = source * sources.Stride + sources.Offset;
+        vec4 staged = vec4(0, 0, 0, 0);
+        if (source < sources.Count && index < options.NbPoints)
+        {
+            Vertex other = positions[index];
+            if (!any(isnan(other.pos)))
+                staged = vec4(other.pos, other.mass * sources.MassScale);
+        }
+        tile[gl_LocalInvocationID.x] = staged;
+        barrier();
+
+        for (uint i = 0; i < TILE_SIZE; ++i)
+        {
+            vec4 other = tile[i];
+            vec3 vector = other.xyz - pos;
+            float distance2 = dot(vector, vector);
+            // The star itself is at distance 0 and adds nothing.
+            float factor = distance2 > 0 ? other.w * inversesqrt(distance2) / (distance2 + options.SmoothLength) : 0;
+            acc += factor * vector;
+        }
+        barrier();
+    }
+    return acc;
+}
@@ -0,0 +1,286 @@
+#include "CommandLine.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+const char *NextValue(int iArgc, char **iArgv, int &ioIndex)
+{
+    if (ioIndex + 1 >= iArgc)
+        throw std::invalid_argument(std::string("missing value after ") + iArgv[ioIndex]);
+    return iArgv[++ioIndex];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t ToUInt(const char *iValue)
+{
+    try
+    {
+        return static_cast<uint32_t>(std::stoul(iValue));
+    }
+    catch (const std::exception &)
+    {
+        throw std::invalid_argument(std::string("invalid integer: ") + iValue);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+CommandLineOptions::CpuSolver ToCpuSolver(const std::string &iValue)
+{
+    if (iValue == "direct")
+        return CommandLineOptions::CpuSolver::Direct;
+    if (iValue == "direct-simd")
+        return CommandLineOptions::CpuSolver::DirectSimd;
+    if (iValue == "barnes-hut")
+        return CommandLineOptions::CpuSolver::BarnesHut;
+    if (iValue == "fmm")
+        return CommandLineOptions::CpuSolver::Fmm;
+    if (iValue == "pm")
+        return CommandLineOptions::CpuSolver::ParticleMesh;
+    throw std::invalid_argument("unknown solver: " + iValue);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool ToTiledAcceleration(const std::string &iValue)
+{
+    if (iValue == "direct")
+        return false;
+    if (iValue == "tiled")
+        return true;
+    throw std::invalid_argument("unknown acceleration kernel: " + iValue);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool ToFusedLeapfrog(const std::string &iValue)
+{
+    if (iValue == "split")
+        return false;
+    if (iValue == "leapfrog")
+        return true;
+    throw std::invalid_argument("unknown integrator: " + iValue);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool ToRotateSources(const std::string &iValue)
+{
+    if (iValue == "fixed")
+        return false;
+    if (iValue == "rotating")
+        return true;
+    throw std::invalid_argument("unknown sampling: " + iValue);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float ToFloat(const char *iValue)
+{
+    try
+    {
+        return std::stof(iValue);
+    }
+    catch (const std::exception &)
+    {
+        throw std::invalid_argument(std::string("invalid number: ") + iValue);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @param iValue Comma separated key=value pairs.
+/// @param iGalaxy Parameters of the galaxy for the keys not given.
+GalaxyDescription ToGalaxy(const std::string &iValue, GalaxyDescription iGalaxy)
+{
+    size_t start = 0;
+    while (start < iValue.size())
+    {
+        const size_t end = std::min(iValue.find(',', start), iValue.size());
+        const std::string pair = iValue.substr(start, end - start);
+        const size_t equal = pair.find('=');
+        if (equal == std::string::npos)
+            throw std::invalid_argument("invalid galaxy parameter: " + pair);
+        const std::string key = pair.substr(0, equal);
+        const char *value = pair.c_str() + equal + 1;
+        if (key == "stars")
+            iGalaxy.NbStars = ToUInt(value);
+        else if (key == "diameter")
+            iGalaxy.Diameter = ToFloat(value);
+        else if (key == "thickness")
+            iGalaxy.Thickness = ToFloat(value);
+        else if (key == "speed")
+            iGalaxy.StarsSpeed = ToFloat(value);
+        else if (key == "black-hole-mass")
+            iGalaxy.BlackHoleMass = ToFloat(value);
+        else if (key == "x")
+            iGalaxy.Position.x = ToFloat(value);
+        else if (key == "y")
+            iGalaxy.Position.y = ToFloat(value);
+        else if (key == "z")
+            iGalaxy.Position.z = ToFloat(value);
+        else if (key == "vx")
+            iGalaxy.Velocity.x = ToFloat(value);
+        else if (key == "vy")
+            iGalaxy.Velocity.y = ToFloat(value);
+        else if (key == "vz")
+            iGalaxy.Velocity.z = ToFloat(value);
+        else if (key == "inclination")
+            iGalaxy.Inclination = ToFloat(value);
+        else
+            throw std::invalid_argument("unknown galaxy parameter: " + key);
+        start = end + 1;
+    }
+    return iGalaxy;
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+CommandLineOptions ParseCommandLine(int iArgc, char **iArgv)
+{
+    CommandLineOptions options;
+    // The galaxies take the galaxy parameters of the whole command line for the keys they do not give.
+    std::vector<std::string> galaxies;
+    for (int i = 1; i < iArgc; ++i)
+    {
+        const std::string arg = iArgv[i];
+        if (arg == "--cpu")
+            options.RunMode = CommandLineOptions::Mode::Cpu;
+        else if (arg == "--headless")
+            options.RunMode = CommandLineOptions::Mode::Headless;
+        else if (arg == "--steps")
+            options.NbSteps = ToUInt(NextValue(iArgc, iArgv, i));
+        else if (arg == "--threads")
+            options.NbThreads = ToUInt(NextValue(iArgc, iArgv, i));
+        else if (arg == "--solver")
+            options.Solver = ToCpuSolver(NextValue(iArgc, iArgv, i));
+        else if (arg == "--theta")
+            options.OpeningAngle = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--fmm-order")
+            options.FmmOrder = ToUInt(NextValue(iArgc, iArgv, i));
+        else if (arg == "--pm-grid")
+            options.PmGridSize = ToUInt(NextValue(iArgc, iArgv, i));
+        else if (arg == "--rungs")
+            options.MaxRung = ToUInt(NextValue(iArgc, iArgv, i));
+        else if (arg == "--rung-accuracy")
+            options.RungAccuracy = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--force-error")
+            options.ForceErrorSamples = ToUInt(NextValue(iArgc, iArgv, i));
+        else if (arg == "--neighbors")
+            options.NeighborRadius = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--sampling-error")
+            options.SamplingErrorSamples = ToUInt(NextValue(iArgc, iArgv, i));
+        else if (arg == "--kernel")
+            options.Galaxy.TiledAcceleration = ToTiledAcceleration(NextValue(iArgc, iArgv, i));
+        else if (arg == "--integrator")
+            options.Galaxy.FusedLeapfrog = ToFusedLeapfrog(NextValue(iArgc, iArgv, i));
+        else if (arg == "--validate")
+            options.ValidateKernels = true;
+        else if (arg == "--load")
+            options.LoadPath = NextValue(iArgc, iArgv, i);
+        else if (arg == "--save")
+            options.SavePath = NextValue(iArgc, iArgv, i);
+        else if (arg == "--record")
+            options.RecordPath = NextValue(iArgc, iArgv, i);
+        else if (arg == "--record-every")
+            options.RecordInterval = ToUInt(NextValue(iArgc, iArgv, i));
+        else if (arg == "--gpu-times")
+            options.GpuTimesPath = NextValue(iArgc, iArgv, i);
+        else if (arg == "--stars")
+            options.Galaxy.NbStars = static_cast<int>(ToUInt(NextValue(iArgc, iArgv, i)));
+        else if (arg == "--diameter")
+            options.Galaxy.Diameter = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--thickness")
+            options.Galaxy.Thickness = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--speed")
+            options.Galaxy.StarsSpeed = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--black-hole-mass")
+            options.Galaxy.BlackHoleMass = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--galaxy")
+            galaxies.emplace_back(NextValue(iArgc, iArgv, i));
+        else if (arg == "--galaxies")
+            options.Galaxy.NbGalaxies = static_cast<int>(ToUInt(NextValue(iArgc, iArgv, i)));
+        else if (arg == "--separation")
+            options.Galaxy.Separation = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--approach-speed")
+            options.Galaxy.ApproachSpeed = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--step")
+            options.RealTime.Step = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--smoothing-length")
+            options.RealTime.SmoothingLenght = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--adaptive-step")
+            options.RealTime.AdaptiveStep = true;
+        else if (arg == "--step-accuracy")
+            options.RealTime.StepAccuracy = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--reorder")
+            options.RealTime.ReorderInterval = static_cast<int>(ToUInt(NextValue(iArgc, iArgv, i)));
+        else if (arg == "--interaction-rate")
+            options.RealTime.InteractionRate = ToFloat(NextValue(iArgc, iArgv, i));
+        else if (arg == "--sampling")
+            options.RealTime.RotateSources = ToRotateSources(NextValue(iArgc, iArgv, i));
+        else
+            throw std::invalid_argument("unknown argument: " + arg);
+    }
+
+    for (const std::string &galaxy : galaxies)
+        options.Galaxies.push_back(ToGalaxy(galaxy, options.Galaxy.GetDescription()));
+    return options;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<GalaxyDescription> GetGalaxies(const CommandLineOptions &iOptions)
+{
+    return iOptions.Galaxies.empty() ? iOptions.Galaxy.GetMerger() : iOptions.Galaxies;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string GetCommandLineUsage()
+{
+    return "Usage: Galaxy [options]\n"
+           "Modes:\n"
+           "  --cpu                      Run the simulation on the CPU, without window.\n"
+           "  --headless                 Run the compute shaders on the GPU, without window.\n"
+           "Run options:\n"
+           "  --steps <n>                Number of time steps to run (default 100).\n"
+           "  --threads <n>              Number of CPU threads, 0 for every core (default 0).\n"
+           "  --load <file>              Start from a snapshot, with its parameters.\n"
+           "  --save <file>              Write a snapshot at the end of the run.\n"
+           "  --record <file>            Record the stars to a trajectory file, headless mode only.\n"
+           "  --record-every <n>         Steps between two records of the trajectory (default 10).\n"
+           "  --gpu-times <file>         Log the GPU time of the passes at each step, headless mode only.\n"
+           "  --neighbors <f>            Count the stars closer than f to each star with a uniform grid, at start and\n"
+           "                             end of the run.\n"
+           "CPU solver:\n"
+           "  --solver <name>            direct (default), direct-simd, barnes-hut, fmm or pm.\n"
+           "  --theta <f>                Opening angle of barnes-hut and fmm (default 0.5).\n"
+           "  --fmm-order <n>            Order of the fmm expansions, 1 to 12 (default 4).\n"
+           "  --pm-grid <n>              Cells along each axis of the pm grid, power of two (default 128).\n"
+           "  --rungs <n>                Block time steps: each star steps Step / 2^r, r up to n (default 0, off).\n"
+           "  --rung-accuracy <f>        Step of a star relative to sqrt(softening / acceleration) (default 0.25).\n"
+           "  --force-error <n>          Report the error against the direct sum on n stars.\n"
+           "  --sampling-error <n>       Report the error of the sampled sources on n stars, for decreasing interaction\n"
+           "                             rates, fixed and rotating.\n"
+           "GPU shaders:\n"
+           "  --kernel <name>            Acceleration shader: direct (default) or tiled.\n"
+           "  --integrator <name>        Passes of a time step: split (default) or leapfrog (one fused dispatch).\n"
+           "  --validate                 Compare the tiled shader with the direct one, and the fused step with the\n"
+           "                             split one, first. Exits with an error above the tolerances.\n"
+           "Galaxy parameters:\n"
+           "  --stars <n>                Number of stars.\n"
+           "  --diameter <f>             Diameter of the galaxy.\n"
+           "  --thickness <f>            Thickness of the galaxy.\n"
+           "  --speed <f>                Initial speed of the stars.\n"
+           "  --black-hole-mass <f>      Mass of the central black hole.\n"
+           "  --galaxies <n>             Merge n copies of the galaxy, each black hole being a star at its center.\n"
+           "  --separation <f>           Distance of the merging galaxies to the center (default 300).\n"
+           "  --approach-speed <f>       Speed of the merging galaxies (default 10).\n"
+           "  --galaxy <key=value,...>   Add a galaxy to the buffer, repeatable, instead of --galaxies. Keys: stars,\n"
+           "                             diameter, thickness, speed, black-hole-mass, x, y, z, vx, vy, vz and\n"
+           "                             inclination (degrees around X); the others take the galaxy parameters.\n"
+           "Simulation parameters:\n"
+           "  --step <f>                 Time step duration, the longest one with --adaptive-step.\n"
+           "  --adaptive-step            Choose each step on the GPU from the largest acceleration and speed.\n"
+           "  --step-accuracy <f>        Part of the softening length a star moves in an adaptive step (default 0.01).\n"
+           "  --smoothing-length <f>     Smoothing length.\n"
+           "  --interaction-rate <f>     Interaction rate.\n"
+           "  --sampling <name>          Gravity sources of the interaction rate: rotating (default, every star in turn)\n"
+           "                             or fixed (the same stars at each step).\n"
+           "  --reorder <n>              Sort the stars along the Z-curve every n steps, headless mode only\n"
+           "                             (default 0, never).\n";
+}
@@ -0,0 +1,202 @@
+#include "CpuRunner.h"
+#include "Geometry/GalaxyGenerator.h"
+#include "Snapshot.h"
+#include "Simulation/BarnesHutSolver.h"
+#include "Simulation/DirectSolver.h"
+#include "Simulation/FmmSolver.h"
+#include "Simulation/PmSolver.h"
+#include "Simulation/SimdDirectSolver.h"
+#include "Simulation/SpatialGrid.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+//----------------------------------------------------------------------------------------------------------------------
+CpuRunner::CpuRunner(const CommandLineOptions &iOptions)
+    : m_Options(iOptions),
+      m_Simulation(iOptions.NbThreads)
+{
+    if (!m_Options.LoadPath.empty())
+    {
+        Snapshot snapshot(m_Options.LoadPath);
+        m_Options.Galaxy = snapshot.GetGalaxyParameters();
+        m_Options.RealTime = snapshot.GetRealTimeParameters();
+        m_Simulation.Init(
+            std::vector<CloudVertex>(snapshot.GetStars(), snapshot.GetStars() + snapshot.GetNbStars()),
+            m_Options.Galaxy.BlackHoleMass,
+            snapshot.GetNbBlackHoles());
+    }
+    else if (const std::vector<GalaxyDescription> galaxies = GetGalaxies(m_Options); !galaxies.empty())
+    {
+        m_GalaxyRanges = GetGalaxyRanges(galaxies);
+        std::vector<CloudVertex> stars = GenerateGalaxies(galaxies);
+        // The black holes are the first stars.
+        m_Options.Galaxy.NbStars = static_cast<int>(stars.size());
+        m_Options.Galaxy.BlackHoleMass = 0.f;
+        m_Simulation.Init(std::move(stars), 0.f, CountBlackHoles(galaxies));
+    }
+    else
+    {
+        const Menu::GalaxyParameters &galaxy = m_Options.Galaxy;
+        m_Simulation.Init(
+            GenerateGalaxy(galaxy.NbStars, galaxy.Diameter, galaxy.Thickness, galaxy.StarsSpeed),
+            galaxy.BlackHoleMass);
+    }
+
+    m_Simulation.SetStep(m_Options.RealTime.Step);
+    m_Simulation.SetInteractionRate(m_Options.RealTime.InteractionRate);
+    m_Simulation.SetSmoothLenght(m_Options.RealTime.SmoothingLenght);
+    m_Simulation.SetRotateSources(m_Options.RealTime.RotateSources);
+    m_Simulation.SetSolver(CreateSolver());
+    m_Simulation.SetBlockSteps(m_Options.MaxRung, m_Options.RungAccuracy);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::unique_ptr<ForceSolver> CpuRunner::CreateSolver()
+{
+    switch (m_Options.Solver)
+    {
+    case CommandLineOptions::CpuSolver::DirectSimd:
+        return std::make_unique<SimdDirectSolver>(m_Simulation.GetThreadPool());
+    case CommandLineOptions::CpuSolver::BarnesHut:
+        return std::make_unique<BarnesHutSolver>(m_Simulation.GetThreadPool(), m_Options.OpeningAngle);
+    case CommandLineOptions::CpuSolver::Fmm:
+        return std::make_unique<FmmSolver>(m_Simulation.GetThreadPool(), m_Options.FmmOrder, m_Options.OpeningAngle);
+    case CommandLineOptions::CpuSolver::ParticleMesh:
+        return std::make_unique<PmSolver>(m_Simulation.GetThreadPool(), m_Options.PmGridSize);
+    case CommandLineOptions::CpuSolver::Direct:
+    default:
+        return std::make_unique<DirectSolver>(m_Simulation.GetThreadPool());
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuRunner::Run()
+{
+    std::cout << "CPU simulation of " << m_Simulation.GetSize() << " stars on "
+              << m_Simulation.GetNbThreads() << " threads, " << m_Simulation.GetSolver().GetName() << " solver" << std::endl;
+
+    if (m_Options.ForceErrorSamples > 0)
+        PrintForceError();
+    if (m_Options.SamplingErrorSamples > 0)
+        PrintSamplingError();
+    if (m_Options.NeighborRadius > 0.f)
+        PrintNeighbors();
+    if (m_GalaxyRanges.size() > 1)
+        PrintGalaxies();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t step = 0; step < m_Options.NbSteps; ++step)
+        m_Simulation.Step();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << m_Options.NbSteps << " steps in " << seconds << " s ("
+              << static_cast<double>(m_Options.NbSteps) / seconds << " steps/s)" << std::endl;
+    if (m_Simulation.GetSolver().GetInteractionsPerSecond() > 0.0)
+        std::cout << "Last step: " << m_Simulation.GetSolver().GetInteractionsPerSecond() << " interactions/s" << std::endl;
+    if (m_Simulation.GetMaxRung() > 0)
+        PrintBlockSteps();
+
+    if (m_Options.ForceErrorSamples > 0)
+        PrintForceError();
+    if (m_Options.NeighborRadius > 0.f)
+        PrintNeighbors();
+    if (m_GalaxyRanges.size() > 1)
+        PrintGalaxies();
+
+    if (!m_Options.SavePath.empty())
+        Snapshot::Save(
+            m_Options.SavePath,
+            m_Simulation.GetStars().data(),
+            m_Simulation.GetSize(),
+            m_Simulation.GetNbBlackHoles(),
+            m_Options.Galaxy,
+            m_Options.RealTime);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuRunner::PrintBlockSteps()
+{
+    std::cout << "Stars by rung:";
+    for (uint32_t count : m_Simulation.GetRungCounts())
+        std::cout << " " << count;
+    std::cout << std::endl;
+
+    // A global step stable for the deepest rung would compute every star at each substep.
+    const double globalEvaluations = static_cast<double>(m_Simulation.GetSize()) * m_Options.NbSteps *
+                                     static_cast<double>(1u << m_Simulation.GetMaxRung());
+    const double evaluations = static_cast<double>(m_Simulation.GetNbForceEvaluations());
+    std::cout << "Force evaluations: " << m_Simulation.GetNbForceEvaluations() << ", "
+              << (evaluations > 0.0 ? globalEvaluations / evaluations : 0.0)
+              << "x fewer than a global step of Step / " << (1u << m_Simulation.GetMaxRung()) << std::endl;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuRunner::PrintForceError()
+{
+    ForceErrorReport report = m_Simulation.MeasureForceError(m_Options.ForceErrorSamples);
+    std::cout << "Force error against the direct sum on " << report.NbSamples << " stars: rms "
+              << report.RmsRelativeError << ", 99% " << report.Percentile99
+              << ", max " << report.MaxRelativeError << std::endl;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuRunner::PrintSamplingError()
+{
+    // Halved from 1/2 while a step keeps a few dozen sources.
+    std::vector<float> rates;
+    for (float rate = 0.5f; rate * static_cast<float>(m_Simulation.GetSize()) >= 32.f && rates.size() < 12; rate *= 0.5f)
+        rates.push_back(rate);
+
+    const std::vector<SamplingErrorReport> reports = MeasureSamplingError(
+        m_Simulation.GetThreadPool(),
+        m_Simulation.GetStars(),
+        m_Simulation.GetNbBlackHoles(),
+        m_Options.RealTime.SmoothingLenght,
+        rates,
+        m_Options.SamplingErrorSamples);
+
+    // The mean is over the steps the rotating sources take to cover every star: a fixed error remains in it.
+    std::cout << "Sampling error against the direct sum on " << std::min(m_Options.SamplingErrorSamples, m_Simulation.GetSize())
+              << " stars, rms of a step and of the mean of the steps:" << std::endl;
+    std::cout << std::setw(10) << "rate" << std::setw(10) << "sources" << std::setw(10) << "sampling" << std::setw(8)
+              << "steps" << std::setw(14) << "step" << std::setw(14) << "mean" << std::endl;
+    for (const SamplingErrorReport &report : reports)
+    {
+        std::cout << std::setw(10) << report.InteractionRate << std::setw(10) << report.NbSources << std::setw(10)
+                  << (report.RotateSources ? "rotating" : "fixed") << std::setw(8) << report.NbSteps << std::setw(14)
+                  << report.StepRmsError << std::setw(14) << report.MeanRmsError << std::endl;
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuRunner::PrintGalaxies()
+{
+    const std::vector<GalaxyMotion> motions = MeasureGalaxies(m_Simulation.GetStars(), m_GalaxyRanges);
+    for (size_t i = 0; i < motions.size(); ++i)
+    {
+        const GalaxyMotion &motion = motions[i];
+        std::cout << "Galaxy " << i << ": center " << motion.CenterOfMass.x << " " << motion.CenterOfMass.y << " "
+                  << motion.CenterOfMass.z << ", velocity " << motion.Velocity.x << " " << motion.Velocity.y << " "
+                  << motion.Velocity.z << ", mass " << motion.Mass << std::endl;
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuRunner::PrintNeighbors()
+{
+    SpatialGrid grid(m_Simulation.GetThreadPool());
+    auto start = std::chrono::high_resolution_clock::now();
+    grid.Build(m_Simulation.GetStars(), m_Options.NeighborRadius);
+    auto built = std::chrono::high_resolution_clock::now();
+    const NeighborReport report = SummarizeNeighbors(grid.CountNeighbors(m_Options.NeighborRadius));
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "Neighbors within " << m_Options.NeighborRadius << ": " << report.NbPairs << " pairs, "
+              << report.NbStarsWithNeighbors << " stars with a neighbor, at most " << report.MaxNeighbors
+              << " (grid built in " << std::chrono::duration<double, std::milli>(built - start).count()
+              << " ms, queried in " << std::chrono::duration<double, std::milli>(end - built).count() << " ms)"
+              << std::endl;
+}
@@ -0,0 +1,160 @@
+#include "Geometry/GalaxyGenerator.h"
+#include "MathHelper.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @return Vector rotated around the X axis.
+glm::vec3 RotateX(const glm::vec3 &iVector, float iCos, float iSin)
+{
+    return glm::vec3(iVector.x, iVector.y * iCos - iVector.z * iSin, iVector.y * iSin + iVector.z * iCos);
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<CloudVertex> GenerateGalaxy(uint32_t iNbStars, float iGalaxyDiameters, float iGalaxyThickness, float iInitialSpeed)
+{
+    std::vector<CloudVertex> stars(iNbStars);
+
+    for (uint32_t id = 0; id < iNbStars; ++id)
+    {
+        CloudVertex &vertex = stars[id];
+        vertex.Pos = Spherical(RandomFloat(0.0f, iGalaxyDiameters * 0.5f), RandomFloat(0.0, 2 * PI), RandomFloat(0.0f, PI));
+        vertex.Pos.y *= iGalaxyThickness / iGalaxyDiameters;
+        vertex.Mass = 1.f;
+        vertex.Speed = glm::normalize(glm::cross(vertex.Pos, glm::vec3(0.f, 1.f, 0.f))) * iInitialSpeed;
+        vertex.Id = id;
+    }
+    return stars;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<CloudVertex> GenerateGalaxies(const std::vector<GalaxyDescription> &iGalaxies)
+{
+    std::vector<CloudVertex> stars;
+    for (const GalaxyDescription &galaxy : iGalaxies)
+    {
+        if (galaxy.BlackHoleMass <= 0.f)
+            continue;
+        CloudVertex &blackHole = stars.emplace_back();
+        blackHole.Pos = galaxy.Position;
+        blackHole.Mass = galaxy.BlackHoleMass;
+        blackHole.Speed = galaxy.Velocity;
+    }
+
+    for (const GalaxyDescription &galaxy : iGalaxies)
+    {
+        const float angle = galaxy.Inclination * PI / 180.f;
+        const float cosine = std::cos(angle);
+        const float sine = std::sin(angle);
+        for (CloudVertex star : GenerateGalaxy(galaxy.NbStars, galaxy.Diameter, galaxy.Thickness, galaxy.StarsSpeed))
+        {
+            star.Pos = RotateX(star.Pos, cosine, sine) + galaxy.Position;
+            star.Speed = RotateX(star.Speed, cosine, sine) + galaxy.Velocity;
+            stars.push_back(star);
+        }
+    }
+
+    for (uint32_t id = 0; id < stars.size(); ++id)
+        stars[id].Id = id;
+    return stars;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t CountBlackHoles(const std::vector<GalaxyDescription> &iGalaxies)
+{
+    return static_cast<uint32_t>(std::count_if(
+        iGalaxies.begin(), iGalaxies.end(), [](const GalaxyDescription &iGalaxy) { return iGalaxy.BlackHoleMass > 0.f; }));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<GalaxyRange> GetGalaxyRanges(const std::vector<GalaxyDescription> &iGalaxies)
+{
+    std::vector<GalaxyRange> ranges;
+    uint32_t blackHoleId = 0;
+    uint32_t firstId = CountBlackHoles(iGalaxies);
+    for (const GalaxyDescription &galaxy : iGalaxies)
+    {
+        GalaxyRange &range = ranges.emplace_back();
+        range.FirstId = firstId;
+        range.NbStars = galaxy.NbStars;
+        if (galaxy.BlackHoleMass > 0.f)
+            range.BlackHoleId = blackHoleId++;
+        firstId += range.NbStars;
+    }
+    return ranges;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<GalaxyDescription> ArrangeGalaxies(
+    const GalaxyDescription &iGalaxy, uint32_t iNbGalaxies, float iSeparation, float iSpeed)
+{
+    std::vector<GalaxyDescription> galaxies(iNbGalaxies, iGalaxy);
+    if (iNbGalaxies == 1)
+        return galaxies;
+
+    for (uint32_t i = 0; i < iNbGalaxies; ++i)
+    {
+        const float angle = 2.f * PI * static_cast<float>(i) / static_cast<float>(iNbGalaxies);
+        const glm::vec3 radial(std::cos(angle), 0.f, std::sin(angle));
+        const glm::vec3 tangential(-radial.z, 0.f, radial.x);
+        galaxies[i].Position = iSeparation * radial;
+        // Off-axis, the galaxies swing past each other before they merge instead of a head-on collision.
+        galaxies[i].Velocity = iSpeed * glm::normalize(-radial + 0.3f * tangential);
+        galaxies[i].Inclination = 90.f * static_cast<float>(i) / static_cast<float>(iNbGalaxies);
+    }
+    return galaxies;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<GalaxyMotion> MeasureGalaxies(const std::vector<CloudVertex> &iStars, const std::vector<GalaxyRange> &iRanges)
+{
+    // Galaxy of each black hole, by Id.
+    std::vector<size_t> blackHoles;
+    for (size_t galaxy = 0; galaxy < iRanges.size(); ++galaxy)
+    {
+        const uint32_t id = iRanges[galaxy].BlackHoleId;
+        if (id == GalaxyRange::NoBlackHole)
+            continue;
+        if (id >= blackHoles.size())
+            blackHoles.resize(id + 1, iRanges.size());
+        blackHoles[id] = galaxy;
+    }
+
+    std::vector<GalaxyMotion> motions(iRanges.size());
+    for (const CloudVertex &star : iStars)
+    {
+        if (glm::any(glm::isnan(star.Pos)))
+            continue;
+        size_t galaxy = iRanges.size();
+        if (star.Id < blackHoles.size())
+        {
+            galaxy = blackHoles[star.Id];
+        }
+        else
+        {
+            // The ranges follow each other: the galaxy of a star is the last one starting before its Id.
+            auto range = std::upper_bound(
+                iRanges.begin(), iRanges.end(), star.Id, [](uint32_t iId, const GalaxyRange &iRange) { return iId < iRange.FirstId; });
+            if (range != iRanges.begin() && star.Id - (range - 1)->FirstId < (range - 1)->NbStars)
+                galaxy = static_cast<size_t>(range - 1 - iRanges.begin());
+        }
+        if (galaxy == iRanges.size())
+            continue;
+
+        GalaxyMotion &motion = motions[galaxy];
+        motion.Mass += star.Mass;
+        motion.CenterOfMass += star.Mass * star.Pos;
+        motion.Velocity += star.Mass * star.Speed;
+    }
+    for (GalaxyMotion &motion : motions)
+    {
+        if (motion.Mass <= 0.f)
+            continue;
+        motion.CenterOfMass /= motion.Mass;
+        motion.Velocity /= motion.Mass;
+    }
+    return motions;
+}
@@ -0,0 +1,34 @@
+#include "Geometry/RenderVertex.h"
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+//----------------------------------------------------------------------------------------------------------------------
+RenderVertex RenderVertex::FromStar(const CloudVertex &iStar)
+{
+    RenderVertex vertex;
+    vertex.PosBrightness[0] = glm::packHalf1x16(iStar.Pos.x);
+    vertex.PosBrightness[1] = glm::packHalf1x16(iStar.Pos.y);
+    vertex.PosBrightness[2] = glm::packHalf1x16(iStar.Pos.z);
+    vertex.PosBrightness[3] = glm::packHalf1x16(glm::length(iStar.Speed));
+    return vertex;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+VkVertexInputBindingDescription RenderVertex::GetBindingDescription()
+{
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(RenderVertex);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return bindingDescription;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<VkVertexInputAttributeDescription> RenderVertex::GetAttributeDescriptions()
+{
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(1);
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(RenderVertex, PosBrightness);
+    return attributeDescriptions;
+}
@@ -1,7 +1,8 @@
 #include "Geometry/VkCloud.h"
+#include "Geometry/GalaxyGenerator.h"
+#include "Olympus/Debug.h"
+#include <cstring>
 #include <iostream>
-#include <glm/geometric.hpp>
-#include "MathHelper.h"
 //----------------------------------------------------------------------------------------------------------------------
 VkCloud::VkCloud(olp::Device &iDevice)
     : m_Device(iDevice)
@@ -11,49 +12,122 @@ VkCloud::VkCloud(olp::Device &iDevice)
 //----------------------------------------------------------------------------------------------------------------------
 void VkCloud::Init(uint32_t iNbStars, float iGalaxyDiameters, float iGalaxyThickness, float iInitialSpeed)
 {
-    m_Cloud.resize(iNbStars);
+    Init(GenerateGalaxy(iNbStars, iGalaxyDiameters, iGalaxyThickness, iInitialSpeed));
+}
 
-    for (CloudVertex &vertex : m_Cloud)
-    {
-        vertex.Pos = Spherical(RandomFloat(0.0f, iGalaxyDiameters * 0.5f), RandomFloat(0.0, 2 * PI), RandomFloat(0.0f, PI));
-        vertex.Pos.y *= iGalaxyThickness / iGalaxyDiameters;
-        vertex.Speed = glm::vec4(glm::normalize(glm::cross(vertex.Pos, glm::vec3(0.f, 1.f, 0.f))) * iInitialSpeed, 0);
-    }
-    CreateVertexBuffer();
+//----------------------------------------------------------------------------------------------------------------------
+void VkCloud::Init(const std::vector<CloudVertex> &iStars)
+{
+    Init(iStars.data(), static_cast<uint32_t>(iStars.size()));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void VkCloud::Init(const CloudVertex *iStars, uint32_t iNbStars)
+{
+    m_NbStars = iNbStars;
+    CreateVertexBuffer(iStars);
+    CreateRenderBuffer(iStars);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void VkCloud::Destroy()
 {
-    m_VertexBuffer.Destroy();
+    for (olp::MemoryBuffer &vertexBuffer : m_VertexBuffers)
+        vertexBuffer.Destroy();
+    for (olp::MemoryBuffer &renderBuffer : m_RenderBuffers)
+        renderBuffer.Destroy();
+    m_Current = 0;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void VkCloud::CreateVertexBuffer()
+void VkCloud::CreateVertexBuffer(const CloudVertex *iStars)
 {
-    VkDeviceSize bufferSize = sizeof(m_Cloud[0]) * m_Cloud.size();
+    VkDeviceSize bufferSize = sizeof(CloudVertex) * m_NbStars;
 
     olp::MemoryBuffer stagingBuffer = m_Device.CreateMemoryBuffer(
         bufferSize,
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-    stagingBuffer.TransferDataInBuffer(m_Cloud, bufferSize);
+    void *data = nullptr;
+    VK_CHECK_RESULT(vkMapMemory(m_Device.GetDevice(), stagingBuffer.Memory, 0, bufferSize, 0, &data))
+    std::memcpy(data, iStars, static_cast<size_t>(bufferSize));
+    vkUnmapMemory(m_Device.GetDevice(), stagingBuffer.Memory);
 
-    m_VertexBuffer = m_Device.CreateMemoryBuffer(
+    for (olp::MemoryBuffer &vertexBuffer : m_VertexBuffers)
+        vertexBuffer = m_Device.CreateMemoryBuffer(
+            bufferSize,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // The second buffer is written by the first step. It holds the same stars until then: the uploaded speeds are
+    // synchronized with the positions, and read by the outputs.
+    m_Current = 0;
+    for (olp::MemoryBuffer &vertexBuffer : m_VertexBuffers)
+        vertexBuffer.CopyFrom(stagingBuffer.Buffer, bufferSize);
+    stagingBuffer.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void VkCloud::CreateRenderBuffer(const CloudVertex *iStars)
+{
+    VkDeviceSize bufferSize = sizeof(RenderVertex) * m_NbStars;
+
+    olp::MemoryBuffer stagingBuffer = m_Device.CreateMemoryBuffer(
         bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-    m_VertexBuffer.CopyFrom(stagingBuffer.Buffer, bufferSize);
+    void *data = nullptr;
+    VK_CHECK_RESULT(vkMapMemory(m_Device.GetDevice(), stagingBuffer.Memory, 0, bufferSize, 0, &data))
+    RenderVertex *vertices = static_cast<RenderVertex *>(data);
+    for (uint32_t i = 0; i < m_NbStars; ++i)
+        vertices[i] = RenderVertex::FromStar(iStars[i]);
+    vkUnmapMemory(m_Device.GetDevice(), stagingBuffer.Memory);
+
+    for (olp::MemoryBuffer &renderBuffer : m_RenderBuffers)
+        renderBuffer = m_Device.CreateMemoryBuffer(
+            bufferSize,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    m_RenderBuffers[m_Current].CopyFrom(stagingBuffer.Buffer, bufferSize);
     stagingBuffer.Destroy();
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void VkCloud::Draw(VkCommandBuffer commandBuffer)
 {
-    const VkBuffer vertexBuffers[] = {m_VertexBuffer.Buffer};
+    // The compact stream of the current stars, not the whole CloudVertex.
+    const VkBuffer vertexBuffers[] = {m_RenderBuffers[m_Current].Buffer};
     const VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdDraw(commandBuffer, static_cast<uint32_t>(m_Cloud.size()), 1, 0, 0);
+    vkCmdDraw(commandBuffer, m_NbStars, 1, 0, 0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void VkCloud::ReadStars(const std::function<void(const CloudVertex *iStars)> &iReader) const
+{
+    ReadBuffer(GetSyncedBuffer(), iReader);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void VkCloud::ReadBuffer(
+    const olp::MemoryBuffer &iBuffer, const std::function<void(const CloudVertex *iStars)> &iReader) const
+{
+    VkDeviceSize bufferSize = sizeof(CloudVertex) * m_NbStars;
+
+    olp::MemoryBuffer stagingBuffer = m_Device.CreateMemoryBuffer(
+        bufferSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer.CopyFrom(iBuffer.Buffer, bufferSize);
+
+    void *data = nullptr;
+    VK_CHECK_RESULT(vkMapMemory(m_Device.GetDevice(), stagingBuffer.Memory, 0, bufferSize, 0, &data))
+    iReader(static_cast<const CloudVertex *>(data));
+    vkUnmapMemory(m_Device.GetDevice(), stagingBuffer.Memory);
+
+    stagingBuffer.Destroy();
 }
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "HeadlessRunner.h"
+#include "Geometry/GalaxyGenerator.h"
+#include "Simulation/SpatialGrid.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+/// Largest rms and max relative differences of the accelerations of the tiled shader accepted by --validate. Both
+/// shaders sum the same sources in the same order, so only the rounding of the compiled code may differ.
+constexpr double MaxRmsAccelerationError = 1e-5;
+constexpr double MaxAccelerationError = 1e-3;
+/// Largest differences of the positions and of the speeds between the fused and the split steps accepted by --validate,
+/// relative to 1 + the norm of the split one.
+constexpr double MaxStepDistance = 1e-5;
+
+//----------------------------------------------------------------------------------------------------------------------
+AccelerationPass::Kernel GetKernel(const Menu::GalaxyParameters &iGalaxy)
+{
+    return iGalaxy.TiledAcceleration ? AccelerationPass::Kernel::Tiled : AccelerationPass::Kernel::Direct;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+IntegrationPass::Scheme GetScheme(const Menu::GalaxyParameters &iGalaxy)
+{
+    return iGalaxy.FusedLeapfrog ? IntegrationPass::Scheme::FusedLeapfrog : IntegrationPass::Scheme::Split;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PrintQuantities(const ReductionPass::Quantities &iStart, const ReductionPass::Quantities &iEnd)
+{
+    const float startEnergy = iStart.KineticEnergy + iStart.PotentialEnergy;
+    const float endEnergy = iEnd.KineticEnergy + iEnd.PotentialEnergy;
+    std::cout << "Energy: " << startEnergy << " -> " << endEnergy;
+    if (startEnergy != 0.f)
+        std::cout << " (drift " << (endEnergy - startEnergy) / std::abs(startEnergy) << ")";
+    std::cout << ", momentum " << glm::length(glm::vec3(iStart.Momentum)) << " -> "
+              << glm::length(glm::vec3(iEnd.Momentum)) << ", angular momentum "
+              << glm::length(glm::vec3(iStart.AngularMomentum)) << " -> "
+              << glm::length(glm::vec3(iEnd.AngularMomentum)) << std::endl;
+    std::cout << "Center of mass " << iEnd.CenterOfMass.x << " " << iEnd.CenterOfMass.y << " " << iEnd.CenterOfMass.z
+              << ", bounds " << iEnd.Min.x << " " << iEnd.Min.y << " " << iEnd.Min.z << " to " << iEnd.Max.x << " "
+              << iEnd.Max.y << " " << iEnd.Max.z << ", " << iEnd.NbStars << " stars" << std::endl;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PrintNeighbors(GpuSimulation &ioSimulation, float iRadius)
+{
+    const NeighborReport report = SummarizeNeighbors(ioSimulation.CountNeighbors(iRadius));
+    std::cout << "Neighbors within " << iRadius << ": " << report.NbPairs << " pairs, " << report.NbStarsWithNeighbors
+              << " stars with a neighbor, at most " << report.MaxNeighbors << " (GPU grid built in "
+              << ioSimulation.GetGridPass().GetBuildTime() << " ms, queried in "
+              << ioSimulation.GetGridPass().GetQueryTime() << " ms)" << std::endl;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PrintGalaxies(const std::vector<CloudVertex> &iStars, const std::vector<GalaxyRange> &iRanges)
+{
+    const std::vector<GalaxyMotion> motions = MeasureGalaxies(iStars, iRanges);
+    for (size_t i = 0; i < motions.size(); ++i)
+    {
+        const GalaxyMotion &motion = motions[i];
+        std::cout << "Galaxy " << i << ": center " << motion.CenterOfMass.x << " " << motion.CenterOfMass.y << " "
+                  << motion.CenterOfMass.z << ", velocity " << motion.Velocity.x << " " << motion.Velocity.y << " "
+                  << motion.Velocity.z << ", mass " << motion.Mass << std::endl;
+    }
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+HeadlessRunner::HeadlessRunner(const CommandLineOptions &iOptions)
+    : m_Options(iOptions)
+{
+    if (!m_Options.LoadPath.empty())
+    {
+        m_Snapshot = std::make_unique<Snapshot>(m_Options.LoadPath);
+        m_Options.Galaxy = m_Snapshot->GetGalaxyParameters();
+        m_NbBlackHoles = m_Snapshot->GetNbBlackHoles();
+        // The snapshot does not hold the interval of the sorts.
+        const int reorderInterval = m_Options.RealTime.ReorderInterval;
+        m_Options.RealTime = m_Snapshot->GetRealTimeParameters();
+        m_Options.RealTime.ReorderInterval = reorderInterval;
+    }
+    else if (const std::vector<GalaxyDescription> galaxies = GetGalaxies(m_Options); !galaxies.empty())
+    {
+        m_Stars = GenerateGalaxies(galaxies);
+        m_GalaxyRanges = GetGalaxyRanges(galaxies);
+        // The black holes are the first stars.
+        m_NbBlackHoles = CountBlackHoles(galaxies);
+        m_Options.Galaxy.NbStars = static_cast<int>(m_Stars.size());
+        m_Options.Galaxy.BlackHoleMass = 0.f;
+    }
+    else
+    {
+        const Menu::GalaxyParameters &galaxy = m_Options.Galaxy;
+        m_Stars = GenerateGalaxy(galaxy.NbStars, galaxy.Diameter, galaxy.Thickness, galaxy.StarsSpeed);
+    }
+
+    // No window: no extension is needed to present.
+    m_Instance.CreateInstance("Galaxy simation", nullptr, 0);
+    m_Instance.SetupDebugMessenger();
+
+    m_Simulation = std::make_unique<GpuSimulation>(m_Instance);
+    m_Simulation->SetStep(m_Options.RealTime.Step);
+    m_Simulation->SetInteractionRate(m_Options.RealTime.InteractionRate);
+    m_Simulation->SetSmoothLenght(m_Options.RealTime.SmoothingLenght);
+    m_Simulation->SetRotateSources(m_Options.RealTime.RotateSources);
+    m_Simulation->SetAdaptiveStep(m_Options.RealTime.AdaptiveStep, m_Options.RealTime.StepAccuracy);
+    m_Simulation->SetReorderInterval(static_cast<uint32_t>(m_Options.RealTime.ReorderInterval));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+HeadlessRunner::~HeadlessRunner()
+{
+    if (m_Simulation)
+        m_Simulation->ReleaseResources();
+    m_Instance.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void HeadlessRunner::Run()
+{
+    if (m_Options.ValidateKernels)
+        ValidateKernels();
+
+    const AccelerationPass::Kernel kernel = GetKernel(m_Options.Galaxy);
+    InitializeGalaxy(kernel);
+    std::cout << "GPU simulation of " << m_Simulation->GetSize() << " stars without window, "
+              << (m_Options.Galaxy.FusedLeapfrog ? "fused leapfrog shader"
+                                                 : kernel == AccelerationPass::Kernel::Tiled ? "tiled acceleration shader"
+                                                                                             : "direct acceleration shader")
+              << std::endl;
+
+    if (!m_Options.RecordPath.empty())
+        m_Simulation->StartRecording(m_Options.RecordPath, m_Options.RecordInterval);
+
+    std::ofstream gpuTimesLog;
+    if (!m_Options.GpuTimesPath.empty())
+    {
+        gpuTimesLog.open(m_Options.GpuTimesPath, std::ios::trunc);
+        if (!gpuTimesLog)
+            throw std::runtime_error("cannot open " + m_Options.GpuTimesPath);
+        gpuTimesLog << "step,acceleration_ms,integration_ms,reorder_ms\n";
+    }
+
+    // Reduced on the device, outside of the timed steps.
+    const ReductionPass::Quantities startQuantities = m_Simulation->ReduceQuantities();
+    if (m_Options.NeighborRadius > 0.f)
+        PrintNeighbors(*m_Simulation, m_Options.NeighborRadius);
+    if (m_GalaxyRanges.size() > 1)
+        PrintGalaxies(m_Stars, m_GalaxyRanges);
+
+    // The passes of a step are timed once their fences are signaled, when the next step is submitted.
+    double accelerationTime = 0.0;
+    double integrationTime = 0.0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t step = 0; step < m_Options.NbSteps; ++step)
+    {
+        m_Simulation->Step();
+        if (step == 0)
+            continue;
+        accelerationTime += m_Simulation->GetAccelerationTime();
+        integrationTime += m_Simulation->GetIntegrationTime();
+        if (gpuTimesLog.is_open())
+            gpuTimesLog << step - 1 << "," << m_Simulation->GetAccelerationTime() << ","
+                        << m_Simulation->GetIntegrationTime() << "," << m_Simulation->GetReorderTime() << "\n";
+    }
+    m_Simulation->Wait();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << m_Options.NbSteps << " steps in " << seconds << " s ("
+              << static_cast<double>(m_Options.NbSteps) / seconds << " steps/s)" << std::endl;
+    if (m_Options.NbSteps > 1 && accelerationTime > 0.0)
+        std::cout << "GPU time by step: acceleration " << accelerationTime / (m_Options.NbSteps - 1)
+                  << " ms, integration " << integrationTime / (m_Options.NbSteps - 1) << " ms" << std::endl;
+    if (m_Options.RealTime.ReorderInterval > 0 && m_Simulation->GetReorderTime() > 0.f)
+        std::cout << "GPU time of the last sort along the Z-curve: " << m_Simulation->GetReorderTime() << " ms"
+                  << std::endl;
+    PrintQuantities(startQuantities, m_Simulation->ReduceQuantities());
+    if (m_Options.NeighborRadius > 0.f)
+        PrintNeighbors(*m_Simulation, m_Options.NeighborRadius);
+    if (m_GalaxyRanges.size() > 1)
+        PrintGalaxies(m_Simulation->ReadStars(), m_GalaxyRanges);
+    if (m_Options.RealTime.AdaptiveStep)
+        std::cout << "Adaptive step: " << m_Simulation->ReadStep() << " at the end, longest " << m_Options.RealTime.Step
+                  << std::endl;
+
+    if (m_Simulation->GetRecorder().IsRecording())
+    {
+        m_Simulation->StopRecording();
+        std::cout << m_Simulation->GetRecorder().GetNbRecorded() << " steps recorded in " << m_Options.RecordPath
+                  << ", " << m_Simulation->GetRecorder().GetNbDropped() << " dropped while the writer was busy"
+                  << std::endl;
+    }
+
+    if (!m_Options.SavePath.empty())
+    {
+        // The stars read back are the ones at the start of the last step, their speeds synchronized by it.
+        m_Simulation->SaveSnapshot(m_Options.SavePath, m_Options.Galaxy, m_Options.RealTime);
+        std::cout << "Stars after " << (m_Options.NbSteps > 0 ? m_Options.NbSteps - 1 : 0) << " steps saved to "
+                  << m_Options.SavePath << std::endl;
+    }
+
+    m_Simulation->ReleaseGalaxy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void HeadlessRunner::InitializeGalaxy(AccelerationPass::Kernel iKernel)
+{
+    if (m_Snapshot)
+        m_Simulation->InitializeGalaxy(
+            m_Snapshot->GetStars(),
+            m_Snapshot->GetNbStars(),
+            m_Options.Galaxy.BlackHoleMass,
+            iKernel,
+            GetScheme(m_Options.Galaxy),
+            m_NbBlackHoles);
+    else
+        m_Simulation->InitializeGalaxy(
+            m_Stars, m_Options.Galaxy.BlackHoleMass, iKernel, GetScheme(m_Options.Galaxy), m_NbBlackHoles);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void HeadlessRunner::ValidateKernels()
+{
+    InitializeGalaxy(AccelerationPass::Kernel::Direct);
+    m_Simulation->ComputeAccelerations();
+    std::vector<glm::vec4> reference = m_Simulation->ReadAccelerations();
+    m_Simulation->ReleaseGalaxy();
+
+    InitializeGalaxy(AccelerationPass::Kernel::Tiled);
+    m_Simulation->ComputeAccelerations();
+    std::vector<glm::vec4> tiled = m_Simulation->ReadAccelerations();
+    m_Simulation->ReleaseGalaxy();
+
+    double sum2 = 0.0;
+    double maxError = 0.0;
+    size_t nbCompared = 0;
+    for (size_t i = 0; i < reference.size(); ++i)
+    {
+        const float norm = glm::length(glm::vec3(reference[i]));
+        if (std::isnan(norm) || norm == 0.f)
+            continue;
+        double error = glm::length(glm::vec3(tiled[i]) - glm::vec3(reference[i])) / norm;
+        if (std::isnan(error))
+            error = std::numeric_limits<double>::infinity();
+        sum2 += error * error;
+        maxError = std::max(maxError, error);
+        ++nbCompared;
+    }
+    const double rms = nbCompared > 0 ? std::sqrt(sum2 / static_cast<double>(nbCompared)) : 0.0;
+    std::cout << "Tiled shader against acceleration.comp on " << nbCompared << " stars: rms relative error " << rms
+              << ", max " << maxError << std::endl;
+
+    // Two steps of each scheme from the same stars: same update, only the rounding may differ. The stars read are the
+    // ones after the first step, their speeds synchronized by the second one.
+    InitializeGalaxy(AccelerationPass::Kernel::Tiled);
+    for (int step = 0; step < 2; ++step)
+    {
+        m_Simulation->ComputeAccelerations();
+        m_Simulation->Integrate();
+    }
+    std::vector<CloudVertex> split = m_Simulation->ReadStars();
+    m_Simulation->ReleaseGalaxy();
+
+    InitializeGalaxy(AccelerationPass::Kernel::Tiled);
+    for (int step = 0; step < 2; ++step)
+        m_Simulation->Leapfrog();
+    std::vector<CloudVertex> fused = m_Simulation->ReadStars();
+    m_Simulation->ReleaseGalaxy();
+
+    double maxDistance = 0.0;
+    for (size_t i = 0; i < split.size(); ++i)
+    {
+        double distance =
+            std::max(glm::length(fused[i].Pos - split[i].Pos) / (1.0 + glm::length(split[i].Pos)),
+                     glm::length(fused[i].Speed - split[i].Speed) / (1.0 + glm::length(split[i].Speed)));
+        if (std::isnan(distance) != std::isnan(glm::length(split[i].Pos)))
+            distance = std::numeric_limits<double>::infinity();
+        if (!std::isnan(distance))
+            maxDistance = std::max(maxDistance, distance);
+    }
+    std::cout << "Fused leapfrog shader against the split passes after two steps: max relative difference "
+              << maxDistance << std::endl;
+
+    if (rms > MaxRmsAccelerationError || maxError > MaxAccelerationError)
+        throw std::runtime_error(
+            "Validation failed: the tiled shader differs from acceleration.comp by more than " +
+            std::to_string(MaxRmsAccelerationError) + " rms or " + std::to_string(MaxAccelerationError) + " max");
+    if (maxDistance > MaxStepDistance)
+        throw std::runtime_error(
+            "Validation failed: the fused leapfrog shader differs from the split passes by more than " +
+            std::to_string(MaxStepDistance));
+}
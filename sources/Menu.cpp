@@ -1,6 +1,8 @@
 #include "Menu.h"
 #include <imgui/imgui.h>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
 
 //----------------------------------------------------------------------------------------------------------------------
 Menu::Menu(uint32_t iWidth, uint32_t iHeight)
@@ -90,9 +92,13 @@ void Menu::UpdateMenu()
 
         ImGui::NewLine();
 
-        ImGui::Text("The time step duration");
+        ImGui::Text(m_RealTimeParameters.AdaptiveStep ? "The longest time step" : "The time step duration");
         ImGui::SliderFloat("##Step", &m_RealTimeParameters.Step, 0.0001f, 0.1f, "%.4f", ImGuiSliderFlags_Logarithmic);
 
+        ImGui::Checkbox("Adaptive step", &m_RealTimeParameters.AdaptiveStep);
+        if (m_RealTimeParameters.AdaptiveStep)
+            ImGui::SliderFloat("##StepAccuracy", &m_RealTimeParameters.StepAccuracy, 0.001f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic);
+
         ImGui::NewLine();
 
         ImGui::Text("The smoothing length");
@@ -102,6 +108,17 @@ void Menu::UpdateMenu()
 
         ImGui::Text("The interaction rate");
         ImGui::SliderFloat("##InteractionRate", &m_RealTimeParameters.InteractionRate, 0.001f, 1.f, "%.3f", ImGuiSliderFlags_Logarithmic);
+        ImGui::Checkbox("Rotate the sources", &m_RealTimeParameters.RotateSources);
+
+        ImGui::NewLine();
+
+        ImGui::Text("The time steps by frame");
+        ImGui::SliderInt("##Substeps", &m_RealTimeParameters.Substeps, 1, 64, NULL, ImGuiSliderFlags_Logarithmic);
+
+        ImGui::NewLine();
+
+        ImGui::Text("The time steps between two sorts of the stars (0: never)");
+        ImGui::SliderInt("##ReorderInterval", &m_RealTimeParameters.ReorderInterval, 0, 1000, NULL, ImGuiSliderFlags_Logarithmic);
 
         ImGui::NewLine();
 
@@ -133,9 +150,51 @@ void Menu::UpdateMenu()
 
         ImGui::NewLine();
 
+        ImGui::Text("The number of merging galaxies");
+        ImGui::SliderInt("##NbGalaxies", &m_GalaxyParameters.NbGalaxies, 1, 8);
+        if (m_GalaxyParameters.NbGalaxies > 1)
+        {
+            ImGui::Text("The distance of the galaxies to the center");
+            ImGui::SliderFloat("##Separation", &m_GalaxyParameters.Separation, 10.f, 2000.f, "%.0f", ImGuiSliderFlags_Logarithmic);
+            ImGui::Text("The speed of the galaxies");
+            ImGui::SliderFloat("##ApproachSpeed", &m_GalaxyParameters.ApproachSpeed, 0.f, 100.f, "%.1f");
+        }
+
+        ImGui::NewLine();
+
+        ImGui::Checkbox("Tiled acceleration shader", &m_GalaxyParameters.TiledAcceleration);
+        ImGui::Checkbox("Fused leapfrog shader", &m_GalaxyParameters.FusedLeapfrog);
+
+        ImGui::NewLine();
+
         std::vector<bool> buttons = CenteredButtons({"Restart"}, 25.0, 20.f);
         m_Restart = buttons[0];
 
+        AddTitle("Snapshot");
+
+        ImGui::NewLine();
+
+        ImGui::Text("The snapshot file");
+        ImGui::InputText("##SnapshotPath", m_SnapshotPath.data(), m_SnapshotPath.size());
+
+        buttons = CenteredButtons({"Save", "Load"}, 25.0, 20.f);
+        m_SaveSnapshot = buttons[0];
+        m_LoadSnapshot = buttons[1];
+
+        AddTitle("Recording");
+
+        ImGui::NewLine();
+
+        ImGui::Text("The trajectory file");
+        ImGui::InputText("##TrajectoryPath", m_TrajectoryPath.data(), m_TrajectoryPath.size());
+
+        ImGui::Text("The steps between two records");
+        ImGui::SliderInt("##RecordInterval", &m_RecordInterval, 1, 1000, NULL, ImGuiSliderFlags_Logarithmic);
+
+        ImGui::Checkbox("Record", &m_Recording);
+        ImGui::Text("%llu steps recorded, %llu dropped", static_cast<unsigned long long>(m_NbRecorded),
+                    static_cast<unsigned long long>(m_NbDropped));
+
         m_Active = ImGui::IsWindowFocused();
 
         ImGui::End();
@@ -144,12 +203,132 @@ void Menu::UpdateMenu()
         ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.8f);
         ImGui::PlotLines("FPS", &m_FPS[0], 50, 0, "", m_MinFPS, m_MaxFPS, ImVec2(0, 80));
         ImGui::End();
+
+        ImGui::Begin("GPU time (F1 to hide)");
+        ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.6f);
+        // The compute times add up the time steps of the frame.
+        PlotGpuTime("Acceleration", m_AccelerationTimes);
+        PlotGpuTime("Integration", m_IntegrationTimes);
+        PlotGpuTime("Cloud", m_CloudTimes);
+        PlotGpuTime("ImGui", m_ImGuiTimes);
+        PlotGpuTime("Reduction", m_ReductionTimes);
+        PlotGpuTime("Reorder", m_ReorderTimes);
+        ImGui::Checkbox("Log to", &m_LogGpuTimes);
+        ImGui::SameLine();
+        ImGui::InputText("##GpuTimesPath", m_GpuTimesPath.data(), m_GpuTimesPath.size());
+        ImGui::End();
+
+        ImGui::Begin("Conserved quantities (F1 to hide)");
+        ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.6f);
+        ImGui::Checkbox("Reduce each frame", &m_Monitoring);
+        PlotQuantity("Energy", m_Energies);
+        PlotQuantity("Kinetic", m_KineticEnergies);
+        PlotQuantity("Potential", m_PotentialEnergies);
+        PlotQuantity("Momentum", m_Momenta);
+        PlotQuantity("Angular momentum", m_AngularMomenta);
+        ImGui::Text("Center of mass %.2f %.2f %.2f", m_Quantities.CenterOfMass[0], m_Quantities.CenterOfMass[1],
+                    m_Quantities.CenterOfMass[2]);
+        ImGui::Text("Bounds %.1f %.1f %.1f", m_Quantities.Min[0], m_Quantities.Min[1], m_Quantities.Min[2]);
+        ImGui::Text("  to   %.1f %.1f %.1f", m_Quantities.Max[0], m_Quantities.Max[1], m_Quantities.Max[2]);
+        ImGui::End();
     }
 
     // Render to generate draw buffers
     ImGui::Render();
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+GalaxyDescription Menu::GalaxyParameters::GetDescription() const
+{
+    GalaxyDescription galaxy;
+    galaxy.NbStars = static_cast<uint32_t>(std::max(NbStars, 0));
+    galaxy.Diameter = Diameter;
+    galaxy.Thickness = Thickness;
+    galaxy.StarsSpeed = StarsSpeed;
+    galaxy.BlackHoleMass = BlackHoleMass;
+    return galaxy;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<GalaxyDescription> Menu::GalaxyParameters::GetMerger() const
+{
+    if (NbGalaxies <= 1)
+        return {};
+    return ArrangeGalaxies(GetDescription(), static_cast<uint32_t>(NbGalaxies), Separation, ApproachSpeed);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Menu::SetParameters(const GalaxyParameters &iGalaxy, const RealTimeParameters &iRealTime)
+{
+    m_GalaxyParameters = iGalaxy;
+    m_RealTimeParameters = iRealTime;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Menu::SetRecordedSteps(uint64_t iNbRecorded, uint64_t iNbDropped)
+{
+    m_NbRecorded = iNbRecorded;
+    m_NbDropped = iNbDropped;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Menu::AddGpuTimes(const GpuTimes &iTimes)
+{
+    const auto push = [](std::array<float, 100> &ioTimes, float iTime)
+    {
+        std::rotate(ioTimes.begin(), ioTimes.begin() + 1, ioTimes.end());
+        ioTimes.back() = iTime;
+    };
+    push(m_AccelerationTimes, iTimes.Acceleration);
+    push(m_IntegrationTimes, iTimes.Integration);
+    push(m_CloudTimes, iTimes.Cloud);
+    push(m_ImGuiTimes, iTimes.ImGui);
+    push(m_ReductionTimes, iTimes.Reduction);
+    push(m_ReorderTimes, iTimes.Reorder);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Menu::AddQuantities(const Quantities &iQuantities)
+{
+    // The first values fill the graphs, the zeros would hide the variations.
+    const auto push = [this](std::array<float, 100> &ioValues, float iValue)
+    {
+        if (!m_HasQuantities)
+            ioValues.fill(iValue);
+        std::rotate(ioValues.begin(), ioValues.begin() + 1, ioValues.end());
+        ioValues.back() = iValue;
+    };
+    push(m_Energies, iQuantities.KineticEnergy + iQuantities.PotentialEnergy);
+    push(m_KineticEnergies, iQuantities.KineticEnergy);
+    push(m_PotentialEnergies, iQuantities.PotentialEnergy);
+    push(m_Momenta, iQuantities.Momentum);
+    push(m_AngularMomenta, iQuantities.AngularMomentum);
+    m_Quantities = iQuantities;
+    m_HasQuantities = true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Menu::PlotGpuTime(const char *iLabel, const std::array<float, 100> &iTimes)
+{
+    const float maxTime = *std::max_element(iTimes.begin(), iTimes.end());
+    std::array<char, 32> overlay;
+    std::snprintf(overlay.data(), overlay.size(), "%.3f ms", iTimes.back());
+    ImGui::PlotLines(iLabel, iTimes.data(), static_cast<int>(iTimes.size()), 0, overlay.data(), 0.f, maxTime * 1.2f,
+                     ImVec2(0, 50));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Menu::PlotQuantity(const char *iLabel, const std::array<float, 100> &iValues)
+{
+    // The range follows the values, so a slow drift stays visible.
+    const auto [minValue, maxValue] = std::minmax_element(iValues.begin(), iValues.end());
+    const float margin = std::max((*maxValue - *minValue) * 0.1f, std::abs(*maxValue) * 1e-6f);
+    std::array<char, 32> overlay;
+    std::snprintf(overlay.data(), overlay.size(), "%.6g", iValues.back());
+    ImGui::PlotLines(iLabel, iValues.data(), static_cast<int>(iValues.size()), 0, overlay.data(), *minValue - margin,
+                     *maxValue + margin, ImVec2(0, 50));
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void Menu::UpdateMouse(double iXPos, double iYPos, bool iLeftClick, bool iRightClick)
 {
@@ -1,8 +1,12 @@
 #include "Renderer.h"
 #include "Olympus/Debug.h"
+#include "Geometry/GalaxyGenerator.h"
+#include "Snapshot.h"
 #include <iostream>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 #include <chrono>
+#include <utility>
 
 //----------------------------------------------------------------------------------------------------------------------
 Renderer::Renderer(const olp::Instance &iInstance, VkSurfaceKHR iSurface, uint32_t iWidth, uint32_t iHeight)
@@ -13,7 +17,13 @@ Renderer::Renderer(const olp::Instance &iInstance, VkSurfaceKHR iSurface, uint32
       m_CloudPipeline(m_Device),
       m_AccelerationPass(m_Device),
       m_IntegrationPass(m_Device),
-      m_DepthBuffer(m_Device)
+      m_LeapfrogPass(m_Device),
+      m_StepPass(m_Device),
+      m_Recorder(m_Device),
+      m_ReductionPass(m_Device),
+      m_ReorderPass(m_Device),
+      m_DepthBuffer(m_Device),
+      m_Timer(m_Device)
 
 {
     CreateResources();
@@ -32,6 +42,7 @@ void Renderer::CreateResources()
     CreateUniformBuffers();
 
     CreateSyncObjects();
+    m_Timer.Create(m_Device.GetQueueIndices().graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT, 3);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -46,46 +57,99 @@ void Renderer::ReleaseResources()
     m_UniformBuffers.Displacement.Destroy();
 
     m_PipelineLayout.Destroy();
+    m_Timer.Destroy();
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
     {
         vkDestroySemaphore(m_Device.GetDevice(), m_RenderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(m_Device.GetDevice(), m_ImageAvailableSemaphores[i], nullptr);
+        vkDestroySemaphore(m_Device.GetDevice(), m_ComputeSemaphores[i], nullptr);
+        vkDestroySemaphore(m_Device.GetDevice(), m_StepSemaphores[i], nullptr);
         vkDestroyFence(m_Device.GetDevice(), m_InFlightFences[i], nullptr);
+        vkDestroyFence(m_Device.GetDevice(), m_RenderPassFences[i], nullptr);
     }
 
     m_Device.Destroy();
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void Renderer::InitializeGalaxy(uint32_t iNbStars, float iGalaxyDiameters, float iGalaxyThickness, float iInitialSpeed, float iBlackHoleMass)
+void Renderer::InitializeGalaxy(uint32_t iNbStars, float iGalaxyDiameters, float iGalaxyThickness, float iInitialSpeed, float iBlackHoleMass,
+                                AccelerationPass::Kernel iAccelerationKernel, IntegrationPass::Scheme iScheme)
+{
+    const std::vector<CloudVertex> stars = GenerateGalaxy(iNbStars, iGalaxyDiameters, iGalaxyThickness, iInitialSpeed);
+    InitializeGalaxy(stars.data(), static_cast<uint32_t>(stars.size()), iBlackHoleMass, iAccelerationKernel, iScheme);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Renderer::InitializeGalaxies(const std::vector<GalaxyDescription> &iGalaxies,
+                                  AccelerationPass::Kernel iAccelerationKernel, IntegrationPass::Scheme iScheme)
+{
+    const std::vector<CloudVertex> stars = GenerateGalaxies(iGalaxies);
+    InitializeGalaxy(
+        stars.data(), static_cast<uint32_t>(stars.size()), 0.f, iAccelerationKernel, iScheme, CountBlackHoles(iGalaxies));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Renderer::InitializeGalaxy(const CloudVertex *iStars, uint32_t iNbStars, float iBlackHoleMass,
+                                AccelerationPass::Kernel iAccelerationKernel, IntegrationPass::Scheme iScheme,
+                                uint32_t iNbBlackHoles)
 {
     CreateDescriptorPool();
     CreateDescriptorSets();
 
     VkCloud &galaxy = m_Clouds.emplace_back(m_Device);
-    galaxy.Init(iNbStars, iGalaxyDiameters, iGalaxyThickness, iInitialSpeed);
+    galaxy.Init(iStars, iNbStars);
 
     m_AccelerationInfo.NbPoint = galaxy.GetSize();
     m_DisplacementInfo.NbPoint = m_AccelerationInfo.NbPoint;
     m_AccelerationInfo.BlackHoleMass = iBlackHoleMass;
+    m_AccelerationInfo.NbBlackHoles = std::min(iNbBlackHoles, iNbStars);
+    m_OptionsChanged = true;
 
-    m_AccelerationPass.Create(m_DescriptorPool, galaxy, m_UniformBuffers.Acceleration);
+    m_StepState = IntegrationPass::CreateStepStateBuffer(m_Device);
+
+    m_AccelerationPass.Create(
+        m_DescriptorPool,
+        galaxy,
+        m_UniformBuffers.Acceleration,
+        m_UniformBuffers.Displacement,
+        m_StepState,
+        iAccelerationKernel);
 
     m_IntegrationPass.Create(
         m_DescriptorPool,
         galaxy,
         m_UniformBuffers.Displacement,
-        m_AccelerationPass.GetAccelerationBuffer());
+        m_AccelerationPass.GetAccelerationBuffer(),
+        m_StepState);
+
+    m_LeapfrogPass.Create(
+        m_DescriptorPool, galaxy, m_UniformBuffers.Acceleration, m_UniformBuffers.Displacement, m_StepState);
+
+    m_ReductionPass.Create(m_DescriptorPool, galaxy, m_UniformBuffers.Acceleration, MAX_FRAMES_IN_FLIGHT);
+    m_FramesReduced.fill(false);
+    m_StepsSinceReorder = 0;
+
+    if (iScheme == IntegrationPass::Scheme::FusedLeapfrog)
+        m_StepPass.Create({&m_LeapfrogPass}, m_NbSubsteps, MAX_FRAMES_IN_FLIGHT);
+    else
+        m_StepPass.Create({&m_AccelerationPass, &m_IntegrationPass}, m_NbSubsteps, MAX_FRAMES_IN_FLIGHT);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void Renderer::ReleaseGalaxy()
 {
+    m_Recorder.Stop();
     vkDeviceWaitIdle(m_Device.GetDevice());
 
+    m_StepPass.Destroy();
+    if (m_ReorderPass.IsCreated())
+        m_ReorderPass.Destroy();
+    m_ReductionPass.Destroy();
+    m_LeapfrogPass.Destroy();
     m_IntegrationPass.Destroy();
     m_AccelerationPass.Destroy();
+    m_StepState.Destroy();
 
     vkDestroyDescriptorPool(m_Device.GetDevice(), m_DescriptorPool, nullptr);
 
@@ -94,6 +158,35 @@ void Renderer::ReleaseGalaxy()
     m_Clouds.clear();
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+void Renderer::StartRecording(const std::filesystem::path &iPath, uint32_t iInterval)
+{
+    if (m_Clouds.empty())
+        return;
+
+    m_Recorder.Start(iPath, m_Clouds.front(), iInterval);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Renderer::StopRecording()
+{
+    m_Recorder.Stop();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Renderer::SaveSnapshot(const std::filesystem::path &iPath, const Menu::GalaxyParameters &iGalaxy,
+                            const Menu::RealTimeParameters &iRealTime)
+{
+    if (m_Clouds.empty())
+        return;
+
+    vkDeviceWaitIdle(m_Device.GetDevice());
+
+    const VkCloud &galaxy = m_Clouds.front();
+    galaxy.ReadStars([&](const CloudVertex *iStars)
+                     { Snapshot::Save(iPath, iStars, galaxy.GetSize(), m_AccelerationInfo.NbBlackHoles, iGalaxy, iRealTime); });
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void Renderer::CreateSwapchainResources()
 {
@@ -152,8 +245,8 @@ void Renderer::CreateCommandBuffers()
 void Renderer::CreateUniformBuffers()
 {
     m_UniformBuffers.Model.Init(sizeof(ModelInfo), m_Device);
-    m_UniformBuffers.Displacement.Init(sizeof(DisplacementInfo), m_Device);
-    m_UniformBuffers.Acceleration.Init(sizeof(AccelerationInfo), m_Device);
+    m_UniformBuffers.Displacement.Init(sizeof(IntegrationPass::Options), m_Device);
+    m_UniformBuffers.Acceleration.Init(sizeof(AccelerationPass::Options), m_Device);
 }
 
 void Renderer::UpdateUniformBuffers(const glm::mat4 &iView, const glm::mat4 &iProj)
@@ -166,8 +259,15 @@ void Renderer::UpdateUniformBuffers(const glm::mat4 &iView, const glm::mat4 &iPr
 
     m_UniformBuffers.Model.SendData(&modelUbo, sizeof(ModelInfo));
 
-    m_UniformBuffers.Displacement.SendData(&m_DisplacementInfo, sizeof(DisplacementInfo));
-    m_UniformBuffers.Acceleration.SendData(&m_AccelerationInfo, sizeof(AccelerationInfo));
+    if (!m_OptionsChanged)
+        return;
+
+    // The compute passes of the frames in flight read the options.
+    vkWaitForFences(
+        m_Device.GetDevice(), static_cast<uint32_t>(m_InFlightFences.size()), m_InFlightFences.data(), VK_TRUE, UINT64_MAX);
+    m_UniformBuffers.Displacement.SendData(&m_DisplacementInfo, sizeof(IntegrationPass::Options));
+    m_UniformBuffers.Acceleration.SendData(&m_AccelerationInfo, sizeof(AccelerationPass::Options));
+    m_OptionsChanged = false;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -202,11 +302,12 @@ void Renderer::CreateDescriptorPool()
 {
     VkDescriptorPoolSize uniformPoolSize{};
     uniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uniformPoolSize.descriptorCount = 3; // ModelInfo + AccelerationInfo + DisplacementInfo
+    uniformPoolSize.descriptorCount = 13; // ModelInfo + (AccelerationInfo*3 + DisplacementInfo*3)*2
 
     VkDescriptorPoolSize storageBufferPoolSize{};
     storageBufferPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    storageBufferPoolSize.descriptorCount = 4; // Position Buffer*2 + Acceleration buffer*2
+    // (Position Buffer*6 + Acceleration buffer*2 + Render buffer*2 + Step state*3 + Reduction*2)*2, and the sort
+    storageBufferPoolSize.descriptorCount = 30 + ReorderPass::NbStorageDescriptors;
 
     std::array<VkDescriptorPoolSize, 2> poolSizes{uniformPoolSize, storageBufferPoolSize};
 
@@ -214,7 +315,8 @@ void Renderer::CreateDescriptorPool()
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = 3;
+    // Model + one set of each compute pass for each vertex buffer, and the sort
+    poolInfo.maxSets = 9 + ReorderPass::NbDescriptorSets;
 
     VK_CHECK_RESULT(vkCreateDescriptorPool(m_Device.GetDevice(), &poolInfo, nullptr, &m_DescriptorPool))
 }
@@ -325,7 +427,10 @@ void Renderer::CreateSyncObjects()
             vkCreateSemaphore(m_Device.GetDevice(), &semaphoreInfo, nullptr, &m_ImageAvailableSemaphores[i]))
         VK_CHECK_RESULT(
             vkCreateSemaphore(m_Device.GetDevice(), &semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]))
+        VK_CHECK_RESULT(vkCreateSemaphore(m_Device.GetDevice(), &semaphoreInfo, nullptr, &m_ComputeSemaphores[i]))
+        VK_CHECK_RESULT(vkCreateSemaphore(m_Device.GetDevice(), &semaphoreInfo, nullptr, &m_StepSemaphores[i]))
         VK_CHECK_RESULT(vkCreateFence(m_Device.GetDevice(), &fenceInfo, nullptr, &m_InFlightFences[i]))
+        VK_CHECK_RESULT(vkCreateFence(m_Device.GetDevice(), &fenceInfo, nullptr, &m_RenderPassFences[i]))
     }
 }
 
@@ -352,6 +457,10 @@ void Renderer::BuildCommandBuffer(uint32_t iIndex)
 
     m_ImGUI->Update();
 
+    const uint32_t timerSlot = static_cast<uint32_t>(m_CurrentFrame);
+    m_Timer.Reset(commandBuffer.GetBuffer(), timerSlot);
+    m_Timer.Write(commandBuffer.GetBuffer(), timerSlot, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
     vkCmdBeginRenderPass(commandBuffer.GetBuffer(), &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
     vkCmdBindPipeline(
         commandBuffer.GetBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_CloudPipeline.GetPipeline());
@@ -368,10 +477,13 @@ void Renderer::BuildCommandBuffer(uint32_t iIndex)
 
     for (VkCloud &cloud : m_Clouds)
         cloud.Draw(commandBuffer.GetBuffer());
+    m_Timer.Write(commandBuffer.GetBuffer(), timerSlot, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 
     m_ImGUI->Draw(commandBuffer.GetBuffer());
 
     vkCmdEndRenderPass(commandBuffer.GetBuffer());
+    m_Timer.Write(commandBuffer.GetBuffer(), timerSlot, 2, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    m_FramesTimed[m_CurrentFrame] = true;
 
     commandBuffer.End();
 }
@@ -379,10 +491,8 @@ void Renderer::BuildCommandBuffer(uint32_t iIndex)
 //----------------------------------------------------------------------------------------------------------------------
 void Renderer::DrawNextFrame(const glm::mat4 &iView, const glm::mat4 &iProj)
 {
-    // TODO remove ?
-    m_IntegrationPass.WaitFence();
-    m_AccelerationPass.WaitFence();
-
+    // The time steps that used these semaphores MAX_FRAMES_IN_FLIGHT frames ago are done.
+    // The compute passes of the previous frame keep running while this one is recorded.
     vkWaitForFences(m_Device.GetDevice(), 1, &m_InFlightFences[m_CurrentFrame], VK_TRUE, UINT64_MAX);
 
     uint32_t imageIndex;
@@ -405,18 +515,91 @@ void Renderer::DrawNextFrame(const glm::mat4 &iView, const glm::mat4 &iProj)
     }
 
     // Mark the image as now being in use by this frame
-    m_ImagesInFlight[imageIndex] = m_InFlightFences[m_CurrentFrame];
+    m_ImagesInFlight[imageIndex] = m_RenderPassFences[m_CurrentFrame];
+
+    // ImGUI and the model uniform buffer are updated in place: the render pass of the previous frame must be done.
+    // It runs after the compute passes of two frames ago, not after the ones of the previous frame.
+    const size_t previousFrame = (m_CurrentFrame + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT;
+    vkWaitForFences(m_Device.GetDevice(), 1, &m_RenderPassFences[previousFrame], VK_TRUE, UINT64_MAX);
 
+    // The render passes run in order: the one using this timer slot MAX_FRAMES_IN_FLIGHT frames ago is done too.
+    std::vector<float> renderTimes;
+    if (m_FramesTimed[m_CurrentFrame] && m_Timer.Read(static_cast<uint32_t>(m_CurrentFrame), renderTimes))
+    {
+        m_GpuTimes.Cloud = renderTimes[0];
+        m_GpuTimes.ImGui = renderTimes[1];
+    }
+    // The steps submitted in this frame slot are done, their fence is signaled. The leapfrog pass is counted as
+    // acceleration, most of its time.
+    std::vector<float> passTimes;
+    if (m_StepPass.ReadPassTimes(static_cast<uint32_t>(m_CurrentFrame), passTimes))
+    {
+        m_GpuTimes.Acceleration = passTimes.front();
+        m_GpuTimes.Integration = passTimes.size() > 1 ? passTimes[1] : 0.f;
+    }
+
+    // The reduction submitted with the steps of this frame slot is done too.
+    if (m_FramesReduced[m_CurrentFrame])
+    {
+        ReductionPass::Quantities quantities;
+        m_ReductionPass.Read(static_cast<uint32_t>(m_CurrentFrame), quantities, m_GpuTimes.Reduction);
+        m_Quantities.KineticEnergy = quantities.KineticEnergy;
+        m_Quantities.PotentialEnergy = quantities.PotentialEnergy;
+        m_Quantities.Momentum = glm::length(glm::vec3(quantities.Momentum));
+        m_Quantities.AngularMomentum = glm::length(glm::vec3(quantities.AngularMomentum));
+        for (glm::length_t i = 0; i < 3; ++i)
+        {
+            m_Quantities.CenterOfMass[i] = quantities.CenterOfMass[i];
+            m_Quantities.Min[i] = quantities.Min[i];
+            m_Quantities.Max[i] = quantities.Max[i];
+        }
+    }
+    else
+        m_GpuTimes.Reduction = 0.f;
+
+    if (m_StepPass.GetNbSteps() != m_NbSubsteps)
+    {
+        // The command buffers of the steps are pending in the frames in flight.
+        vkWaitForFences(m_Device.GetDevice(), static_cast<uint32_t>(m_InFlightFences.size()), m_InFlightFences.data(),
+                        VK_TRUE, UINT64_MAX);
+        m_StepPass.SetNbSteps(m_NbSubsteps);
+    }
+
+    VkCloud &galaxy = m_Clouds.front();
+    if (m_ReorderInterval > 0 && m_StepsSinceReorder >= m_ReorderInterval)
+    {
+        if (!m_ReorderPass.IsCreated())
+            m_ReorderPass.Create(m_DescriptorPool, galaxy, m_AccelerationInfo.NbBlackHoles, MAX_FRAMES_IN_FLIGHT);
+        // The sorted stars are written to the buffer drawn by the previous frame, once the steps of the previous frame
+        // are done; this frame draws them. Its steps then write the other buffer, which no render pass in flight draws.
+        // The sort of this frame slot is done: the steps that followed it signaled the fence waited above.
+        m_ReorderPass.Submit(
+            static_cast<uint32_t>(m_CurrentFrame),
+            galaxy.GetCurrent(),
+            {m_PendingStep, m_PendingRender},
+            {m_ReorderPass.GetSemaphore()},
+            VK_NULL_HANDLE);
+        galaxy.Advance(1);
+        m_PendingStep = m_ReorderPass.GetSemaphore();
+        m_PendingRender = VK_NULL_HANDLE;
+        m_StepsSinceReorder = 0;
+    }
+    m_GpuTimes.Reorder = m_ReorderPass.GetGpuTime();
+
+    // The stars drawn are the current ones, sorted or not.
     BuildCommandBuffer(imageIndex);
     UpdateUniformBuffers(iView, iProj);
 
-    std::array<VkPipelineStageFlags, 1> waitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    std::array<VkSemaphore, 1> waitSemaphores = {m_ImageAvailableSemaphores[m_CurrentFrame]};
-    std::array<VkSemaphore, 1> signalSemaphores = {m_AccelerationPass.GetSemaphore()};
+    // The stars are drawn once the integration pass of the previous frame, or the sort, wrote them.
+    std::array<VkPipelineStageFlags, 2> waitStages = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT};
+    std::array<VkSemaphore, 2> waitSemaphores = {m_ImageAvailableSemaphores[m_CurrentFrame], m_PendingStep};
+    std::array<VkSemaphore, 2> signalSemaphores = {
+        m_RenderFinishedSemaphores[m_CurrentFrame], m_ComputeSemaphores[m_CurrentFrame]};
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.waitSemaphoreCount = m_PendingStep != VK_NULL_HANDLE ? 2 : 1;
     submitInfo.pWaitSemaphores = waitSemaphores.data();
     submitInfo.pWaitDstStageMask = waitStages.data();
     submitInfo.commandBufferCount = 1;
@@ -424,13 +607,37 @@ void Renderer::DrawNextFrame(const glm::mat4 &iView, const glm::mat4 &iProj)
     submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
     submitInfo.pSignalSemaphores = signalSemaphores.data();
 
-    vkResetFences(m_Device.GetDevice(), 1, &m_InFlightFences[m_CurrentFrame]);
+    vkResetFences(m_Device.GetDevice(), 1, &m_RenderPassFences[m_CurrentFrame]);
 
     VK_CHECK_RESULT(
-        vkQueueSubmit(m_Device.GetGraphicsQueue(), 1, &submitInfo, m_InFlightFences[m_CurrentFrame]))
+        vkQueueSubmit(m_Device.GetGraphicsQueue(), 1, &submitInfo, m_RenderPassFences[m_CurrentFrame]))
+
+    // The steps write the vertex buffer not drawn by this frame, so they run along with the render pass. The first
+    // step only waits for the render pass of the previous frame, which drew that buffer. The next steps write the
+    // drawn buffer again and wait for this render pass.
+    const uint32_t source = galaxy.GetCurrent();
+    VkSemaphore firstWaitSemaphore = m_PendingRender;
+    VkSemaphore nextWaitSemaphore = VK_NULL_HANDLE;
+    m_PendingRender = m_ComputeSemaphores[m_CurrentFrame];
+    if (m_StepPass.GetNbSteps() > 1)
+        std::swap(nextWaitSemaphore, m_PendingRender);
+    // The recorder and the reduction read the buffer written by the last step.
+    galaxy.Advance(m_StepPass.GetNbSteps());
+    const uint32_t slot = static_cast<uint32_t>(m_CurrentFrame);
+    m_FramesReduced[m_CurrentFrame] = m_Monitoring;
+    m_StepsSinceReorder += m_StepPass.GetNbSteps();
 
-    m_AccelerationPass.Process(m_AccelerationPass.GetSemaphore(), m_IntegrationPass.GetSemaphore());
-    m_IntegrationPass.Process(m_IntegrationPass.GetSemaphore(), m_RenderFinishedSemaphores[m_CurrentFrame]);
+    vkResetFences(m_Device.GetDevice(), 1, &m_InFlightFences[m_CurrentFrame]);
+    m_StepPass.Submit(
+        slot,
+        source,
+        firstWaitSemaphore,
+        nextWaitSemaphore,
+        {m_StepSemaphores[m_CurrentFrame]},
+        m_InFlightFences[m_CurrentFrame],
+        {m_Recorder.NextStep(m_StepPass.GetNbSteps()),
+         m_Monitoring ? m_ReductionPass.GetSlotCommandBuffer(slot, galaxy.GetCurrent()) : VK_NULL_HANDLE});
+    m_PendingStep = m_StepSemaphores[m_CurrentFrame];
 
     result = m_Swapchain.PresentNextImage(&m_RenderFinishedSemaphores[m_CurrentFrame], imageIndex);
 
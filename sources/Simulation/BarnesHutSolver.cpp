@@ -0,0 +1,109 @@
+#include "Simulation/BarnesHutSolver.h"
+#include <glm/geometric.hpp>
+#include <array>
+#include <limits>
+
+//----------------------------------------------------------------------------------------------------------------------
+BarnesHutSolver::BarnesHutSolver(ThreadPool &iThreadPool, float iOpeningAngle, uint32_t iLeafSize)
+    : m_ThreadPool(iThreadPool),
+      m_Octree(iThreadPool),
+      m_OpeningAngle(iOpeningAngle),
+      m_LeafSize(iLeafSize)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void BarnesHutSolver::ComputeOpeningRadii()
+{
+    // A node is opened when the star is closer than size / angle + offset of the center of mass (Barnes 1994),
+    // so stars inside or next to the node always open it.
+    const std::vector<Octree::Node> &nodes = m_Octree.GetNodes();
+    m_OpeningRadii2.resize(nodes.size());
+    m_ThreadPool.ParallelFor(
+        0,
+        nodes.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                const Octree::Node &node = nodes[i];
+                if (m_OpeningAngle <= 0.f)
+                {
+                    m_OpeningRadii2[i] = std::numeric_limits<float>::infinity();
+                    continue;
+                }
+                const float radius = 2.f * node.HalfSize / m_OpeningAngle + glm::distance(node.CenterOfMass, node.Center);
+                m_OpeningRadii2[i] = radius * radius;
+            }
+        });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void BarnesHutSolver::ComputeAccelerations(
+    const std::vector<CloudVertex> &iStars,
+    const Settings &iSettings,
+    std::vector<glm::vec4> &oAccelerations)
+{
+    m_Octree.Build(iStars, m_LeafSize);
+    ComputeOpeningRadii();
+
+    const std::vector<Octree::Node> &nodes = m_Octree.GetNodes();
+    const std::vector<glm::vec4> &stars = m_Octree.GetSortedStars();
+    const std::vector<uint32_t> &indices = m_Octree.GetSortedIndices();
+
+    // Stars left out of the tree have a NaN position, they get a NaN acceleration as in the shader.
+    oAccelerations.resize(iStars.size());
+    if (stars.size() != iStars.size())
+        std::fill(oAccelerations.begin(), oAccelerations.end(), glm::vec4(std::numeric_limits<float>::quiet_NaN()));
+
+    // Targets are walked in Z-curve order so that neighbouring threads walk similar parts of the tree.
+    m_ThreadPool.ParallelFor(
+        0,
+        stars.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            // Deep enough for 21 levels of 8 children.
+            std::array<uint32_t, 8 * 22> stack;
+            for (size_t target = iBegin; target < iEnd; ++target)
+            {
+                const glm::vec3 pos(stars[target]);
+                glm::vec3 acc(0.f);
+
+                uint32_t stackSize = 0;
+                stack[stackSize++] = 0;
+                while (stackSize > 0)
+                {
+                    const uint32_t nodeIndex = stack[--stackSize];
+                    const Octree::Node &node = nodes[nodeIndex];
+
+                    const glm::vec3 vector = node.CenterOfMass - pos;
+                    const float distance2 = glm::dot(vector, vector);
+                    if (distance2 > m_OpeningRadii2[nodeIndex])
+                    {
+                        acc += node.Mass * vector / (std::sqrt(distance2) * (distance2 + iSettings.SmoothLenght));
+                        continue;
+                    }
+
+                    if (!node.IsLeaf())
+                    {
+                        for (uint32_t child = 0; child < node.NbChildren; ++child)
+                            stack[stackSize++] = node.FirstChild + child;
+                        continue;
+                    }
+
+                    for (uint32_t i = node.Begin; i < node.End; ++i)
+                    {
+                        if (i == target)
+                            continue;
+                        const glm::vec3 other = glm::vec3(stars[i]) - pos;
+                        const float norm = glm::dot(other, other) + iSettings.SmoothLenght;
+                        if (norm == 0)
+                            continue;
+                        acc += stars[i].w * glm::normalize(other) / norm;
+                    }
+                }
+                oAccelerations[indices[target]] = glm::vec4(acc, 0.f);
+            }
+        },
+        256);
+}
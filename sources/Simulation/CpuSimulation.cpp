@@ -0,0 +1,204 @@
+#include "Simulation/CpuSimulation.h"
+#include "Simulation/DirectSolver.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------------------------------------------------
+CpuSimulation::CpuSimulation(uint32_t iNbThreads)
+    : m_ThreadPool(iNbThreads),
+      m_Solver(std::make_unique<DirectSolver>(m_ThreadPool))
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuSimulation::Init(std::vector<CloudVertex> iStars, float iBlackHoleMass, uint32_t iNbBlackHoles)
+{
+    m_Stars = std::move(iStars);
+    m_Settings.NbBlackHoles = iNbBlackHoles;
+    m_Accelerations.assign(m_Stars.size(), glm::vec4(0.f));
+    m_BlackHoleMass = iBlackHoleMass;
+    m_Rungs.clear();
+    m_NbForceEvaluations = 0;
+    m_Settings.StepIndex = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuSimulation::SetBlockSteps(uint32_t iMaxRung, float iAccuracy)
+{
+    // 2^MaxRung substeps by step, and the rungs are stored on a byte.
+    m_MaxRung = std::min(iMaxRung, 16u);
+    m_RungAccuracy = iAccuracy;
+    m_Rungs.clear();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuSimulation::ComputeAccelerations()
+{
+    m_Solver->ComputeAccelerations(m_Stars, m_Settings, m_Accelerations);
+    ++m_Settings.StepIndex;
+    AddBlackHole();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuSimulation::AddBlackHole()
+{
+    m_ThreadPool.ParallelFor(
+        0,
+        m_Stars.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t index = iBegin; index < iEnd; ++index)
+                m_Accelerations[index] += GetBlackHoleAcceleration(m_Stars[index].Pos);
+        });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuSimulation::AddBlackHole(const std::vector<uint32_t> &iTargets)
+{
+    m_ThreadPool.ParallelFor(
+        0,
+        iTargets.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+                m_Accelerations[iTargets[i]] += GetBlackHoleAcceleration(m_Stars[iTargets[i]].Pos);
+        });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+glm::vec4 CpuSimulation::GetBlackHoleAcceleration(const glm::vec3 &iPos) const
+{
+    const float normPos = glm::dot(iPos, iPos) + m_Settings.SmoothLenght;
+    if (normPos == 0)
+        return glm::vec4(0.f);
+    return glm::vec4((m_BlackHoleMass * glm::normalize(-iPos)) / normPos, 0.f);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuSimulation::Integrate()
+{
+    m_ThreadPool.ParallelFor(
+        0,
+        m_Stars.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t index = iBegin; index < iEnd; ++index)
+            {
+                CloudVertex &star = m_Stars[index];
+                star.Speed += m_Step * glm::vec3(m_Accelerations[index]);
+                star.Pos += m_Step * star.Speed;
+            }
+        });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+ForceErrorReport CpuSimulation::MeasureForceError(uint32_t iNbSamples)
+{
+    m_Solver->ComputeAccelerations(m_Stars, m_Settings, m_ErrorAccelerations);
+    return ::MeasureForceError(m_ThreadPool, m_Stars, m_Settings.SmoothLenght, m_ErrorAccelerations, iNbSamples);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuSimulation::Step()
+{
+    if (m_MaxRung > 0)
+    {
+        BlockStep();
+        return;
+    }
+
+    ComputeAccelerations();
+    Integrate();
+    m_NbForceEvaluations += m_Stars.size();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t CpuSimulation::ChooseRung(const glm::vec4 &iAcceleration) const
+{
+    // The softening length is the square root of the term added to the squared distances.
+    const float acceleration = glm::length(glm::vec3(iAcceleration));
+    if (!(acceleration > 0.f) || m_Step <= 0.f)
+        return 0;
+    const float step = m_RungAccuracy * std::sqrt(std::sqrt(m_Settings.SmoothLenght) / acceleration);
+    const float rung = std::ceil(std::log2(m_Step / step));
+    return rung > 0.f ? std::min(static_cast<uint32_t>(rung), m_MaxRung) : 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuSimulation::BlockStep()
+{
+    const uint32_t nbSubsteps = 1u << m_MaxRung;
+    const float substepDuration = m_Step / static_cast<float>(nbSubsteps);
+    // The speeds are half a step behind the positions: the first kick of a star has no previous step to finish,
+    // it uses the same duration for both halves, as the global step does.
+    const bool firstStep = m_Rungs.size() != m_Stars.size();
+    if (firstStep)
+        m_Rungs.assign(m_Stars.size(), 0);
+
+    for (uint32_t substep = 0; substep < nbSubsteps; ++substep)
+    {
+        // A step of rung r lasts 2^(MaxRung - r) substeps: the shallowest rung starting a step here.
+        uint32_t alignedRung = 0;
+        while (substep % (nbSubsteps >> alignedRung) != 0)
+            ++alignedRung;
+
+        m_ActiveStars.clear();
+        for (uint32_t index = 0; index < m_Stars.size(); ++index)
+        {
+            if (m_Rungs[index] >= alignedRung)
+                m_ActiveStars.push_back(index);
+        }
+
+        // Every star starts a step with the first substep.
+        if (substep == 0)
+            ComputeAccelerations();
+        else
+        {
+            m_Solver->ComputeTargetAccelerations(m_Stars, m_Settings, m_ActiveStars, m_Accelerations);
+            ++m_Settings.StepIndex;
+            AddBlackHole(m_ActiveStars);
+        }
+        m_NbForceEvaluations += m_ActiveStars.size();
+
+        // Kick: the second half of the previous step of the star and the first half of its next one.
+        m_ThreadPool.ParallelFor(
+            0,
+            m_ActiveStars.size(),
+            [&](size_t iBegin, size_t iEnd)
+            {
+                for (size_t i = iBegin; i < iEnd; ++i)
+                {
+                    const uint32_t index = m_ActiveStars[i];
+                    const uint32_t rung = std::max(ChooseRung(m_Accelerations[index]), alignedRung);
+                    const float previousStep = m_Step / static_cast<float>(1u << m_Rungs[index]);
+                    const float nextStep = m_Step / static_cast<float>(1u << rung);
+                    const float kick = firstStep && substep == 0 ? nextStep : 0.5f * (previousStep + nextStep);
+                    m_Stars[index].Speed += kick * glm::vec3(m_Accelerations[index]);
+                    m_Rungs[index] = static_cast<uint8_t>(rung);
+                }
+            });
+
+        // Drift: every star moves, so the next accelerations see the positions at the same time.
+        m_ThreadPool.ParallelFor(
+            0,
+            m_Stars.size(),
+            [&](size_t iBegin, size_t iEnd)
+            {
+                for (size_t index = iBegin; index < iEnd; ++index)
+                {
+                    CloudVertex &star = m_Stars[index];
+                    star.Pos += substepDuration * star.Speed;
+                }
+            });
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<uint32_t> CpuSimulation::GetRungCounts() const
+{
+    std::vector<uint32_t> counts(m_MaxRung + 1, 0);
+    for (uint8_t rung : m_Rungs)
+        ++counts[std::min<uint32_t>(rung, m_MaxRung)];
+    return counts;
+}
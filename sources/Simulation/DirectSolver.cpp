@@ -0,0 +1,116 @@
+#include "Simulation/DirectSolver.h"
+#include "Simulation/SourceSampling.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @return Sources of the computation, the same ones as the shader.
+SourceSampling GetSampling(size_t iNbStars, const ForceSolver::Settings &iSettings)
+{
+    return GetSourceSampling(
+        static_cast<uint32_t>(iNbStars),
+        iSettings.NbBlackHoles,
+        iSettings.InteractionRate,
+        iSettings.RotateSources,
+        iSettings.StepIndex);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @return Attraction of a star on the star iIndex, per unit of its mass. 0 for the star itself or a NaN star.
+glm::vec3 GetAttraction(
+    const std::vector<CloudVertex> &iStars, const ForceSolver::Settings &iSettings, size_t iIndex, size_t iSource)
+{
+    const glm::vec3 other = iStars[iSource].Pos;
+    if (std::isnan(other.x) || std::isnan(other.y) || std::isnan(other.z))
+        return glm::vec3(0.f);
+    if (iSource == iIndex)
+        return glm::vec3(0.f);
+
+    const glm::vec3 vector = other - iStars[iIndex].Pos;
+    const float norm = glm::dot(vector, vector) + iSettings.SmoothLenght;
+    if (norm == 0)
+        return glm::vec3(0.f);
+    return glm::normalize(vector) / norm;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @return Acceleration of a star due to the sources.
+glm::vec3 SumAttractions(
+    const std::vector<CloudVertex> &iStars,
+    const ForceSolver::Settings &iSettings,
+    const SourceSampling &iSampling,
+    size_t iIndex)
+{
+    glm::vec3 acc(0.f);
+    for (uint32_t i = 0; i < iSampling.NbBlackHoles; ++i)
+        acc += iStars[i].Mass * GetAttraction(iStars, iSettings, iIndex, i);
+    for (uint32_t source = 0; source < iSampling.NbSources; ++source)
+    {
+        const size_t i = iSampling.GetStar(source);
+        if (i >= iStars.size())
+            break;
+        acc += iStars[i].Mass * iSampling.MassScale * GetAttraction(iStars, iSettings, iIndex, i);
+    }
+    return acc;
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+DirectSolver::DirectSolver(ThreadPool &iThreadPool)
+    : m_ThreadPool(iThreadPool)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DirectSolver::ComputeAccelerations(
+    const std::vector<CloudVertex> &iStars,
+    const Settings &iSettings,
+    std::vector<glm::vec4> &oAccelerations)
+{
+    oAccelerations.resize(iStars.size());
+    SumAccelerations(iStars, iSettings, nullptr, iStars.size(), oAccelerations);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DirectSolver::ComputeTargetAccelerations(
+    const std::vector<CloudVertex> &iStars,
+    const Settings &iSettings,
+    const std::vector<uint32_t> &iTargets,
+    std::vector<glm::vec4> &ioAccelerations)
+{
+    SumAccelerations(iStars, iSettings, iTargets.data(), iTargets.size(), ioAccelerations);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void DirectSolver::SumAccelerations(
+    const std::vector<CloudVertex> &iStars,
+    const Settings &iSettings,
+    const uint32_t *iTargets,
+    size_t iNbTargets,
+    std::vector<glm::vec4> &ioAccelerations)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const SourceSampling sampling = GetSampling(iStars.size(), iSettings);
+    const auto getStar = [&](size_t iTarget) -> size_t { return iTargets != nullptr ? iTargets[iTarget] : iTarget; };
+
+    m_ThreadPool.ParallelFor(
+        0,
+        iNbTargets,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t target = iBegin; target < iEnd; ++target)
+            {
+                const size_t index = getStar(target);
+                ioAccelerations[index] = glm::vec4(SumAttractions(iStars, iSettings, sampling, index), 0.f);
+            }
+        });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    m_InteractionsPerSecond = seconds > 0.0 ? static_cast<double>(iNbTargets) * static_cast<double>(sampling.NbBlackHoles + sampling.NbSources) / seconds : 0.0;
+}
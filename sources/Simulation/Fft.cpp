@@ -0,0 +1,59 @@
+#include "Simulation/Fft.h"
+#include <cmath>
+#include <utility>
+
+//----------------------------------------------------------------------------------------------------------------------
+Fft::Fft(uint32_t iSize)
+    : m_Size(iSize),
+      m_Twiddles(iSize / 2),
+      m_BitReversed(iSize)
+{
+    const double pi = std::acos(-1.0);
+    for (uint32_t k = 0; k < iSize / 2; ++k)
+    {
+        const double angle = -2.0 * pi * k / iSize;
+        m_Twiddles[k] = std::complex<float>(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+    }
+
+    uint32_t nbBits = 0;
+    while ((1u << nbBits) < iSize)
+        ++nbBits;
+    for (uint32_t i = 0; i < iSize; ++i)
+    {
+        uint32_t reversed = 0;
+        for (uint32_t bit = 0; bit < nbBits; ++bit)
+            reversed |= ((i >> bit) & 1u) << (nbBits - 1 - bit);
+        m_BitReversed[i] = reversed;
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Fft::Transform(std::complex<float> *ioValues, bool iInverse) const
+{
+    for (uint32_t i = 0; i < m_Size; ++i)
+    {
+        if (i < m_BitReversed[i])
+            std::swap(ioValues[i], ioValues[m_BitReversed[i]]);
+    }
+
+    for (uint32_t length = 2; length <= m_Size; length *= 2)
+    {
+        const uint32_t half = length / 2;
+        const uint32_t twiddleStride = m_Size / length;
+        for (uint32_t start = 0; start < m_Size; start += length)
+        {
+            for (uint32_t k = 0; k < half; ++k)
+            {
+                // Written out: std::complex multiplication checks for NaN and infinities and is much slower.
+                const std::complex<float> twiddle = m_Twiddles[k * twiddleStride];
+                const float twiddleImag = iInverse ? -twiddle.imag() : twiddle.imag();
+                const std::complex<float> value = ioValues[start + k + half];
+                const std::complex<float> odd(
+                    twiddle.real() * value.real() - twiddleImag * value.imag(),
+                    twiddle.real() * value.imag() + twiddleImag * value.real());
+                ioValues[start + k + half] = ioValues[start + k] - odd;
+                ioValues[start + k] += odd;
+            }
+        }
+    }
+}
@@ -0,0 +1,439 @@
+#include "Simulation/FmmSolver.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+double Factorial(uint32_t iValue)
+{
+    double result = 1.0;
+    for (uint32_t i = 2; i <= iValue; ++i)
+        result *= i;
+    return result;
+}
+
+/// sqrt(3), distance from the center of a cube to its corners in half edges.
+constexpr float SQRT_3 = 1.7320508f;
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+FmmSolver::FmmSolver(ThreadPool &iThreadPool, uint32_t iOrder, float iOpeningAngle, uint32_t iLeafSize)
+    : m_ThreadPool(iThreadPool),
+      m_Octree(iThreadPool),
+      m_Order(std::clamp(iOrder, 1u, 12u)),
+      m_OpeningAngle(iOpeningAngle),
+      m_LeafSize(iLeafSize)
+{
+    CreateTables();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::CreateTables()
+{
+    const uint32_t n = m_Order + 1;
+    m_IndexOf.assign(n * n * n, std::numeric_limits<uint32_t>::max());
+    m_Indices.clear();
+    for (uint32_t degree = 0; degree <= m_Order; ++degree)
+    {
+        for (uint32_t x = degree + 1; x-- > 0;)
+        {
+            for (uint32_t y = degree - x + 1; y-- > 0;)
+            {
+                const uint32_t z = degree - x - y;
+                m_IndexOf[(x * n + y) * n + z] = static_cast<uint32_t>(m_Indices.size());
+                m_Indices.push_back({static_cast<uint8_t>(x), static_cast<uint8_t>(y), static_cast<uint8_t>(z)});
+            }
+        }
+    }
+
+    // Derivatives of G(x.x): for each axis, d^a/dx^a G(x^2) = sum_j a! / (j! (a - 2j)!) (2x)^(a - 2j) G^(a - j)(x^2).
+    m_DerivativeTerms.assign(m_Indices.size(), {});
+    for (size_t i = 1; i < m_Indices.size(); ++i)
+    {
+        const std::array<uint8_t, 3> &a = m_Indices[i];
+        for (uint32_t jx = 0; 2 * jx <= a[0]; ++jx)
+        {
+            for (uint32_t jy = 0; 2 * jy <= a[1]; ++jy)
+            {
+                for (uint32_t jz = 0; 2 * jz <= a[2]; ++jz)
+                {
+                    const std::array<uint32_t, 3> j{jx, jy, jz};
+                    DerivativeTerm term{1.0, {}, 0};
+                    for (uint32_t axis = 0; axis < 3; ++axis)
+                    {
+                        const uint32_t power = a[axis] - 2 * j[axis];
+                        term.Coefficient *= Factorial(a[axis]) / (Factorial(j[axis]) * Factorial(power)) * std::pow(2.0, power);
+                        term.Power[axis] = static_cast<uint8_t>(power);
+                    }
+                    term.Derivative = static_cast<uint8_t>(a[0] + a[1] + a[2] - jx - jy - jz);
+                    m_DerivativeTerms[i].push_back(term);
+                }
+            }
+        }
+    }
+
+    m_ShiftProducts.clear();
+    m_M2LProducts.clear();
+    for (size_t i = 0; i < m_Indices.size(); ++i)
+    {
+        const std::array<uint8_t, 3> &a = m_Indices[i];
+        for (size_t j = 0; j < m_Indices.size(); ++j)
+        {
+            const std::array<uint8_t, 3> &b = m_Indices[j];
+            if (b[0] <= a[0] && b[1] <= a[1] && b[2] <= a[2])
+            {
+                m_ShiftProducts.push_back({static_cast<uint16_t>(i), static_cast<uint16_t>(j),
+                                           static_cast<uint16_t>(GetIndex(a[0] - b[0], a[1] - b[1], a[2] - b[2]))});
+            }
+            if (static_cast<uint32_t>(a[0] + a[1] + a[2] + b[0] + b[1] + b[2]) <= m_Order)
+            {
+                m_M2LProducts.push_back({static_cast<uint16_t>(j), static_cast<uint16_t>(i),
+                                         static_cast<uint16_t>(GetIndex(a[0] + b[0], a[1] + b[1], a[2] + b[2]))});
+            }
+        }
+    }
+
+    for (uint32_t axis = 0; axis < 3; ++axis)
+    {
+        m_GradientTerms[axis].clear();
+        for (size_t i = 0; i < m_Indices.size(); ++i)
+        {
+            std::array<uint8_t, 3> b = m_Indices[i];
+            if (b[0] + b[1] + b[2] + 1u > m_Order)
+                continue;
+            ++b[axis];
+            m_GradientTerms[axis].emplace_back(static_cast<uint16_t>(GetIndex(b[0], b[1], b[2])), static_cast<uint16_t>(i));
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::ComputeMonomials(const glm::dvec3 &iVector, double *oMonomials) const
+{
+    // powers[axis][k] = v[axis]^k / k!
+    std::array<std::array<double, 13>, 3> powers;
+    for (uint32_t axis = 0; axis < 3; ++axis)
+    {
+        powers[axis][0] = 1.0;
+        for (uint32_t k = 1; k <= m_Order; ++k)
+            powers[axis][k] = powers[axis][k - 1] * iVector[axis] / k;
+    }
+    for (size_t i = 0; i < m_Indices.size(); ++i)
+        oMonomials[i] = powers[0][m_Indices[i][0]] * powers[1][m_Indices[i][1]] * powers[2][m_Indices[i][2]];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::ComputeDerivatives(const glm::dvec3 &iVector, double *oDerivatives) const
+{
+    // The potential of a star is G(u), u = r^2, with G'(u) = 1 / (2 sqrt(u) (u + s)) so that the force is the softened
+    // attraction of acceleration.comp. Its derivatives come from the Leibniz rule on u^(-1/2) and (u + s)^(-1).
+    const double u = glm::dot(iVector, iVector);
+    const double inverseU = 1.0 / u;
+    const double inverseNorm = 1.0 / (u + m_SmoothLenght);
+
+    std::array<double, 13> radial; // d^m/du^m u^(-1/2)
+    std::array<double, 13> smooth; // d^m/du^m (u + s)^(-1)
+    radial[0] = 1.0 / std::sqrt(u);
+    smooth[0] = inverseNorm;
+    for (uint32_t m = 1; m < m_Order; ++m)
+    {
+        radial[m] = radial[m - 1] * -(m - 0.5) * inverseU;
+        smooth[m] = smooth[m - 1] * -static_cast<double>(m) * inverseNorm;
+    }
+
+    // G^(k) for k >= 1.
+    std::array<double, 13> derivatives{};
+    for (uint32_t k = 1; k <= m_Order; ++k)
+    {
+        const uint32_t n = k - 1;
+        double binomial = 1.0;
+        double sum = 0.0;
+        for (uint32_t m = 0; m <= n; ++m)
+        {
+            sum += binomial * radial[m] * smooth[n - m];
+            binomial = binomial * (n - m) / (m + 1);
+        }
+        derivatives[k] = 0.5 * sum;
+    }
+
+    std::array<std::array<double, 13>, 3> powers;
+    for (uint32_t axis = 0; axis < 3; ++axis)
+    {
+        powers[axis][0] = 1.0;
+        for (uint32_t k = 1; k <= m_Order; ++k)
+            powers[axis][k] = powers[axis][k - 1] * iVector[axis];
+    }
+
+    oDerivatives[0] = 0.0;
+    for (size_t i = 1; i < m_Indices.size(); ++i)
+    {
+        double sum = 0.0;
+        for (const DerivativeTerm &term : m_DerivativeTerms[i])
+            sum += term.Coefficient * powers[0][term.Power[0]] * powers[1][term.Power[1]] * powers[2][term.Power[2]] * derivatives[term.Derivative];
+        oDerivatives[i] = sum;
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::CollectSubtrees()
+{
+    const std::vector<Octree::Node> &nodes = m_Octree.GetNodes();
+    const size_t minCount = static_cast<size_t>(m_ThreadPool.GetSize()) * 8;
+
+    m_TopNodes.clear();
+    m_Subtrees.assign(1, 0);
+    bool hasInternalNode = !nodes[0].IsLeaf();
+    while (m_Subtrees.size() < minCount && hasInternalNode)
+    {
+        std::vector<uint32_t> next;
+        hasInternalNode = false;
+        for (uint32_t index : m_Subtrees)
+        {
+            const Octree::Node &node = nodes[index];
+            if (node.IsLeaf())
+            {
+                next.push_back(index);
+                continue;
+            }
+            m_TopNodes.push_back(index);
+            for (uint32_t child = node.FirstChild; child < node.FirstChild + node.NbChildren; ++child)
+            {
+                next.push_back(child);
+                hasInternalNode |= !nodes[child].IsLeaf();
+            }
+        }
+        m_Subtrees.swap(next);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::ComputeAccelerations(
+    const std::vector<CloudVertex> &iStars,
+    const Settings &iSettings,
+    std::vector<glm::vec4> &oAccelerations)
+{
+    m_SmoothLenght = iSettings.SmoothLenght;
+    m_Octree.Build(iStars, m_LeafSize);
+
+    const std::vector<Octree::Node> &nodes = m_Octree.GetNodes();
+    const std::vector<glm::vec4> &stars = m_Octree.GetSortedStars();
+    const std::vector<uint32_t> &indices = m_Octree.GetSortedIndices();
+
+    // Stars left out of the tree have a NaN position, they get a NaN acceleration as in the shader.
+    oAccelerations.resize(iStars.size());
+    if (stars.size() != iStars.size())
+        std::fill(oAccelerations.begin(), oAccelerations.end(), glm::vec4(std::numeric_limits<float>::quiet_NaN()));
+    if (nodes.empty())
+        return;
+
+    const size_t nbTerms = m_Indices.size();
+    m_Multipoles.assign(nodes.size() * nbTerms, 0.f);
+    m_Locals.assign(nodes.size() * nbTerms, 0.f);
+    m_Radii.assign(nodes.size(), 0.f);
+    m_SortedAccelerations.assign(stars.size(), glm::vec3(0.f));
+
+    CollectSubtrees();
+
+    // Upward pass, subtrees in parallel then the top nodes, children first.
+    m_ThreadPool.ParallelFor(
+        0,
+        m_Subtrees.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+                Upward(m_Subtrees[i], true);
+        },
+        1);
+    for (size_t i = m_TopNodes.size(); i-- > 0;)
+        Upward(m_TopNodes[i], false);
+
+    // Each subtree gathers the interactions of its stars with the whole tree, then pushes them down.
+    m_ThreadPool.ParallelFor(
+        0,
+        m_Subtrees.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            std::vector<double> scratch(3 * nbTerms);
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                Interact(m_Subtrees[i], 0, scratch);
+                Downward(m_Subtrees[i], scratch);
+            }
+        },
+        1);
+
+    m_ThreadPool.ParallelFor(
+        0,
+        stars.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+                oAccelerations[indices[i]] = glm::vec4(m_SortedAccelerations[i], 0.f);
+        });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::Upward(uint32_t iNodeIndex, bool iRecursive)
+{
+    const std::vector<Octree::Node> &nodes = m_Octree.GetNodes();
+    const std::vector<glm::vec4> &stars = m_Octree.GetSortedStars();
+    const Octree::Node &node = nodes[iNodeIndex];
+    const size_t nbTerms = m_Indices.size();
+    float *multipole = &m_Multipoles[iNodeIndex * nbTerms];
+
+    std::vector<double> monomials(nbTerms);
+    std::vector<double> sums(nbTerms, 0.0);
+    float radius = 0.f;
+
+    if (node.IsLeaf())
+    {
+        // P2M
+        for (uint32_t i = node.Begin; i < node.End; ++i)
+        {
+            const glm::vec3 pos(stars[i]);
+            ComputeMonomials(glm::dvec3(node.CenterOfMass) - glm::dvec3(pos), monomials.data());
+            for (size_t term = 0; term < nbTerms; ++term)
+                sums[term] += stars[i].w * monomials[term];
+            radius = std::max(radius, glm::distance(pos, node.CenterOfMass));
+        }
+    }
+    else
+    {
+        // M2M
+        for (uint32_t child = node.FirstChild; child < node.FirstChild + node.NbChildren; ++child)
+        {
+            if (iRecursive)
+                Upward(child, true);
+
+            const Octree::Node &childNode = nodes[child];
+            const float *childMultipole = &m_Multipoles[child * nbTerms];
+            ComputeMonomials(glm::dvec3(node.CenterOfMass) - glm::dvec3(childNode.CenterOfMass), monomials.data());
+            for (const Product &product : m_ShiftProducts)
+                sums[product.Output] += childMultipole[product.First] * monomials[product.Second];
+            radius = std::max(radius, glm::distance(childNode.CenterOfMass, node.CenterOfMass) + m_Radii[child]);
+        }
+    }
+
+    for (size_t term = 0; term < nbTerms; ++term)
+        multipole[term] = static_cast<float>(sums[term]);
+    m_Radii[iNodeIndex] = std::min(radius, glm::distance(node.CenterOfMass, node.Center) + SQRT_3 * node.HalfSize);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::Interact(uint32_t iTarget, uint32_t iSource, std::vector<double> &ioScratch)
+{
+    const std::vector<Octree::Node> &nodes = m_Octree.GetNodes();
+    const Octree::Node &target = nodes[iTarget];
+    const Octree::Node &source = nodes[iSource];
+
+    const float distance = glm::distance(target.Center, source.CenterOfMass);
+    if (SQRT_3 * target.HalfSize + m_Radii[iSource] < m_OpeningAngle * distance)
+    {
+        M2L(iTarget, iSource, ioScratch);
+        return;
+    }
+
+    if (target.IsLeaf() && source.IsLeaf())
+    {
+        P2P(target, source);
+        return;
+    }
+
+    // Splits the larger node, the target stays in the subtree of the calling thread.
+    if (source.IsLeaf() || (!target.IsLeaf() && target.HalfSize >= source.HalfSize))
+    {
+        for (uint32_t child = target.FirstChild; child < target.FirstChild + target.NbChildren; ++child)
+            Interact(child, iSource, ioScratch);
+    }
+    else
+    {
+        for (uint32_t child = source.FirstChild; child < source.FirstChild + source.NbChildren; ++child)
+            Interact(iTarget, child, ioScratch);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::M2L(uint32_t iTarget, uint32_t iSource, std::vector<double> &ioScratch)
+{
+    const std::vector<Octree::Node> &nodes = m_Octree.GetNodes();
+    const size_t nbTerms = m_Indices.size();
+    double *derivatives = ioScratch.data();
+    double *sums = derivatives + nbTerms;
+
+    ComputeDerivatives(glm::dvec3(nodes[iTarget].Center) - glm::dvec3(nodes[iSource].CenterOfMass), derivatives);
+
+    const float *multipole = &m_Multipoles[iSource * nbTerms];
+    std::fill(sums, sums + nbTerms, 0.0);
+    for (const Product &product : m_M2LProducts)
+        sums[product.Output] += multipole[product.First] * derivatives[product.Second];
+
+    float *local = &m_Locals[iTarget * nbTerms];
+    for (size_t term = 0; term < nbTerms; ++term)
+        local[term] += static_cast<float>(sums[term]);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::P2P(const Octree::Node &iTarget, const Octree::Node &iSource)
+{
+    const std::vector<glm::vec4> &stars = m_Octree.GetSortedStars();
+    for (uint32_t i = iTarget.Begin; i < iTarget.End; ++i)
+    {
+        const glm::vec3 pos(stars[i]);
+        glm::vec3 acc(0.f);
+        for (uint32_t j = iSource.Begin; j < iSource.End; ++j)
+        {
+            const glm::vec3 v = glm::vec3(stars[j]) - pos;
+            const float norm2 = glm::dot(v, v);
+            if (i == j || norm2 == 0.f)
+                continue;
+            acc += stars[j].w * (v / std::sqrt(norm2)) / (norm2 + m_SmoothLenght);
+        }
+        m_SortedAccelerations[i] += acc;
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FmmSolver::Downward(uint32_t iNodeIndex, std::vector<double> &ioScratch)
+{
+    const std::vector<Octree::Node> &nodes = m_Octree.GetNodes();
+    const std::vector<glm::vec4> &stars = m_Octree.GetSortedStars();
+    const Octree::Node &node = nodes[iNodeIndex];
+    const size_t nbTerms = m_Indices.size();
+    const float *local = &m_Locals[iNodeIndex * nbTerms];
+    double *monomials = ioScratch.data();
+    double *sums = monomials + nbTerms;
+
+    if (node.IsLeaf())
+    {
+        // L2P: the acceleration is minus the gradient of the local expansion.
+        for (uint32_t i = node.Begin; i < node.End; ++i)
+        {
+            ComputeMonomials(glm::dvec3(glm::vec3(stars[i])) - glm::dvec3(node.Center), monomials);
+            glm::dvec3 acc(0.0);
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                for (const std::pair<uint16_t, uint16_t> &term : m_GradientTerms[axis])
+                    acc[axis] -= local[term.first] * monomials[term.second];
+            }
+            m_SortedAccelerations[i] += glm::vec3(acc);
+        }
+        return;
+    }
+
+    // L2L: local(b) += parent local(a) * shift(a - b), for b <= a.
+    for (uint32_t child = node.FirstChild; child < node.FirstChild + node.NbChildren; ++child)
+    {
+        ComputeMonomials(glm::dvec3(nodes[child].Center) - glm::dvec3(node.Center), monomials);
+        std::fill(sums, sums + nbTerms, 0.0);
+        for (const Product &product : m_ShiftProducts)
+            sums[product.First] += local[product.Output] * monomials[product.Second];
+
+        float *childLocal = &m_Locals[child * nbTerms];
+        for (size_t term = 0; term < nbTerms; ++term)
+            childLocal[term] += static_cast<float>(sums[term]);
+        Downward(child, ioScratch);
+    }
+}
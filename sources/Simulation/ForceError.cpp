@@ -0,0 +1,168 @@
+#include "Simulation/ForceError.h"
+#include "Simulation/SourceSampling.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+/// @return Attraction of a source on a star at iPos, in double. 0 for the star itself and the NaN sources.
+glm::dvec3 GetAttraction(const CloudVertex &iSource, const glm::vec3 &iPos, float iSmoothLenght)
+{
+    const glm::dvec3 vector = glm::dvec3(iSource.Pos) - glm::dvec3(iPos);
+    const double distance2 = glm::dot(vector, vector);
+    if (distance2 == 0.0 || std::isnan(distance2))
+        return glm::dvec3(0.0);
+    return static_cast<double>(iSource.Mass) * vector / (std::sqrt(distance2) * (distance2 + iSmoothLenght));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @return Squared relative error of an acceleration.
+double GetSquaredError(const glm::dvec3 &iAcceleration, const glm::dvec3 &iReference)
+{
+    const glm::dvec3 error = iAcceleration - iReference;
+    const double norm2 = glm::dot(iReference, iReference);
+    return norm2 > 0.0 ? glm::dot(error, error) / norm2 : glm::dot(error, error);
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+ForceErrorReport MeasureForceError(
+    ThreadPool &iThreadPool,
+    const std::vector<CloudVertex> &iStars,
+    float iSmoothLenght,
+    const std::vector<glm::vec4> &iAccelerations,
+    uint32_t iNbSamples)
+{
+    ForceErrorReport report;
+    const size_t nbStars = iStars.size();
+    iNbSamples = static_cast<uint32_t>(std::min<size_t>(iNbSamples, nbStars));
+    if (iNbSamples == 0)
+        return report;
+
+    std::vector<float> errors(iNbSamples, 0.f);
+    iThreadPool.ParallelFor(
+        0,
+        iNbSamples,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t sample = iBegin; sample < iEnd; ++sample)
+            {
+                const size_t index = sample * nbStars / iNbSamples;
+                const glm::vec3 pos = iStars[index].Pos;
+
+                // Accumulated in double so that the reference is exact at the float precision.
+                glm::dvec3 reference(0.0);
+                for (const CloudVertex &star : iStars)
+                    reference += GetAttraction(star, pos, iSmoothLenght);
+
+                const double error = glm::length(glm::dvec3(glm::vec3(iAccelerations[index])) - reference);
+                const double norm = glm::length(reference);
+                errors[sample] = static_cast<float>(norm > 0.0 ? error / norm : error);
+            }
+        },
+        1);
+
+    double sum2 = 0.0;
+    for (float error : errors)
+        sum2 += static_cast<double>(error) * error;
+
+    std::sort(errors.begin(), errors.end());
+    report.NbSamples = iNbSamples;
+    report.RmsRelativeError = static_cast<float>(std::sqrt(sum2 / iNbSamples));
+    report.Percentile99 = errors[std::min<size_t>(iNbSamples - 1, iNbSamples * 99 / 100)];
+    report.MaxRelativeError = errors.back();
+    return report;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<SamplingErrorReport> MeasureSamplingError(
+    ThreadPool &iThreadPool,
+    const std::vector<CloudVertex> &iStars,
+    uint32_t iNbBlackHoles,
+    float iSmoothLenght,
+    const std::vector<float> &iInteractionRates,
+    uint32_t iNbSamples)
+{
+    const uint32_t nbStars = static_cast<uint32_t>(iStars.size());
+    iNbSamples = std::min(iNbSamples, nbStars);
+
+    std::vector<SamplingErrorReport> reports;
+    for (float rate : iInteractionRates)
+    {
+        for (bool rotate : {false, true})
+        {
+            const SourceSampling sampling = GetSourceSampling(nbStars, iNbBlackHoles, rate, rotate, 0);
+            SamplingErrorReport report;
+            report.InteractionRate = rate;
+            report.RotateSources = rotate;
+            report.NbSources = sampling.NbSources;
+            report.NbSteps = rotate ? sampling.Stride : 1;
+            reports.push_back(report);
+        }
+    }
+    if (iNbSamples == 0)
+        return reports;
+
+    // Squared relative errors of each sample, for a step and for the mean of the steps, by report.
+    std::vector<double> stepErrors(iNbSamples * reports.size(), 0.0);
+    std::vector<double> meanErrors(iNbSamples * reports.size(), 0.0);
+    iThreadPool.ParallelFor(
+        0,
+        iNbSamples,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t sample = iBegin; sample < iEnd; ++sample)
+            {
+                const size_t index = sample * nbStars / iNbSamples;
+                const glm::vec3 pos = iStars[index].Pos;
+
+                glm::dvec3 reference(0.0);
+                for (const CloudVertex &star : iStars)
+                    reference += GetAttraction(star, pos, iSmoothLenght);
+
+                for (size_t r = 0; r < reports.size(); ++r)
+                {
+                    const SamplingErrorReport &report = reports[r];
+                    glm::dvec3 mean(0.0);
+                    double stepError = 0.0;
+                    for (uint32_t step = 0; step < report.NbSteps; ++step)
+                    {
+                        const SourceSampling sampling = GetSourceSampling(
+                            nbStars, iNbBlackHoles, report.InteractionRate, report.RotateSources, step);
+                        glm::dvec3 acc(0.0);
+                        for (uint32_t source = 0; source < sampling.NbSources; ++source)
+                        {
+                            const uint32_t i = sampling.GetStar(source);
+                            if (i >= nbStars)
+                                break;
+                            acc += GetAttraction(iStars[i], pos, iSmoothLenght);
+                        }
+                        acc *= static_cast<double>(sampling.MassScale);
+                        for (uint32_t i = 0; i < sampling.NbBlackHoles; ++i)
+                            acc += GetAttraction(iStars[i], pos, iSmoothLenght);
+                        stepError += GetSquaredError(acc, reference);
+                        mean += acc;
+                    }
+                    stepErrors[r * iNbSamples + sample] = stepError / report.NbSteps;
+                    meanErrors[r * iNbSamples + sample] = GetSquaredError(mean / static_cast<double>(report.NbSteps), reference);
+                }
+            }
+        },
+        1);
+
+    for (size_t r = 0; r < reports.size(); ++r)
+    {
+        double stepSum = 0.0;
+        double meanSum = 0.0;
+        for (size_t sample = 0; sample < iNbSamples; ++sample)
+        {
+            stepSum += stepErrors[r * iNbSamples + sample];
+            meanSum += meanErrors[r * iNbSamples + sample];
+        }
+        reports[r].StepRmsError = static_cast<float>(std::sqrt(stepSum / iNbSamples));
+        reports[r].MeanRmsError = static_cast<float>(std::sqrt(meanSum / iNbSamples));
+    }
+    return reports;
+}
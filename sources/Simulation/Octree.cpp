@@ -0,0 +1,312 @@
+#include "Simulation/Octree.h"
+#include "Simulation/Morton.h"
+#include <glm/common.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+/// Number of levels of the 63-bit Morton keys.
+constexpr uint32_t MAX_LEVEL = 21;
+/// Level passed to BuildNode to build a whole subtree.
+constexpr uint32_t NO_LEVEL_LIMIT = std::numeric_limits<uint32_t>::max();
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+Octree::Octree(ThreadPool &iThreadPool)
+    : m_ThreadPool(iThreadPool)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Octree::Build(const std::vector<CloudVertex> &iStars, uint32_t iLeafSize)
+{
+    m_LeafSize = std::max(1u, iLeafSize);
+    m_Nodes.clear();
+    m_Subtrees.clear();
+
+    ComputeKeys(iStars);
+    if (m_Keys.empty())
+    {
+        m_SortedStars.clear();
+        m_SortedIndices.clear();
+        return;
+    }
+    SortKeys();
+
+    const size_t nbStars = m_Keys.size();
+    m_SortedStars.resize(nbStars);
+    m_SortedIndices.resize(nbStars);
+    m_ThreadPool.ParallelFor(
+        0,
+        nbStars,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                m_SortedIndices[i] = m_Keys[i].second;
+                m_SortedStars[i] = glm::vec4(iStars[m_Keys[i].second].Pos, iStars[m_Keys[i].second].Mass);
+            }
+        });
+
+    // Top of the tree, built serially until there are enough subtrees to keep every thread busy.
+    Node &root = m_Nodes.emplace_back();
+    root.HalfSize = m_Size * 0.5f;
+    root.Center = m_Min + glm::vec3(root.HalfSize);
+    root.Begin = 0;
+    root.End = static_cast<uint32_t>(nbStars);
+
+    uint32_t topLevels = 1;
+    while ((1u << (3 * topLevels)) < m_ThreadPool.GetSize() * 8 && topLevels < 4)
+        ++topLevels;
+    BuildNode(m_Nodes, 0, 0, topLevels);
+
+    // Subtrees, built in parallel in their own arrays. The first node of each array is the top node itself.
+    std::vector<std::vector<Node>> subtrees(m_Subtrees.size());
+    m_ThreadPool.ParallelFor(
+        0,
+        m_Subtrees.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                subtrees[i].push_back(m_Nodes[m_Subtrees[i].first]);
+                BuildNode(subtrees[i], 0, m_Subtrees[i].second, NO_LEVEL_LIMIT);
+            }
+        },
+        1);
+
+    // Appends the subtrees to the top, shifting their child indices.
+    const uint32_t topCount = static_cast<uint32_t>(m_Nodes.size());
+    std::vector<uint32_t> offsets(subtrees.size());
+    uint32_t nbNodes = topCount;
+    for (size_t i = 0; i < subtrees.size(); ++i)
+    {
+        offsets[i] = nbNodes - 1;
+        nbNodes += static_cast<uint32_t>(subtrees[i].size()) - 1;
+    }
+    m_Nodes.resize(nbNodes);
+    m_ThreadPool.ParallelFor(
+        0,
+        subtrees.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                for (Node &node : subtrees[i])
+                {
+                    if (!node.IsLeaf())
+                        node.FirstChild += offsets[i];
+                }
+                m_Nodes[m_Subtrees[i].first] = subtrees[i][0];
+                std::copy(subtrees[i].begin() + 1, subtrees[i].end(), m_Nodes.begin() + offsets[i] + 1);
+            }
+        },
+        1);
+
+    // Moments of the top nodes, children first.
+    for (uint32_t i = topCount; i-- > 0;)
+        ComputeMoments(m_Nodes, i);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Octree::ComputeKeys(const std::vector<CloudVertex> &iStars)
+{
+    const size_t nbStars = iStars.size();
+    const size_t nbChunks = std::max<size_t>(1, std::min<size_t>(nbStars, m_ThreadPool.GetSize() * 4));
+    const size_t chunkSize = (nbStars + nbChunks - 1) / nbChunks;
+
+    // Bounding box and number of valid stars of each chunk.
+    std::vector<glm::vec3> chunkMin(nbChunks, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> chunkMax(nbChunks, glm::vec3(std::numeric_limits<float>::lowest()));
+    std::vector<size_t> chunkCount(nbChunks + 1, 0);
+    m_ThreadPool.ParallelFor(
+        0,
+        nbChunks,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t chunk = iBegin; chunk < iEnd; ++chunk)
+            {
+                const size_t end = std::min(nbStars, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                {
+                    const glm::vec3 &pos = iStars[i].Pos;
+                    if (!std::isfinite(pos.x) || !std::isfinite(pos.y) || !std::isfinite(pos.z))
+                        continue;
+                    chunkMin[chunk] = glm::min(chunkMin[chunk], pos);
+                    chunkMax[chunk] = glm::max(chunkMax[chunk], pos);
+                    ++chunkCount[chunk + 1];
+                }
+            }
+        },
+        1);
+
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    for (size_t chunk = 0; chunk < nbChunks; ++chunk)
+    {
+        min = glm::min(min, chunkMin[chunk]);
+        max = glm::max(max, chunkMax[chunk]);
+        chunkCount[chunk + 1] += chunkCount[chunk];
+    }
+
+    m_Keys.resize(chunkCount[nbChunks]);
+    if (m_Keys.empty())
+        return;
+
+    const glm::vec3 extent = max - min;
+    m_Size = std::max(std::max(extent.x, extent.y), extent.z);
+    m_Size = m_Size * 1.0001f + std::numeric_limits<float>::min();
+    m_Min = min;
+
+    const float maxCoordinate = static_cast<float>((1u << MAX_LEVEL) - 1);
+    const float scale = static_cast<float>(1u << MAX_LEVEL) / m_Size;
+    m_ThreadPool.ParallelFor(
+        0,
+        nbChunks,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t chunk = iBegin; chunk < iEnd; ++chunk)
+            {
+                size_t key = chunkCount[chunk];
+                const size_t end = std::min(nbStars, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                {
+                    const glm::vec3 &pos = iStars[i].Pos;
+                    if (!std::isfinite(pos.x) || !std::isfinite(pos.y) || !std::isfinite(pos.z))
+                        continue;
+                    const glm::vec3 coordinates = glm::clamp((pos - m_Min) * scale, 0.f, maxCoordinate);
+                    m_Keys[key++] = {
+                        MortonKey63(
+                            static_cast<uint32_t>(coordinates.x),
+                            static_cast<uint32_t>(coordinates.y),
+                            static_cast<uint32_t>(coordinates.z)),
+                        static_cast<uint32_t>(i)};
+                }
+            }
+        },
+        1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Octree::SortKeys()
+{
+    // Merge sort: chunks sorted in parallel, then merged two by two.
+    const size_t nbKeys = m_Keys.size();
+    const size_t nbChunks = std::max<size_t>(1, std::min<size_t>(nbKeys / 1024, m_ThreadPool.GetSize()));
+    const size_t chunkSize = (nbKeys + nbChunks - 1) / nbChunks;
+
+    m_ThreadPool.ParallelFor(
+        0,
+        nbChunks,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t chunk = iBegin; chunk < iEnd; ++chunk)
+            {
+                auto begin = m_Keys.begin() + std::min(nbKeys, chunk * chunkSize);
+                auto end = m_Keys.begin() + std::min(nbKeys, (chunk + 1) * chunkSize);
+                std::sort(begin, end);
+            }
+        },
+        1);
+
+    m_SortBuffer.resize(nbKeys);
+    for (size_t width = chunkSize; width < nbKeys; width *= 2)
+    {
+        const size_t nbMerges = (nbKeys + 2 * width - 1) / (2 * width);
+        m_ThreadPool.ParallelFor(
+            0,
+            nbMerges,
+            [&](size_t iBegin, size_t iEnd)
+            {
+                for (size_t merge = iBegin; merge < iEnd; ++merge)
+                {
+                    const size_t begin = merge * 2 * width;
+                    const size_t middle = std::min(nbKeys, begin + width);
+                    const size_t end = std::min(nbKeys, begin + 2 * width);
+                    std::merge(
+                        m_Keys.begin() + begin, m_Keys.begin() + middle,
+                        m_Keys.begin() + middle, m_Keys.begin() + end,
+                        m_SortBuffer.begin() + begin);
+                }
+            },
+            1);
+        m_Keys.swap(m_SortBuffer);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Octree::BuildNode(std::vector<Node> &ioNodes, uint32_t iNodeIndex, uint32_t iLevel, uint32_t iMaxLevel)
+{
+    const Node node = ioNodes[iNodeIndex];
+    if (node.End - node.Begin <= m_LeafSize || iLevel == MAX_LEVEL)
+    {
+        ComputeMoments(ioNodes, iNodeIndex);
+        return;
+    }
+    if (iLevel == iMaxLevel)
+    {
+        m_Subtrees.emplace_back(iNodeIndex, iLevel);
+        return;
+    }
+
+    // The keys of the node share their first iLevel octants, the next 3 bits give the child.
+    const uint32_t shift = 3 * (MAX_LEVEL - 1 - iLevel);
+    const uint32_t firstChild = static_cast<uint32_t>(ioNodes.size());
+    uint32_t begin = node.Begin;
+    for (uint32_t octant = 0; octant < 8 && begin < node.End; ++octant)
+    {
+        auto end = std::partition_point(
+            m_Keys.begin() + begin,
+            m_Keys.begin() + node.End,
+            [&](const std::pair<uint64_t, uint32_t> &iKey) { return ((iKey.first >> shift) & 7) <= octant; });
+        const uint32_t endIndex = static_cast<uint32_t>(end - m_Keys.begin());
+        if (endIndex == begin)
+            continue;
+
+        Node &child = ioNodes.emplace_back();
+        child.HalfSize = node.HalfSize * 0.5f;
+        child.Center = node.Center + child.HalfSize * glm::vec3(octant & 4 ? 1.f : -1.f, octant & 2 ? 1.f : -1.f, octant & 1 ? 1.f : -1.f);
+        child.Begin = begin;
+        child.End = endIndex;
+        begin = endIndex;
+    }
+
+    const uint32_t nbChildren = static_cast<uint32_t>(ioNodes.size()) - firstChild;
+    ioNodes[iNodeIndex].FirstChild = firstChild;
+    ioNodes[iNodeIndex].NbChildren = nbChildren;
+
+    for (uint32_t child = 0; child < nbChildren; ++child)
+        BuildNode(ioNodes, firstChild + child, iLevel + 1, iMaxLevel);
+
+    // The moments of the top nodes are computed once their subtrees are built.
+    if (iMaxLevel == NO_LEVEL_LIMIT)
+        ComputeMoments(ioNodes, iNodeIndex);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Octree::ComputeMoments(std::vector<Node> &ioNodes, uint32_t iNodeIndex) const
+{
+    Node &node = ioNodes[iNodeIndex];
+    glm::vec3 weightedPosition(0.f);
+    float mass = 0.f;
+    if (node.IsLeaf())
+    {
+        for (uint32_t i = node.Begin; i < node.End; ++i)
+        {
+            weightedPosition += m_SortedStars[i].w * glm::vec3(m_SortedStars[i]);
+            mass += m_SortedStars[i].w;
+        }
+    }
+    else
+    {
+        for (uint32_t i = node.FirstChild; i < node.FirstChild + node.NbChildren; ++i)
+        {
+            weightedPosition += ioNodes[i].Mass * ioNodes[i].CenterOfMass;
+            mass += ioNodes[i].Mass;
+        }
+    }
+    node.Mass = mass;
+    node.CenterOfMass = mass > 0.f ? weightedPosition / mass : node.Center;
+}
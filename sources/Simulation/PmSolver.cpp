@@ -0,0 +1,432 @@
+#include "Simulation/PmSolver.h"
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+bool IsValid(const glm::vec3 &iPosition)
+{
+    return std::isfinite(iPosition.x) && std::isfinite(iPosition.y) && std::isfinite(iPosition.z);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t RoundUpToPowerOfTwo(uint32_t iValue)
+{
+    uint32_t result = 1;
+    while (result < iValue)
+        result *= 2;
+    return result;
+}
+
+/// Number of lines transformed together along the strided axes, so that they share the cache lines.
+constexpr uint32_t NB_BATCHED_LINES = 8;
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+PmSolver::PmSolver(ThreadPool &iThreadPool, uint32_t iGridSize)
+    : m_ThreadPool(iThreadPool),
+      m_GridSize(RoundUpToPowerOfTwo(std::clamp(iGridSize, 16u, 1024u))),
+      m_PaddedSize(2 * m_GridSize),
+      m_Fft(m_PaddedSize)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PmSolver::ComputeAccelerations(
+    const std::vector<CloudVertex> &iStars,
+    const Settings &iSettings,
+    std::vector<glm::vec4> &oAccelerations)
+{
+    // Bounding box of the valid stars, per chunk then merged.
+    const size_t nbChunks = static_cast<size_t>(m_ThreadPool.GetSize()) * 4;
+    const size_t chunkSize = (iStars.size() + nbChunks - 1) / nbChunks;
+    std::vector<glm::vec3> chunkMin(nbChunks, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> chunkMax(nbChunks, glm::vec3(std::numeric_limits<float>::lowest()));
+    m_ThreadPool.ParallelFor(
+        0,
+        nbChunks,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t chunk = iBegin; chunk < iEnd; ++chunk)
+            {
+                const size_t end = std::min(iStars.size(), (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                {
+                    if (!IsValid(iStars[i].Pos))
+                        continue;
+                    chunkMin[chunk] = glm::min(chunkMin[chunk], iStars[i].Pos);
+                    chunkMax[chunk] = glm::max(chunkMax[chunk], iStars[i].Pos);
+                }
+            }
+        },
+        1);
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    for (size_t chunk = 0; chunk < nbChunks; ++chunk)
+    {
+        min = glm::min(min, chunkMin[chunk]);
+        max = glm::max(max, chunkMax[chunk]);
+    }
+
+    // Stars with a NaN position get a NaN acceleration as in the shader.
+    oAccelerations.assign(iStars.size(), glm::vec4(std::numeric_limits<float>::quiet_NaN()));
+    if (min.x > max.x)
+        return;
+
+    if (UpdateGrid(min, max) || iSettings.SmoothLenght != m_SmoothLenght)
+    {
+        m_SmoothLenght = iSettings.SmoothLenght;
+        ComputeGreenFunction();
+    }
+
+    SortStarsBySlab(iStars);
+    DepositMass();
+
+    TransformGrid(m_Grid, false, m_GridSize);
+    m_ThreadPool.ParallelFor(
+        0,
+        m_Grid.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+                m_Grid[i] *= m_GreenFunction[i];
+        });
+    TransformGrid(m_Grid, true, m_GridSize);
+
+    ComputeGridAccelerations();
+    InterpolateAccelerations(iStars, oAccelerations);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool PmSolver::UpdateGrid(const glm::vec3 &iMin, const glm::vec3 &iMax)
+{
+    const glm::vec3 extent = iMax - iMin;
+    m_SlabAxis = extent.x >= extent.y ? (extent.x >= extent.z ? 0 : 2) : (extent.y >= extent.z ? 1 : 2);
+    const float maxExtent = extent[m_SlabAxis];
+
+    // Stars stay in [1, size - 3] in grid units: the cloud of a star covers two nodes along each axis, and the
+    // accelerations of the nodes are central differences of the potential.
+    const uint32_t usableCells = m_GridSize - 4;
+    if (m_CellSize > 0.f)
+    {
+        const glm::vec3 low = m_Origin + m_CellSize;
+        const glm::vec3 high = m_Origin + m_CellSize * static_cast<float>(m_GridSize - 3);
+        const bool inside = glm::all(glm::greaterThanEqual(iMin, low)) && glm::all(glm::lessThanEqual(iMax, high));
+        if (inside && maxExtent >= 0.5f * m_CellSize * static_cast<float>(usableCells))
+            return false;
+    }
+
+    // Margin so that the grid follows a slowly expanding galaxy for a while.
+    m_CellSize = std::max(1.25f * maxExtent, std::numeric_limits<float>::min()) / static_cast<float>(usableCells);
+    m_Origin = 0.5f * (iMin + iMax) - m_CellSize * 0.5f * static_cast<float>(m_GridSize - 2);
+    return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PmSolver::ComputeGreenFunction()
+{
+    // Potential of a unit mass whose attraction is 1 / (r^2 + s), as in acceleration.comp:
+    // phi(r) = (atan(r / sqrt(s)) - pi / 2) / sqrt(s). The grid cannot resolve less than a cell, the smoothing length
+    // is kept above half a cell so that the potential of the cell of the star stays finite.
+    const float smoothLenght = std::max(m_SmoothLenght, 0.25f * m_CellSize * m_CellSize);
+    const double sqrtSmooth = std::sqrt(static_cast<double>(smoothLenght));
+    const double halfPi = 0.5 * std::acos(-1.0);
+    const uint32_t size = m_PaddedSize;
+
+    std::vector<std::complex<float>> green(static_cast<size_t>(size) * size * size);
+    m_ThreadPool.ParallelFor(
+        0,
+        size,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t z = iBegin; z < iEnd; ++z)
+            {
+                for (uint32_t y = 0; y < size; ++y)
+                {
+                    for (uint32_t x = 0; x < size; ++x)
+                    {
+                        // Distances wrap around so that the potential is even on the padded grid.
+                        const glm::dvec3 cells(std::min<size_t>(x, size - x), std::min<size_t>(y, size - y), std::min<size_t>(z, size - z));
+                        const double distance = glm::length(cells) * m_CellSize;
+                        const double potential = (std::atan(distance / sqrtSmooth) - halfPi) / sqrtSmooth;
+                        green[(z * size + y) * size + x] = static_cast<float>(potential);
+                    }
+                }
+            }
+        },
+        1);
+
+    TransformGrid(green, false, size);
+
+    // The normalization of the inverse transform is folded in.
+    const float scale = 1.f / (static_cast<float>(size) * static_cast<float>(size) * static_cast<float>(size));
+    m_GreenFunction.resize(green.size());
+    for (size_t i = 0; i < green.size(); ++i)
+        m_GreenFunction[i] = green[i].real() * scale;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PmSolver::SortStarsBySlab(const std::vector<CloudVertex> &iStars)
+{
+    const size_t nbChunks = static_cast<size_t>(m_ThreadPool.GetSize()) * 4;
+    const size_t chunkSize = (iStars.size() + nbChunks - 1) / nbChunks;
+    const float originOnAxis = m_Origin[m_SlabAxis];
+    const float inverseCellSize = 1.f / m_CellSize;
+    auto getSlab = [&](const glm::vec3 &iPosition)
+    { return static_cast<uint32_t>((iPosition[m_SlabAxis] - originOnAxis) * inverseCellSize); };
+
+    m_SlabCounts.assign(nbChunks * m_GridSize, 0);
+    m_ThreadPool.ParallelFor(
+        0,
+        nbChunks,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t chunk = iBegin; chunk < iEnd; ++chunk)
+            {
+                uint32_t *counts = &m_SlabCounts[chunk * m_GridSize];
+                const size_t end = std::min(iStars.size(), (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                {
+                    if (IsValid(iStars[i].Pos))
+                        ++counts[getSlab(iStars[i].Pos)];
+                }
+            }
+        },
+        1);
+
+    // Counts become the first position of each chunk in each slab.
+    m_SlabStarts.resize(m_GridSize + 1);
+    uint32_t position = 0;
+    for (uint32_t slab = 0; slab < m_GridSize; ++slab)
+    {
+        m_SlabStarts[slab] = position;
+        for (size_t chunk = 0; chunk < nbChunks; ++chunk)
+        {
+            const uint32_t count = m_SlabCounts[chunk * m_GridSize + slab];
+            m_SlabCounts[chunk * m_GridSize + slab] = position;
+            position += count;
+        }
+    }
+    m_SlabStarts[m_GridSize] = position;
+
+    m_SortedPositions.resize(position);
+    m_ThreadPool.ParallelFor(
+        0,
+        nbChunks,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t chunk = iBegin; chunk < iEnd; ++chunk)
+            {
+                uint32_t *positions = &m_SlabCounts[chunk * m_GridSize];
+                const size_t end = std::min(iStars.size(), (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                {
+                    if (IsValid(iStars[i].Pos))
+                        m_SortedPositions[positions[getSlab(iStars[i].Pos)]++] =
+                            glm::vec4((iStars[i].Pos - m_Origin) * inverseCellSize, iStars[i].Mass);
+                }
+            }
+        },
+        1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PmSolver::DepositMass()
+{
+    const size_t size = m_GridSize;
+    m_Mass.assign(size * size * size, 0.f);
+
+    // The stars of a slab write to the nodes of two slabs: even slabs are deposited in parallel, then odd ones.
+    for (uint32_t parity = 0; parity < 2; ++parity)
+    {
+        m_ThreadPool.ParallelFor(
+            0,
+            m_GridSize / 2,
+            [&](size_t iBegin, size_t iEnd)
+            {
+                for (size_t slab = 2 * iBegin + parity; slab < 2 * iEnd; slab += 2)
+                {
+                    for (uint32_t star = m_SlabStarts[slab]; star < m_SlabStarts[slab + 1]; ++star)
+                    {
+                        const glm::vec3 position(m_SortedPositions[star]);
+                        const float mass = m_SortedPositions[star].w;
+                        const glm::vec3 cell = glm::floor(position);
+                        const glm::vec3 weight = position - cell;
+                        float *node = &m_Mass[(static_cast<size_t>(cell.z) * size + static_cast<size_t>(cell.y)) * size + static_cast<size_t>(cell.x)];
+                        const float wx0 = 1.f - weight.x;
+                        const float wy0 = 1.f - weight.y;
+                        const float wz0 = mass * (1.f - weight.z);
+                        const float wz1 = mass * weight.z;
+                        node[0] += wx0 * wy0 * wz0;
+                        node[1] += weight.x * wy0 * wz0;
+                        node[size] += wx0 * weight.y * wz0;
+                        node[size + 1] += weight.x * weight.y * wz0;
+                        node[size * size] += wx0 * wy0 * wz1;
+                        node[size * size + 1] += weight.x * wy0 * wz1;
+                        node[size * size + size] += wx0 * weight.y * wz1;
+                        node[size * size + size + 1] += weight.x * weight.y * wz1;
+                    }
+                }
+            },
+            1);
+    }
+
+    // Copy to the padded grid, zero outside of the grid.
+    const size_t padded = m_PaddedSize;
+    m_Grid.resize(padded * padded * padded);
+    m_ThreadPool.ParallelFor(
+        0,
+        padded,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t z = iBegin; z < iEnd; ++z)
+            {
+                for (size_t y = 0; y < padded; ++y)
+                {
+                    std::complex<float> *line = &m_Grid[(z * padded + y) * padded];
+                    size_t x = 0;
+                    if (z < size && y < size)
+                    {
+                        for (; x < size; ++x)
+                            line[x] = m_Mass[(z * size + y) * size + x];
+                    }
+                    std::fill(line + x, line + padded, std::complex<float>(0.f));
+                }
+            }
+        },
+        1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PmSolver::TransformGrid(std::vector<std::complex<float>> &ioGrid, bool iInverse, uint32_t iExtent)
+{
+    const size_t size = m_PaddedSize;
+    const size_t nbBatches = size / NB_BATCHED_LINES;
+
+    // Lines along x are contiguous.
+    auto transformX = [&]()
+    {
+        m_ThreadPool.ParallelFor(
+            0,
+            static_cast<size_t>(iExtent) * iExtent,
+            [&](size_t iBegin, size_t iEnd)
+            {
+                for (size_t line = iBegin; line < iEnd; ++line)
+                {
+                    const size_t z = line / iExtent;
+                    const size_t y = line % iExtent;
+                    m_Fft.Transform(&ioGrid[(z * size + y) * size], iInverse);
+                }
+            });
+    };
+
+    // Lines along y and z are copied in batches of neighbouring lines.
+    auto transformStrided = [&](size_t iNbPlanes, size_t iPlaneStride, size_t iStride)
+    {
+        m_ThreadPool.ParallelFor(
+            0,
+            iNbPlanes * nbBatches,
+            [&](size_t iBegin, size_t iEnd)
+            {
+                std::vector<std::complex<float>> lines(NB_BATCHED_LINES * size);
+                for (size_t batch = iBegin; batch < iEnd; ++batch)
+                {
+                    const size_t first = (batch / nbBatches) * iPlaneStride + (batch % nbBatches) * NB_BATCHED_LINES;
+                    for (size_t i = 0; i < size; ++i)
+                    {
+                        for (size_t line = 0; line < NB_BATCHED_LINES; ++line)
+                            lines[line * size + i] = ioGrid[first + i * iStride + line];
+                    }
+                    for (size_t line = 0; line < NB_BATCHED_LINES; ++line)
+                        m_Fft.Transform(&lines[line * size], iInverse);
+                    for (size_t i = 0; i < size; ++i)
+                    {
+                        for (size_t line = 0; line < NB_BATCHED_LINES; ++line)
+                            ioGrid[first + i * iStride + line] = lines[line * size + i];
+                    }
+                }
+            });
+    };
+    auto transformY = [&]() { transformStrided(iExtent, size * size, size); };
+    auto transformZ = [&]() { transformStrided(size, size, size * size); };
+
+    if (iInverse)
+    {
+        transformZ();
+        transformY();
+        transformX();
+    }
+    else
+    {
+        transformX();
+        transformY();
+        transformZ();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PmSolver::ComputeGridAccelerations()
+{
+    const size_t size = m_GridSize;
+    const size_t padded = m_PaddedSize;
+    const float scale = -0.5f / m_CellSize;
+    m_GridAccelerations.assign(size * size * size, glm::vec3(0.f));
+
+    // Only the nodes reached by the clouds of the stars are needed, [1, size - 2] along each axis.
+    m_ThreadPool.ParallelFor(
+        1,
+        size - 1,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            auto potential = [&](size_t iX, size_t iY, size_t iZ) { return m_Grid[(iZ * padded + iY) * padded + iX].real(); };
+            for (size_t z = iBegin; z < iEnd; ++z)
+            {
+                for (size_t y = 1; y < size - 1; ++y)
+                {
+                    for (size_t x = 1; x < size - 1; ++x)
+                    {
+                        m_GridAccelerations[(z * size + y) * size + x] = scale * glm::vec3(
+                            potential(x + 1, y, z) - potential(x - 1, y, z),
+                            potential(x, y + 1, z) - potential(x, y - 1, z),
+                            potential(x, y, z + 1) - potential(x, y, z - 1));
+                    }
+                }
+            }
+        },
+        1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PmSolver::InterpolateAccelerations(const std::vector<CloudVertex> &iStars, std::vector<glm::vec4> &oAccelerations)
+{
+    // Stars are read in their order, the grid is small enough to stay in cache.
+    const size_t size = m_GridSize;
+    const float inverseCellSize = 1.f / m_CellSize;
+    m_ThreadPool.ParallelFor(
+        0,
+        iStars.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                if (!IsValid(iStars[i].Pos))
+                    continue;
+                const glm::vec3 position = (iStars[i].Pos - m_Origin) * inverseCellSize;
+                const glm::vec3 cell = glm::floor(position);
+                const glm::vec3 weight = position - cell;
+                const glm::vec3 *node = &m_GridAccelerations[(static_cast<size_t>(cell.z) * size + static_cast<size_t>(cell.y)) * size + static_cast<size_t>(cell.x)];
+                const float wx0 = 1.f - weight.x;
+                const float wy0 = 1.f - weight.y;
+                const float wz0 = 1.f - weight.z;
+                const glm::vec3 acc = wz0 * (wy0 * (wx0 * node[0] + weight.x * node[1]) +
+                                             weight.y * (wx0 * node[size] + weight.x * node[size + 1])) +
+                                      weight.z * (wy0 * (wx0 * node[size * size] + weight.x * node[size * size + 1]) +
+                                                  weight.y * (wx0 * node[size * size + size] + weight.x * node[size * size + size + 1]));
+                oAccelerations[i] = glm::vec4(acc, 0.f);
+            }
+        });
+}
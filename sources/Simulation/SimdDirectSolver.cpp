@@ -0,0 +1,341 @@
+#include "Simulation/SimdDirectSolver.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GALAXY_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace
+{
+/// Number of sources kept in the L1 cache while the targets of a chunk are processed.
+constexpr size_t TILE_SIZE = 2048;
+/// The sources are padded to a multiple of the widest vector.
+constexpr size_t PADDING = 16;
+
+/// Sums the attraction of the sources [0, iCount) on a star.
+using Kernel = glm::vec3 (*)(const float *iX, const float *iY, const float *iZ, const float *iMass, size_t iCount, glm::vec3 iPos, float iSmoothLenght);
+
+//----------------------------------------------------------------------------------------------------------------------
+glm::vec3 KernelScalar(const float *iX, const float *iY, const float *iZ, const float *iMass, size_t iCount, glm::vec3 iPos, float iSmoothLenght)
+{
+    glm::vec3 acc(0.f);
+    for (size_t i = 0; i < iCount; ++i)
+    {
+        const glm::vec3 vector(iX[i] - iPos.x, iY[i] - iPos.y, iZ[i] - iPos.z);
+        const float distance2 = glm::dot(vector, vector);
+        const float norm = distance2 + iSmoothLenght;
+        if (distance2 == 0.f || norm == 0.f)
+            continue;
+        acc += vector * (iMass[i] / (std::sqrt(distance2) * norm));
+    }
+    return acc;
+}
+
+#ifdef GALAXY_X86_SIMD
+//----------------------------------------------------------------------------------------------------------------------
+__attribute__((target("sse2"))) float HorizontalSum(__m128 iValue)
+{
+    __m128 shuffled = _mm_shuffle_ps(iValue, iValue, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(iValue, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__attribute__((target("sse2"))) glm::vec3 KernelSse(const float *iX, const float *iY, const float *iZ, const float *iMass, size_t iCount, glm::vec3 iPos, float iSmoothLenght)
+{
+    const __m128 posX = _mm_set1_ps(iPos.x);
+    const __m128 posY = _mm_set1_ps(iPos.y);
+    const __m128 posZ = _mm_set1_ps(iPos.z);
+    const __m128 smooth = _mm_set1_ps(iSmoothLenght);
+    const __m128 tiny = _mm_set1_ps(std::numeric_limits<float>::min());
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 two = _mm_set1_ps(2.f);
+
+    __m128 accX = zero, accY = zero, accZ = zero;
+    for (size_t i = 0; i < iCount; i += 4)
+    {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(iX + i), posX);
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(iY + i), posY);
+        const __m128 dz = _mm_sub_ps(_mm_loadu_ps(iZ + i), posZ);
+        const __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        // 1 / distance and 1 / norm, estimates refined by one Newton-Raphson step.
+        const __m128 d2 = _mm_max_ps(distance2, tiny);
+        __m128 invDistance = _mm_rsqrt_ps(d2);
+        invDistance = _mm_mul_ps(invDistance, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, d2), _mm_mul_ps(invDistance, invDistance))));
+        const __m128 norm = _mm_max_ps(_mm_add_ps(distance2, smooth), tiny);
+        __m128 invNorm = _mm_rcp_ps(norm);
+        invNorm = _mm_mul_ps(invNorm, _mm_sub_ps(two, _mm_mul_ps(norm, invNorm)));
+
+        // The star itself, and the sources at the same position, have no effect.
+        const __m128 mass = _mm_and_ps(_mm_loadu_ps(iMass + i), _mm_cmpgt_ps(distance2, zero));
+        const __m128 scale = _mm_mul_ps(mass, _mm_mul_ps(invDistance, invNorm));
+        accX = _mm_add_ps(accX, _mm_mul_ps(scale, dx));
+        accY = _mm_add_ps(accY, _mm_mul_ps(scale, dy));
+        accZ = _mm_add_ps(accZ, _mm_mul_ps(scale, dz));
+    }
+    return glm::vec3(HorizontalSum(accX), HorizontalSum(accY), HorizontalSum(accZ));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__attribute__((target("avx2,fma"))) float HorizontalSum(__m256 iValue)
+{
+    return HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(iValue), _mm256_extractf128_ps(iValue, 1)));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__attribute__((target("avx2,fma"))) glm::vec3 KernelAvx2(const float *iX, const float *iY, const float *iZ, const float *iMass, size_t iCount, glm::vec3 iPos, float iSmoothLenght)
+{
+    const __m256 posX = _mm256_set1_ps(iPos.x);
+    const __m256 posY = _mm256_set1_ps(iPos.y);
+    const __m256 posZ = _mm256_set1_ps(iPos.z);
+    const __m256 smooth = _mm256_set1_ps(iSmoothLenght);
+    const __m256 tiny = _mm256_set1_ps(std::numeric_limits<float>::min());
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 two = _mm256_set1_ps(2.f);
+
+    __m256 accX = zero, accY = zero, accZ = zero;
+    for (size_t i = 0; i < iCount; i += 8)
+    {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(iX + i), posX);
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(iY + i), posY);
+        const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(iZ + i), posZ);
+        const __m256 distance2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+
+        const __m256 d2 = _mm256_max_ps(distance2, tiny);
+        __m256 invDistance = _mm256_rsqrt_ps(d2);
+        invDistance = _mm256_mul_ps(invDistance, _mm256_fnmadd_ps(_mm256_mul_ps(half, d2), _mm256_mul_ps(invDistance, invDistance), threeHalves));
+        const __m256 norm = _mm256_max_ps(_mm256_add_ps(distance2, smooth), tiny);
+        __m256 invNorm = _mm256_rcp_ps(norm);
+        invNorm = _mm256_mul_ps(invNorm, _mm256_fnmadd_ps(norm, invNorm, two));
+
+        const __m256 mass = _mm256_and_ps(_mm256_loadu_ps(iMass + i), _mm256_cmp_ps(distance2, zero, _CMP_GT_OQ));
+        const __m256 scale = _mm256_mul_ps(mass, _mm256_mul_ps(invDistance, invNorm));
+        accX = _mm256_fmadd_ps(scale, dx, accX);
+        accY = _mm256_fmadd_ps(scale, dy, accY);
+        accZ = _mm256_fmadd_ps(scale, dz, accZ);
+    }
+    return glm::vec3(HorizontalSum(accX), HorizontalSum(accY), HorizontalSum(accZ));
+}
+
+// GCC 12 warns about the intentionally undefined registers of the AVX-512 intrinsics (GCC bug 105593).
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+//----------------------------------------------------------------------------------------------------------------------
+__attribute__((target("avx512f"))) glm::vec3 KernelAvx512(const float *iX, const float *iY, const float *iZ, const float *iMass, size_t iCount, glm::vec3 iPos, float iSmoothLenght)
+{
+    const __m512 posX = _mm512_set1_ps(iPos.x);
+    const __m512 posY = _mm512_set1_ps(iPos.y);
+    const __m512 posZ = _mm512_set1_ps(iPos.z);
+    const __m512 smooth = _mm512_set1_ps(iSmoothLenght);
+    const __m512 tiny = _mm512_set1_ps(std::numeric_limits<float>::min());
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+    const __m512 two = _mm512_set1_ps(2.f);
+
+    __m512 accX = zero, accY = zero, accZ = zero;
+    for (size_t i = 0; i < iCount; i += 16)
+    {
+        const __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(iX + i), posX);
+        const __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(iY + i), posY);
+        const __m512 dz = _mm512_sub_ps(_mm512_loadu_ps(iZ + i), posZ);
+        const __m512 distance2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+
+        const __m512 d2 = _mm512_max_ps(distance2, tiny);
+        __m512 invDistance = _mm512_rsqrt14_ps(d2);
+        invDistance = _mm512_mul_ps(invDistance, _mm512_fnmadd_ps(_mm512_mul_ps(half, d2), _mm512_mul_ps(invDistance, invDistance), threeHalves));
+        const __m512 norm = _mm512_max_ps(_mm512_add_ps(distance2, smooth), tiny);
+        __m512 invNorm = _mm512_rcp14_ps(norm);
+        invNorm = _mm512_mul_ps(invNorm, _mm512_fnmadd_ps(norm, invNorm, two));
+
+        const __mmask16 isOther = _mm512_cmp_ps_mask(distance2, zero, _CMP_GT_OQ);
+        const __m512 mass = _mm512_maskz_mov_ps(isOther, _mm512_loadu_ps(iMass + i));
+        const __m512 scale = _mm512_mul_ps(mass, _mm512_mul_ps(invDistance, invNorm));
+        accX = _mm512_fmadd_ps(scale, dx, accX);
+        accY = _mm512_fmadd_ps(scale, dy, accY);
+        accZ = _mm512_fmadd_ps(scale, dz, accZ);
+    }
+    return glm::vec3(_mm512_reduce_add_ps(accX), _mm512_reduce_add_ps(accY), _mm512_reduce_add_ps(accZ));
+}
+#pragma GCC diagnostic pop
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+Kernel GetKernel(SimdDirectSolver::InstructionSet iInstructionSet)
+{
+    switch (iInstructionSet)
+    {
+#ifdef GALAXY_X86_SIMD
+    case SimdDirectSolver::InstructionSet::Avx512:
+        return KernelAvx512;
+    case SimdDirectSolver::InstructionSet::Avx2:
+        return KernelAvx2;
+    case SimdDirectSolver::InstructionSet::Sse:
+        return KernelSse;
+#endif
+    default:
+        return KernelScalar;
+    }
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+SimdDirectSolver::SimdDirectSolver(ThreadPool &iThreadPool)
+    : m_ThreadPool(iThreadPool),
+      m_InstructionSet(DetectInstructionSet())
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+SimdDirectSolver::InstructionSet SimdDirectSolver::DetectInstructionSet()
+{
+#ifdef GALAXY_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return InstructionSet::Avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return InstructionSet::Avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return InstructionSet::Sse;
+#endif
+    return InstructionSet::Scalar;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SimdDirectSolver::SetInstructionSet(InstructionSet iInstructionSet)
+{
+    m_InstructionSet = std::min(iInstructionSet, DetectInstructionSet());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+const char *SimdDirectSolver::GetName() const
+{
+    switch (m_InstructionSet)
+    {
+    case InstructionSet::Avx512:
+        return "direct-simd (avx512)";
+    case InstructionSet::Avx2:
+        return "direct-simd (avx2)";
+    case InstructionSet::Sse:
+        return "direct-simd (sse)";
+    default:
+        return "direct-simd (scalar)";
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SimdDirectSolver::CopySources(const std::vector<CloudVertex> &iStars, const SourceSampling &iSampling)
+{
+    const size_t blackHoleSize = (iSampling.NbBlackHoles + PADDING - 1) / PADDING * PADDING;
+    const size_t paddedSize = blackHoleSize + (iSampling.NbSources + PADDING - 1) / PADDING * PADDING;
+    m_X.assign(paddedSize, 0.f);
+    m_Y.assign(paddedSize, 0.f);
+    m_Z.assign(paddedSize, 0.f);
+    m_Mass.assign(paddedSize, 0.f);
+
+    const auto copySource = [&](size_t iSource, size_t iStar, float iMassScale)
+    {
+        // The last sources of a rotating step may be past the stars, they stay massless.
+        if (iStar >= iStars.size())
+            return;
+        const glm::vec3 &pos = iStars[iStar].Pos;
+        // NaN sources are skipped by the shader, here they become massless sources at the origin.
+        if (std::isnan(pos.x) || std::isnan(pos.y) || std::isnan(pos.z))
+            return;
+        m_X[iSource] = pos.x;
+        m_Y[iSource] = pos.y;
+        m_Z[iSource] = pos.z;
+        m_Mass[iSource] = iStars[iStar].Mass * iMassScale;
+    };
+
+    // The scale is staged with the masses, as the shaders do: without sampled source it is never applied, even
+    // infinite with fixed sources and a null interaction rate.
+    for (uint32_t i = 0; i < iSampling.NbBlackHoles; ++i)
+        copySource(i, i, 1.f);
+    m_ThreadPool.ParallelFor(
+        0,
+        iSampling.NbSources,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t source = iBegin; source < iEnd; ++source)
+                copySource(
+                    blackHoleSize + source, iSampling.GetStar(static_cast<uint32_t>(source)), iSampling.MassScale);
+        });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SimdDirectSolver::ComputeAccelerations(
+    const std::vector<CloudVertex> &iStars,
+    const Settings &iSettings,
+    std::vector<glm::vec4> &oAccelerations)
+{
+    oAccelerations.resize(iStars.size());
+    SumAccelerations(iStars, iSettings, nullptr, iStars.size(), oAccelerations);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SimdDirectSolver::ComputeTargetAccelerations(
+    const std::vector<CloudVertex> &iStars,
+    const Settings &iSettings,
+    const std::vector<uint32_t> &iTargets,
+    std::vector<glm::vec4> &ioAccelerations)
+{
+    SumAccelerations(iStars, iSettings, iTargets.data(), iTargets.size(), ioAccelerations);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SimdDirectSolver::SumAccelerations(
+    const std::vector<CloudVertex> &iStars,
+    const Settings &iSettings,
+    const uint32_t *iTargets,
+    size_t iNbTargets,
+    std::vector<glm::vec4> &ioAccelerations)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const SourceSampling sampling = GetSourceSampling(
+        static_cast<uint32_t>(iStars.size()), iSettings.NbBlackHoles, iSettings.InteractionRate, iSettings.RotateSources, iSettings.StepIndex);
+    CopySources(iStars, sampling);
+
+    const Kernel kernel = GetKernel(m_InstructionSet);
+    const size_t paddedSize = m_X.size();
+    const auto getStar = [&](size_t iTarget) -> size_t { return iTargets != nullptr ? iTargets[iTarget] : iTarget; };
+
+    m_ThreadPool.ParallelFor(
+        0,
+        iNbTargets,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            // The black holes and the sources, their masses scaled, are summed alike.
+            std::vector<glm::vec3> acc(iEnd - iBegin, glm::vec3(0.f));
+            for (size_t tile = 0; tile < paddedSize; tile += TILE_SIZE)
+            {
+                const size_t count = std::min(TILE_SIZE, paddedSize - tile);
+                for (size_t target = iBegin; target < iEnd; ++target)
+                {
+                    acc[target - iBegin] += kernel(
+                        m_X.data() + tile, m_Y.data() + tile, m_Z.data() + tile, m_Mass.data() + tile,
+                        count, iStars[getStar(target)].Pos, iSettings.SmoothLenght);
+                }
+            }
+            for (size_t target = iBegin; target < iEnd; ++target)
+                ioAccelerations[getStar(target)] = glm::vec4(acc[target - iBegin], 0.f);
+        },
+        64);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    m_InteractionsPerSecond = seconds > 0.0 ? static_cast<double>(iNbTargets) * static_cast<double>(sampling.NbBlackHoles + sampling.NbSources) / seconds : 0.0;
+}
@@ -0,0 +1,199 @@
+#include "Simulation/SpatialGrid.h"
+#include <algorithm>
+
+namespace
+{
+/// Largest cell coordinate, the cells further away are clamped to it.
+constexpr float MAX_CELL = static_cast<float>(1 << 30);
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+SpatialGrid::SpatialGrid(ThreadPool &iThreadPool)
+    : m_ThreadPool(iThreadPool)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+glm::ivec3 SpatialGrid::GetCell(const glm::vec3 &iPos) const
+{
+    return glm::ivec3(glm::clamp(glm::floor(iPos * m_InvCellSize), glm::vec3(-MAX_CELL), glm::vec3(MAX_CELL)));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGrid::Build(const std::vector<CloudVertex> &iStars, float iCellSize)
+{
+    m_CellSize = iCellSize > 0.f ? iCellSize : 1.f;
+    m_InvCellSize = 1.f / m_CellSize;
+    m_NbStars = static_cast<uint32_t>(iStars.size());
+
+    uint32_t tableSize = 1;
+    while (tableSize < m_NbStars)
+        tableSize <<= 1;
+    m_Mask = tableSize - 1;
+    if (m_NbCounters != tableSize)
+    {
+        m_Counters = std::make_unique<std::atomic<uint32_t>[]>(tableSize);
+        m_NbCounters = tableSize;
+    }
+
+    m_StarBuckets.resize(m_NbStars);
+    m_ThreadPool.ParallelFor(
+        0,
+        m_NbStars,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                const glm::vec3 &pos = iStars[i].Pos;
+                m_StarBuckets[i] = glm::any(glm::isnan(pos)) ? tableSize : Hash(GetCell(pos), m_Mask);
+            }
+        });
+
+    CountBuckets();
+    Scatter(iStars);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGrid::CountBuckets()
+{
+    const size_t tableSize = m_NbCounters;
+    m_ThreadPool.ParallelFor(
+        0,
+        tableSize,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+                m_Counters[i].store(0, std::memory_order_relaxed);
+        });
+    m_ThreadPool.ParallelFor(
+        0,
+        m_NbStars,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                if (m_StarBuckets[i] < tableSize)
+                    m_Counters[m_StarBuckets[i]].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+
+    // Exclusive scan of the counts: the sum of each range of buckets, then the ranges from the start of their sum.
+    const size_t nbChunks = std::max<size_t>(1, std::min<size_t>(tableSize, m_ThreadPool.GetSize() * 4));
+    const size_t chunkSize = (tableSize + nbChunks - 1) / nbChunks;
+    std::vector<uint32_t> chunkStarts(nbChunks, 0);
+    m_ThreadPool.ParallelFor(
+        0,
+        nbChunks,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t chunk = iBegin; chunk < iEnd; ++chunk)
+            {
+                const size_t end = std::min(tableSize, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                    chunkStarts[chunk] += m_Counters[i].load(std::memory_order_relaxed);
+            }
+        },
+        1);
+
+    uint32_t nbSorted = 0;
+    for (uint32_t &start : chunkStarts)
+    {
+        const uint32_t count = start;
+        start = nbSorted;
+        nbSorted += count;
+    }
+
+    m_BucketStarts.resize(tableSize + 1);
+    m_BucketStarts[tableSize] = nbSorted;
+    m_ThreadPool.ParallelFor(
+        0,
+        nbChunks,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t chunk = iBegin; chunk < iEnd; ++chunk)
+            {
+                uint32_t start = chunkStarts[chunk];
+                const size_t end = std::min(tableSize, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                {
+                    const uint32_t count = m_Counters[i].load(std::memory_order_relaxed);
+                    // The counter becomes the next free slot of the bucket.
+                    m_BucketStarts[i] = start;
+                    m_Counters[i].store(start, std::memory_order_relaxed);
+                    start += count;
+                }
+            }
+        },
+        1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGrid::Scatter(const std::vector<CloudVertex> &iStars)
+{
+    const size_t tableSize = m_NbCounters;
+    m_SortedIndices.resize(m_BucketStarts[tableSize]);
+    m_SortedStars.resize(m_BucketStarts[tableSize]);
+    m_ThreadPool.ParallelFor(
+        0,
+        m_NbStars,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                if (m_StarBuckets[i] < tableSize)
+                    m_SortedIndices[m_Counters[m_StarBuckets[i]].fetch_add(1, std::memory_order_relaxed)] =
+                        static_cast<uint32_t>(i);
+            }
+        });
+
+    // The threads filled the buckets in any order: a few stars by bucket are sorted back, so the build is deterministic.
+    m_ThreadPool.ParallelFor(
+        0,
+        tableSize,
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t bucket = iBegin; bucket < iEnd; ++bucket)
+            {
+                auto first = m_SortedIndices.begin() + m_BucketStarts[bucket];
+                auto last = m_SortedIndices.begin() + m_BucketStarts[bucket + 1];
+                std::sort(first, last);
+                for (auto it = first; it != last; ++it)
+                    m_SortedStars[it - m_SortedIndices.begin()] = glm::vec4(iStars[*it].Pos, iStars[*it].Mass);
+            }
+        });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<uint32_t> SpatialGrid::CountNeighbors(float iRadius) const
+{
+    std::vector<uint32_t> counts(m_NbStars, 0);
+    m_ThreadPool.ParallelFor(
+        0,
+        m_SortedStars.size(),
+        [&](size_t iBegin, size_t iEnd)
+        {
+            for (size_t i = iBegin; i < iEnd; ++i)
+            {
+                // The star finds itself at a distance of 0.
+                uint32_t count = 0;
+                ForEachNeighbor(glm::vec3(m_SortedStars[i]), iRadius, [&](uint32_t, const glm::vec4 &, float) { ++count; });
+                counts[m_SortedIndices[i]] = count > 0 ? count - 1 : 0;
+            }
+        });
+    return counts;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+NeighborReport SummarizeNeighbors(const std::vector<uint32_t> &iCounts)
+{
+    NeighborReport report;
+    for (uint32_t count : iCounts)
+    {
+        // Each pair is counted from both of its stars.
+        report.NbPairs += count;
+        report.NbStarsWithNeighbors += count > 0 ? 1 : 0;
+        report.MaxNeighbors = std::max(report.MaxNeighbors, count);
+    }
+    report.NbPairs /= 2;
+    return report;
+}
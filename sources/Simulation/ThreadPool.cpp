@@ -0,0 +1,107 @@
+#include "Simulation/ThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+/// True while the thread runs chunks of a loop, to run nested loops serially.
+thread_local bool t_InsideLoop = false;
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+ThreadPool::ThreadPool(uint32_t iNbThreads)
+{
+    if (iNbThreads == 0)
+        iNbThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    m_Workers.reserve(iNbThreads - 1);
+    for (uint32_t i = 1; i < iNbThreads; ++i)
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_StartCondition.notify_all();
+
+    for (std::thread &worker : m_Workers)
+        worker.join();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ThreadPool::ParallelFor(size_t iBegin, size_t iEnd, const Task &iTask, size_t iGrainSize)
+{
+    if (iBegin >= iEnd)
+        return;
+
+    const size_t count = iEnd - iBegin;
+    if (iGrainSize == 0)
+        iGrainSize = std::max<size_t>(1, count / (static_cast<size_t>(GetSize()) * 8));
+
+    const size_t nbChunks = (count + iGrainSize - 1) / iGrainSize;
+    if (m_Workers.empty() || nbChunks == 1 || t_InsideLoop)
+    {
+        iTask(iBegin, iEnd);
+        return;
+    }
+
+    std::lock_guard<std::mutex> loopLock(m_LoopMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Task = &iTask;
+        m_Begin = iBegin;
+        m_End = iEnd;
+        m_GrainSize = iGrainSize;
+        m_NbChunks = nbChunks;
+        m_NextChunk = 0;
+        m_NbBusyWorkers = static_cast<uint32_t>(m_Workers.size());
+        ++m_Generation;
+    }
+    m_StartCondition.notify_all();
+
+    RunChunks();
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this]() { return m_NbBusyWorkers == 0; });
+    m_Task = nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ThreadPool::WorkerLoop()
+{
+    uint64_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_StartCondition.wait(lock, [&]() { return m_Stop || m_Generation != generation; });
+            if (m_Stop)
+                return;
+            generation = m_Generation;
+        }
+
+        RunChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            --m_NbBusyWorkers;
+        }
+        m_DoneCondition.notify_one();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ThreadPool::RunChunks()
+{
+    t_InsideLoop = true;
+    for (size_t chunk = m_NextChunk.fetch_add(1); chunk < m_NbChunks; chunk = m_NextChunk.fetch_add(1))
+    {
+        const size_t begin = m_Begin + chunk * m_GrainSize;
+        const size_t end = std::min(begin + m_GrainSize, m_End);
+        (*m_Task)(begin, end);
+    }
+    t_InsideLoop = false;
+}
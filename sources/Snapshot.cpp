@@ -0,0 +1,244 @@
+#include "Snapshot.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+/// Header of a snapshot file, followed by the stars.
+/// Fixed-size fields only: the file is read back by mapping, on a machine of the same endianness.
+struct SnapshotHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    /// Offset of the first star in the file.
+    uint32_t HeaderSize;
+    uint64_t NbStars;
+    /// Size of a star record, sizeof(CloudVertex).
+    uint32_t VertexSize;
+    /// Bit 0: tiled acceleration shader. Bit 2: adaptive step. Bit 3: fixed sources. Bit 4: fused leapfrog pass.
+    /// Bits 16 to 31: number of black holes of a merger, its first stars.
+    uint32_t Flags;
+
+    float Diameter;
+    float Thickness;
+    float StarsSpeed;
+    float BlackHoleMass;
+
+    float Step;
+    float SmoothingLenght;
+    float InteractionRate;
+    /// Time steps by frame, 0 in the files written before it was saved.
+    uint32_t Substeps;
+};
+static_assert(sizeof(SnapshotHeader) == 64, "The header keeps the stars aligned on 32 bytes");
+static_assert(sizeof(CloudVertex) == 32, "Snapshots store the stars as they are in the vertex buffer");
+
+constexpr char Magic[8] = {'G', 'A', 'L', 'A', 'X', 'Y', 'S', 'N'};
+constexpr uint32_t TiledAccelerationFlag = 1;
+/// Flag 2 marked the split passes when the fused pass was the default. It is ignored: the split passes are the
+/// default again, and the files without FusedLeapfrogFlag load with them.
+/// The accuracy of the adaptive step is not saved, it takes its default value.
+constexpr uint32_t AdaptiveStepFlag = 4;
+/// Set for the fixed gravity sources, so the files written before the rotating sources load with the default.
+constexpr uint32_t FixedSourcesFlag = 8;
+/// Set for the fused leapfrog pass.
+constexpr uint32_t FusedLeapfrogFlag = 16;
+/// The number of black holes is in the high half of the flags, 0 in the files written before it was saved.
+constexpr uint32_t NbBlackHolesShift = 16;
+constexpr uint32_t MaxNbBlackHoles = 0xffff;
+/// Version of the files whose stars have no mass, 0 in the place of the mass.
+constexpr uint32_t MasslessVersion = 1;
+/// Last version of the files whose stars have no Id, 0 in the place of the Id.
+constexpr uint32_t WithoutIdVersion = 2;
+
+//----------------------------------------------------------------------------------------------------------------------
+std::runtime_error SnapshotError(const std::filesystem::path &iPath, const std::string &iMessage)
+{
+    return std::runtime_error("snapshot " + iPath.string() + ": " + iMessage);
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+void Snapshot::Save(
+    const std::filesystem::path &iPath,
+    const CloudVertex *iStars,
+    uint32_t iNbStars,
+    uint32_t iNbBlackHoles,
+    const Menu::GalaxyParameters &iGalaxy,
+    const Menu::RealTimeParameters &iRealTime)
+{
+    if (iNbBlackHoles > MaxNbBlackHoles)
+        throw SnapshotError(iPath, "too many black holes");
+
+    SnapshotHeader header{};
+    std::memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = Version;
+    header.HeaderSize = sizeof(SnapshotHeader);
+    header.NbStars = iNbStars;
+    header.VertexSize = sizeof(CloudVertex);
+    header.Flags = (iGalaxy.TiledAcceleration ? TiledAccelerationFlag : 0) |
+                   (iGalaxy.FusedLeapfrog ? FusedLeapfrogFlag : 0) |
+                   (iRealTime.AdaptiveStep ? AdaptiveStepFlag : 0) |
+                   (iRealTime.RotateSources ? 0 : FixedSourcesFlag) |
+                   iNbBlackHoles << NbBlackHolesShift;
+    header.Diameter = iGalaxy.Diameter;
+    header.Thickness = iGalaxy.Thickness;
+    header.StarsSpeed = iGalaxy.StarsSpeed;
+    header.BlackHoleMass = iGalaxy.BlackHoleMass;
+    header.Step = iRealTime.Step;
+    header.SmoothingLenght = iRealTime.SmoothingLenght;
+    header.InteractionRate = iRealTime.InteractionRate;
+    header.Substeps = static_cast<uint32_t>(iRealTime.Substeps);
+
+    std::ofstream file(iPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw SnapshotError(iPath, "cannot be created");
+
+    // The stars are large enough to bypass the buffer of the stream: a single write to the file.
+    file.write(reinterpret_cast<const char *>(&header), sizeof(SnapshotHeader));
+    file.write(reinterpret_cast<const char *>(iStars), static_cast<std::streamsize>(sizeof(CloudVertex)) * iNbStars);
+    file.close();
+    if (!file)
+        throw SnapshotError(iPath, "write failed");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+Snapshot::Snapshot(const std::filesystem::path &iPath)
+{
+#ifdef _WIN32
+    m_File = CreateFileW(
+        iPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE)
+    {
+        m_File = nullptr;
+        throw SnapshotError(iPath, "cannot be opened");
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(m_File, &size);
+    m_Size = static_cast<size_t>(size.QuadPart);
+    if (m_Size >= sizeof(SnapshotHeader))
+    {
+        m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_Mapping)
+            m_Data = MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    int file = open(iPath.c_str(), O_RDONLY);
+    if (file < 0)
+        throw SnapshotError(iPath, "cannot be opened");
+    struct stat status;
+    if (fstat(file, &status) == 0)
+        m_Size = static_cast<size_t>(status.st_size);
+    if (m_Size >= sizeof(SnapshotHeader))
+    {
+        m_Data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (m_Data == MAP_FAILED)
+            m_Data = nullptr;
+        else
+        {
+            // The whole file is read once, in order, by the upload.
+            madvise(m_Data, m_Size, MADV_SEQUENTIAL);
+            madvise(m_Data, m_Size, MADV_WILLNEED);
+        }
+    }
+    close(file);
+#endif
+
+    if (!m_Data)
+    {
+        Unmap();
+        throw SnapshotError(iPath, m_Size < sizeof(SnapshotHeader) ? "too small" : "cannot be mapped");
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, m_Data, sizeof(SnapshotHeader));
+    std::string error;
+    if (std::memcmp(header.Magic, Magic, sizeof(Magic)) != 0)
+        error = "not a galaxy snapshot";
+    else if (header.Version < MasslessVersion || header.Version > Version)
+        error = "version " + std::to_string(header.Version) + ", expected " + std::to_string(Version);
+    else if (header.VertexSize != sizeof(CloudVertex) || header.HeaderSize < sizeof(SnapshotHeader) ||
+             header.NbStars > UINT32_MAX ||
+             m_Size < header.HeaderSize + header.NbStars * sizeof(CloudVertex))
+        error = "corrupted header or truncated file";
+    if (!error.empty())
+    {
+        Unmap();
+        throw SnapshotError(iPath, error);
+    }
+
+    m_Stars = reinterpret_cast<const CloudVertex *>(static_cast<const char *>(m_Data) + header.HeaderSize);
+    m_NbStars = static_cast<uint32_t>(header.NbStars);
+    if (header.Version <= WithoutIdVersion)
+    {
+        m_ConvertedStars.assign(m_Stars, m_Stars + m_NbStars);
+        for (uint32_t id = 0; id < m_NbStars; ++id)
+        {
+            // The stars were never reordered: the index is the Id.
+            m_ConvertedStars[id].Id = id;
+            if (header.Version == MasslessVersion)
+                m_ConvertedStars[id].Mass = 1.f;
+        }
+        // The copy replaces the mapping.
+        Unmap();
+        m_Stars = m_ConvertedStars.data();
+        m_NbStars = static_cast<uint32_t>(m_ConvertedStars.size());
+    }
+
+    m_NbBlackHoles = std::min(header.Flags >> NbBlackHolesShift, m_NbStars);
+    m_GalaxyParameters.NbStars = static_cast<int>(m_NbStars);
+    m_GalaxyParameters.Diameter = header.Diameter;
+    m_GalaxyParameters.Thickness = header.Thickness;
+    m_GalaxyParameters.StarsSpeed = header.StarsSpeed;
+    m_GalaxyParameters.BlackHoleMass = header.BlackHoleMass;
+    m_GalaxyParameters.TiledAcceleration = (header.Flags & TiledAccelerationFlag) != 0;
+    m_GalaxyParameters.FusedLeapfrog = (header.Flags & FusedLeapfrogFlag) != 0;
+    m_RealTimeParameters.Step = header.Step;
+    m_RealTimeParameters.SmoothingLenght = header.SmoothingLenght;
+    m_RealTimeParameters.InteractionRate = header.InteractionRate;
+    m_RealTimeParameters.Substeps = header.Substeps > 0 ? static_cast<int>(header.Substeps) : 1;
+    m_RealTimeParameters.AdaptiveStep = (header.Flags & AdaptiveStepFlag) != 0;
+    m_RealTimeParameters.RotateSources = (header.Flags & FixedSourcesFlag) == 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+Snapshot::~Snapshot()
+{
+    Unmap();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Snapshot::Unmap()
+{
+#ifdef _WIN32
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping)
+        CloseHandle(m_Mapping);
+    if (m_File)
+        CloseHandle(m_File);
+    m_Mapping = nullptr;
+    m_File = nullptr;
+#else
+    if (m_Data)
+        munmap(m_Data, m_Size);
+#endif
+    m_Data = nullptr;
+    m_Stars = nullptr;
+    m_NbStars = 0;
+}
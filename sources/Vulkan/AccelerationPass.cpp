@@ -12,19 +12,23 @@ void AccelerationPass::Destroy()
 void AccelerationPass::Create(
     VkDescriptorPool &iDescriptorPool,
     const VkCloud &iGalaxy,
-    const olp::UniformBuffer &iOptions)
+    const olp::UniformBuffer &iOptions,
+    const olp::UniformBuffer &iStepOptions,
+    const olp::MemoryBuffer &iStepState,
+    Kernel iKernel)
 {
+    m_Kernel = iKernel;
     VkDeviceSize nbPoint = iGalaxy.GetSize();
     CreatePipelineLayout();
     CreateBuffers(nbPoint);
-    CreateDescriptor(iDescriptorPool, iGalaxy, iOptions);
-    ComputePass::Create("acceleration", nbPoint);
+    CreateDescriptor(iDescriptorPool, iGalaxy, iOptions, iStepOptions, iStepState);
+    ComputePass::Create(m_Kernel == Kernel::Tiled ? "acceleration_tiled" : "acceleration", nbPoint);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void AccelerationPass::CreatePipelineLayout()
 {
-    std::vector<VkDescriptorSetLayoutBinding> descriptorBinding(3);
+    std::vector<VkDescriptorSetLayoutBinding> descriptorBinding(5);
 
     // Position storage buffer.
     descriptorBinding[0].binding = 0;
@@ -47,6 +51,20 @@ void AccelerationPass::CreatePipelineLayout()
     descriptorBinding[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
     descriptorBinding[2].pImmutableSamplers = nullptr;
 
+    // Step options
+    descriptorBinding[3].binding = 3;
+    descriptorBinding[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorBinding[3].descriptorCount = 1;
+    descriptorBinding[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[3].pImmutableSamplers = nullptr;
+
+    // Step state storage buffer, written.
+    descriptorBinding[4].binding = 4;
+    descriptorBinding[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[4].descriptorCount = 1;
+    descriptorBinding[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[4].pImmutableSamplers = nullptr;
+
     m_PipelineLayout.Create(descriptorBinding);
 }
 
@@ -56,29 +74,45 @@ void AccelerationPass::CreateBuffers(VkDeviceSize iNbPoint)
     VkDeviceSize bufferSize = sizeof(glm::vec4) * iNbPoint;
     m_AccelerationBuffer = m_Device.CreateMemoryBuffer(
         bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void AccelerationPass::CreateDescriptor(
-    VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy, const olp::UniformBuffer &iOptions)
+    VkDescriptorPool &iDescriptorPool,
+    const VkCloud &iGalaxy,
+    const olp::UniformBuffer &iOptions,
+    const olp::UniformBuffer &iStepOptions,
+    const olp::MemoryBuffer &iStepState)
 {
-    m_DescriptorSet.AllocateDescriptorSets(m_PipelineLayout.GetDescriptorLayout(), iDescriptorPool);
-    //Vertex Buffer of the galaxy
-    VkDescriptorBufferInfo vertexBufferInfo{};
-    vertexBufferInfo.buffer = iGalaxy.GetVertexBuffer().Buffer;
-    vertexBufferInfo.offset = 0;
-    vertexBufferInfo.range = iGalaxy.GetVertexBuffer().Size;
-
     // Acceleration buffer
     VkDescriptorBufferInfo accelerationBufferInfo{};
     accelerationBufferInfo.buffer = m_AccelerationBuffer.Buffer;
     accelerationBufferInfo.offset = 0;
     accelerationBufferInfo.range = m_AccelerationBuffer.Size;
 
-    m_DescriptorSet.AddWriteDescriptor(0, vertexBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-    m_DescriptorSet.AddWriteDescriptor(1, accelerationBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-    m_DescriptorSet.AddWriteDescriptor(2, iOptions);
-    m_DescriptorSet.UpdateDescriptorSets();
+    // Step state
+    VkDescriptorBufferInfo stepStateInfo{};
+    stepStateInfo.buffer = iStepState.Buffer;
+    stepStateInfo.offset = 0;
+    stepStateInfo.range = iStepState.Size;
+
+    for (uint32_t source = 0; source < m_DescriptorSets.size(); ++source)
+    {
+        olp::DescriptorSet &descriptorSet = m_DescriptorSets[source];
+        descriptorSet.AllocateDescriptorSets(m_PipelineLayout.GetDescriptorLayout(), iDescriptorPool);
+        //Vertex Buffer of the galaxy holding the current stars
+        VkDescriptorBufferInfo vertexBufferInfo{};
+        vertexBufferInfo.buffer = iGalaxy.GetVertexBuffer(source).Buffer;
+        vertexBufferInfo.offset = 0;
+        vertexBufferInfo.range = iGalaxy.GetVertexBuffer(source).Size;
+
+        descriptorSet.AddWriteDescriptor(0, vertexBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(1, accelerationBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(2, iOptions);
+        descriptorSet.AddWriteDescriptor(3, iStepOptions);
+        descriptorSet.AddWriteDescriptor(4, stepStateInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.UpdateDescriptorSets();
+    }
 }
@@ -2,13 +2,16 @@
 #include "Vulkan/ComputePass.h"
 #include "Olympus/Debug.h"
 #include "Olympus/Shader.h"
+#include <algorithm>
+#include <array>
 #include <cmath>
 
 //----------------------------------------------------------------------------------------------------------------------
 ComputePass::ComputePass(const olp::Device &iDevice)
     : m_Device(iDevice),
       m_PipelineLayout(iDevice),
-      m_DescriptorSet(iDevice)
+      m_DescriptorSets{olp::DescriptorSet(iDevice), olp::DescriptorSet(iDevice)},
+      m_Timer(iDevice)
 {
 }
 
@@ -20,15 +23,21 @@ void ComputePass::Destroy()
     vkDestroySemaphore(m_Device.GetDevice(), m_Semaphore, nullptr);
     vkDestroyCommandPool(m_Device.GetDevice(), m_CommandPool, nullptr);
     vkDestroyFence(m_Device.GetDevice(), m_Fence, nullptr);
+    m_Timer.Destroy();
 }
 //----------------------------------------------------------------------------------------------------------------------
 void ComputePass::Create(
     std::filesystem::path iShaderName,
-    VkDeviceSize iNbPoint)
+    VkDeviceSize iNbPoint,
+    uint32_t iNbSlots)
 {
+    const uint32_t nbSlots = std::max(iNbSlots, 1u);
     CreatePipeline(iShaderName);
-    CreateCommandPoolAndBuffer();
+    CreateCommandPoolAndBuffer(nbSlots);
     CreateSemaphore();
+    m_Timer.Create(m_Device.GetQueueIndices().computeFamily.value(), nbSlots, 2);
+    m_SlotsSubmitted.assign(nbSlots, false);
+    m_GpuTime = 0.f;
     BuildCommandBuffer(iNbPoint);
 }
 
@@ -57,7 +66,7 @@ void ComputePass::CreatePipeline(std::filesystem::path iShaderName)
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void ComputePass::CreateCommandPoolAndBuffer()
+void ComputePass::CreateCommandPoolAndBuffer(uint32_t iNbSlots)
 {
     olp::Device::QueueFamilyIndices queueFamilyIndices = m_Device.GetQueueIndices();
     VkCommandPoolCreateInfo cmdPoolInfo{};
@@ -67,15 +76,19 @@ void ComputePass::CreateCommandPoolAndBuffer()
     VK_CHECK_RESULT(
         vkCreateCommandPool(m_Device.GetDevice(), &cmdPoolInfo, nullptr, &m_CommandPool))
 
-    // Create a command buffer for compute operations
-    VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
-    cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdBufAllocateInfo.commandPool = m_CommandPool;
-    cmdBufAllocateInfo.commandBufferCount = 1;
-    cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-
-    VK_CHECK_RESULT(vkAllocateCommandBuffers(
-        m_Device.GetDevice(), &cmdBufAllocateInfo, &m_CommandBuffer))
+    // Create the command buffers for compute operations, for each slot
+    m_CommandBuffers.resize(iNbSlots);
+    for (std::array<VkCommandBuffer, 2> &slotCommandBuffers : m_CommandBuffers)
+    {
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
+        cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdBufAllocateInfo.commandPool = m_CommandPool;
+        cmdBufAllocateInfo.commandBufferCount = static_cast<uint32_t>(slotCommandBuffers.size());
+        cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(
+            m_Device.GetDevice(), &cmdBufAllocateInfo, slotCommandBuffers.data()))
+    }
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -97,45 +110,91 @@ void ComputePass::CreateSemaphore()
 //----------------------------------------------------------------------------------------------------------------------
 void ComputePass::BuildCommandBuffer(VkDeviceSize iNbPoint)
 {
-    VkCommandBufferBeginInfo cmdBufInfo{};
-    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    VK_CHECK_RESULT(vkBeginCommandBuffer(m_CommandBuffer, &cmdBufInfo))
-    vkCmdBindPipeline(m_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+    m_NbGroups = static_cast<uint32_t>(std::ceil(static_cast<double>(iNbPoint) / 256.0));
+
+    // A slot is submitted again once its previous submission is done: no simultaneous use.
+    for (uint32_t slot = 0; slot < m_CommandBuffers.size(); ++slot)
+    {
+        for (uint32_t source = 0; source < m_CommandBuffers[slot].size(); ++source)
+        {
+            VkCommandBuffer commandBuffer = m_CommandBuffers[slot][source];
+            VkCommandBufferBeginInfo cmdBufInfo{};
+            cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo))
+            m_Timer.Reset(commandBuffer, slot);
+            // In the stage waiting for the semaphore of the submission, so the time waited is not counted.
+            m_Timer.Write(commandBuffer, slot, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+            RecordDispatch(commandBuffer, source);
+
+            m_Timer.Write(commandBuffer, slot, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+            vkEndCommandBuffer(commandBuffer);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ComputePass::RecordDispatch(VkCommandBuffer iCommandBuffer, uint32_t iSource)
+{
+    vkCmdBindPipeline(iCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
     // Bind descriptor here.
     vkCmdBindDescriptorSets(
-        m_CommandBuffer,
+        iCommandBuffer,
         VK_PIPELINE_BIND_POINT_COMPUTE,
         m_PipelineLayout.GetLayout(),
         0,
         1,
-        &m_DescriptorSet.GetDescriptorSet(),
+        &m_DescriptorSets[iSource].GetDescriptorSet(),
         0,
         nullptr);
 
-    uint32_t x = static_cast<uint32_t>(std::ceil(static_cast<double>(iNbPoint) / 256.0));
-
-    vkCmdDispatch(m_CommandBuffer, x, 1, 1);
+    vkCmdDispatch(iCommandBuffer, m_NbGroups, 1, 1);
+}
 
-    vkEndCommandBuffer(m_CommandBuffer);
+//----------------------------------------------------------------------------------------------------------------------
+void ComputePass::Process(
+    uint32_t iSource,
+    VkSemaphore iWaitSemaphore,
+    VkSemaphore iSignalSemaphore,
+    VkCommandBuffer iFollowingCommandBuffer)
+{
+    vkResetFences(m_Device.GetDevice(), 1, &m_Fence);
+    if (iSignalSemaphore != VK_NULL_HANDLE)
+        Submit(0, iSource, iWaitSemaphore, {iSignalSemaphore}, m_Fence, iFollowingCommandBuffer);
+    else
+        Submit(0, iSource, iWaitSemaphore, {}, m_Fence, iFollowingCommandBuffer);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void ComputePass::Process(VkSemaphore iWaitSemaphore, VkSemaphore iSignalSemaphore)
+void ComputePass::Submit(
+    uint32_t iSlot,
+    uint32_t iSource,
+    VkSemaphore iWaitSemaphore,
+    std::initializer_list<VkSemaphore> iSignalSemaphores,
+    VkFence iFence,
+    VkCommandBuffer iFollowingCommandBuffer)
 {
+    // Timestamps of the previous submission of the slot, done before the slot is reused.
+    std::vector<float> gpuTime;
+    if (m_SlotsSubmitted[iSlot] && m_Timer.Read(iSlot, gpuTime))
+        m_GpuTime = gpuTime.front();
+    m_SlotsSubmitted[iSlot] = true;
+
     // Wait for rendering finished
     VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const std::array<VkCommandBuffer, 2> commandBuffers{m_CommandBuffers[iSlot][iSource], iFollowingCommandBuffer};
     // Submit compute commands
     VkSubmitInfo computeSubmitInfo{};
     computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    computeSubmitInfo.commandBufferCount = 1;
-    computeSubmitInfo.pCommandBuffers = &m_CommandBuffer;
-    computeSubmitInfo.waitSemaphoreCount = 1;
+    computeSubmitInfo.commandBufferCount = iFollowingCommandBuffer != VK_NULL_HANDLE ? 2 : 1;
+    computeSubmitInfo.pCommandBuffers = commandBuffers.data();
+    computeSubmitInfo.waitSemaphoreCount = iWaitSemaphore != VK_NULL_HANDLE ? 1 : 0;
     computeSubmitInfo.pWaitSemaphores = &iWaitSemaphore;
     computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
-    computeSubmitInfo.signalSemaphoreCount = 1;
-    computeSubmitInfo.pSignalSemaphores = &iSignalSemaphore;
-    vkResetFences(m_Device.GetDevice(), 1, &m_Fence);
-    VK_CHECK_RESULT(vkQueueSubmit(m_Device.GetComputeQueue(), 1, &computeSubmitInfo, m_Fence))
+    computeSubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(iSignalSemaphores.size());
+    computeSubmitInfo.pSignalSemaphores = iSignalSemaphores.begin();
+    VK_CHECK_RESULT(vkQueueSubmit(m_Device.GetComputeQueue(), 1, &computeSubmitInfo, iFence))
 }
 
 void ComputePass::WaitFence()
@@ -0,0 +1,425 @@
+#include "Vulkan/GpuSimulation.h"
+#include "Olympus/Debug.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+//----------------------------------------------------------------------------------------------------------------------
+GpuSimulation::GpuSimulation(const olp::Instance &iInstance)
+    : m_Device(iInstance, VK_NULL_HANDLE),
+      m_AccelerationPass(m_Device),
+      m_IntegrationPass(m_Device),
+      m_LeapfrogPass(m_Device),
+      m_ReductionPass(m_Device),
+      m_GridPass(m_Device),
+      m_ReorderPass(m_Device),
+      m_Recorder(m_Device)
+{
+    CreateUniformBuffers();
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    for (VkFence &fence : m_StepFences)
+        VK_CHECK_RESULT(vkCreateFence(m_Device.GetDevice(), &fenceInfo, nullptr, &fence))
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::ReleaseResources()
+{
+    ReleaseGalaxy();
+    m_UniformBuffers.Acceleration.Destroy();
+    m_UniformBuffers.Displacement.Destroy();
+    for (VkFence fence : m_StepFences)
+        vkDestroyFence(m_Device.GetDevice(), fence, nullptr);
+    m_Device.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::InitializeGalaxy(
+    const std::vector<CloudVertex> &iStars,
+    float iBlackHoleMass,
+    AccelerationPass::Kernel iAccelerationKernel,
+    IntegrationPass::Scheme iScheme,
+    uint32_t iNbBlackHoles)
+{
+    InitializeGalaxy(
+        iStars.data(), static_cast<uint32_t>(iStars.size()), iBlackHoleMass, iAccelerationKernel, iScheme, iNbBlackHoles);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::InitializeGalaxy(
+    const CloudVertex *iStars,
+    uint32_t iNbStars,
+    float iBlackHoleMass,
+    AccelerationPass::Kernel iAccelerationKernel,
+    IntegrationPass::Scheme iScheme,
+    uint32_t iNbBlackHoles)
+{
+    CreateDescriptorPool();
+
+    VkCloud &galaxy = m_Clouds.emplace_back(m_Device);
+    galaxy.Init(iStars, iNbStars);
+
+    m_AccelerationInfo.NbPoint = galaxy.GetSize();
+    m_DisplacementInfo.NbPoint = m_AccelerationInfo.NbPoint;
+    m_AccelerationInfo.BlackHoleMass = iBlackHoleMass;
+    m_AccelerationInfo.NbBlackHoles = std::min(iNbBlackHoles, iNbStars);
+    m_OptionsChanged = true;
+    m_PendingStep = false;
+    m_StepsSinceReorder = 0;
+    m_Scheme = iScheme;
+
+    m_StepState = IntegrationPass::CreateStepStateBuffer(m_Device);
+
+    m_AccelerationPass.Create(
+        m_DescriptorPool,
+        galaxy,
+        m_UniformBuffers.Acceleration,
+        m_UniformBuffers.Displacement,
+        m_StepState,
+        iAccelerationKernel);
+
+    m_IntegrationPass.Create(
+        m_DescriptorPool,
+        galaxy,
+        m_UniformBuffers.Displacement,
+        m_AccelerationPass.GetAccelerationBuffer(),
+        m_StepState);
+
+    // A slot for each step in flight, see Step.
+    m_LeapfrogPass.Create(
+        m_DescriptorPool,
+        galaxy,
+        m_UniformBuffers.Acceleration,
+        m_UniformBuffers.Displacement,
+        m_StepState,
+        static_cast<uint32_t>(m_StepFences.size()));
+
+    m_ReductionPass.Create(m_DescriptorPool, galaxy, m_UniformBuffers.Acceleration);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::ReleaseGalaxy()
+{
+    m_Recorder.Stop();
+
+    if (m_Clouds.empty())
+        return;
+
+    vkDeviceWaitIdle(m_Device.GetDevice());
+
+    if (m_GridPass.IsCreated())
+        m_GridPass.Destroy();
+    if (m_ReorderPass.IsCreated())
+        m_ReorderPass.Destroy();
+    m_ReductionPass.Destroy();
+    m_LeapfrogPass.Destroy();
+    m_IntegrationPass.Destroy();
+    m_AccelerationPass.Destroy();
+    m_StepState.Destroy();
+
+    vkDestroyDescriptorPool(m_Device.GetDevice(), m_DescriptorPool, nullptr);
+
+    for (VkCloud &c : m_Clouds)
+        c.Destroy();
+    m_Clouds.clear();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::CreateUniformBuffers()
+{
+    m_UniformBuffers.Displacement.Init(sizeof(IntegrationPass::Options), m_Device);
+    m_UniformBuffers.Acceleration.Init(sizeof(AccelerationPass::Options), m_Device);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::UpdateUniformBuffers()
+{
+    if (!m_OptionsChanged)
+        return;
+
+    // The buffers are read by the passes in flight.
+    Wait();
+    m_UniformBuffers.Displacement.SendData(&m_DisplacementInfo, sizeof(IntegrationPass::Options));
+    m_UniformBuffers.Acceleration.SendData(&m_AccelerationInfo, sizeof(AccelerationPass::Options));
+    m_OptionsChanged = false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::CreateDescriptorPool()
+{
+    VkDescriptorPoolSize uniformPoolSize{};
+    uniformPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uniformPoolSize.descriptorCount = 12; // (AccelerationInfo*3 + DisplacementInfo*3)*2
+
+    VkDescriptorPoolSize storageBufferPoolSize{};
+    storageBufferPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    // (Position Buffer*6 + Acceleration buffer*2 + Render buffer*2 + Step state*3 + Reduction*2)*2, the grid and the sort
+    storageBufferPoolSize.descriptorCount =
+        30 + SpatialGridPass::NbStorageDescriptors + ReorderPass::NbStorageDescriptors;
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{uniformPoolSize, storageBufferPoolSize};
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    // One set of each pass for each vertex buffer, the grid and the sort
+    poolInfo.maxSets = 8 + SpatialGridPass::NbDescriptorSets + ReorderPass::NbDescriptorSets;
+
+    VK_CHECK_RESULT(vkCreateDescriptorPool(m_Device.GetDevice(), &poolInfo, nullptr, &m_DescriptorPool))
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::Step()
+{
+    UpdateUniformBuffers();
+
+    VkCloud &galaxy = m_Clouds.front();
+    const bool fused = m_Scheme == IntegrationPass::Scheme::FusedLeapfrog;
+    // Signaled by the last pass of the previous step.
+    VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+    if (m_PendingStep)
+        waitSemaphore = fused ? m_LeapfrogPass.GetSemaphore() : m_IntegrationPass.GetSemaphore();
+
+    // Each step in flight has its slot of command buffers and timestamps in the leapfrog pass and in the sort, reused
+    // once the step submitted two steps before is done.
+    const uint32_t slot = static_cast<uint32_t>(m_NbSteps % m_StepFences.size());
+    ++m_NbSteps;
+    VkFence fence = m_StepFences[slot];
+    if (fused)
+    {
+        // Two steps are in flight: waiting for the previous one would leave the device idle until the next one is
+        // submitted.
+        vkWaitForFences(m_Device.GetDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(m_Device.GetDevice(), 1, &fence);
+    }
+
+    if (m_ReorderInterval > 0 && m_StepsSinceReorder >= m_ReorderInterval)
+    {
+        if (!m_ReorderPass.IsCreated())
+            m_ReorderPass.Create(
+                m_DescriptorPool, galaxy, m_AccelerationInfo.NbBlackHoles, static_cast<uint32_t>(m_StepFences.size()));
+        // Chained to the previous step and to this one by semaphores, the host does not wait. The step reads the
+        // sorted stars and writes the buffer the sort read.
+        m_ReorderPass.Submit(
+            slot, galaxy.GetCurrent(), {waitSemaphore}, {m_ReorderPass.GetSemaphore()}, VK_NULL_HANDLE);
+        galaxy.Advance(1);
+        waitSemaphore = m_ReorderPass.GetSemaphore();
+        m_StepsSinceReorder = 0;
+    }
+    ++m_StepsSinceReorder;
+
+    const uint32_t source = galaxy.GetCurrent();
+    if (fused)
+    {
+        // A single submission by step, chained to the previous one by the semaphore of the pass.
+        galaxy.Advance(1);
+        m_LeapfrogPass.Submit(
+            slot,
+            source,
+            waitSemaphore,
+            {m_LeapfrogPass.GetSemaphore()},
+            fence,
+            m_Recorder.NextStep());
+        m_PendingStep = true;
+        return;
+    }
+
+    // A pass is submitted again only once its previous submission is done, the fence of the pass is reused.
+    // The device still has the other pass queued, so it never idles.
+    m_AccelerationPass.WaitFence();
+    m_AccelerationPass.Process(source, waitSemaphore, m_AccelerationPass.GetSemaphore());
+
+    // The recorder copies the buffer the integration writes.
+    galaxy.Advance(1);
+    m_IntegrationPass.WaitFence();
+    m_IntegrationPass.Process(
+        source, m_AccelerationPass.GetSemaphore(), m_IntegrationPass.GetSemaphore(), m_Recorder.NextStep());
+    m_PendingStep = true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::StartRecording(const std::filesystem::path &iPath, uint32_t iInterval)
+{
+    m_Recorder.Start(iPath, m_Clouds.front(), iInterval);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::StopRecording()
+{
+    m_Recorder.Stop();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::ComputeAccelerations()
+{
+    UpdateUniformBuffers();
+    Wait();
+
+    m_AccelerationPass.Process(m_Clouds.front().GetCurrent(), VK_NULL_HANDLE, VK_NULL_HANDLE);
+    m_AccelerationPass.WaitFence();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::Integrate()
+{
+    UpdateUniformBuffers();
+    Wait();
+
+    VkCloud &galaxy = m_Clouds.front();
+    m_IntegrationPass.Process(galaxy.GetCurrent(), VK_NULL_HANDLE, VK_NULL_HANDLE);
+    galaxy.Advance(1);
+    m_IntegrationPass.WaitFence();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::Leapfrog()
+{
+    UpdateUniformBuffers();
+    Wait();
+
+    VkCloud &galaxy = m_Clouds.front();
+    m_LeapfrogPass.Process(galaxy.GetCurrent(), VK_NULL_HANDLE, VK_NULL_HANDLE);
+    galaxy.Advance(1);
+    m_LeapfrogPass.WaitFence();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::Reorder()
+{
+    Wait();
+
+    VkCloud &galaxy = m_Clouds.front();
+    if (!m_ReorderPass.IsCreated())
+        m_ReorderPass.Create(m_DescriptorPool, galaxy, m_AccelerationInfo.NbBlackHoles);
+    m_ReorderPass.Reorder(galaxy.GetCurrent());
+    galaxy.Advance(1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::Wait()
+{
+    vkDeviceWaitIdle(m_Device.GetDevice());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<CloudVertex> GpuSimulation::ReadStars()
+{
+    std::vector<CloudVertex> stars(GetSize());
+    ReadBuffer(m_Clouds.front().GetSyncedBuffer(), stars.data());
+    return stars;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::SaveSnapshot(
+    const std::filesystem::path &iPath,
+    const Menu::GalaxyParameters &iGalaxy,
+    const Menu::RealTimeParameters &iRealTime)
+{
+    Wait();
+
+    const VkCloud &galaxy = m_Clouds.front();
+    galaxy.ReadStars([&](const CloudVertex *iStars)
+                     { Snapshot::Save(iPath, iStars, galaxy.GetSize(), m_AccelerationInfo.NbBlackHoles, iGalaxy, iRealTime); });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<glm::vec4> GpuSimulation::ReadAccelerations()
+{
+    std::vector<glm::vec4> accelerations(GetSize());
+    ReadBuffer(m_AccelerationPass.GetAccelerationBuffer(), accelerations.data());
+    return accelerations;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+ReductionPass::Quantities GpuSimulation::ReduceQuantities()
+{
+    UpdateUniformBuffers();
+    Wait();
+
+    return m_ReductionPass.Reduce(m_Clouds.front().GetCurrent());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<uint32_t> GpuSimulation::CountNeighbors(float iRadius)
+{
+    Wait();
+    if (GetSize() == 0)
+        return {};
+
+    if (!m_GridPass.IsCreated())
+        m_GridPass.Create(m_DescriptorPool, m_Clouds.front());
+    m_GridPass.CountNeighbors(m_Clouds.front().GetCurrent(), iRadius);
+
+    std::vector<uint32_t> counts(GetSize());
+    ReadBuffer(m_GridPass.GetNeighborCounts(), counts.data());
+    return counts;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float GpuSimulation::ReadStep()
+{
+    IntegrationPass::StepState state;
+    ReadBuffer(m_StepState, &state);
+    return state.DriftStep;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::ReadBuffer(const olp::MemoryBuffer &iBuffer, void *oData)
+{
+    Wait();
+
+    olp::MemoryBuffer stagingBuffer = m_Device.CreateMemoryBuffer(
+        iBuffer.Size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer.CopyFrom(iBuffer.Buffer, iBuffer.Size);
+
+    void *data = nullptr;
+    VK_CHECK_RESULT(vkMapMemory(m_Device.GetDevice(), stagingBuffer.Memory, 0, iBuffer.Size, 0, &data))
+    std::memcpy(oData, data, static_cast<size_t>(iBuffer.Size));
+    vkUnmapMemory(m_Device.GetDevice(), stagingBuffer.Memory);
+
+    stagingBuffer.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::SetStep(float iStep)
+{
+    m_OptionsChanged |= m_DisplacementInfo.Step != iStep;
+    m_DisplacementInfo.Step = iStep;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::SetInteractionRate(float iInteractionRate)
+{
+    m_OptionsChanged |= m_AccelerationInfo.InteractionRate != iInteractionRate;
+    m_AccelerationInfo.InteractionRate = iInteractionRate;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::SetSmoothLenght(float iSmoothLenght)
+{
+    m_OptionsChanged |= m_AccelerationInfo.SmoothLenght != iSmoothLenght;
+    m_AccelerationInfo.SmoothLenght = iSmoothLenght;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::SetRotateSources(bool iRotateSources)
+{
+    const uint32_t rotate = iRotateSources ? 1 : 0;
+    m_OptionsChanged |= m_AccelerationInfo.RotateSources != rotate;
+    m_AccelerationInfo.RotateSources = rotate;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuSimulation::SetAdaptiveStep(bool iAdaptive, float iAccuracy)
+{
+    const uint32_t adaptive = iAdaptive ? 1 : 0;
+    m_OptionsChanged |= m_DisplacementInfo.AdaptiveStep != adaptive || m_DisplacementInfo.StepAccuracy != iAccuracy;
+    m_DisplacementInfo.AdaptiveStep = adaptive;
+    m_DisplacementInfo.StepAccuracy = iAccuracy;
+}
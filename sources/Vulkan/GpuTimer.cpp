@@ -0,0 +1,83 @@
+#include "Vulkan/GpuTimer.h"
+#include "Olympus/Debug.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+GpuTimer::GpuTimer(const olp::Device &iDevice)
+    : m_Device(iDevice)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuTimer::Create(uint32_t iQueueFamily, uint32_t iNbSlots, uint32_t iNbTimestamps)
+{
+    uint32_t nbFamilies = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_Device.GetPhysicalDevice(), &nbFamilies, nullptr);
+    std::vector<VkQueueFamilyProperties> families(nbFamilies);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_Device.GetPhysicalDevice(), &nbFamilies, families.data());
+
+    const uint32_t validBits = iQueueFamily < nbFamilies ? families[iQueueFamily].timestampValidBits : 0;
+    if (validBits == 0)
+        return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_Device.GetPhysicalDevice(), &properties);
+    m_Period = properties.limits.timestampPeriod;
+    m_Mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    m_NbTimestamps = iNbTimestamps;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = iNbSlots * iNbTimestamps;
+    VK_CHECK_RESULT(vkCreateQueryPool(m_Device.GetDevice(), &queryPoolInfo, nullptr, &m_QueryPool))
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuTimer::Destroy()
+{
+    vkDestroyQueryPool(m_Device.GetDevice(), m_QueryPool, nullptr);
+    m_QueryPool = VK_NULL_HANDLE;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuTimer::Reset(VkCommandBuffer iCommandBuffer, uint32_t iSlot)
+{
+    if (IsSupported())
+        vkCmdResetQueryPool(iCommandBuffer, m_QueryPool, iSlot * m_NbTimestamps, m_NbTimestamps);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void GpuTimer::Write(VkCommandBuffer iCommandBuffer, uint32_t iSlot, uint32_t iIndex, VkPipelineStageFlagBits iStage)
+{
+    if (IsSupported())
+        vkCmdWriteTimestamp(iCommandBuffer, iStage, m_QueryPool, iSlot * m_NbTimestamps + iIndex);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool GpuTimer::Read(uint32_t iSlot, std::vector<float> &oMilliseconds) const
+{
+    if (!IsSupported())
+        return false;
+
+    std::vector<uint64_t> timestamps(m_NbTimestamps);
+    // No wait flag: VK_NOT_READY instead of a stall if the submission is not done.
+    VkResult result = vkGetQueryPoolResults(
+        m_Device.GetDevice(),
+        m_QueryPool,
+        iSlot * m_NbTimestamps,
+        m_NbTimestamps,
+        timestamps.size() * sizeof(uint64_t),
+        timestamps.data(),
+        sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+        return false;
+
+    oMilliseconds.resize(m_NbTimestamps - 1);
+    for (uint32_t i = 0; i + 1 < m_NbTimestamps; ++i)
+    {
+        const uint64_t ticks = (timestamps[i + 1] - timestamps[i]) & m_Mask;
+        oMilliseconds[i] = static_cast<float>(ticks) * m_Period * 1e-6f;
+    }
+    return true;
+}
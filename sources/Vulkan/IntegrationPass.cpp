@@ -1,31 +1,59 @@
 #include "Vulkan/IntegrationPass.h"
+#include "Olympus/Debug.h"
 #include <glm/vec4.hpp>
 #include <glm/geometric.hpp>
+#include <cstring>
 //----------------------------------------------------------------------------------------------------------------------
 void IntegrationPass::Destroy()
 {
     ComputePass::Destroy();
 }
 
+//----------------------------------------------------------------------------------------------------------------------
+olp::MemoryBuffer IntegrationPass::CreateStepStateBuffer(const olp::Device &iDevice)
+{
+    VkDeviceSize bufferSize = sizeof(StepState);
+
+    olp::MemoryBuffer stagingBuffer = iDevice.CreateMemoryBuffer(
+        bufferSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    const StepState state{};
+    void *data = nullptr;
+    VK_CHECK_RESULT(vkMapMemory(iDevice.GetDevice(), stagingBuffer.Memory, 0, bufferSize, 0, &data))
+    std::memcpy(data, &state, sizeof(StepState));
+    vkUnmapMemory(iDevice.GetDevice(), stagingBuffer.Memory);
+
+    olp::MemoryBuffer stepState = iDevice.CreateMemoryBuffer(
+        bufferSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    stepState.CopyFrom(stagingBuffer.Buffer, bufferSize);
+    stagingBuffer.Destroy();
+    return stepState;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 void IntegrationPass::Create(
     VkDescriptorPool &iDescriptorPool,
     const VkCloud &iGalaxy,
     const olp::UniformBuffer &iOptions,
-    const olp::MemoryBuffer &iAccelerationBuffer)
+    const olp::MemoryBuffer &iAccelerationBuffer,
+    const olp::MemoryBuffer &iStepState)
 {
     VkDeviceSize nbPoint = iGalaxy.GetSize();
     CreatePipelineLayout();
-    CreateDescriptor(iDescriptorPool, iGalaxy, iOptions, iAccelerationBuffer);
+    CreateDescriptor(iDescriptorPool, iGalaxy, iOptions, iAccelerationBuffer, iStepState);
     ComputePass::Create("integration", nbPoint);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void IntegrationPass::CreatePipelineLayout()
 {
-    std::vector<VkDescriptorSetLayoutBinding> descriptorBinding(3);
+    std::vector<VkDescriptorSetLayoutBinding> descriptorBinding(6);
 
-    // Position storage buffer.
+    // Position storage buffer, read.
     descriptorBinding[0].binding = 0;
     descriptorBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     descriptorBinding[0].descriptorCount = 1;
@@ -46,28 +74,77 @@ void IntegrationPass::CreatePipelineLayout()
     descriptorBinding[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
     descriptorBinding[2].pImmutableSamplers = nullptr;
 
+    // Position storage buffer, written.
+    descriptorBinding[3].binding = 3;
+    descriptorBinding[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[3].descriptorCount = 1;
+    descriptorBinding[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[3].pImmutableSamplers = nullptr;
+
+    // Render vertex storage buffer, written.
+    descriptorBinding[4].binding = 4;
+    descriptorBinding[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[4].descriptorCount = 1;
+    descriptorBinding[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[4].pImmutableSamplers = nullptr;
+
+    // Step state storage buffer, read.
+    descriptorBinding[5].binding = 5;
+    descriptorBinding[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[5].descriptorCount = 1;
+    descriptorBinding[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[5].pImmutableSamplers = nullptr;
+
     m_PipelineLayout.Create(descriptorBinding);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void IntegrationPass::CreateDescriptor(
-    VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy, const olp::UniformBuffer &iOptions, const olp::MemoryBuffer &iAccelerationBuffer)
+    VkDescriptorPool &iDescriptorPool,
+    const VkCloud &iGalaxy,
+    const olp::UniformBuffer &iOptions,
+    const olp::MemoryBuffer &iAccelerationBuffer,
+    const olp::MemoryBuffer &iStepState)
 {
-    m_DescriptorSet.AllocateDescriptorSets(m_PipelineLayout.GetDescriptorLayout(), iDescriptorPool);
-    //Vertex Buffer of the galaxy
-    VkDescriptorBufferInfo vertexBufferInfo{};
-    vertexBufferInfo.buffer = iGalaxy.GetVertexBuffer().Buffer;
-    vertexBufferInfo.offset = 0;
-    vertexBufferInfo.range = iGalaxy.GetVertexBuffer().Size;
-
     // Acceleration buffer
     VkDescriptorBufferInfo accelerationBufferInfo{};
     accelerationBufferInfo.buffer = iAccelerationBuffer.Buffer;
     accelerationBufferInfo.offset = 0;
     accelerationBufferInfo.range = iAccelerationBuffer.Size;
 
-    m_DescriptorSet.AddWriteDescriptor(0, vertexBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-    m_DescriptorSet.AddWriteDescriptor(1, accelerationBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-    m_DescriptorSet.AddWriteDescriptor(2, iOptions);
-    m_DescriptorSet.UpdateDescriptorSets();
+    // Step state
+    VkDescriptorBufferInfo stepStateInfo{};
+    stepStateInfo.buffer = iStepState.Buffer;
+    stepStateInfo.offset = 0;
+    stepStateInfo.range = iStepState.Size;
+
+    for (uint32_t source = 0; source < m_DescriptorSets.size(); ++source)
+    {
+        olp::DescriptorSet &descriptorSet = m_DescriptorSets[source];
+        descriptorSet.AllocateDescriptorSets(m_PipelineLayout.GetDescriptorLayout(), iDescriptorPool);
+        //Vertex Buffer of the galaxy holding the current stars
+        VkDescriptorBufferInfo sourceBufferInfo{};
+        sourceBufferInfo.buffer = iGalaxy.GetVertexBuffer(source).Buffer;
+        sourceBufferInfo.offset = 0;
+        sourceBufferInfo.range = iGalaxy.GetVertexBuffer(source).Size;
+
+        //Other vertex buffer, receives the moved stars
+        VkDescriptorBufferInfo destinationBufferInfo{};
+        destinationBufferInfo.buffer = iGalaxy.GetVertexBuffer(1 - source).Buffer;
+        destinationBufferInfo.offset = 0;
+        destinationBufferInfo.range = iGalaxy.GetVertexBuffer(1 - source).Size;
+        //Render buffer of the other vertex buffer, receives the drawn stream
+        VkDescriptorBufferInfo renderBufferInfo{};
+        renderBufferInfo.buffer = iGalaxy.GetRenderBuffer(1 - source).Buffer;
+        renderBufferInfo.offset = 0;
+        renderBufferInfo.range = iGalaxy.GetRenderBuffer(1 - source).Size;
+
+        descriptorSet.AddWriteDescriptor(0, sourceBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(1, accelerationBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(2, iOptions);
+        descriptorSet.AddWriteDescriptor(3, destinationBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(4, renderBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(5, stepStateInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.UpdateDescriptorSets();
+    }
 }
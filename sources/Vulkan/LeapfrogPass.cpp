@@ -0,0 +1,117 @@
+#include "Vulkan/LeapfrogPass.h"
+//----------------------------------------------------------------------------------------------------------------------
+void LeapfrogPass::Destroy()
+{
+    ComputePass::Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LeapfrogPass::Create(
+    VkDescriptorPool &iDescriptorPool,
+    const VkCloud &iGalaxy,
+    const olp::UniformBuffer &iAccelerationOptions,
+    const olp::UniformBuffer &iIntegrationOptions,
+    const olp::MemoryBuffer &iStepState,
+    uint32_t iNbSlots)
+{
+    VkDeviceSize nbPoint = iGalaxy.GetSize();
+    CreatePipelineLayout();
+    CreateDescriptor(iDescriptorPool, iGalaxy, iAccelerationOptions, iIntegrationOptions, iStepState);
+    ComputePass::Create("leapfrog", nbPoint, iNbSlots);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LeapfrogPass::CreatePipelineLayout()
+{
+    std::vector<VkDescriptorSetLayoutBinding> descriptorBinding(6);
+
+    // Position storage buffer, read.
+    descriptorBinding[0].binding = 0;
+    descriptorBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[0].descriptorCount = 1;
+    descriptorBinding[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[0].pImmutableSamplers = nullptr;
+
+    // Position storage buffer, written.
+    descriptorBinding[1].binding = 1;
+    descriptorBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[1].descriptorCount = 1;
+    descriptorBinding[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[1].pImmutableSamplers = nullptr;
+
+    // Smoothing length, interaction rate and black hole
+    descriptorBinding[2].binding = 2;
+    descriptorBinding[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorBinding[2].descriptorCount = 1;
+    descriptorBinding[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[2].pImmutableSamplers = nullptr;
+
+    // Time step
+    descriptorBinding[3].binding = 3;
+    descriptorBinding[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorBinding[3].descriptorCount = 1;
+    descriptorBinding[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[3].pImmutableSamplers = nullptr;
+
+    // Render vertex storage buffer, written.
+    descriptorBinding[4].binding = 4;
+    descriptorBinding[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[4].descriptorCount = 1;
+    descriptorBinding[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[4].pImmutableSamplers = nullptr;
+
+    // Step state storage buffer, read and written.
+    descriptorBinding[5].binding = 5;
+    descriptorBinding[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[5].descriptorCount = 1;
+    descriptorBinding[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[5].pImmutableSamplers = nullptr;
+
+    m_PipelineLayout.Create(descriptorBinding);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LeapfrogPass::CreateDescriptor(
+    VkDescriptorPool &iDescriptorPool,
+    const VkCloud &iGalaxy,
+    const olp::UniformBuffer &iAccelerationOptions,
+    const olp::UniformBuffer &iIntegrationOptions,
+    const olp::MemoryBuffer &iStepState)
+{
+    // Step state
+    VkDescriptorBufferInfo stepStateInfo{};
+    stepStateInfo.buffer = iStepState.Buffer;
+    stepStateInfo.offset = 0;
+    stepStateInfo.range = iStepState.Size;
+
+    for (uint32_t source = 0; source < m_DescriptorSets.size(); ++source)
+    {
+        olp::DescriptorSet &descriptorSet = m_DescriptorSets[source];
+        descriptorSet.AllocateDescriptorSets(m_PipelineLayout.GetDescriptorLayout(), iDescriptorPool);
+        //Vertex Buffer of the galaxy holding the current stars
+        VkDescriptorBufferInfo sourceBufferInfo{};
+        sourceBufferInfo.buffer = iGalaxy.GetVertexBuffer(source).Buffer;
+        sourceBufferInfo.offset = 0;
+        sourceBufferInfo.range = iGalaxy.GetVertexBuffer(source).Size;
+
+        //Other vertex buffer, receives the moved stars
+        VkDescriptorBufferInfo destinationBufferInfo{};
+        destinationBufferInfo.buffer = iGalaxy.GetVertexBuffer(1 - source).Buffer;
+        destinationBufferInfo.offset = 0;
+        destinationBufferInfo.range = iGalaxy.GetVertexBuffer(1 - source).Size;
+
+        //Render buffer of the other vertex buffer, receives the drawn stream
+        VkDescriptorBufferInfo renderBufferInfo{};
+        renderBufferInfo.buffer = iGalaxy.GetRenderBuffer(1 - source).Buffer;
+        renderBufferInfo.offset = 0;
+        renderBufferInfo.range = iGalaxy.GetRenderBuffer(1 - source).Size;
+
+        descriptorSet.AddWriteDescriptor(0, sourceBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(1, destinationBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(2, iAccelerationOptions);
+        descriptorSet.AddWriteDescriptor(3, iIntegrationOptions);
+        descriptorSet.AddWriteDescriptor(4, renderBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(5, stepStateInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.UpdateDescriptorSets();
+    }
+}
@@ -0,0 +1,300 @@
+#include "Vulkan/RadixSort.h"
+#include "Olympus/Debug.h"
+#include "Olympus/Shader.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace
+{
+/// Bits sorted by a pass.
+constexpr uint32_t DigitBits = 8;
+/// Number of digits, and workgroup size of the shaders: an invocation by digit in the scan.
+constexpr uint32_t Radix = 1u << DigitBits;
+static_assert(RadixSort::KeysPerBlock == Radix * 16, "KEYS_PER_THREAD keys by invocation in the shaders");
+
+/// Offsets of the fields of the state buffer, same layout as the State of the shaders.
+constexpr VkDeviceSize NbKeysOffset = 0;
+constexpr VkDeviceSize ShiftOffset = 4;
+constexpr VkDeviceSize NbBlocksOffset = 8;
+constexpr VkDeviceSize KeyWordsOffset = 12;
+constexpr VkDeviceSize StateSize = 16;
+
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t GetNbBlocks(uint32_t iNbKeys)
+{
+    return (iNbKeys + RadixSort::KeysPerBlock - 1) / RadixSort::KeysPerBlock;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// Records a barrier between two commands of the sort.
+void RecordBarrier(
+    VkCommandBuffer iCommandBuffer,
+    VkPipelineStageFlags iSrcStage,
+    VkAccessFlags iSrcAccess,
+    VkPipelineStageFlags iDstStage,
+    VkAccessFlags iDstAccess)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = iSrcAccess;
+    barrier.dstAccessMask = iDstAccess;
+    vkCmdPipelineBarrier(iCommandBuffer, iSrcStage, iDstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+RadixSort::RadixSort(const olp::Device &iDevice)
+    : m_Device(iDevice),
+      m_PipelineLayout(iDevice),
+      m_DescriptorSets{olp::DescriptorSet(iDevice), olp::DescriptorSet(iDevice)},
+      m_Timer(iDevice)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void RadixSort::Create(
+    VkDescriptorPool &iDescriptorPool,
+    const olp::MemoryBuffer &iKeys,
+    const olp::MemoryBuffer &iValues,
+    uint32_t iMaxNbKeys,
+    KeySize iKeySize)
+{
+    m_KeySize = iKeySize;
+    CreatePipelineLayout();
+    m_HistogramPipeline = CreatePipeline("radix_histogram");
+    m_ScanPipeline = CreatePipeline("radix_scan");
+    m_ScatterPipeline = CreatePipeline("radix_scatter");
+    CreateBuffers(iMaxNbKeys);
+    CreateDescriptors(iDescriptorPool, iKeys, iValues);
+    CreateCommandBuffer();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void RadixSort::Destroy()
+{
+    vkDestroyFence(m_Device.GetDevice(), m_Fence, nullptr);
+    vkDestroyCommandPool(m_Device.GetDevice(), m_CommandPool, nullptr);
+    m_Fence = VK_NULL_HANDLE;
+    m_CommandPool = VK_NULL_HANDLE;
+    m_CommandBuffer = VK_NULL_HANDLE;
+    m_Timer.Destroy();
+
+    m_TemporaryValues.Destroy();
+    m_TemporaryKeys.Destroy();
+    m_HistogramBuffer.Destroy();
+    m_StateBuffer.Destroy();
+
+    vkDestroyPipeline(m_Device.GetDevice(), m_ScatterPipeline, nullptr);
+    vkDestroyPipeline(m_Device.GetDevice(), m_ScanPipeline, nullptr);
+    vkDestroyPipeline(m_Device.GetDevice(), m_HistogramPipeline, nullptr);
+    m_ScatterPipeline = VK_NULL_HANDLE;
+    m_ScanPipeline = VK_NULL_HANDLE;
+    m_HistogramPipeline = VK_NULL_HANDLE;
+    m_PipelineLayout.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void RadixSort::CreatePipelineLayout()
+{
+    // State, keys and values read, keys and values written, histogram: storage buffers only.
+    std::vector<VkDescriptorSetLayoutBinding> descriptorBinding(6);
+    for (uint32_t binding = 0; binding < descriptorBinding.size(); ++binding)
+    {
+        descriptorBinding[binding].binding = binding;
+        descriptorBinding[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorBinding[binding].descriptorCount = 1;
+        descriptorBinding[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        descriptorBinding[binding].pImmutableSamplers = nullptr;
+    }
+
+    m_PipelineLayout.Create(descriptorBinding);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+VkPipeline RadixSort::CreatePipeline(const std::filesystem::path &iShaderName) const
+{
+    olp::Shader shader(m_Device);
+    std::filesystem::path shaderPath = GALAXY_SHADERS / iShaderName;
+    shaderPath += "_comp.spv";
+    shader.Load(shaderPath);
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo{};
+    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStageInfo.module = shader.GetShaderModule();
+    shaderStageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.layout = m_PipelineLayout.GetLayout();
+    pipelineCreateInfo.stage = shaderStageInfo;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(
+        vkCreateComputePipelines(m_Device.GetDevice(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline))
+    return pipeline;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void RadixSort::CreateBuffers(uint32_t iMaxNbKeys)
+{
+    const uint32_t maxNbKeys = std::max(iMaxNbKeys, 1u);
+    const VkDeviceSize keySize = sizeof(uint32_t) * static_cast<uint32_t>(m_KeySize);
+
+    m_StateBuffer = m_Device.CreateMemoryBuffer(
+        StateSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_HistogramBuffer = m_Device.CreateMemoryBuffer(
+        sizeof(uint32_t) * Radix * GetNbBlocks(maxNbKeys),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_TemporaryKeys = m_Device.CreateMemoryBuffer(
+        keySize * maxNbKeys, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_TemporaryValues = m_Device.CreateMemoryBuffer(
+        sizeof(uint32_t) * maxNbKeys, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void RadixSort::CreateDescriptors(
+    VkDescriptorPool &iDescriptorPool,
+    const olp::MemoryBuffer &iKeys,
+    const olp::MemoryBuffer &iValues)
+{
+    auto bufferInfo = [](const olp::MemoryBuffer &iBuffer)
+    {
+        VkDescriptorBufferInfo info{};
+        info.buffer = iBuffer.Buffer;
+        info.offset = 0;
+        info.range = iBuffer.Size;
+        return info;
+    };
+
+    // Set 0 reads the caller's buffers and writes the temporary ones, set 1 the other way.
+    const std::array<const olp::MemoryBuffer *, 2> keys{&iKeys, &m_TemporaryKeys};
+    const std::array<const olp::MemoryBuffer *, 2> values{&iValues, &m_TemporaryValues};
+    for (uint32_t set = 0; set < m_DescriptorSets.size(); ++set)
+    {
+        olp::DescriptorSet &descriptorSet = m_DescriptorSets[set];
+        descriptorSet.AllocateDescriptorSets(m_PipelineLayout.GetDescriptorLayout(), iDescriptorPool);
+        descriptorSet.AddWriteDescriptor(0, bufferInfo(m_StateBuffer), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(1, bufferInfo(*keys[set]), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(2, bufferInfo(*values[set]), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(3, bufferInfo(*keys[1 - set]), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(4, bufferInfo(*values[1 - set]), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(5, bufferInfo(m_HistogramBuffer), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.UpdateDescriptorSets();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void RadixSort::CreateCommandBuffer()
+{
+    VkCommandPoolCreateInfo cmdPoolInfo{};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.queueFamilyIndex = m_Device.GetQueueIndices().computeFamily.value();
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    VK_CHECK_RESULT(vkCreateCommandPool(m_Device.GetDevice(), &cmdPoolInfo, nullptr, &m_CommandPool))
+
+    VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
+    cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufAllocateInfo.commandPool = m_CommandPool;
+    cmdBufAllocateInfo.commandBufferCount = 1;
+    cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    VK_CHECK_RESULT(vkAllocateCommandBuffers(m_Device.GetDevice(), &cmdBufAllocateInfo, &m_CommandBuffer))
+
+    VkFenceCreateInfo fenceCreateInfo{};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateFence(m_Device.GetDevice(), &fenceCreateInfo, nullptr, &m_Fence))
+
+    m_Timer.Create(m_Device.GetQueueIndices().computeFamily.value(), 1, 2);
+    m_GpuTime = 0.f;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void RadixSort::Record(VkCommandBuffer iCommandBuffer, uint32_t iNbKeys, uint32_t iKeyBits) const
+{
+    if (iNbKeys < 2 || iKeyBits == 0)
+        return;
+
+    // An even number of passes: the last one writes the caller's buffers.
+    uint32_t nbPasses = (iKeyBits + DigitBits - 1) / DigitBits;
+    nbPasses += nbPasses % 2;
+    const uint32_t nbBlocks = GetNbBlocks(iNbKeys);
+
+    // The keys were written by a transfer or a shader, and a previous sort may still read the state.
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(iCommandBuffer, m_StateBuffer.Buffer, NbKeysOffset, sizeof(uint32_t), iNbKeys);
+    vkCmdFillBuffer(iCommandBuffer, m_StateBuffer.Buffer, NbBlocksOffset, sizeof(uint32_t), nbBlocks);
+    vkCmdFillBuffer(
+        iCommandBuffer, m_StateBuffer.Buffer, KeyWordsOffset, sizeof(uint32_t), static_cast<uint32_t>(m_KeySize));
+
+    for (uint32_t pass = 0; pass < nbPasses; ++pass)
+    {
+        // The shift of the digit is the only state changing between the passes, the shaders have no push constant.
+        vkCmdFillBuffer(iCommandBuffer, m_StateBuffer.Buffer, ShiftOffset, sizeof(uint32_t), pass * DigitBits);
+        RecordBarrier(
+            iCommandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT);
+
+        vkCmdBindDescriptorSets(
+            iCommandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_PipelineLayout.GetLayout(),
+            0,
+            1,
+            &m_DescriptorSets[pass % 2].GetDescriptorSet(),
+            0,
+            nullptr);
+
+        const std::array<std::pair<VkPipeline, uint32_t>, 3> dispatches{
+            {{m_HistogramPipeline, nbBlocks}, {m_ScanPipeline, 1}, {m_ScatterPipeline, nbBlocks}}};
+        for (const auto &[pipeline, nbGroups] : dispatches)
+        {
+            vkCmdBindPipeline(iCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            vkCmdDispatch(iCommandBuffer, nbGroups, 1, 1);
+            // Each dispatch reads what the previous one wrote, the next pass overwrites the shift they read.
+            RecordBarrier(
+                iCommandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void RadixSort::Sort(uint32_t iNbKeys, uint32_t iKeyBits)
+{
+    VK_CHECK_RESULT(vkResetCommandBuffer(m_CommandBuffer, 0))
+    VkCommandBufferBeginInfo cmdBufInfo{};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(m_CommandBuffer, &cmdBufInfo))
+    m_Timer.Reset(m_CommandBuffer, 0);
+    m_Timer.Write(m_CommandBuffer, 0, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    Record(m_CommandBuffer, iNbKeys, iKeyBits);
+    m_Timer.Write(m_CommandBuffer, 0, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    VK_CHECK_RESULT(vkEndCommandBuffer(m_CommandBuffer))
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_CommandBuffer;
+
+    vkResetFences(m_Device.GetDevice(), 1, &m_Fence);
+    VK_CHECK_RESULT(vkQueueSubmit(m_Device.GetComputeQueue(), 1, &submitInfo, m_Fence))
+    vkWaitForFences(m_Device.GetDevice(), 1, &m_Fence, VK_TRUE, UINT64_MAX);
+
+    std::vector<float> gpuTime;
+    if (m_Timer.Read(0, gpuTime))
+        m_GpuTime = gpuTime.front();
+}
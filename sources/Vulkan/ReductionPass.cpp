@@ -0,0 +1,263 @@
+#include "Vulkan/ReductionPass.h"
+#include "Olympus/Debug.h"
+#include <algorithm>
+
+namespace
+{
+/// Workgroup size of reduction.comp. The last workgroup reduces one partial result by invocation.
+constexpr uint32_t GroupSize = 256;
+/// Offset of the partial results in the partial buffer, after the counter of the workgroups done.
+constexpr VkDeviceSize PartialsOffset = 16;
+} // namespace
+
+static_assert(sizeof(ReductionPass::Quantities) == 96, "Same layout as the Quantities of reduction.comp");
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReductionPass::Destroy()
+{
+    if (m_HostResults != nullptr)
+        vkUnmapMemory(m_Device.GetDevice(), m_HostBuffer.Memory);
+    m_HostResults = nullptr;
+    m_HostBuffer.Destroy();
+    m_ResultBuffer.Destroy();
+    m_PartialBuffer.Destroy();
+    m_SlotTimer.Destroy();
+    // The command pool frees the command buffers of the slots.
+    m_SlotCommandBuffers.clear();
+    ComputePass::Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReductionPass::Create(
+    VkDescriptorPool &iDescriptorPool,
+    const VkCloud &iGalaxy,
+    const olp::UniformBuffer &iOptions,
+    uint32_t iNbSlots)
+{
+    const uint32_t nbSlots = std::max(iNbSlots, 1u);
+    CreatePipelineLayout();
+    CreateBuffers(nbSlots);
+    CreateDescriptor(iDescriptorPool, iGalaxy, iOptions);
+    // At most GroupSize workgroups, each invocation loops over the stars.
+    ComputePass::Create("reduction", std::min<VkDeviceSize>(iGalaxy.GetSize(), GroupSize * GroupSize));
+
+    m_SlotTimer.Create(m_Device.GetQueueIndices().computeFamily.value(), nbSlots, 2);
+    m_SlotCommandBuffers.resize(nbSlots);
+    for (uint32_t slot = 0; slot < nbSlots; ++slot)
+    {
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
+        cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdBufAllocateInfo.commandPool = m_CommandPool;
+        cmdBufAllocateInfo.commandBufferCount = static_cast<uint32_t>(m_SlotCommandBuffers[slot].size());
+        cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        VK_CHECK_RESULT(
+            vkAllocateCommandBuffers(m_Device.GetDevice(), &cmdBufAllocateInfo, m_SlotCommandBuffers[slot].data()))
+
+        for (uint32_t source = 0; source < m_SlotCommandBuffers[slot].size(); ++source)
+            BuildSlotCommandBuffer(slot, source);
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReductionPass::CreatePipelineLayout()
+{
+    std::vector<VkDescriptorSetLayoutBinding> descriptorBinding(4);
+
+    // Position storage buffer, read.
+    descriptorBinding[0].binding = 0;
+    descriptorBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[0].descriptorCount = 1;
+    descriptorBinding[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[0].pImmutableSamplers = nullptr;
+
+    // Acceleration options
+    descriptorBinding[1].binding = 1;
+    descriptorBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorBinding[1].descriptorCount = 1;
+    descriptorBinding[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[1].pImmutableSamplers = nullptr;
+
+    // Partial results storage buffer
+    descriptorBinding[2].binding = 2;
+    descriptorBinding[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[2].descriptorCount = 1;
+    descriptorBinding[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[2].pImmutableSamplers = nullptr;
+
+    // Result storage buffer, written.
+    descriptorBinding[3].binding = 3;
+    descriptorBinding[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorBinding[3].descriptorCount = 1;
+    descriptorBinding[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorBinding[3].pImmutableSamplers = nullptr;
+
+    m_PipelineLayout.Create(descriptorBinding);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReductionPass::CreateBuffers(uint32_t iNbSlots)
+{
+    m_PartialBuffer = m_Device.CreateMemoryBuffer(
+        PartialsOffset + sizeof(Quantities) * GroupSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_ResultBuffer = m_Device.CreateMemoryBuffer(
+        sizeof(Quantities),
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_HostBuffer = m_Device.CreateMemoryBuffer(
+        sizeof(Quantities) * iNbSlots,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    void *data = nullptr;
+    VK_CHECK_RESULT(vkMapMemory(m_Device.GetDevice(), m_HostBuffer.Memory, 0, m_HostBuffer.Size, 0, &data))
+    m_HostResults = static_cast<const Quantities *>(data);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReductionPass::CreateDescriptor(
+    VkDescriptorPool &iDescriptorPool,
+    const VkCloud &iGalaxy,
+    const olp::UniformBuffer &iOptions)
+{
+    // Partial results
+    VkDescriptorBufferInfo partialBufferInfo{};
+    partialBufferInfo.buffer = m_PartialBuffer.Buffer;
+    partialBufferInfo.offset = 0;
+    partialBufferInfo.range = m_PartialBuffer.Size;
+
+    // Result
+    VkDescriptorBufferInfo resultBufferInfo{};
+    resultBufferInfo.buffer = m_ResultBuffer.Buffer;
+    resultBufferInfo.offset = 0;
+    resultBufferInfo.range = m_ResultBuffer.Size;
+
+    for (uint32_t source = 0; source < m_DescriptorSets.size(); ++source)
+    {
+        olp::DescriptorSet &descriptorSet = m_DescriptorSets[source];
+        descriptorSet.AllocateDescriptorSets(m_PipelineLayout.GetDescriptorLayout(), iDescriptorPool);
+        // Vertex buffer read by the last step, with the speeds synchronized with the positions: the speeds of the
+        // current buffer are half a step behind.
+        VkDescriptorBufferInfo vertexBufferInfo{};
+        vertexBufferInfo.buffer = iGalaxy.GetVertexBuffer(1 - source).Buffer;
+        vertexBufferInfo.offset = 0;
+        vertexBufferInfo.range = iGalaxy.GetVertexBuffer(1 - source).Size;
+
+        descriptorSet.AddWriteDescriptor(0, vertexBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(1, iOptions);
+        descriptorSet.AddWriteDescriptor(2, partialBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(3, resultBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.UpdateDescriptorSets();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReductionPass::BuildSlotCommandBuffer(uint32_t iSlot, uint32_t iSource)
+{
+    VkCommandBuffer commandBuffer = m_SlotCommandBuffers[iSlot][iSource];
+    VkCommandBufferBeginInfo cmdBufInfo{};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo))
+    m_SlotTimer.Reset(commandBuffer, iSlot);
+
+    // The steps wrote the stars, and the previous reduction still uses the counter and the result.
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+    vkCmdFillBuffer(commandBuffer, m_PartialBuffer.Buffer, 0, sizeof(uint32_t), 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+
+    m_SlotTimer.Write(commandBuffer, iSlot, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    RecordDispatch(commandBuffer, iSource);
+    m_SlotTimer.Write(commandBuffer, iSlot, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+
+    VkBufferCopy region{};
+    region.dstOffset = sizeof(Quantities) * iSlot;
+    region.size = sizeof(Quantities);
+    vkCmdCopyBuffer(commandBuffer, m_ResultBuffer.Buffer, m_HostBuffer.Buffer, 1, &region);
+
+    // The copy is visible to the host once the submission is done.
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer))
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReductionPass::Read(uint32_t iSlot, Quantities &oQuantities, float &oGpuTime) const
+{
+    oQuantities = m_HostResults[iSlot];
+
+    std::vector<float> gpuTime;
+    if (m_SlotTimer.Read(iSlot, gpuTime))
+        oGpuTime = gpuTime.front();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+ReductionPass::Quantities ReductionPass::Reduce(uint32_t iSource)
+{
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_SlotCommandBuffers[0][iSource];
+
+    vkResetFences(m_Device.GetDevice(), 1, &m_Fence);
+    VK_CHECK_RESULT(vkQueueSubmit(m_Device.GetComputeQueue(), 1, &submitInfo, m_Fence))
+    WaitFence();
+
+    Quantities quantities;
+    float gpuTime = 0.f;
+    Read(0, quantities, gpuTime);
+    return quantities;
+}
@@ -0,0 +1,337 @@
+#include "Vulkan/ReorderPass.h"
+#include "Olympus/Debug.h"
+#include "Olympus/Shader.h"
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+/// Workgroup size of the reorder shaders, an invocation by star.
+constexpr uint32_t GroupSize = 256;
+
+/// Offsets of the fields of the state buffer, same layout as the State of the shaders.
+constexpr VkDeviceSize NbStarsOffset = 0;
+constexpr VkDeviceSize NbBlackHolesOffset = 4;
+constexpr VkDeviceSize MinOffset = 8;
+constexpr VkDeviceSize MaxOffset = 20;
+constexpr VkDeviceSize BoundsSize = 12;
+constexpr VkDeviceSize StateSize = 32;
+
+/// Low bits of the keys sorted: the 30-bit Morton keys plus one, and the key of the NaN stars past them.
+constexpr uint32_t KeyBits = 31;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// Records a barrier between two commands of the sort.
+void RecordBarrier(
+    VkCommandBuffer iCommandBuffer,
+    VkPipelineStageFlags iSrcStage,
+    VkAccessFlags iSrcAccess,
+    VkPipelineStageFlags iDstStage,
+    VkAccessFlags iDstAccess)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = iSrcAccess;
+    barrier.dstAccessMask = iDstAccess;
+    vkCmdPipelineBarrier(iCommandBuffer, iSrcStage, iDstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+ReorderPass::ReorderPass(const olp::Device &iDevice)
+    : m_Device(iDevice),
+      m_PipelineLayout(iDevice),
+      m_DescriptorSets{olp::DescriptorSet(iDevice), olp::DescriptorSet(iDevice)},
+      m_Sort(iDevice),
+      m_Timer(iDevice)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::Create(
+    VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy, uint32_t iNbBlackHoles, uint32_t iNbSlots)
+{
+    m_NbStars = iGalaxy.GetSize();
+    m_NbBlackHoles = std::min(iNbBlackHoles, m_NbStars);
+
+    CreatePipelineLayout();
+    m_BoundsPipeline = CreatePipeline("reorder_bounds");
+    m_KeysPipeline = CreatePipeline("reorder_keys");
+    m_GatherPipeline = CreatePipeline("reorder_gather");
+    CreateBuffers();
+    CreateDescriptors(iDescriptorPool, iGalaxy);
+    m_Sort.Create(iDescriptorPool, m_Keys, m_Values, m_NbStars, RadixSort::KeySize::Bits32);
+    CreateCommandBuffers(std::max(iNbSlots, 1u));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::Destroy()
+{
+    vkDestroyFence(m_Device.GetDevice(), m_Fence, nullptr);
+    vkDestroySemaphore(m_Device.GetDevice(), m_Semaphore, nullptr);
+    vkDestroyCommandPool(m_Device.GetDevice(), m_CommandPool, nullptr);
+    m_Fence = VK_NULL_HANDLE;
+    m_Semaphore = VK_NULL_HANDLE;
+    m_CommandPool = VK_NULL_HANDLE;
+    m_CommandBuffers.clear();
+    m_Timer.Destroy();
+
+    m_Sort.Destroy();
+    m_Values.Destroy();
+    m_Keys.Destroy();
+    m_StateBuffer.Destroy();
+
+    vkDestroyPipeline(m_Device.GetDevice(), m_GatherPipeline, nullptr);
+    vkDestroyPipeline(m_Device.GetDevice(), m_KeysPipeline, nullptr);
+    vkDestroyPipeline(m_Device.GetDevice(), m_BoundsPipeline, nullptr);
+    m_GatherPipeline = VK_NULL_HANDLE;
+    m_KeysPipeline = VK_NULL_HANDLE;
+    m_BoundsPipeline = VK_NULL_HANDLE;
+    m_PipelineLayout.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::CreatePipelineLayout()
+{
+    // State, stars, keys, values, sorted stars and render vertices: storage buffers only.
+    std::vector<VkDescriptorSetLayoutBinding> descriptorBinding(6);
+    for (uint32_t binding = 0; binding < descriptorBinding.size(); ++binding)
+    {
+        descriptorBinding[binding].binding = binding;
+        descriptorBinding[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorBinding[binding].descriptorCount = 1;
+        descriptorBinding[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        descriptorBinding[binding].pImmutableSamplers = nullptr;
+    }
+
+    m_PipelineLayout.Create(descriptorBinding);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+VkPipeline ReorderPass::CreatePipeline(const std::filesystem::path &iShaderName) const
+{
+    olp::Shader shader(m_Device);
+    std::filesystem::path shaderPath = GALAXY_SHADERS / iShaderName;
+    shaderPath += "_comp.spv";
+    shader.Load(shaderPath);
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo{};
+    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStageInfo.module = shader.GetShaderModule();
+    shaderStageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.layout = m_PipelineLayout.GetLayout();
+    pipelineCreateInfo.stage = shaderStageInfo;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(
+        vkCreateComputePipelines(m_Device.GetDevice(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline))
+    return pipeline;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::CreateBuffers()
+{
+    const VkDeviceSize nbStars = std::max(m_NbStars, 1u);
+
+    m_StateBuffer = m_Device.CreateMemoryBuffer(
+        StateSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_Keys = m_Device.CreateMemoryBuffer(
+        sizeof(uint32_t) * nbStars, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_Values = m_Device.CreateMemoryBuffer(
+        sizeof(uint32_t) * nbStars, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::CreateDescriptors(VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy)
+{
+    auto bufferInfo = [](const olp::MemoryBuffer &iBuffer)
+    {
+        VkDescriptorBufferInfo info{};
+        info.buffer = iBuffer.Buffer;
+        info.offset = 0;
+        info.range = iBuffer.Size;
+        return info;
+    };
+
+    for (uint32_t source = 0; source < m_DescriptorSets.size(); ++source)
+    {
+        olp::DescriptorSet &descriptorSet = m_DescriptorSets[source];
+        descriptorSet.AllocateDescriptorSets(m_PipelineLayout.GetDescriptorLayout(), iDescriptorPool);
+        descriptorSet.AddWriteDescriptor(0, bufferInfo(m_StateBuffer), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(1, bufferInfo(iGalaxy.GetVertexBuffer(source)), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(2, bufferInfo(m_Keys), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(3, bufferInfo(m_Values), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(
+            4, bufferInfo(iGalaxy.GetVertexBuffer(1 - source)), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(
+            5, bufferInfo(iGalaxy.GetRenderBuffer(1 - source)), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.UpdateDescriptorSets();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::CreateCommandBuffers(uint32_t iNbSlots)
+{
+    VkCommandPoolCreateInfo cmdPoolInfo{};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.queueFamilyIndex = m_Device.GetQueueIndices().computeFamily.value();
+    VK_CHECK_RESULT(vkCreateCommandPool(m_Device.GetDevice(), &cmdPoolInfo, nullptr, &m_CommandPool))
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo{};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateSemaphore(m_Device.GetDevice(), &semaphoreCreateInfo, nullptr, &m_Semaphore))
+
+    VkFenceCreateInfo fenceCreateInfo{};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateFence(m_Device.GetDevice(), &fenceCreateInfo, nullptr, &m_Fence))
+
+    m_Timer.Create(m_Device.GetQueueIndices().computeFamily.value(), iNbSlots, 2);
+    m_SlotsSubmitted.assign(iNbSlots, false);
+    m_GpuTime = 0.f;
+
+    // A slot is submitted again once its previous sort is done: no simultaneous use.
+    m_CommandBuffers.resize(iNbSlots);
+    for (uint32_t slot = 0; slot < iNbSlots; ++slot)
+    {
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
+        cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdBufAllocateInfo.commandPool = m_CommandPool;
+        cmdBufAllocateInfo.commandBufferCount = static_cast<uint32_t>(m_CommandBuffers[slot].size());
+        cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        VK_CHECK_RESULT(
+            vkAllocateCommandBuffers(m_Device.GetDevice(), &cmdBufAllocateInfo, m_CommandBuffers[slot].data()))
+
+        for (uint32_t source = 0; source < m_CommandBuffers[slot].size(); ++source)
+        {
+            VkCommandBuffer commandBuffer = m_CommandBuffers[slot][source];
+            VkCommandBufferBeginInfo cmdBufInfo{};
+            cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo))
+            m_Timer.Reset(commandBuffer, slot);
+            // In a stage waiting for the semaphores of the submission, so the time waited is not counted.
+            m_Timer.Write(commandBuffer, slot, 0, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            RecordReorder(commandBuffer, source);
+            m_Timer.Write(commandBuffer, slot, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+            VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer))
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::RecordReorder(VkCommandBuffer iCommandBuffer, uint32_t iSource) const
+{
+    if (m_NbStars == 0)
+        return;
+
+    // The steps wrote the stars, and the previous commands may still read the buffer the sorted stars are written to
+    // and the state.
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(iCommandBuffer, m_StateBuffer.Buffer, NbStarsOffset, sizeof(uint32_t), m_NbStars);
+    vkCmdFillBuffer(iCommandBuffer, m_StateBuffer.Buffer, NbBlackHolesOffset, sizeof(uint32_t), m_NbBlackHoles);
+    // Empty bounds: the largest minimum and the smallest maximum.
+    vkCmdFillBuffer(iCommandBuffer, m_StateBuffer.Buffer, MinOffset, BoundsSize, 0xffffffff);
+    vkCmdFillBuffer(iCommandBuffer, m_StateBuffer.Buffer, MaxOffset, BoundsSize, 0);
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    RecordDispatch(iCommandBuffer, iSource, m_BoundsPipeline);
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT);
+    RecordDispatch(iCommandBuffer, iSource, m_KeysPipeline);
+    // The sort orders itself after the keys, and binds its own layout.
+    m_Sort.Record(iCommandBuffer, m_NbStars, KeyBits);
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    RecordDispatch(iCommandBuffer, iSource, m_GatherPipeline);
+
+    // The steps, the copies of the stars and the draw read the sorted stars.
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::RecordDispatch(VkCommandBuffer iCommandBuffer, uint32_t iSource, VkPipeline iPipeline) const
+{
+    vkCmdBindPipeline(iCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, iPipeline);
+    vkCmdBindDescriptorSets(
+        iCommandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        m_PipelineLayout.GetLayout(),
+        0,
+        1,
+        &m_DescriptorSets[iSource].GetDescriptorSet(),
+        0,
+        nullptr);
+    vkCmdDispatch(iCommandBuffer, (m_NbStars + GroupSize - 1) / GroupSize, 1, 1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::Submit(
+    uint32_t iSlot,
+    uint32_t iSource,
+    std::initializer_list<VkSemaphore> iWaitSemaphores,
+    std::initializer_list<VkSemaphore> iSignalSemaphores,
+    VkFence iFence)
+{
+    // Timestamps of the previous sort of the slot, done before the slot is reused.
+    std::vector<float> gpuTime;
+    if (m_SlotsSubmitted[iSlot] && m_Timer.Read(iSlot, gpuTime))
+        m_GpuTime = gpuTime.front();
+    m_SlotsSubmitted[iSlot] = true;
+
+    // The render pass drawing the buffer the sorted stars are written to, or the steps writing the stars.
+    std::vector<VkSemaphore> waitSemaphores;
+    std::copy_if(iWaitSemaphores.begin(), iWaitSemaphores.end(), std::back_inserter(waitSemaphores),
+                 [](VkSemaphore iSemaphore) { return iSemaphore != VK_NULL_HANDLE; });
+    const std::vector<VkPipelineStageFlags> waitStageMasks(
+        waitSemaphores.size(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStageMasks.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_CommandBuffers[iSlot][iSource];
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(iSignalSemaphores.size());
+    submitInfo.pSignalSemaphores = iSignalSemaphores.begin();
+    VK_CHECK_RESULT(vkQueueSubmit(m_Device.GetComputeQueue(), 1, &submitInfo, iFence))
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ReorderPass::Reorder(uint32_t iSource)
+{
+    vkResetFences(m_Device.GetDevice(), 1, &m_Fence);
+    Submit(0, iSource, {}, {}, m_Fence);
+    vkWaitForFences(m_Device.GetDevice(), 1, &m_Fence, VK_TRUE, UINT64_MAX);
+
+    std::vector<float> gpuTime;
+    if (m_Timer.Read(0, gpuTime))
+        m_GpuTime = gpuTime.front();
+}
@@ -0,0 +1,335 @@
+#include "Vulkan/SpatialGridPass.h"
+#include "Olympus/Debug.h"
+#include "Olympus/Shader.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+/// Workgroup size of the grid shaders, an invocation by star.
+constexpr uint32_t GroupSize = 256;
+
+/// Offsets of the fields of the state buffer, same layout as the State of the shaders.
+constexpr VkDeviceSize NbStarsOffset = 0;
+constexpr VkDeviceSize TableMaskOffset = 4;
+constexpr VkDeviceSize CellSizeOffset = 8;
+constexpr VkDeviceSize InvCellSizeOffset = 12;
+constexpr VkDeviceSize StateSize = 16;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// Records the write of a float of the state, vkCmdFillBuffer writes 32-bit words.
+void RecordFillFloat(VkCommandBuffer iCommandBuffer, VkBuffer iBuffer, VkDeviceSize iOffset, float iValue)
+{
+    uint32_t bits = 0;
+    std::memcpy(&bits, &iValue, sizeof(bits));
+    vkCmdFillBuffer(iCommandBuffer, iBuffer, iOffset, sizeof(uint32_t), bits);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// Records a barrier between two commands of the grid.
+void RecordBarrier(
+    VkCommandBuffer iCommandBuffer,
+    VkPipelineStageFlags iSrcStage,
+    VkAccessFlags iSrcAccess,
+    VkPipelineStageFlags iDstStage,
+    VkAccessFlags iDstAccess)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = iSrcAccess;
+    barrier.dstAccessMask = iDstAccess;
+    vkCmdPipelineBarrier(iCommandBuffer, iSrcStage, iDstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+SpatialGridPass::SpatialGridPass(const olp::Device &iDevice)
+    : m_Device(iDevice),
+      m_PipelineLayout(iDevice),
+      m_DescriptorSets{olp::DescriptorSet(iDevice), olp::DescriptorSet(iDevice)},
+      m_Sort(iDevice),
+      m_Timer(iDevice)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::Create(VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy)
+{
+    m_NbStars = iGalaxy.GetSize();
+    m_TableSize = 1;
+    while (m_TableSize < m_NbStars)
+        m_TableSize <<= 1;
+
+    CreatePipelineLayout();
+    m_HashPipeline = CreatePipeline("grid_hash");
+    m_CellsPipeline = CreatePipeline("grid_cells");
+    m_NeighborsPipeline = CreatePipeline("grid_neighbors");
+    CreateBuffers();
+    CreateDescriptors(iDescriptorPool, iGalaxy);
+    m_Sort.Create(iDescriptorPool, m_Keys, m_Values, m_NbStars, RadixSort::KeySize::Bits32);
+    CreateCommandBuffer();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::Destroy()
+{
+    vkDestroyFence(m_Device.GetDevice(), m_Fence, nullptr);
+    vkDestroyCommandPool(m_Device.GetDevice(), m_CommandPool, nullptr);
+    m_Fence = VK_NULL_HANDLE;
+    m_CommandPool = VK_NULL_HANDLE;
+    m_CommandBuffer = VK_NULL_HANDLE;
+    m_Timer.Destroy();
+
+    m_Sort.Destroy();
+    m_NeighborCounts.Destroy();
+    m_SortedStars.Destroy();
+    m_CellRanges.Destroy();
+    m_Values.Destroy();
+    m_Keys.Destroy();
+    m_StateBuffer.Destroy();
+
+    vkDestroyPipeline(m_Device.GetDevice(), m_NeighborsPipeline, nullptr);
+    vkDestroyPipeline(m_Device.GetDevice(), m_CellsPipeline, nullptr);
+    vkDestroyPipeline(m_Device.GetDevice(), m_HashPipeline, nullptr);
+    m_NeighborsPipeline = VK_NULL_HANDLE;
+    m_CellsPipeline = VK_NULL_HANDLE;
+    m_HashPipeline = VK_NULL_HANDLE;
+    m_PipelineLayout.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::CreatePipelineLayout()
+{
+    // State, stars, keys, values, cell ranges, sorted stars and neighbor counts: storage buffers only.
+    std::vector<VkDescriptorSetLayoutBinding> descriptorBinding(7);
+    for (uint32_t binding = 0; binding < descriptorBinding.size(); ++binding)
+    {
+        descriptorBinding[binding].binding = binding;
+        descriptorBinding[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorBinding[binding].descriptorCount = 1;
+        descriptorBinding[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        descriptorBinding[binding].pImmutableSamplers = nullptr;
+    }
+
+    m_PipelineLayout.Create(descriptorBinding);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+VkPipeline SpatialGridPass::CreatePipeline(const std::filesystem::path &iShaderName) const
+{
+    olp::Shader shader(m_Device);
+    std::filesystem::path shaderPath = GALAXY_SHADERS / iShaderName;
+    shaderPath += "_comp.spv";
+    shader.Load(shaderPath);
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo{};
+    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStageInfo.module = shader.GetShaderModule();
+    shaderStageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.layout = m_PipelineLayout.GetLayout();
+    pipelineCreateInfo.stage = shaderStageInfo;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(
+        vkCreateComputePipelines(m_Device.GetDevice(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline))
+    return pipeline;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::CreateBuffers()
+{
+    const VkDeviceSize nbStars = std::max(m_NbStars, 1u);
+
+    m_StateBuffer = m_Device.CreateMemoryBuffer(
+        StateSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_Keys = m_Device.CreateMemoryBuffer(
+        sizeof(uint32_t) * nbStars, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_Values = m_Device.CreateMemoryBuffer(
+        sizeof(uint32_t) * nbStars,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_CellRanges = m_Device.CreateMemoryBuffer(
+        2 * sizeof(uint32_t) * m_TableSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_SortedStars = m_Device.CreateMemoryBuffer(
+        4 * sizeof(float) * nbStars,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_NeighborCounts = m_Device.CreateMemoryBuffer(
+        sizeof(uint32_t) * nbStars,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::CreateDescriptors(VkDescriptorPool &iDescriptorPool, const VkCloud &iGalaxy)
+{
+    auto bufferInfo = [](const olp::MemoryBuffer &iBuffer)
+    {
+        VkDescriptorBufferInfo info{};
+        info.buffer = iBuffer.Buffer;
+        info.offset = 0;
+        info.range = iBuffer.Size;
+        return info;
+    };
+
+    for (uint32_t source = 0; source < m_DescriptorSets.size(); ++source)
+    {
+        olp::DescriptorSet &descriptorSet = m_DescriptorSets[source];
+        descriptorSet.AllocateDescriptorSets(m_PipelineLayout.GetDescriptorLayout(), iDescriptorPool);
+        descriptorSet.AddWriteDescriptor(0, bufferInfo(m_StateBuffer), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(1, bufferInfo(iGalaxy.GetVertexBuffer(source)), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(2, bufferInfo(m_Keys), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(3, bufferInfo(m_Values), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(4, bufferInfo(m_CellRanges), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(5, bufferInfo(m_SortedStars), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.AddWriteDescriptor(6, bufferInfo(m_NeighborCounts), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        descriptorSet.UpdateDescriptorSets();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::CreateCommandBuffer()
+{
+    VkCommandPoolCreateInfo cmdPoolInfo{};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.queueFamilyIndex = m_Device.GetQueueIndices().computeFamily.value();
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    VK_CHECK_RESULT(vkCreateCommandPool(m_Device.GetDevice(), &cmdPoolInfo, nullptr, &m_CommandPool))
+
+    VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
+    cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufAllocateInfo.commandPool = m_CommandPool;
+    cmdBufAllocateInfo.commandBufferCount = 1;
+    cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    VK_CHECK_RESULT(vkAllocateCommandBuffers(m_Device.GetDevice(), &cmdBufAllocateInfo, &m_CommandBuffer))
+
+    VkFenceCreateInfo fenceCreateInfo{};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateFence(m_Device.GetDevice(), &fenceCreateInfo, nullptr, &m_Fence))
+
+    m_Timer.Create(m_Device.GetQueueIndices().computeFamily.value(), 1, 3);
+    m_BuildTime = 0.f;
+    m_QueryTime = 0.f;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::RecordBuild(VkCommandBuffer iCommandBuffer, uint32_t iSource, float iCellSize) const
+{
+    if (m_NbStars == 0)
+        return;
+
+    const float cellSize = iCellSize > 0.f ? iCellSize : 1.f;
+    // The bucket of the NaN stars is the size of the table, past the mask: one more bit than the mask.
+    uint32_t keyBits = 1;
+    while ((1u << (keyBits - 1)) < m_TableSize)
+        ++keyBits;
+
+    // The steps wrote the stars, and a previous build or query may still read the state and the cell ranges.
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(iCommandBuffer, m_StateBuffer.Buffer, NbStarsOffset, sizeof(uint32_t), m_NbStars);
+    vkCmdFillBuffer(iCommandBuffer, m_StateBuffer.Buffer, TableMaskOffset, sizeof(uint32_t), m_TableSize - 1);
+    RecordFillFloat(iCommandBuffer, m_StateBuffer.Buffer, CellSizeOffset, cellSize);
+    RecordFillFloat(iCommandBuffer, m_StateBuffer.Buffer, InvCellSizeOffset, 1.f / cellSize);
+    // Empty buckets: their first and last stars are both 0.
+    vkCmdFillBuffer(iCommandBuffer, m_CellRanges.Buffer, 0, VK_WHOLE_SIZE, 0);
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    RecordDispatch(iCommandBuffer, iSource, m_HashPipeline);
+    // The sort orders itself after the hash, and binds its own layout.
+    m_Sort.Record(iCommandBuffer, m_NbStars, keyBits);
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    RecordDispatch(iCommandBuffer, iSource, m_CellsPipeline);
+
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::RecordNeighborCounts(VkCommandBuffer iCommandBuffer, uint32_t iSource) const
+{
+    if (m_NbStars == 0)
+        return;
+
+    RecordDispatch(iCommandBuffer, iSource, m_NeighborsPipeline);
+    RecordBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::RecordDispatch(VkCommandBuffer iCommandBuffer, uint32_t iSource, VkPipeline iPipeline) const
+{
+    vkCmdBindDescriptorSets(
+        iCommandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        m_PipelineLayout.GetLayout(),
+        0,
+        1,
+        &m_DescriptorSets[iSource].GetDescriptorSet(),
+        0,
+        nullptr);
+    vkCmdBindPipeline(iCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, iPipeline);
+    vkCmdDispatch(iCommandBuffer, (m_NbStars + GroupSize - 1) / GroupSize, 1, 1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SpatialGridPass::CountNeighbors(uint32_t iSource, float iRadius)
+{
+    VK_CHECK_RESULT(vkResetCommandBuffer(m_CommandBuffer, 0))
+    VkCommandBufferBeginInfo cmdBufInfo{};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(m_CommandBuffer, &cmdBufInfo))
+    m_Timer.Reset(m_CommandBuffer, 0);
+    m_Timer.Write(m_CommandBuffer, 0, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    RecordBuild(m_CommandBuffer, iSource, iRadius);
+    m_Timer.Write(m_CommandBuffer, 0, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    RecordNeighborCounts(m_CommandBuffer, iSource);
+    m_Timer.Write(m_CommandBuffer, 0, 2, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    VK_CHECK_RESULT(vkEndCommandBuffer(m_CommandBuffer))
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_CommandBuffer;
+
+    vkResetFences(m_Device.GetDevice(), 1, &m_Fence);
+    VK_CHECK_RESULT(vkQueueSubmit(m_Device.GetComputeQueue(), 1, &submitInfo, m_Fence))
+    vkWaitForFences(m_Device.GetDevice(), 1, &m_Fence, VK_TRUE, UINT64_MAX);
+
+    std::vector<float> gpuTimes;
+    if (m_Timer.Read(0, gpuTimes))
+    {
+        m_BuildTime = gpuTimes[0];
+        m_QueryTime = gpuTimes[1];
+    }
+}
@@ -0,0 +1,196 @@
+#include "Vulkan/StepPass.h"
+#include "Olympus/Debug.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+//----------------------------------------------------------------------------------------------------------------------
+StepPass::StepPass(const olp::Device &iDevice)
+    : m_Device(iDevice),
+      m_FirstTimer(iDevice),
+      m_NextTimer(iDevice)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void StepPass::Create(std::vector<ComputePass *> iPasses, uint32_t iNbSteps, uint32_t iNbSlots)
+{
+    m_Passes = std::move(iPasses);
+    m_NbSteps = std::max(iNbSteps, 1u);
+    BuildCommandBuffers(std::max(iNbSlots, 1u));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void StepPass::Destroy()
+{
+    vkDestroyCommandPool(m_Device.GetDevice(), m_CommandPool, nullptr);
+    m_CommandPool = VK_NULL_HANDLE;
+    m_FirstStep.clear();
+    m_NextSteps.clear();
+    m_FirstTimer.Destroy();
+    m_NextTimer.Destroy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void StepPass::SetNbSteps(uint32_t iNbSteps)
+{
+    const uint32_t nbSlots = static_cast<uint32_t>(m_FirstStep.size());
+    Destroy();
+    Create(std::move(m_Passes), iNbSteps, nbSlots);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void StepPass::BuildCommandBuffers(uint32_t iNbSlots)
+{
+    VkCommandPoolCreateInfo cmdPoolInfo{};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.queueFamilyIndex = m_Device.GetQueueIndices().computeFamily.value();
+    VK_CHECK_RESULT(vkCreateCommandPool(m_Device.GetDevice(), &cmdPoolInfo, nullptr, &m_CommandPool))
+
+    const uint32_t computeFamily = m_Device.GetQueueIndices().computeFamily.value();
+    const uint32_t nbPasses = static_cast<uint32_t>(m_Passes.size());
+    m_FirstTimer.Create(computeFamily, iNbSlots, nbPasses + 1);
+    if (m_NbSteps > 1)
+        m_NextTimer.Create(computeFamily, iNbSlots, nbPasses * (m_NbSteps - 1) + 1);
+    m_SlotsSubmitted.assign(iNbSlots, false);
+
+    m_FirstStep.resize(iNbSlots);
+    m_NextSteps.resize(iNbSlots);
+    for (uint32_t slot = 0; slot < iNbSlots; ++slot)
+    {
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
+        cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdBufAllocateInfo.commandPool = m_CommandPool;
+        cmdBufAllocateInfo.commandBufferCount = static_cast<uint32_t>(m_FirstStep[slot].size());
+        cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(m_Device.GetDevice(), &cmdBufAllocateInfo, m_FirstStep[slot].data()))
+        if (m_NbSteps > 1)
+            VK_CHECK_RESULT(
+                vkAllocateCommandBuffers(m_Device.GetDevice(), &cmdBufAllocateInfo, m_NextSteps[slot].data()))
+
+        for (uint32_t source = 0; source < m_FirstStep[slot].size(); ++source)
+        {
+            RecordSteps(m_FirstStep[slot][source], m_FirstTimer, slot, source, 1);
+            if (m_NbSteps > 1)
+                RecordSteps(m_NextSteps[slot][source], m_NextTimer, slot, source, m_NbSteps - 1);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void StepPass::RecordSteps(
+    VkCommandBuffer iCommandBuffer, GpuTimer &iTimer, uint32_t iSlot, uint32_t iSource, uint32_t iNbSteps)
+{
+    // A slot is submitted again once its previous submission is done: no simultaneous use.
+    VkCommandBufferBeginInfo cmdBufInfo{};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(iCommandBuffer, &cmdBufInfo))
+    iTimer.Reset(iCommandBuffer, iSlot);
+
+    // Each dispatch reads what the previous one wrote: the accelerations, or the positions and speeds.
+    // The first barrier also orders the steps after the ones and the trajectory copy of the previous submission,
+    // which read the buffers the steps write.
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        iCommandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+    // In the stage waiting for the semaphores of the submission, so the time waited is not counted.
+    iTimer.Write(iCommandBuffer, iSlot, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    uint32_t source = iSource;
+    uint32_t timestamp = 1;
+    for (uint32_t step = 0; step < iNbSteps; ++step)
+    {
+        for (ComputePass *pass : m_Passes)
+        {
+            if (timestamp > 1)
+                vkCmdPipelineBarrier(
+                    iCommandBuffer,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    0,
+                    1,
+                    &barrier,
+                    0,
+                    nullptr,
+                    0,
+                    nullptr);
+            pass->RecordDispatch(iCommandBuffer, source);
+            iTimer.Write(iCommandBuffer, iSlot, timestamp++, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        }
+
+        // The last pass wrote the stars in the other buffer.
+        source = 1 - source;
+    }
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(iCommandBuffer))
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool StepPass::ReadPassTimes(uint32_t iSlot, std::vector<float> &oPassTimes) const
+{
+    std::vector<float> firstTimes;
+    std::vector<float> nextTimes;
+    if (iSlot >= m_SlotsSubmitted.size() || !m_SlotsSubmitted[iSlot] || !m_FirstTimer.Read(iSlot, firstTimes) ||
+        (m_NbSteps > 1 && !m_NextTimer.Read(iSlot, nextTimes)))
+        return false;
+
+    oPassTimes.assign(m_Passes.size(), 0.f);
+    firstTimes.insert(firstTimes.end(), nextTimes.begin(), nextTimes.end());
+    for (size_t i = 0; i < firstTimes.size(); ++i)
+        oPassTimes[i % oPassTimes.size()] += firstTimes[i];
+    return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void StepPass::Submit(
+    uint32_t iSlot,
+    uint32_t iSource,
+    VkSemaphore iFirstWaitSemaphore,
+    VkSemaphore iNextWaitSemaphore,
+    std::initializer_list<VkSemaphore> iSignalSemaphores,
+    VkFence iFence,
+    std::initializer_list<VkCommandBuffer> iFollowingCommandBuffers)
+{
+    m_SlotsSubmitted[iSlot] = true;
+
+    VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const bool nextSteps = m_NbSteps > 1;
+    // The last batch holds the last step and the following command buffers, it signals the end of the submission.
+    std::vector<VkCommandBuffer> lastCommandBuffers{
+        nextSteps ? m_NextSteps[iSlot][1 - iSource] : m_FirstStep[iSlot][iSource]};
+    std::copy_if(iFollowingCommandBuffers.begin(), iFollowingCommandBuffers.end(),
+                 std::back_inserter(lastCommandBuffers),
+                 [](VkCommandBuffer iCommandBuffer) { return iCommandBuffer != VK_NULL_HANDLE; });
+    const std::array<VkSemaphore, 2> waitSemaphores{iFirstWaitSemaphore, iNextWaitSemaphore};
+
+    std::array<VkSubmitInfo, 2> submitInfos{};
+    for (size_t batch = 0; batch < submitInfos.size(); ++batch)
+    {
+        VkSubmitInfo &submitInfo = submitInfos[batch];
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = waitSemaphores[batch] != VK_NULL_HANDLE ? 1 : 0;
+        submitInfo.pWaitSemaphores = &waitSemaphores[batch];
+        submitInfo.pWaitDstStageMask = &waitStageMask;
+    }
+
+    VkSubmitInfo &lastSubmitInfo = submitInfos[nextSteps ? 1 : 0];
+    submitInfos[0].commandBufferCount = 1;
+    submitInfos[0].pCommandBuffers = &m_FirstStep[iSlot][iSource];
+    lastSubmitInfo.commandBufferCount = static_cast<uint32_t>(lastCommandBuffers.size());
+    lastSubmitInfo.pCommandBuffers = lastCommandBuffers.data();
+    lastSubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(iSignalSemaphores.size());
+    lastSubmitInfo.pSignalSemaphores = iSignalSemaphores.begin();
+    VK_CHECK_RESULT(vkQueueSubmit(m_Device.GetComputeQueue(), nextSteps ? 2 : 1, submitInfos.data(), iFence))
+}
@@ -0,0 +1,304 @@
+#include "Vulkan/TrajectoryRecorder.h"
+#include "Olympus/Debug.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+/// Header of a trajectory file, followed by the frames.
+struct TrajectoryHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    /// Offset of the first frame in the file.
+    uint32_t HeaderSize;
+    uint32_t NbStars;
+    /// Size of a star record, sizeof(CloudVertex).
+    uint32_t VertexSize;
+    /// Number of steps between two frames.
+    uint32_t Interval;
+    uint32_t Reserved[9];
+};
+static_assert(sizeof(TrajectoryHeader) == 64, "The header keeps the stars aligned on 32 bytes");
+
+/// Header of a frame, followed by the stars.
+struct FrameHeader
+{
+    /// Number of steps done before the state of the stars: the copy holds the stars at the start of the last step
+    /// submitted, so a frame copied after k steps holds step k - 1, and 0 is the initial state.
+    uint64_t Step;
+    uint32_t NbStars;
+    uint32_t Reserved[5];
+};
+static_assert(sizeof(FrameHeader) == 32, "The header keeps the stars aligned on 32 bytes");
+
+constexpr char Magic[8] = {'G', 'A', 'L', 'A', 'X', 'Y', 'T', 'R'};
+/// Version 2: the stars carry their Id, they may be reordered from a frame to another.
+constexpr uint32_t Version = 2;
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+TrajectoryRecorder::TrajectoryRecorder(const olp::Device &iDevice)
+    : m_Device(iDevice)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+    Stop();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TrajectoryRecorder::Start(
+    const std::filesystem::path &iPath,
+    const VkCloud &iGalaxy,
+    uint32_t iInterval,
+    uint32_t iRingSize)
+{
+    Stop();
+
+    m_File.open(iPath, std::ios::binary | std::ios::trunc);
+    if (!m_File)
+        throw std::runtime_error("trajectory " + iPath.string() + ": cannot be created");
+
+    m_Galaxy = &iGalaxy;
+    m_NbStars = iGalaxy.GetSize();
+    m_Interval = std::max(iInterval, 1u);
+    m_Step = 0;
+    m_NbRecorded = 0;
+    m_NbDropped = 0;
+
+    TrajectoryHeader header{};
+    std::memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = Version;
+    header.HeaderSize = sizeof(TrajectoryHeader);
+    header.NbStars = m_NbStars;
+    header.VertexSize = sizeof(CloudVertex);
+    header.Interval = m_Interval;
+    m_File.write(reinterpret_cast<const char *>(&header), sizeof(TrajectoryHeader));
+
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.queueFamilyIndex = m_Device.GetQueueIndices().computeFamily.value();
+    VK_CHECK_RESULT(vkCreateCommandPool(m_Device.GetDevice(), &cmdPoolInfo, nullptr, &m_CommandPool))
+
+    m_Slots.resize(std::max(iRingSize, 1u));
+    for (Slot &slot : m_Slots)
+    {
+        // Cached memory: the writer thread reads it at CPU speed.
+        slot.Buffer = m_Device.CreateMemoryBuffer(
+            m_Galaxy->GetVertexBuffer().Size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        void *data = nullptr;
+        VK_CHECK_RESULT(vkMapMemory(m_Device.GetDevice(), slot.Buffer.Memory, 0, slot.Buffer.Size, 0, &data))
+        slot.Data = data;
+
+        VkEventCreateInfo eventInfo{};
+        eventInfo.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
+        VK_CHECK_RESULT(vkCreateEvent(m_Device.GetDevice(), &eventInfo, nullptr, &slot.Event))
+
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
+        cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdBufAllocateInfo.commandPool = m_CommandPool;
+        cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmdBufAllocateInfo.commandBufferCount = static_cast<uint32_t>(slot.CommandBuffers.size());
+        VK_CHECK_RESULT(
+            vkAllocateCommandBuffers(m_Device.GetDevice(), &cmdBufAllocateInfo, slot.CommandBuffers.data()))
+
+        for (uint32_t source = 0; source < slot.CommandBuffers.size(); ++source)
+            BuildCommandBuffer(slot, source);
+        slot.Status = Slot::State::Free;
+    }
+
+    m_StopWriter = false;
+    m_Writer = std::thread(&TrajectoryRecorder::WriteLoop, this);
+    m_Recording = true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TrajectoryRecorder::Stop()
+{
+    if (!m_Recording)
+        return;
+
+    vkDeviceWaitIdle(m_Device.GetDevice());
+    CollectCopies();
+    // Copies never submitted.
+    m_Copying.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_StopWriter = true;
+    }
+    m_Condition.notify_one();
+    m_Writer.join();
+    m_File.close();
+
+    for (Slot &slot : m_Slots)
+    {
+        vkUnmapMemory(m_Device.GetDevice(), slot.Buffer.Memory);
+        slot.Buffer.Destroy();
+        vkDestroyEvent(m_Device.GetDevice(), slot.Event, nullptr);
+    }
+    m_Slots.clear();
+    vkDestroyCommandPool(m_Device.GetDevice(), m_CommandPool, nullptr);
+    m_CommandPool = VK_NULL_HANDLE;
+
+    m_Galaxy = nullptr;
+    m_Recording = false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+VkCommandBuffer TrajectoryRecorder::NextStep(uint32_t iNbSteps)
+{
+    if (!m_Recording)
+        return VK_NULL_HANDLE;
+
+    CollectCopies();
+
+    // A record is due when the submission crosses a multiple of the interval.
+    const uint64_t previousStep = m_Step;
+    m_Step += iNbSteps;
+    if (m_Step / m_Interval == previousStep / m_Interval)
+        return VK_NULL_HANDLE;
+
+    uint32_t slotIndex = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        while (slotIndex < m_Slots.size() && m_Slots[slotIndex].Status != Slot::State::Free)
+            ++slotIndex;
+        if (slotIndex == m_Slots.size())
+        {
+            ++m_NbDropped;
+            return VK_NULL_HANDLE;
+        }
+        m_Slots[slotIndex].Status = Slot::State::Copying;
+    }
+
+    Slot &slot = m_Slots[slotIndex];
+    vkResetEvent(m_Device.GetDevice(), slot.Event);
+    // The synchronized buffer holds the stars at the start of the last step of the submission.
+    slot.Step = m_Step - 1;
+    m_Copying.push_back(slotIndex);
+    ++m_NbRecorded;
+    return slot.CommandBuffers[m_Galaxy->GetCurrent()];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TrajectoryRecorder::BuildCommandBuffer(Slot &ioSlot, uint32_t iSource)
+{
+    // The buffer read by the last step, with the speeds synchronized with the positions.
+    const olp::MemoryBuffer &vertexBuffer = m_Galaxy->GetVertexBuffer(1 - iSource);
+    VkCommandBuffer commandBuffer = ioSlot.CommandBuffers[iSource];
+
+    VkCommandBufferBeginInfo cmdBufInfo{};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo))
+
+    // The step wrote the synchronized speeds.
+    VkBufferMemoryBarrier shaderToTransfer{};
+    shaderToTransfer.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    shaderToTransfer.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    shaderToTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    shaderToTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    shaderToTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    shaderToTransfer.buffer = vertexBuffer.Buffer;
+    shaderToTransfer.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        nullptr,
+        1,
+        &shaderToTransfer,
+        0,
+        nullptr);
+
+    VkBufferCopy region{};
+    region.size = vertexBuffer.Size;
+    vkCmdCopyBuffer(commandBuffer, vertexBuffer.Buffer, ioSlot.Buffer.Buffer, 1, &region);
+
+    // The copy is visible to the host once the event is set.
+    VkBufferMemoryBarrier transferToHost{};
+    transferToHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    transferToHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    transferToHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    transferToHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    transferToHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    transferToHost.buffer = ioSlot.Buffer.Buffer;
+    transferToHost.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        0,
+        nullptr,
+        1,
+        &transferToHost,
+        0,
+        nullptr);
+    vkCmdSetEvent(commandBuffer, ioSlot.Event, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer))
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TrajectoryRecorder::CollectCopies()
+{
+    // The copies run in submission order on the compute queue: stop at the first one not done.
+    while (!m_Copying.empty())
+    {
+        const uint32_t slotIndex = m_Copying.front();
+        Slot &slot = m_Slots[slotIndex];
+        if (vkGetEventStatus(m_Device.GetDevice(), slot.Event) != VK_EVENT_SET)
+            break;
+
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot.Buffer.Memory;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(m_Device.GetDevice(), 1, &range);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            slot.Status = Slot::State::Writing;
+            m_Writing.push_back(slotIndex);
+        }
+        m_Condition.notify_one();
+        m_Copying.pop_front();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TrajectoryRecorder::WriteLoop()
+{
+    for (;;)
+    {
+        uint32_t slotIndex = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this] { return !m_Writing.empty() || m_StopWriter; });
+            // Stops once every copy is written.
+            if (m_Writing.empty())
+                return;
+            slotIndex = m_Writing.front();
+            m_Writing.pop_front();
+        }
+
+        const Slot &slot = m_Slots[slotIndex];
+        FrameHeader header{};
+        header.Step = slot.Step;
+        header.NbStars = m_NbStars;
+        m_File.write(reinterpret_cast<const char *>(&header), sizeof(FrameHeader));
+        m_File.write(static_cast<const char *>(slot.Data), static_cast<std::streamsize>(slot.Buffer.Size));
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Slots[slotIndex].Status = Slot::State::Free;
+    }
+}
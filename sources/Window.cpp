@@ -1,6 +1,8 @@
 #include "Window.h"
 #include "Olympus/Debug.h"
+#include "Snapshot.h"
 #include <imgui/imgui.h>
+#include <iostream>
 
 // TODO percent of max size.
 //----------------------------------------------------------------------------------------------------------------------
@@ -46,9 +48,7 @@ Window::Window(std::string iName, uint32_t iWidth, uint32_t iHeight)
     CreateSurface();
 
     m_Renderer = std::make_unique<Renderer>(m_Instance, m_Surface, m_Width, m_Height);
-    m_Renderer->InitializeGalaxy(m_Menu.GetGalaxyParameters().NbStars, m_Menu.GetGalaxyParameters().Diameter,
-                                 m_Menu.GetGalaxyParameters().Thickness, m_Menu.GetGalaxyParameters().StarsSpeed,
-                                 m_Menu.GetGalaxyParameters().BlackHoleMass);
+    InitializeGalaxy();
 
     m_Camera.SetPerspective(45.0f, static_cast<float>(m_Width) / static_cast<float>(m_Height), 0.1f, 1000.0f);
     m_Camera.SetPosition(glm::vec3(0.0f, 0.0f, -150.0f));
@@ -74,12 +74,19 @@ void Window::Run()
     {
         if (m_Menu.IsRestart())
             Restart();
+        if (m_Menu.IsSaveSnapshot())
+            SaveSnapshot();
+        if (m_Menu.IsLoadSnapshot())
+            LoadSnapshot();
 
         MouseInteraction();
         m_Menu.UpdateMenu();
         UpdateParameters();
+        UpdateRecording();
+        UpdateGpuTimes();
 
         m_Renderer->DrawNextFrame(m_Camera.GetViewMatrix(), m_Camera.GetPerspectiveMatrix());
+        ++m_FrameIndex;
         glfwPollEvents();
     }
 }
@@ -143,15 +150,126 @@ void Window::UpdateParameters()
     m_Renderer->SetStep(m_Menu.GetRealTimeParameters().Step);
     m_Renderer->SetInteractionRate(m_Menu.GetRealTimeParameters().InteractionRate);
     m_Renderer->SetSmoothLenght(m_Menu.GetRealTimeParameters().SmoothingLenght);
+    m_Renderer->SetRotateSources(m_Menu.GetRealTimeParameters().RotateSources);
+    m_Renderer->SetSubsteps(static_cast<uint32_t>(m_Menu.GetRealTimeParameters().Substeps));
+    m_Renderer->SetAdaptiveStep(m_Menu.GetRealTimeParameters().AdaptiveStep, m_Menu.GetRealTimeParameters().StepAccuracy);
+    m_Renderer->SetMonitoring(m_Menu.IsMonitoring());
+    m_Renderer->SetReorderInterval(static_cast<uint32_t>(m_Menu.GetRealTimeParameters().ReorderInterval));
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void Window::Restart()
 {
     m_Renderer->ReleaseGalaxy();
-    m_Renderer->InitializeGalaxy(m_Menu.GetGalaxyParameters().NbStars, m_Menu.GetGalaxyParameters().Diameter,
-                                 m_Menu.GetGalaxyParameters().Thickness, m_Menu.GetGalaxyParameters().StarsSpeed,
-                                 m_Menu.GetGalaxyParameters().BlackHoleMass);
+    m_Menu.StopRecording();
+    InitializeGalaxy();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Window::InitializeGalaxy()
+{
+    const Menu::GalaxyParameters &galaxy = m_Menu.GetGalaxyParameters();
+    const AccelerationPass::Kernel kernel =
+        galaxy.TiledAcceleration ? AccelerationPass::Kernel::Tiled : AccelerationPass::Kernel::Direct;
+    const IntegrationPass::Scheme scheme =
+        galaxy.FusedLeapfrog ? IntegrationPass::Scheme::FusedLeapfrog : IntegrationPass::Scheme::Split;
+
+    const std::vector<GalaxyDescription> merger = galaxy.GetMerger();
+    if (!merger.empty())
+        m_Renderer->InitializeGalaxies(merger, kernel, scheme);
+    else
+        m_Renderer->InitializeGalaxy(galaxy.NbStars, galaxy.Diameter, galaxy.Thickness, galaxy.StarsSpeed,
+                                     galaxy.BlackHoleMass, kernel, scheme);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Window::SaveSnapshot()
+{
+    try
+    {
+        // The black holes of a merger are among the stars, the snapshot has no fixed black hole.
+        Menu::GalaxyParameters galaxy = m_Menu.GetGalaxyParameters();
+        if (galaxy.NbGalaxies > 1)
+            galaxy.BlackHoleMass = 0.f;
+        m_Renderer->SaveSnapshot(m_Menu.GetSnapshotPath(), galaxy, m_Menu.GetRealTimeParameters());
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Window::LoadSnapshot()
+{
+    try
+    {
+        Snapshot snapshot(m_Menu.GetSnapshotPath());
+        m_Menu.SetParameters(snapshot.GetGalaxyParameters(), snapshot.GetRealTimeParameters());
+
+        m_Renderer->ReleaseGalaxy();
+        m_Menu.StopRecording();
+        m_Renderer->InitializeGalaxy(snapshot.GetStars(), snapshot.GetNbStars(), m_Menu.GetGalaxyParameters().BlackHoleMass,
+                                     m_Menu.GetGalaxyParameters().TiledAcceleration ? AccelerationPass::Kernel::Tiled
+                                                                                    : AccelerationPass::Kernel::Direct,
+                                     m_Menu.GetGalaxyParameters().FusedLeapfrog ? IntegrationPass::Scheme::FusedLeapfrog
+                                                                                : IntegrationPass::Scheme::Split,
+                                     snapshot.GetNbBlackHoles());
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Window::UpdateRecording()
+{
+    const TrajectoryRecorder &recorder = m_Renderer->GetRecorder();
+    if (m_Menu.IsRecording() && !recorder.IsRecording())
+    {
+        try
+        {
+            m_Renderer->StartRecording(m_Menu.GetTrajectoryPath(), m_Menu.GetRecordInterval());
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+            m_Menu.StopRecording();
+        }
+    }
+    else if (!m_Menu.IsRecording() && recorder.IsRecording())
+        m_Renderer->StopRecording();
+
+    m_Menu.SetRecordedSteps(recorder.GetNbRecorded(), recorder.GetNbDropped());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Window::UpdateGpuTimes()
+{
+    const Menu::GpuTimes &times = m_Renderer->GetGpuTimes();
+    m_Menu.AddGpuTimes(times);
+    if (m_Menu.IsMonitoring())
+        m_Menu.AddQuantities(m_Renderer->GetQuantities());
+
+    if (m_Menu.IsLogGpuTimes() && !m_GpuTimesLog.is_open())
+    {
+        m_GpuTimesLog.open(m_Menu.GetGpuTimesPath(), std::ios::trunc);
+        if (!m_GpuTimesLog)
+        {
+            std::cerr << "cannot open " << m_Menu.GetGpuTimesPath() << std::endl;
+            m_GpuTimesLog.clear();
+            m_Menu.StopLogGpuTimes();
+            return;
+        }
+        m_GpuTimesLog << "frame,acceleration_ms,integration_ms,cloud_ms,imgui_ms,reduction_ms,reorder_ms\n";
+    }
+    else if (!m_Menu.IsLogGpuTimes() && m_GpuTimesLog.is_open())
+        m_GpuTimesLog.close();
+
+    if (m_GpuTimesLog.is_open())
+        m_GpuTimesLog << m_FrameIndex << "," << times.Acceleration << "," << times.Integration << "," << times.Cloud
+                      << "," << times.ImGui << "," << times.Reduction << "," << times.Reorder << "\n";
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -1,8 +1,48 @@
 #include "Window.h"
+#include "CommandLine.h"
+#include "CpuRunner.h"
+#include "HeadlessRunner.h"
+#include <iostream>
+#include <stdexcept>
 
-int main()
+int main(int argc, char **argv)
 {
+    CommandLineOptions options;
+    try
+    {
+        options = ParseCommandLine(argc, argv);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << e.what() << "\n"
+                  << GetCommandLineUsage();
+        return 1;
+    }
+
+    try
+    {
+        if (options.RunMode == CommandLineOptions::Mode::Cpu)
+        {
+            CpuRunner runner(options);
+            runner.Run();
+            return 0;
+        }
+
+        if (options.RunMode == CommandLineOptions::Mode::Headless)
+        {
+            HeadlessRunner runner(options);
+            runner.Run();
+            return 0;
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        // Snapshot that cannot be read or written, or failed validation.
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
     Window window("Galaxy simation", 1200, 800);
     window.Run();
     return 0;
-}
\ No newline at end of file
+}